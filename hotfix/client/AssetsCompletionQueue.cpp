@@ -0,0 +1,187 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsCompletionQueue.h"
+
+#include <thread>
+
+NS_CC_EXT_BEGIN
+
+// Implementation of AssetsCompletionQueue
+
+AssetsCompletionQueue::AssetsCompletionQueue(int slotCount)
+: _enqueuePos(0)
+, _dequeuePos(0)
+{
+    if (slotCount < 1)
+        slotCount = 1;
+    for (int i = slotCount - 1; i >= 0; --i)
+    {
+        _slots.emplace_back(new Slot());
+        _freeSlots.push_back(i);
+    }
+
+    // A slot has at most one progress and one completion in the ring, plus as many
+    // from the task it ran before when it's reused before the consumer caught up
+    size_t capacity = 1;
+    while (capacity < (size_t)slotCount * 4)
+    {
+        capacity <<= 1;
+    }
+    _cells.reset(new Cell[capacity]);
+    _mask = capacity - 1;
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+int AssetsCompletionQueue::acquire()
+{
+    if (_freeSlots.empty())
+        return -1;
+    int slot = _freeSlots.back();
+    _freeSlots.pop_back();
+    Slot &s = *_slots[slot];
+    s.used = true;
+    s.progressQueued.store(false, std::memory_order_relaxed);
+    s.totalBytesReceived.store(0, std::memory_order_relaxed);
+    s.totalBytesExpected.store(0, std::memory_order_relaxed);
+    s.forwardedBytes = 0;
+    return slot;
+}
+
+void AssetsCompletionQueue::release(int slot)
+{
+    Slot &s = *_slots[slot];
+    if (!s.used)
+        return;
+    s.used = false;
+    s.generation.fetch_add(1, std::memory_order_release);
+    _freeSlots.push_back(slot);
+}
+
+void AssetsCompletionQueue::releaseAll()
+{
+    for (int i = (int)_slots.size() - 1; i >= 0; --i)
+    {
+        release(i);
+    }
+}
+
+void AssetsCompletionQueue::pushProgress(int slot, int64_t totalBytesReceived, int64_t totalBytesExpected)
+{
+    Slot &s = *_slots[slot];
+    s.totalBytesReceived.store(totalBytesReceived, std::memory_order_relaxed);
+    s.totalBytesExpected.store(totalBytesExpected, std::memory_order_relaxed);
+    // Merged with the progress already waiting in the ring, if any
+    if (!s.progressQueued.exchange(true, std::memory_order_acq_rel))
+    {
+        push(Type::PROGRESS, slot);
+    }
+}
+
+void AssetsCompletionQueue::pushSuccess(int slot)
+{
+    push(Type::SUCCESS, slot);
+}
+
+void AssetsCompletionQueue::pushError(int slot, int errorCode, int errorCodeInternal, const std::string &errorStr)
+{
+    Slot &s = *_slots[slot];
+    s.errorCode = errorCode;
+    s.errorCodeInternal = errorCodeInternal;
+    s.errorStr = errorStr;
+    push(Type::FAILURE, slot);
+}
+
+void AssetsCompletionQueue::push(Type type, int slot)
+{
+    uint32_t generation = _slots[slot]->generation.load(std::memory_order_acquire);
+    size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    Cell *cell = nullptr;
+    while (true)
+    {
+        cell = &_cells[pos & _mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0)
+        {
+            if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // Full, only when the consumer fell a whole ring behind: wait for it rather than lose a completion
+            std::this_thread::yield();
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->entry.type = type;
+    cell->entry.slot = slot;
+    cell->entry.generation = generation;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool AssetsCompletionQueue::pop(Completion *completion)
+{
+    while (true)
+    {
+        Cell *cell = &_cells[_dequeuePos & _mask];
+        if (cell->sequence.load(std::memory_order_acquire) != _dequeuePos + 1)
+            return false;
+        Entry entry = cell->entry;
+        cell->sequence.store(_dequeuePos + _mask + 1, std::memory_order_release);
+        ++_dequeuePos;
+
+        Slot &s = *_slots[entry.slot];
+        if (!s.used || entry.generation != s.generation.load(std::memory_order_relaxed))
+            continue;
+
+        completion->type = entry.type;
+        completion->slot = entry.slot;
+        completion->errorStr = nullptr;
+        if (entry.type == Type::PROGRESS)
+        {
+            // Cleared before reading, a later progress queues a new entry
+            s.progressQueued.store(false, std::memory_order_release);
+        }
+        else if (entry.type == Type::FAILURE)
+        {
+            completion->errorCode = s.errorCode;
+            completion->errorCodeInternal = s.errorCodeInternal;
+            completion->errorStr = &s.errorStr;
+        }
+        completion->totalBytesReceived = s.totalBytesReceived.load(std::memory_order_acquire);
+        completion->totalBytesExpected = s.totalBytesExpected.load(std::memory_order_relaxed);
+        completion->bytesReceived = completion->totalBytesReceived - s.forwardedBytes;
+        s.forwardedBytes = completion->totalBytesReceived;
+        return true;
+    }
+}
+
+NS_CC_EXT_END
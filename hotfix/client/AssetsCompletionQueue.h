@@ -0,0 +1,148 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsCompletionQueue__
+#define __AssetsCompletionQueue__
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   Hands download results from the threads of a download backend to the thread driving the downloads.
+ *          Each running task owns a slot, acquired when it starts. Producers on any thread push completions
+ *          into a bounded multiple producer / single consumer ring without locks or allocations, and the
+ *          progress of a task is merged in its slot, so at most one progress entry per task waits in the ring
+ *          however many chunks arrive before the consumer drains it.
+ */
+class CC_EX_DLL AssetsCompletionQueue
+{
+public:
+
+    enum class Type : uint8_t
+    {
+        PROGRESS,
+        SUCCESS,
+        FAILURE
+    };
+
+    //! Result of a task as seen by the consumer, valid until the next pop
+    struct Completion
+    {
+        Type type;
+        int slot;
+        //! Bytes received since the previous progress of the slot
+        int64_t bytesReceived;
+        int64_t totalBytesReceived;
+        int64_t totalBytesExpected;
+        int errorCode;
+        int errorCodeInternal;
+        const std::string *errorStr;
+    };
+
+    /** @param slotCount     Max number of tasks running at once
+     */
+    explicit AssetsCompletionQueue(int slotCount);
+
+    int getSlotCount() const { return (int)_slots.size(); }
+
+    /** @brief Consumer side, slot for a task about to start, -1 if all of them are used
+     */
+    int acquire();
+
+    /** @brief Consumer side, give the slot of a finished or aborted task back.
+     *         Entries it still has in the ring are skipped by pop.
+     */
+    void release(int slot);
+
+    /** @brief Consumer side, release all slots, once the backend reported it won't call back for them anymore
+     */
+    void releaseAll();
+
+    // Producer side, from any thread, for a slot acquired and not released yet
+
+    void pushProgress(int slot, int64_t totalBytesReceived, int64_t totalBytesExpected);
+
+    void pushSuccess(int slot);
+
+    void pushError(int slot, int errorCode, int errorCodeInternal, const std::string &errorStr);
+
+    /** @brief Consumer side, next completion of a live slot, false when the ring is empty
+     */
+    bool pop(Completion *completion);
+
+private:
+    struct Slot
+    {
+        Slot() : generation(0), used(false), progressQueued(false), totalBytesReceived(0), totalBytesExpected(0), forwardedBytes(0), errorCode(0), errorCodeInternal(0) {}
+
+        //! Bumped on release so entries of the previous task are recognized
+        std::atomic<uint32_t> generation;
+        bool used;
+        //! Whether a progress entry of the slot is in the ring
+        std::atomic<bool> progressQueued;
+        std::atomic<int64_t> totalBytesReceived;
+        std::atomic<int64_t> totalBytesExpected;
+        //! Total reported by the last progress popped, consumer only
+        int64_t forwardedBytes;
+        //! Written by the producer before it pushes the error
+        int errorCode;
+        int errorCodeInternal;
+        std::string errorStr;
+    };
+
+    struct Entry
+    {
+        Type type;
+        int slot;
+        uint32_t generation;
+    };
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Entry entry;
+    };
+
+    void push(Type type, int slot);
+
+    std::vector<std::unique_ptr<Slot>> _slots;
+    std::vector<int> _freeSlots;
+
+    std::unique_ptr<Cell[]> _cells;
+    size_t _mask;
+    std::atomic<size_t> _enqueuePos;
+    size_t _dequeuePos;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsCompletionQueue__) */
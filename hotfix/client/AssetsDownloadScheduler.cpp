@@ -0,0 +1,381 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsDownloadScheduler.h"
+#include "base/ccUTF8.h"
+#include "base/CCDirector.h"
+#include "base/CCScheduler.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+NS_CC_EXT_BEGIN
+
+#define DEFAULT_CONNECTION_TIMEOUT 45
+
+#define DRAIN_SCHEDULE_KEY "AssetsDownloadScheduler"
+
+// Implementation of SharedAssetsDownloader
+
+SharedAssetsDownloader::SharedAssetsDownloader(AssetsDownloadScheduler *scheduler, int priority)
+: _scheduler(scheduler)
+, _priority(1)
+, _running(0)
+{
+    setPriority(priority);
+}
+
+SharedAssetsDownloader::~SharedAssetsDownloader()
+{
+    _scheduler->unregister(this);
+}
+
+void SharedAssetsDownloader::createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier)
+{
+    PendingTask task;
+    task.srcUrl = srcUrl;
+    task.storagePath = storagePath;
+    task.identifier = identifier;
+    _scheduler->enqueue(this, std::move(task));
+}
+
+void SharedAssetsDownloader::cancelAll()
+{
+    _scheduler->cancel(this);
+}
+
+// Implementation of AssetsDownloadScheduler
+
+AssetsDownloadScheduler* AssetsDownloadScheduler::s_sharedScheduler = nullptr;
+
+AssetsDownloadScheduler* AssetsDownloadScheduler::getInstance()
+{
+    if (!s_sharedScheduler)
+    {
+        s_sharedScheduler = new (std::nothrow) AssetsDownloadScheduler();
+    }
+    return s_sharedScheduler;
+}
+
+void AssetsDownloadScheduler::destroyInstance()
+{
+    CC_SAFE_DELETE(s_sharedScheduler);
+}
+
+AssetsDownloadScheduler::AssetsDownloadScheduler()
+: _runningCount(0)
+, _maxConnections(DEFAULT_MAX_CONNECTIONS)
+, _policy(Policy::FAIR)
+, _forwarding(false)
+{
+}
+
+AssetsDownloadScheduler::~AssetsDownloadScheduler()
+{
+    if (_backend)
+    {
+        _backend->onTaskError = (nullptr);
+        _backend->onFileTaskSuccess = (nullptr);
+        _backend->onTaskProgress = (nullptr);
+        Director::getInstance()->getScheduler()->unschedule(DRAIN_SCHEDULE_KEY, this);
+    }
+}
+
+std::shared_ptr<SharedAssetsDownloader> AssetsDownloadScheduler::createDownloader(int priority)
+{
+    std::shared_ptr<SharedAssetsDownloader> downloader(new (std::nothrow) SharedAssetsDownloader(this, priority));
+    if (downloader)
+    {
+        _downloaders.push_back(downloader.get());
+    }
+    return downloader;
+}
+
+void AssetsDownloadScheduler::setBackend(const std::shared_ptr<IAssetsDownloader> &backend)
+{
+    if (_runningCount > 0)
+    {
+        CCLOGERROR("AssetsDownloadScheduler::setBackend, tasks are running");
+        return;
+    }
+    if (_backend)
+    {
+        _backend->onTaskError = (nullptr);
+        _backend->onFileTaskSuccess = (nullptr);
+        _backend->onTaskProgress = (nullptr);
+    }
+    _backend = backend;
+    initBackend();
+}
+
+void AssetsDownloadScheduler::initBackend()
+{
+    if (!_backend)
+    {
+        _backend = std::make_shared<NetworkAssetsDownloader>(_maxConnections, DEFAULT_CONNECTION_TIMEOUT);
+    }
+    // Sized for the connections of the backend, a budget raised later is capped by it
+    if (!_completions || _completions->getSlotCount() < _maxConnections)
+    {
+        _completions.reset(new AssetsCompletionQueue(_maxConnections));
+        _running.assign(_maxConnections, RunningTask());
+    }
+
+    // Called from any thread, they only touch the completion queue
+    _backend->onTaskError = [this](const network::DownloadTask &task, int errorCode, int errorCodeInternal, const std::string &errorStr) {
+        int slot = slotOf(task);
+        if (slot >= 0)
+            _completions->pushError(slot, errorCode, errorCodeInternal, errorStr);
+    };
+    _backend->onTaskProgress = [this](const network::DownloadTask &task, int64_t /*bytesReceived*/, int64_t totalBytesReceived, int64_t totalBytesExpected) {
+        int slot = slotOf(task);
+        if (slot >= 0)
+            _completions->pushProgress(slot, totalBytesReceived, totalBytesExpected);
+    };
+    _backend->onFileTaskSuccess = [this](const network::DownloadTask &task) {
+        int slot = slotOf(task);
+        if (slot >= 0)
+            _completions->pushSuccess(slot);
+    };
+
+    Director::getInstance()->getScheduler()->schedule([this](float /*dt*/) {
+        drain();
+    }, this, 0, false, DRAIN_SCHEDULE_KEY);
+}
+
+int AssetsDownloadScheduler::slotOf(const network::DownloadTask &task) const
+{
+    const char *identifier = task.identifier.c_str();
+    char *end = nullptr;
+    long slot = strtol(identifier, &end, 10);
+    if (end == identifier || *end != '\0' || slot < 0 || slot >= _completions->getSlotCount())
+        return -1;
+    return (int)slot;
+}
+
+void AssetsDownloadScheduler::enqueue(SharedAssetsDownloader *owner, SharedAssetsDownloader::PendingTask &&task)
+{
+    owner->_pending.push_back(std::move(task));
+    if (!_forwarding)
+    {
+        pump();
+    }
+}
+
+void AssetsDownloadScheduler::cancel(SharedAssetsDownloader *owner)
+{
+    owner->_pending.clear();
+    if (owner->_running == 0)
+        return;
+
+    // The backend can only abort all of its tasks, so the transfers of owner are detached instead
+    // and the other downloaders keep theirs, drain() frees their slots when the backend ends them
+    bool othersRunning = false;
+    for (auto &running : _running)
+    {
+        if (running.owner == owner)
+        {
+            running.owner = nullptr;
+            running.detached = true;
+        }
+        else if (running.owner)
+        {
+            othersRunning = true;
+        }
+    }
+    owner->_running = 0;
+    if (othersRunning)
+        return;
+
+    // Only detached transfers are left, abort them to free their connections now
+    for (auto &running : _running)
+    {
+        running.detached = false;
+    }
+    _runningCount = 0;
+    _backend->cancelAll();
+    // After cancelAll, so completions queued before it are dropped with their slots
+    _completions->releaseAll();
+    if (!_forwarding)
+    {
+        pump();
+    }
+}
+
+void AssetsDownloadScheduler::unregister(SharedAssetsDownloader *owner)
+{
+    cancel(owner);
+    auto it = std::find(_downloaders.begin(), _downloaders.end(), owner);
+    if (it != _downloaders.end())
+    {
+        _downloaders.erase(it);
+    }
+}
+
+SharedAssetsDownloader* AssetsDownloadScheduler::pickNext() const
+{
+    SharedAssetsDownloader *next = nullptr;
+    for (auto downloader : _downloaders)
+    {
+        // A task whose file is still written by a detached transfer holds back its downloader
+        if (downloader->_pending.empty() || isDetachedPath(downloader->_pending.front().storagePath))
+            continue;
+        if (!next)
+        {
+            next = downloader;
+        }
+        else if (_policy == Policy::PRIORITY)
+        {
+            if (downloader->_priority > next->_priority
+                || (downloader->_priority == next->_priority && downloader->_running < next->_running))
+            {
+                next = downloader;
+            }
+        }
+        else
+        {
+            // Lowest share of connections per priority unit, compared without division
+            if (downloader->_running * next->_priority < next->_running * downloader->_priority)
+            {
+                next = downloader;
+            }
+        }
+    }
+    return next;
+}
+
+bool AssetsDownloadScheduler::isDetachedPath(const std::string &storagePath) const
+{
+    for (const auto &running : _running)
+    {
+        if (running.detached && running.task.storagePath == storagePath)
+            return true;
+    }
+    return false;
+}
+
+void AssetsDownloadScheduler::pump()
+{
+    if (!_backend || !_backend->onFileTaskSuccess)
+    {
+        initBackend();
+    }
+    int maxConnections = MIN(_maxConnections, _completions->getSlotCount());
+    while (_runningCount < maxConnections)
+    {
+        SharedAssetsDownloader *next = pickNext();
+        if (!next)
+            break;
+        SharedAssetsDownloader::PendingTask task = std::move(next->_pending.front());
+        next->_pending.pop_front();
+        start(next, std::move(task));
+    }
+}
+
+void AssetsDownloadScheduler::start(SharedAssetsDownloader *owner, SharedAssetsDownloader::PendingTask &&task)
+{
+    int slot = _completions->acquire();
+    RunningTask &running = _running[slot];
+    running.owner = owner;
+    running.task = std::move(task);
+    owner->_running++;
+    _runningCount++;
+    _backend->createDownloadFileTask(running.task.srcUrl, running.task.storagePath, StringUtils::format("%d", slot));
+}
+
+SharedAssetsDownloader* AssetsDownloadScheduler::forward(int slot, bool finished)
+{
+    RunningTask &running = _running[slot];
+    SharedAssetsDownloader *owner = running.owner;
+    _forwardTask.identifier.assign(running.task.identifier);
+    _forwardTask.requestURL.assign(running.task.srcUrl);
+    _forwardTask.storagePath.assign(running.task.storagePath);
+    if (finished)
+    {
+        owner->_running--;
+        _runningCount--;
+        running.owner = nullptr;
+        _completions->release(slot);
+    }
+    return owner;
+}
+
+void AssetsDownloadScheduler::drain()
+{
+    if (!_completions)
+        return;
+
+    bool wasForwarding = _forwarding;
+    _forwarding = true;
+    AssetsCompletionQueue::Completion completion;
+    // Owners may cancel while completions are forwarded, pop skips the slots it releases
+    while (_completions->pop(&completion))
+    {
+        RunningTask &running = _running[completion.slot];
+        if (!running.owner)
+        {
+            // Dropped, the slot of a detached transfer is freed once it ends
+            if (running.detached && completion.type != AssetsCompletionQueue::Type::PROGRESS)
+            {
+                running.detached = false;
+                _runningCount--;
+                _completions->release(completion.slot);
+            }
+            continue;
+        }
+        switch (completion.type)
+        {
+            case AssetsCompletionQueue::Type::PROGRESS:
+            {
+                SharedAssetsDownloader *owner = forward(completion.slot, false);
+                if (owner->onTaskProgress)
+                    owner->onTaskProgress(_forwardTask, completion.bytesReceived, completion.totalBytesReceived, completion.totalBytesExpected);
+            }
+                break;
+            case AssetsCompletionQueue::Type::SUCCESS:
+            {
+                SharedAssetsDownloader *owner = forward(completion.slot, true);
+                if (owner->onFileTaskSuccess)
+                    owner->onFileTaskSuccess(_forwardTask);
+            }
+                break;
+            case AssetsCompletionQueue::Type::FAILURE:
+            {
+                // Copied, the slot may be reused by the time the owner reads it
+                std::string errorStr = *completion.errorStr;
+                SharedAssetsDownloader *owner = forward(completion.slot, true);
+                if (owner->onTaskError)
+                    owner->onTaskError(_forwardTask, completion.errorCode, completion.errorCodeInternal, errorStr);
+            }
+                break;
+        }
+    }
+    _forwarding = wasForwarding;
+    if (!_forwarding)
+    {
+        pump();
+    }
+}
+
+NS_CC_EXT_END
@@ -0,0 +1,233 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsDownloadScheduler__
+#define __AssetsDownloadScheduler__
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AssetsCompletionQueue.h"
+#include "AssetsManagerExEnv.h"
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+
+NS_CC_EXT_BEGIN
+
+class AssetsDownloadScheduler;
+
+/**
+ * @brief   Download backend of one AssetsManagerEx, sharing the connections of the process wide
+ *          AssetsDownloadScheduler with the other managers. Created by AssetsDownloadScheduler::createDownloader.
+ */
+class CC_EX_DLL SharedAssetsDownloader : public IAssetsDownloader
+{
+public:
+    virtual ~SharedAssetsDownloader();
+
+    /** @brief Queue the task, it starts when the scheduler gives this downloader a connection
+     */
+    virtual void createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier) override;
+
+    /** @brief Drop the queued tasks and detach the running ones of this downloader, the other downloaders
+     *         keep their transfers. Detached transfers hold their connection until the backend ends them,
+     *         their results are dropped, and a new task for the same storage path waits for them.
+     */
+    virtual void cancelAll() override;
+
+    /** @brief Priority among the downloaders of the scheduler, at least 1.
+     *         It's the share of connections with AssetsDownloadScheduler::Policy::FAIR,
+     *         the rank with AssetsDownloadScheduler::Policy::PRIORITY.
+     */
+    void setPriority(int priority) { _priority = priority > 0 ? priority : 1; };
+
+    int getPriority() const { return _priority; };
+
+    /** @brief Number of tasks waiting for a connection
+     */
+    size_t getQueuedCount() const { return _pending.size(); };
+
+    /** @brief Number of tasks running in the shared downloader
+     */
+    int getRunningCount() const { return _running; };
+
+private:
+    friend class AssetsDownloadScheduler;
+
+    struct PendingTask
+    {
+        std::string srcUrl;
+        std::string storagePath;
+        std::string identifier;
+    };
+
+    SharedAssetsDownloader(AssetsDownloadScheduler *scheduler, int priority);
+
+    AssetsDownloadScheduler *_scheduler;
+    int _priority;
+    int _running;
+    std::deque<PendingTask> _pending;
+};
+
+/**
+ * @brief   Process wide download scheduler: every AssetsManagerEx created without its own downloader
+ *          registers here, and all of them share one download backend and one connection budget.
+ *          Like network::Downloader, it's driven from the main thread. Backend callbacks go through an
+ *          AssetsCompletionQueue drained once per frame, so the backend may call them from its own threads
+ *          and the progress of a task reaches its downloader at most once per frame.
+ */
+class CC_EX_DLL AssetsDownloadScheduler
+{
+public:
+
+    //! How connections are shared between downloaders with queued tasks
+    enum class Policy
+    {
+        //! In proportion to the priority of each downloader
+        FAIR,
+        //! The highest priority downloader first, lower ones only get the connections it leaves
+        PRIORITY
+    };
+
+    static const int DEFAULT_MAX_CONNECTIONS = 32;
+
+    static const int DEFAULT_PRIORITY = 1;
+
+    static AssetsDownloadScheduler* getInstance();
+
+    /** @brief Destroy the scheduler, all downloaders it created must be released before
+     */
+    static void destroyInstance();
+
+    /** @brief Create a downloader for one AssetsManagerEx, to set as AssetsManagerExEnv::downloader
+     */
+    std::shared_ptr<SharedAssetsDownloader> createDownloader(int priority = DEFAULT_PRIORITY);
+
+    /** @brief Set the total number of connections of all downloaders.
+     *         The default backend is created with the budget set when the first task starts,
+     *         a budget raised later is capped by it.
+     */
+    void setMaxConnections(int maxConnections) { _maxConnections = maxConnections > 0 ? maxConnections : 1; };
+
+    int getMaxConnections() const { return _maxConnections; };
+
+    void setPolicy(Policy policy) { _policy = policy; };
+
+    Policy getPolicy() const { return _policy; };
+
+    /** @brief Replace the download backend, network::Downloader by default.
+     *         Its callbacks may be invoked from any thread. Only while no task is running.
+     */
+    void setBackend(const std::shared_ptr<IAssetsDownloader> &backend);
+
+    /** @brief Number of tasks running in the backend, for all downloaders
+     */
+    size_t getRunningCount() const { return (size_t)_runningCount; };
+
+CC_CONSTRUCTOR_ACCESS:
+
+    AssetsDownloadScheduler();
+
+    ~AssetsDownloadScheduler();
+
+protected:
+
+    friend class SharedAssetsDownloader;
+
+    struct RunningTask
+    {
+        SharedAssetsDownloader *owner = nullptr;
+        SharedAssetsDownloader::PendingTask task;
+        //! Its owner cancelled it, the slot is freed when the backend reports its end
+        bool detached = false;
+    };
+
+    void enqueue(SharedAssetsDownloader *owner, SharedAssetsDownloader::PendingTask &&task);
+
+    void cancel(SharedAssetsDownloader *owner);
+
+    void unregister(SharedAssetsDownloader *owner);
+
+    /** @brief Start queued tasks while connections are left
+     */
+    void pump();
+
+    /** @brief Downloader whose next queued task gets the free connection, nullptr if nothing is queued
+     */
+    SharedAssetsDownloader* pickNext() const;
+
+    /** @brief Whether a detached transfer still writes to storagePath
+     */
+    bool isDetachedPath(const std::string &storagePath) const;
+
+    void start(SharedAssetsDownloader *owner, SharedAssetsDownloader::PendingTask &&task);
+
+    void initBackend();
+
+    /** @brief Slot of the running task a backend callback is about, -1 if it isn't one of ours
+     */
+    int slotOf(const network::DownloadTask &task) const;
+
+    /** @brief Build the task its owner knows for a running slot
+     @return    The owner
+     */
+    SharedAssetsDownloader* forward(int slot, bool finished);
+
+    /** @brief Forward the completions queued since the last frame to the owners, then start queued tasks
+     */
+    void drain();
+
+private:
+    static AssetsDownloadScheduler *s_sharedScheduler;
+
+    std::shared_ptr<IAssetsDownloader> _backend;
+
+    //! Registered downloaders, in creation order
+    std::vector<SharedAssetsDownloader*> _downloaders;
+
+    //! Completions of the backend, the slot of a running task is its backend identifier
+    std::unique_ptr<AssetsCompletionQueue> _completions;
+
+    //! Running tasks, indexed by completion slot
+    std::vector<RunningTask> _running;
+
+    //! Running tasks in the backend, detached ones included
+    int _runningCount;
+
+    int _maxConnections;
+
+    Policy _policy;
+
+    //! Task handed to the owner callbacks, reused to avoid copies on every progression
+    network::DownloadTask _forwardTask;
+
+    //! Whether a callback is being forwarded, pump() is deferred to its end
+    bool _forwarding;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsDownloadScheduler__) */
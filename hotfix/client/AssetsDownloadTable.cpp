@@ -0,0 +1,121 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsDownloadTable.h"
+
+NS_CC_EXT_BEGIN
+
+uint32_t AssetsDownloadTable::intern(const std::string &prefix)
+{
+    auto it = _prefixIndexes.find(prefix);
+    if (it != _prefixIndexes.end())
+        return it->second;
+    uint32_t index = (uint32_t)_prefixes.size();
+    _prefixes.push_back(prefix);
+    _prefixIndexes.emplace(prefix, index);
+    return index;
+}
+
+void AssetsDownloadTable::setPath(const std::string &key, const std::string &path)
+{
+    if (path == key)
+    {
+        _paths.erase(key);
+    }
+    else
+    {
+        _paths[key] = path;
+    }
+}
+
+void AssetsDownloadTable::add(const std::string &key, const std::string &urlPrefix, const std::string &storagePrefix, const std::string &path, float size)
+{
+    Unit unit;
+    unit.size = size;
+    unit.urlPrefix = intern(urlPrefix);
+    unit.storagePrefix = intern(storagePrefix);
+    _units[key] = unit;
+    setPath(key, path);
+}
+
+void AssetsDownloadTable::addPaths(const std::string &key, const std::string &srcUrl, const std::string &storagePath, float size)
+{
+    size_t common = 0;
+    size_t maxCommon = srcUrl.size() < storagePath.size() ? srcUrl.size() : storagePath.size();
+    while (common < maxCommon && srcUrl[srcUrl.size() - 1 - common] == storagePath[storagePath.size() - 1 - common])
+    {
+        ++common;
+    }
+    add(key, srcUrl.substr(0, srcUrl.size() - common), storagePath.substr(0, storagePath.size() - common),
+        srcUrl.substr(srcUrl.size() - common), size);
+}
+
+void AssetsDownloadTable::retain(const std::unordered_set<std::string> &keys)
+{
+    for (auto it = _units.begin(); it != _units.end();)
+    {
+        if (keys.find(it->first) == keys.end())
+        {
+            it = erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+AssetsDownloadTable::Units::iterator AssetsDownloadTable::erase(Units::iterator it)
+{
+    if (!_paths.empty())
+    {
+        _paths.erase(it->first);
+    }
+    return _units.erase(it);
+}
+
+void AssetsDownloadTable::clear()
+{
+    _units.clear();
+    _paths.clear();
+}
+
+const std::string& AssetsDownloadTable::getPath(const std::string &key) const
+{
+    auto it = _paths.find(key);
+    return it != _paths.end() ? it->second : key;
+}
+
+void AssetsDownloadTable::getSrcUrl(const std::string &key, const Unit &unit, std::string *url) const
+{
+    url->assign(_prefixes[unit.urlPrefix]);
+    url->append(getPath(key));
+}
+
+void AssetsDownloadTable::getStoragePath(const std::string &key, const Unit &unit, std::string *path) const
+{
+    path->assign(_prefixes[unit.storagePrefix]);
+    path->append(getPath(key));
+}
+
+NS_CC_EXT_END
@@ -0,0 +1,119 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsDownloadTable__
+#define __AssetsDownloadTable__
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   Download units of an update, keyed by asset key which is also the task identifier.
+ *          The url and storage path of a unit are a shared prefix, the package url and the temporary
+ *          storage usually, followed by its relative path, which is the key itself for most assets.
+ *          A unit only holds the indexes of its prefixes and its size, the full strings are built
+ *          when its task starts.
+ */
+class CC_EX_DLL AssetsDownloadTable
+{
+public:
+
+    struct Unit
+    {
+        //! Expected size in bytes, 0 if the manifest doesn't tell
+        float size;
+        //! Indexes of the url and storage path prefixes
+        uint32_t urlPrefix;
+        uint32_t storagePrefix;
+    };
+
+    typedef std::unordered_map<std::string, Unit> Units;
+
+    /** @brief Add or replace a unit downloaded from urlPrefix + path to storagePrefix + path
+     */
+    void add(const std::string &key, const std::string &urlPrefix, const std::string &storagePrefix, const std::string &path, float size);
+
+    /** @brief Add or replace a unit from its full url and storage path, split on their longest common suffix
+     */
+    void addPaths(const std::string &key, const std::string &srcUrl, const std::string &storagePath, float size);
+
+    /** @brief Keep only the units whose key is in keys
+     */
+    void retain(const std::unordered_set<std::string> &keys);
+
+    Units::iterator find(const std::string &key) { return _units.find(key); }
+    Units::const_iterator find(const std::string &key) const { return _units.find(key); }
+
+    Units::iterator begin() { return _units.begin(); }
+    Units::iterator end() { return _units.end(); }
+    Units::const_iterator begin() const { return _units.begin(); }
+    Units::const_iterator end() const { return _units.end(); }
+
+    Units::iterator erase(Units::iterator it);
+
+    size_t size() const { return _units.size(); }
+
+    bool empty() const { return _units.empty(); }
+
+    /** @brief Remove the units, the prefixes are kept for the next ones
+     */
+    void clear();
+
+    /** @brief Path of a unit relative to its prefixes
+     */
+    const std::string& getPath(const std::string &key) const;
+
+    /** @brief Build the url of a unit into url, reusing its capacity
+     */
+    void getSrcUrl(const std::string &key, const Unit &unit, std::string *url) const;
+
+    /** @brief Build the storage path of a unit into path, reusing its capacity
+     */
+    void getStoragePath(const std::string &key, const Unit &unit, std::string *path) const;
+
+private:
+    uint32_t intern(const std::string &prefix);
+
+    void setPath(const std::string &key, const std::string &path);
+
+    Units _units;
+
+    //! Relative paths of the units whose path isn't their key
+    std::unordered_map<std::string, std::string> _paths;
+
+    std::vector<std::string> _prefixes;
+    std::unordered_map<std::string, uint32_t> _prefixIndexes;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsDownloadTable__) */
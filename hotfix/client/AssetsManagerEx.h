@@ -25,26 +25,29 @@
 #ifndef __AssetsManagerEx__
 #define __AssetsManagerEx__
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "base/CCEventDispatcher.h"
-#include "platform/CCFileUtils.h"
-#include "network/CCDownloader.h"
 
 #include "CCEventAssetsManagerEx.h"
 
+#include "AssetsManagerExEnv.h"
+#include "AssetsUpdateMetrics.h"
 #include "Manifest.h"
 #include "extensions/ExtensionMacros.h"
 #include "extensions/ExtensionExport.h"
-#include "json/document-wrapper.h"
 
 
 NS_CC_EXT_BEGIN
 
 /**
  * @brief   This class is used to auto update resources, such as pictures or scripts.
+ *          It resolves the engine singletons of its environment and delivers events, the update itself
+ *          runs in a Core, see AssetsManagerExCore.h.
  */
 class CC_EX_DLL AssetsManagerEx : public Ref
 {
@@ -78,6 +81,16 @@ public:
      */
     static AssetsManagerEx* create(const std::string &manifestUrl, const std::string &storagePath);
     
+    /** @brief Create an AssetsManagerEx running on the given environment instead of the engine singletons.
+     *         When all members of env are set, the manager works without Director, e.g. in a command line
+     *         preloader or a benchmark, and is driven by the callbacks of env.downloader and env.taskRunner
+     *         and the updates of env.scheduler.
+     @param manifestUrl   The url for the local manifest file
+     @param storagePath   The storage path for downloaded assets
+     @param env           File system, downloader, task runner and event callback to use
+     */
+    static AssetsManagerEx* create(const std::string &manifestUrl, const std::string &storagePath, const AssetsManagerExEnv &env);
+    
     /** @brief  Check out if there is a new version of manifest.
      *          You may use this method before updating, then let user determine whether
      *          he wants to update resources.
@@ -92,7 +105,43 @@ public:
      */
     void downloadFailedAssets();
     
+    /** @brief Pause the running update: no new task is issued and running downloads are aborted,
+     *         their partial files are kept and resumed by resume().
+     */
+    void pause();
+    
+    /** @brief Resume an update paused by pause(), without checking version or manifest again.
+     */
+    void resume();
+    
+    /** @brief Cancel the running update. Download states are saved, so the next update() resumes
+     *         where this one stopped.
+     */
+    void cancel();
+    
+    /** @brief Check the files installed in the storage by previous updates against the local manifest,
+     *         size and verify callback, on background threads, then download the broken and missing ones again.
+     *         Progress and throughput are reported by VERIFY_PROGRESSION events and the result by VERIFY_FINISHED,
+     *         followed by the update events of the repair if files are downloaded.
+     *         Only while no update is running, files are checked in batches so it can run while the game is idle.
+     @param maxThreads  Number of threads hashing files, 0 for all cores but one, which is left to rendering.
+     *                  They call the verify callback concurrently, see setVerifyCallback.
+     */
+    void verifyInstalled(int maxThreads = 0);
+    
+    /** @brief Remove in the background the files of the storage the local manifest doesn't reference anymore,
+     *         left by updates older than the deletion at commit. The result is reported by a GARBAGE_COLLECTED event.
+     *         Directories of compressed assets are kept, their extracted files aren't listed in manifests.
+     *         Only while no update is running.
+     */
+    void collectGarbage();
+    
+    /** @brief Whether the update is paused.
+     */
+    bool isPaused() const;
+    
     /** @brief Gets the current update state.
+     *         In worker thread mode, this is the state of the last event received by the main thread.
      */
     State getState() const;
     
@@ -110,217 +159,167 @@ public:
     
     /** @brief Function for retrieving the max concurrent task count
      */
-    const int getMaxConcurrentTask() const {return _maxConcurrentTask;};
+    const int getMaxConcurrentTask() const;
     
     /** @brief Function for setting the max concurrent task count
      */
-    void setMaxConcurrentTask(const int max) {_maxConcurrentTask = max;};
+    void setMaxConcurrentTask(const int max);
     
     /** @brief Set the handle function for comparing manifests versions
      * @param handle    The compare function
      */
-    void setVersionCompareHandle(const std::function<int(const std::string& versionA, const std::string& versionB)>& handle) {_versionCompareHandle = handle;};
+    void setVersionCompareHandle(const std::function<int(const std::string& versionA, const std::string& versionB)>& handle);
     
-    /** @brief Set the verification function for checking whether downloaded asset is correct, e.g. using md5 verification
+    /** @brief Set the verification function for checking whether downloaded asset is correct, e.g. using md5 verification.
+     *         Files installed in a pack storage aren't on disk, verifyInstalled passes their storage path
+     *         and the callback reads them through FileUtils, see AssetsManagerExEnv::packStorage.
+     *         Updates call it on the thread driving the manager, or on the worker in worker thread mode,
+     *         but verifyInstalled calls it from several threads at once: it must be thread-safe then.
      * @param callback  The verify callback function
      */
-    void setVerifyCallback(const std::function<bool(const std::string& path, Manifest::Asset asset)>& callback) {_verifyCallback = callback;};
-    
-CC_CONSTRUCTOR_ACCESS:
-    
-    AssetsManagerEx(const std::string& manifestUrl, const std::string& storagePath);
-    
-    virtual ~AssetsManagerEx();
-    
-protected:
-    
-    std::string basename(const std::string& path) const;
-    
-    std::string get(const std::string& key) const;
-    
-    void initManifests(const std::string& manifestUrl);
-    
-    void loadLocalManifest(const std::string& manifestUrl);
-    
-    void prepareLocalManifest();
-    
-    void setStoragePath(const std::string& storagePath);
-    
-    void adjustPath(std::string &path);
-    
-    void dispatchUpdateEvent(EventAssetsManagerEx::EventCode code, const std::string &message = "", const std::string &assetId = "", int curle_code = 0, int curlm_code = 0);
-    
-    void downloadVersion();
-    void parseVersion();
-    void downloadManifest();
-    void parseManifest();
-    void startUpdate();
-    void updateSucceed();
-    bool decompress(const std::string &filename);
-    void decompressDownloadedZip(const std::string &customId, const std::string &storagePath);
-    
-    /** @brief Update a list of assets under the current AssetsManagerEx context
+    void setVerifyCallback(const std::function<bool(const std::string& path, const Manifest::Asset& asset)>& callback);
+    
+    /** @brief Enable or disable the streaming manifest parser, enabled by default.
+     *         When disabled, manifests are loaded into a rapidjson DOM by Manifest::parse as before.
+     *         Sharded manifests, written by manifest_gen --shard-depth, need it: a remote manifest may then list its
+     *         shards instead of its assets, and only the shards whose md5 changed are downloaded and diffed.
+     *         The manifests loaded by create() are always parsed by the streaming parser, the setting applies to the
+     *         remote manifests. Manifests without a DOM are always saved by the streaming writer.
      */
-    void updateAssets(const DownloadUnits& assets);
+    void setStreamingManifestParse(bool enabled);
     
-    /** @brief Retrieve all failed assets during the last update
+    /** @brief Enable or disable the verification cache, enabled by default.
+     *         Files accepted by the verify callback are trusted again without calling it while their size,
+     *         modification time and inode don't change, e.g. when resuming an update.
      */
-    const DownloadUnits& getFailedAssets() const;
-    
-    /** @brief Function for destroying the downloaded version file and manifest file
+    void setVerifyCacheEnabled(bool enabled);
+    
+    /** @brief Enable or disable the warm-up of updated assets, disabled by default.
+     *         The remote manifest lists the assets worth warming up with their priority in a root "warmUp" object,
+     *         e.g. "warmUp" : {"res/ui.png" : 10, "src/main.lua" : 5}. Once an update is finished, the listed
+     *         assets it downloaded are loaded in the background, highest priority first: textures are decoded
+     *         into the TextureCache, other files are read through so their first load hits the system cache.
+     *         Hints are only read by the streaming parser, see setStreamingManifestParse.
      */
-    void destroyDownloadedVersion();
-    
-    /** @brief Download items in queue with max concurrency setting
+    void setWarmUpEnabled(bool enabled);
+    
+    /** @brief Limit the download of deferred assets once the critical ones are ready.
+     *         The remote manifest may list the path prefixes of the assets needed to play in a root "critical" array,
+     *         or of the assets which can wait in a root "deferred" array. Critical assets are downloaded first and,
+     *         as soon as all of them are in the temporary storage, CRITICAL_SET_READY is dispatched and the temporary
+     *         storage is searched first by FileUtils so the game can go on while the rest is downloaded.
+     *         UPDATE_FINISHED still comes when everything is installed.
+     @param maxConcurrentTask   Max concurrent tasks for deferred assets, 0 for getMaxConcurrentTask()
+     @param bytesPerSecond      Bandwidth budget for deferred assets, by manifest size, 0 for no limit
      */
-    void queueDowload();
-    
-    void fileError(const std::string& identifier, const std::string& errorStr, int errorCode = 0, int errorCodeInternal = 0);
+    void setDeferredDownloadBudget(int maxConcurrentTask, int bytesPerSecond);
     
-    void fileSuccess(const std::string &customId, const std::string &storagePath);
-    
-    /** @brief  Call back function for error handling,
-     the error will then be reported to user's listener registed in addUpdateEventListener
-     @param error   The error object contains ErrorCode, message, asset url, asset key
-     @warning AssetsManagerEx internal use only
-     * @js NA
-     * @lua NA
+    /** @brief Seconds from update() to CRITICAL_SET_READY in the last update, or to UPDATE_FINISHED
+     *         if its manifest doesn't mark critical assets, -1 if not reached yet
      */
-    virtual void onError(const network::DownloadTask& task,
-                         int errorCode,
-                         int errorCodeInternal,
-                         const std::string& errorStr);
+    float getTimeToPlayable() const;
     
-    /** @brief  Call back function for recording downloading percent of the current asset,
-     the progression will then be reported to user's listener registed in addUpdateProgressEventListener
-     @param total       Total size to download for this asset
-     @param downloaded  Total size already downloaded for this asset
-     @param url         The url of this asset
-     @param customId    The key of this asset
-     @warning AssetsManagerEx internal use only
-     * @js NA
-     * @lua NA
+    /** @brief Seconds from update() to UPDATE_FINISHED in the last update, -1 if not reached yet
      */
-    virtual void onProgress(double total, double downloaded, const std::string &url, const std::string &customId);
+    float getTimeToComplete() const;
     
-    /** @brief  Call back function for success of the current asset
-     the success event will then be send to user's listener registed in addUpdateEventListener
-     @param srcUrl      The url of this asset
-     @param customId    The key of this asset
-     @warning AssetsManagerEx internal use only
-     * @js NA
-     * @lua NA
+    /** @brief Bytes the last update didn't download, by manifest size, because their content was already
+     *         in the storage or downloaded under another path
      */
-    virtual void onSuccess(const std::string &srcUrl, const std::string &storagePath, const std::string &customId);
-    
-private:
-    void batchDownload();
-
-    // Called when one DownloadUnits finished
-    void onDownloadUnitsFinished();
-    
-    //! The event of the current AssetsManagerEx in event dispatcher
-    std::string _eventName;
-    
-    //! Reference to the global event dispatcher
-    EventDispatcher *_eventDispatcher;
-    //! Reference to the global file utils
-    FileUtils *_fileUtils;
+    double getDedupBytesSaved() const;
     
-    //! State of update
-    State _updateState;
-    
-    //! Downloader
-    std::shared_ptr<network::Downloader> _downloader;
-    
-    //! The reference to the local assets
-    const std::unordered_map<std::string, Manifest::Asset> *_assets;
-    
-    //! The path to store successfully downloaded version.
-    std::string _storagePath;
-    
-    //! The path to store downloading version.
-    std::string _tempStoragePath;
-    
-    //! The local path of cached temporary version file
-    std::string _tempVersionPath;
-    
-    //! The local path of cached manifest file
-    std::string _cacheManifestPath;
+    /** @brief Seconds these bytes would have taken at the average rate of the last update, 0 until it completes
+     */
+    float getDedupTimeSaved() const;
     
-    //! The local path of cached temporary manifest file
-    std::string _tempManifestPath;
+    /** @brief Counters and histograms of the downloads, verifications and decompressions since this manager was created.
+     *         Snapshot them or get their json from any thread at any time, reset them to start a new measure.
+     */
+    AssetsUpdateMetrics& getMetrics();
     
-    //! The path of local manifest file
-    std::string _manifestUrl;
+    /** @brief Limit the bytes of downloaded archives waiting for or in extraction, 64 MB by default, 0 for no limit.
+     *         Past it compressed units are held back while the other units go on, until extractions catch up.
+     *         Archives downloading when it's reached may exceed it.
+     */
+    void setExtractionBudget(double bytes);
     
-    //! Local manifest
-    Manifest *_localManifest;
+    double getExtractionBudget() const;
     
-    //! Local temporary manifest for download resuming
-    Manifest *_tempManifest;
+    /** @brief Downloaded archives waiting for or in extraction, also given by every event
+     */
+    int getPendingExtractions() const;
+    
+    /** @brief Enable or disable staged updates, disabled by default. Set it before update().
+     *         A staged update downloads and verifies the new version into the temporary storage while the current one
+     *         stays in use, all of its assets within the deferred download budget, see setDeferredDownloadBudget.
+     *         Once everything is downloaded UPDATE_STAGED is dispatched instead of UPDATE_FINISHED, and the next
+     *         AssetsManagerEx created for the storage, at the next launch usually, applies it before loading the local
+     *         manifest: with a pack storage by renaming the staged pack index, otherwise by moving the downloaded files.
+     *         Checking again dispatches UPDATE_STAGED while the remote version is the staged one, a newer remote
+     *         version discards it.
+     */
+    void setStagedUpdate(bool enabled);
     
-    //! Remote manifest
-    Manifest *_remoteManifest;
+    /** @brief Whether a downloaded version waits for the next launch to be applied
+     */
+    bool isUpdateStaged() const;
+    
+    /** @brief Select the variant of a dimension of the tagged assets, e.g. setVariant("tex", "astc") or setVariant("locale", "fr").
+     *         Assets list their variants in a "tags" array of "dimension:value" strings, e.g. "tags" : ["tex:astc", "res:hd"].
+     *         Only the assets matching the selected value of each of their dimensions are installed, every variant of a
+     *         dimension without selection is. Untagged assets are always installed.
+     *         Set it before checkUpdate() or update(): the next update downloads the assets of a new selection and removes
+     *         those of the old one, even if the remote version didn't change.
+     *         Tags are only read by the streaming parser, see setStreamingManifestParse.
+     @param value   The variant to install, empty to install all of them
+     */
+    void setVariant(const std::string &dimension, const std::string &value);
     
-    //! Whether user have requested to update
-    enum class UpdateEntry : char
-    {
-        NONE,
-        CHECK_UPDATE,
-        DO_UPDATE
-    };
-
-    UpdateEntry _updateEntry;
+    const std::unordered_map<std::string, std::string>& getVariants() const;
     
-    //! All assets unit to download
-    DownloadUnits _downloadUnits;
+    /** @brief Receive update events through a callback instead of the EventDispatcher
+     * @param callback  The event callback, nullptr to dispatch events through the Director's EventDispatcher again,
+     *                  also for a manager created with AssetsManagerExEnv::eventCallback
+     */
+    void setEventCallback(const std::function<void(EventAssetsManagerEx *event)>& callback);
     
-    //! All failed units
-    DownloadUnits _failedUnits;
     
-    //! Download queue
-    std::vector<std::string> _queue;
+CC_CONSTRUCTOR_ACCESS:
     
-    //! Max concurrent task count for downloading
-    int _maxConcurrentTask;
+    AssetsManagerEx(const std::string& manifestUrl, const std::string& storagePath);
     
-    //! Current concurrent task count
-    int _currConcurrentTask;
+    AssetsManagerEx(const std::string& manifestUrl, const std::string& storagePath, const AssetsManagerExEnv& env);
     
-    //! Download percent
-    float _percent;
+    virtual ~AssetsManagerEx();
     
-    //! Download percent by file
-    float _percentByFile;
+private:
     
-    //! Indicate whether the total size should be enabled
-    int _totalEnabled;
+    class Core;
     
-    //! Indicate the number of file whose total size have been collected
-    int _sizeCollected;
+    /** @brief Hand an event to the listeners, on the main thread
+     */
+    void deliverUpdateEvent(EventAssetsManagerEx::EventCode code, const std::string &assetId, const std::string &message, int curle_code, int curlm_code, float percent, float percentByFile, int pendingExtractions);
     
-    //! Total file size need to be downloaded (sum of all file)
-    double _totalSize;
+    /** @brief Decode textures into the TextureCache in the background, on the main thread
+     */
+    static void warmUpTextures(const std::vector<std::string> &paths);
     
-    //! Downloaded size for each file
-    std::unordered_map<std::string, double> _downloadedSize;
+    //! The update state machine, nullptr only if it couldn't be allocated
+    std::unique_ptr<Core> _core;
     
-    //! Total number of assets to download
-    int _totalToDownload;
-    //! Total number of assets still waiting to be downloaded
-    int _totalWaitToDownload;
-    //! Next target percent for saving the manifest file
-    float _nextSavePoint;
+    //! The event of the current AssetsManagerEx in event dispatcher
+    std::string _eventName;
     
-    //! Handle function to compare versions between different manifests
-    std::function<int(const std::string& versionA, const std::string& versionB)> _versionCompareHandle;
+    //! Reference to the global event dispatcher, nullptr when events go to _eventCallback
+    EventDispatcher *_eventDispatcher;
+    //! Callback receiving events instead of the event dispatcher
+    std::function<void(EventAssetsManagerEx *event)> _eventCallback;
     
-    //! Callback function to verify the downloaded assets
-    std::function<bool(const std::string& path, Manifest::Asset asset)> _verifyCallback;
+    //! Events reused by deliverUpdateEvent, indexed by dispatch nesting level
+    std::vector<EventAssetsManagerEx*> _eventPool;
     
-    //! Marker for whether the assets manager is inited
-    bool _inited;
+    //! Current nesting level of deliverUpdateEvent
+    size_t _eventDepth;
 };
 
 NS_CC_EXT_END
@@ -0,0 +1,3580 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsManagerExCore.h"
+#include "AssetsResolutionIndex.h"
+#include "ManifestStream.h"
+#include "base/ccUTF8.h"
+
+#include <stdio.h>
+#include <math.h>
+#if (CC_TARGET_PLATFORM != CC_PLATFORM_WIN32)
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifdef MINIZIP_FROM_SYSTEM
+#include <minizip/unzip.h>
+#else // from our embedded sources
+#include "unzip.h"
+#endif
+
+NS_CC_EXT_BEGIN
+
+#define TEMP_PACKAGE_SUFFIX     "_temp"
+#define SALVAGE_PACKAGE_SUFFIX  "_salvage"
+#define VERSION_FILENAME        "version.manifest"
+#define TEMP_MANIFEST_FILENAME  "project.manifest.temp"
+#define MANIFEST_FILENAME       "project.manifest"
+
+#define BUFFER_SIZE    8192
+#define MAX_FILENAME   512
+
+#define SAVE_POINT_INTERVAL 0.1
+
+#define WORKER_SCHEDULE_KEY "AssetsManagerExWorker"
+
+#define QUEUE_SCHEDULE_KEY  "AssetsManagerExQueue"
+
+#define DEFAULT_EXTRACTION_BUDGET (64 * 1024 * 1024)
+
+#define VERIFY_CACHE_FILENAME   "verify.cache"
+
+//! Written in the temporary storage once a staged version is complete, with how its files are kept
+#define STAGED_FILENAME         "update.staged"
+#define STAGED_PACKED           "packed"
+#define STAGED_FILES            "files"
+
+#define VERIFY_BATCH_SIZE 256
+
+//! Download identifiers of manifest shards, followed by the shard path
+#define SHARD_ID_PREFIX         "@shard:"
+#define SHARD_FILE_PREFIX       "shard-"
+
+//! State of a verifyInstalled run
+struct AssetsManagerEx::Core::VerifySession
+{
+    enum class Result : char
+    {
+        UNCHECKED,
+        //! Hashed by the verify callback and accepted
+        VERIFIED,
+        //! Unchanged since a previous verification, not hashed
+        TRUSTED,
+        BROKEN
+    };
+
+    struct Item
+    {
+        std::string key;
+        std::string path;
+        Manifest::Asset asset;
+        //! Stat recorded by the verification cache, if hasCachedStat
+        AssetsVerifyCache::FileStat cachedStat;
+        bool hasCachedStat;
+        int64_t bytes;
+        Result result;
+    };
+
+    std::vector<Item> items;
+    std::vector<std::string> broken;
+    std::function<bool(const std::string& path, const Manifest::Asset& asset)> verifyCallback;
+    size_t next;
+    int threads;
+    //! Next item of the running batch to claim, by the pool threads
+    std::atomic<size_t> claimed;
+    //! Pool tasks of the running batch not done yet, driving thread only
+    int pendingTasks;
+    //! Set when the session is dropped, the pool threads stop after their current item
+    std::atomic<bool> cancelled;
+    int64_t bytesHashed;
+    std::chrono::steady_clock::time_point start;
+
+    static void check(Item &item, const std::string &statPath, const AssetsPackStorage *packs,
+                      const std::function<bool(const std::string&, const Manifest::Asset&)> &verifyCallback)
+    {
+        AssetsVerifyCache::FileStat stat;
+        // Packed files have no stat of their own, they're always hashed
+        const bool packed = packs && (stat.size = packs->getSize(item.asset.path)) >= 0;
+        if (!packed && !AssetsVerifyCache::statFile(statPath, &stat))
+        {
+            item.result = Result::BROKEN;
+            return;
+        }
+        item.bytes = stat.size;
+        // Sizes are stored as float in manifests
+        if (item.asset.size > 0 && fabs((double)stat.size - item.asset.size) > 1 + item.asset.size * 1e-6)
+        {
+            item.result = Result::BROKEN;
+        }
+        else if (!packed && item.hasCachedStat && AssetsVerifyCache::sameStat(stat, item.cachedStat))
+        {
+            item.result = Result::TRUSTED;
+        }
+        else if (!verifyCallback)
+        {
+            item.result = Result::TRUSTED;
+        }
+        else
+        {
+            item.result = verifyCallback(item.path, item.asset) ? Result::VERIFIED : Result::BROKEN;
+        }
+    }
+};
+
+// Implementation of AssetsManagerEx::Core
+
+AssetsManagerEx::Core::Core(AssetsManagerEx *owner, const std::string& manifestUrl, const std::string& storagePath, const AssetsManagerExEnv& env)
+: _owner(owner)
+, _textureWarmUp(false)
+, _updateState(State::UNCHECKED)
+, _assets(nullptr)
+, _storagePath("")
+, _tempVersionPath("")
+, _cacheManifestPath("")
+, _tempManifestPath("")
+, _manifestUrl(manifestUrl)
+, _localManifest(nullptr)
+, _tempManifest(nullptr)
+, _remoteManifest(nullptr)
+, _updateEntry(UpdateEntry::NONE)
+, _maxConcurrentTask(32)
+, _currConcurrentTask(0)
+, _percent(0)
+, _percentByFile(0)
+, _totalToDownload(0)
+, _totalWaitToDownload(0)
+, _nextSavePoint(0.0)
+, _versionCompareHandle(nullptr)
+, _verifyCallback(nullptr)
+, _streamingParse(true)
+, _verifyCacheEnabled(true)
+, _verifyPoolThreads(0)
+, _repairing(false)
+, _stateBeforeRepair(State::UNCHECKED)
+, _sweeping(false)
+, _warmUpEnabled(false)
+, _stagedUpdate(false)
+, _updateStaged(false)
+, _shardedDiff(false)
+, _pendingShards(0)
+, _criticalReady(false)
+, _tempSearchPathsApplied(false)
+, _queueScheduled(false)
+, _deferredMaxConcurrentTask(0)
+, _deferredBytesPerSecond(0)
+, _budgetBytes(0)
+, _timeToPlayable(-1)
+, _timeToComplete(-1)
+, _dedupBytesSaved(0)
+, _dedupTimeSaved(0)
+, _extractionBudget(DEFAULT_EXTRACTION_BUDGET)
+, _pendingExtractions(0)
+, _pendingExtractionBytes(0)
+, _paused(false)
+, _updateGeneration(0)
+, _downloadEpoch(0)
+, _issuedEpoch(0)
+, _downloadProgressPosted(false)
+, _workerProgressQueued(false)
+, _workerProgressDirty(false)
+, _publishedState(State::UNCHECKED)
+, _inited(false)
+, _alive(std::make_shared<std::atomic<bool>>(true))
+{
+    // The owner resolved the environment, no engine singleton is reached from here
+    _fileUtils = env.fileUtils;
+    _taskRunner = env.taskRunner;
+    _scheduler = env.scheduler;
+    _textureWarmUp = dynamic_cast<DirectorAssetsScheduler*>(_scheduler.get()) != nullptr;
+    _downloader = env.downloader;
+    if (env.workerThread)
+    {
+        _worker.reset(new (std::nothrow) AssetsUpdateWorker([this]() {
+            flushWorkerProgress(false);
+        }));
+    }
+    if (env.extractionThreads > 0)
+    {
+        _extractionPool.reset(new (std::nothrow) ThreadPoolRunner(env.extractionThreads, [this](const std::function<void()> &done) {
+            if (_worker)
+            {
+                _worker->post(done);
+            }
+            else
+            {
+                _scheduler->performInDriverThread(done);
+            }
+        }));
+    }
+
+    initDownloader();
+    setStoragePath(storagePath);
+    _tempVersionPath = _tempStoragePath + VERSION_FILENAME; // ʱversion.manifest
+    _cacheManifestPath = _storagePath + MANIFEST_FILENAME; // project.manifest ϴεmanifest
+    _tempManifestPath = _tempStoragePath + TEMP_MANIFEST_FILENAME; //ʷ project.manifest
+    _verifyCachePath = _storagePath + VERIFY_CACHE_FILENAME;
+    if (env.packStorage)
+    {
+        if (AssetsResolutionIndex::getInstance()->isEnabled())
+        {
+            _packStorage = std::make_shared<AssetsPackStorage>(_fileUtils->getSuitableFOpen(_storagePath));
+            _packStorage->load();
+        }
+        else
+        {
+            CCLOGERROR("AssetsManagerEx : The pack storage needs HotUpdateFileUtils, files are installed unpacked");
+        }
+    }
+}
+
+void AssetsManagerEx::Core::start()
+{
+    initManifests(_manifestUrl);
+    // After initManifests, which may have emptied the storage
+    _verifyCache.load(_fileUtils->getSuitableFOpen(_verifyCachePath));
+
+    if (_worker)
+    {
+        _scheduler->schedule([this](float /*dt*/) {
+            drainWorkerMessages();
+        }, this, 0, WORKER_SCHEDULE_KEY);
+    }
+}
+
+AssetsManagerEx::Core::~Core() //
+{
+    // The task runner isn't owned, its completions still to come are dropped
+    _alive->store(false, std::memory_order_release);
+    if (_worker)
+    {
+        // Wait for the running task, nothing touches this manager from the worker afterwards
+        _worker->stop();
+        _scheduler->unschedule(WORKER_SCHEDULE_KEY, this);
+    }
+    // Waits for the running extractions and verifications, their completions are dropped
+    if (_verifySession)
+    {
+        _verifySession->cancelled = true;
+    }
+    _extractionPool.reset();
+    _verifyPool.reset();
+    if (_queueScheduled)
+    {
+        _scheduler->unschedule(QUEUE_SCHEDULE_KEY, this);
+    }
+	//ͷ
+    _downloader->onTaskError = (nullptr);
+    _downloader->onFileTaskSuccess = (nullptr);
+    _downloader->onTaskProgress = (nullptr);
+
+	//ͷűصManifest
+    CC_SAFE_RELEASE(_localManifest);
+    // _tempManifest could share a ptr with _remoteManifest or _localManifest
+    if (_tempManifest != _localManifest && _tempManifest != _remoteManifest)
+        CC_SAFE_RELEASE(_tempManifest); //ͷ ʱManifest
+    CC_SAFE_RELEASE(_remoteManifest); //ͷManefest ʵmanifestʱmanifestʼ
+}
+
+void AssetsManagerEx::Core::initDownloader()
+{
+    if (_worker)
+    {
+        // Callbacks arrive on the main thread and are forwarded to the worker,
+        // those of tasks aborted by an earlier cancellation are dropped there
+        _downloader->onTaskError = [this](const network::DownloadTask& task,
+                                          int errorCode,
+                                          int errorCodeInternal,
+                                          const std::string& errorStr)
+        {
+            unsigned int epoch = _downloadEpoch;
+            std::string identifier = task.identifier;
+            std::string requestURL = task.requestURL;
+            std::string storagePath = task.storagePath;
+            _worker->post([=]() {
+                if (epoch != _issuedEpoch)
+                    return;
+                network::DownloadTask workerTask;
+                workerTask.identifier = identifier;
+                workerTask.requestURL = requestURL;
+                workerTask.storagePath = storagePath;
+                this->onError(workerTask, errorCode, errorCodeInternal, errorStr);
+            });
+        };
+        _downloader->onTaskProgress = [this](const network::DownloadTask& task,
+                                             int64_t /*bytesReceived*/,
+                                             int64_t totalBytesReceived,
+                                             int64_t totalBytesExpected)
+        {
+            // Progressions of a task overwrite each other until the worker runs them,
+            // a single drain task is posted for all of them
+            bool post = false;
+            {
+                std::lock_guard<std::mutex> lock(_downloadProgressMutex);
+                DownloadProgress &progress = _downloadProgress[task.identifier];
+                if (progress.requestURL.empty())
+                    progress.requestURL = task.requestURL;
+                progress.totalBytesReceived = totalBytesReceived;
+                progress.totalBytesExpected = totalBytesExpected;
+                progress.epoch = _downloadEpoch;
+                if (!_downloadProgressPosted)
+                {
+                    _downloadProgressPosted = true;
+                    post = true;
+                }
+            }
+            if (post)
+            {
+                _worker->post([this]() {
+                    this->drainDownloadProgress();
+                });
+            }
+        };
+        _downloader->onFileTaskSuccess = [this](const network::DownloadTask& task)
+        {
+            unsigned int epoch = _downloadEpoch;
+            std::string identifier = task.identifier;
+            std::string requestURL = task.requestURL;
+            std::string storagePath = task.storagePath;
+            _worker->post([=]() {
+                if (epoch == _issuedEpoch)
+                    this->onSuccess(requestURL, storagePath, identifier);
+            });
+        };
+        return;
+    }
+
+    _downloader->onTaskError = std::bind(&AssetsManagerEx::Core::onError, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4);
+    _downloader->onTaskProgress = [this](const network::DownloadTask& task,
+                                         int64_t /*bytesReceived*/,
+                                         int64_t totalBytesReceived,
+                                         int64_t totalBytesExpected)
+    {
+        this->onProgress(totalBytesExpected, totalBytesReceived, task.requestURL, task.identifier);
+    };
+    _downloader->onFileTaskSuccess = [this](const network::DownloadTask& task)
+    {
+        this->onSuccess(task.requestURL, task.storagePath, task.identifier);
+    };
+}
+
+void AssetsManagerEx::Core::drainDownloadProgress()
+{
+    // Success and error callbacks posted after a progression run after this task,
+    // so a task's progression never runs after its end
+    std::unordered_map<std::string, DownloadProgress> progresses;
+    {
+        std::lock_guard<std::mutex> lock(_downloadProgressMutex);
+        progresses.swap(_downloadProgress);
+        _downloadProgressPosted = false;
+    }
+    for (const auto &progress : progresses)
+    {
+        if (progress.second.epoch == _issuedEpoch)
+            onProgress(progress.second.totalBytesExpected, progress.second.totalBytesReceived, progress.second.requestURL, progress.first);
+    }
+}
+
+void AssetsManagerEx::Core::abortDownloads()
+{
+    if (_worker)
+    {
+        ++_issuedEpoch;
+        if (beginWorkerMessage(AssetsWorkerMessage::Type::CANCEL_DOWNLOADS))
+        {
+            _worker->commitMessage();
+        }
+    }
+    else
+    {
+        _downloader->cancelAll();
+    }
+
+    // Aborted units go back to the queue, at the end so they are issued first
+    for (const auto &it : _downloadingUnits)
+    {
+        _tempManifest->setAssetDownloadState(it.first, Manifest::DownloadState::UNSTARTED);
+        _queue.push_back(it.first);
+    }
+    if (!_downloadingUnits.empty())
+    {
+        auto transferTime = std::chrono::steady_clock::now() - _transferStartTime;
+        _metrics.recordTransferTime(std::chrono::duration_cast<std::chrono::microseconds>(transferTime).count());
+    }
+    _currConcurrentTask = MAX(0, _currConcurrentTask - (int)_downloadingUnits.size());
+    _downloadingUnits.clear();
+}
+
+//ļʼmanifest ʼǱص manifest
+void AssetsManagerEx::Core::initManifests(const std::string& manifestUrl)
+{
+    _inited = true;
+    // Init and load local manifest
+    _localManifest = new (std::nothrow) Manifest();
+    if (_localManifest)
+    {
+        loadLocalManifest(manifestUrl); //ʼصmanifest
+        
+        // Init and load temporary manifest
+        _tempManifest = new (std::nothrow) Manifest();
+        if (_tempManifest)
+        {
+            ManifestHints tempHints;
+            parseManifestFile(_tempManifest, _tempManifestPath, &tempHints); // ʱmanifeʼtempManifest manifest
+            _tempVariants = std::move(tempHints.variants);
+            // Previous update is interrupted
+            if (_fileUtils->isFileExist(_tempManifestPath))
+            {
+                // Manifest parse failed, remove all temp files
+                if (!_tempManifest->isLoaded())
+                {
+                    _fileUtils->removeDirectory(_tempStoragePath);
+                    CC_SAFE_RELEASE(_tempManifest);
+                    _tempManifest = nullptr;
+                }
+            }
+        }
+        else
+        {
+            _inited = false;
+        }
+        
+        // Init remote manifest for future usage
+        _remoteManifest = new (std::nothrow) Manifest();
+        if (!_remoteManifest)
+        {
+            _inited = false;
+        }
+    }
+    else
+    {
+        _inited = false;
+    }
+    
+    if (!_inited)//ʼʧ
+    {
+        CC_SAFE_RELEASE(_localManifest);
+        CC_SAFE_RELEASE(_tempManifest);
+        CC_SAFE_RELEASE(_remoteManifest);
+        _localManifest = nullptr;
+        _tempManifest = nullptr;
+        _remoteManifest = nullptr;
+    }
+}
+
+void AssetsManagerEx::Core::prepareLocalManifest()
+{
+    // An alias to assets
+    _assets = &(_localManifest->getAssets());//صԴ
+
+    // Add search paths
+    prependSearchPaths(_localManifest);
+}
+
+void AssetsManagerEx::Core::prependSearchPaths(const Manifest *manifest)
+{
+    prependSearchPaths(manifest->_manifestRoot, manifest->_searchPaths);
+}
+
+void AssetsManagerEx::Core::prependSearchPaths(const std::string &manifestRoot, const std::vector<std::string> &manifestSearchPaths)
+{
+    // Search paths are read by FileUtils on the main thread
+    if (_worker && _worker->isWorkerThread())
+    {
+        AssetsWorkerMessage *message = beginWorkerMessage(AssetsWorkerMessage::Type::SEARCH_PATHS);
+        if (message)
+        {
+            message->assetId.assign(manifestRoot);
+            message->searchPaths = manifestSearchPaths;
+            _worker->commitMessage();
+        }
+        return;
+    }
+    applySearchPaths(manifestRoot, manifestSearchPaths);
+}
+
+void AssetsManagerEx::Core::removeSearchPaths(const std::string &root)
+{
+    if (_worker && _worker->isWorkerThread())
+    {
+        AssetsWorkerMessage *message = beginWorkerMessage(AssetsWorkerMessage::Type::REMOVE_SEARCH_PATHS);
+        if (message)
+        {
+            message->assetId.assign(root);
+            _worker->commitMessage();
+        }
+        return;
+    }
+    applySearchPathsRemoval(root);
+}
+
+void AssetsManagerEx::Core::applySearchPathsRemoval(const std::string &root)
+{
+    std::vector<std::string> searchPaths = _fileUtils->getSearchPaths();
+    auto end = std::remove_if(searchPaths.begin(), searchPaths.end(), [&root](const std::string &path) {
+        return path.compare(0, root.size(), root) == 0;
+    });
+    if (end != searchPaths.end())
+    {
+        searchPaths.erase(end, searchPaths.end());
+        _fileUtils->setSearchPaths(searchPaths);
+    }
+}
+
+void AssetsManagerEx::Core::applySearchPaths(const std::string &manifestRoot, const std::vector<std::string> &manifestSearchPaths)
+{
+    // Same as Manifest::prependSearchPaths, through the file utils of this manager
+    std::vector<std::string> searchPaths = _fileUtils->getSearchPaths();
+    bool needChangeSearchPaths = false;
+    if (std::find(searchPaths.begin(), searchPaths.end(), manifestRoot) == searchPaths.end())
+    {
+        searchPaths.insert(searchPaths.begin(), manifestRoot);
+        needChangeSearchPaths = true;
+    }
+    for (int i = (int)manifestSearchPaths.size()-1; i >= 0; i--)
+    {
+        std::string path = manifestSearchPaths[i];
+        if (path.size() > 0 && path[path.size() - 1] != '/')
+            path.append("/");
+        path = manifestRoot + path;
+        searchPaths.insert(searchPaths.begin(), path);
+        needChangeSearchPaths = true;
+    }
+    if (needChangeSearchPaths)
+    {
+        _fileUtils->setSearchPaths(searchPaths);
+    }
+}
+
+void AssetsManagerEx::Core::loadLocalManifest(const std::string& /*manifestUrl*/)
+{
+    // A version staged by the previous run becomes the cached one first
+    if (_fileUtils->isFileExist(_tempStoragePath + STAGED_FILENAME))
+    {
+        applyStagedUpdate();
+    }
+    Manifest *cachedManifest = nullptr;
+    ManifestHints cachedHints, bundleHints;
+    // Find the cached manifest file
+    if (_fileUtils->isFileExist(_cacheManifestPath)) //Ŀ¼manifestȥ Ŀ¼manifest
+    {
+        cachedManifest = new (std::nothrow) Manifest();
+        if (cachedManifest) {
+            parseManifestFile(cachedManifest, _cacheManifestPath, &cachedHints);
+            if (!cachedManifest->isLoaded())
+            {
+                _fileUtils->removeFile(_cacheManifestPath);
+                CC_SAFE_RELEASE(cachedManifest);
+                cachedManifest = nullptr;
+            }
+        }
+    }
+    
+    // Ensure no search path of cached manifest is used to load this manifest
+    std::vector<std::string> searchPaths = _fileUtils->getSearchPaths();
+    if (cachedManifest)
+    {
+        std::vector<std::string> cacheSearchPaths = cachedManifest->getSearchPaths();
+        std::vector<std::string> trimmedPaths = searchPaths;
+        for (auto path : cacheSearchPaths)
+        {
+            const auto pos = std::find(trimmedPaths.begin(), trimmedPaths.end(), path);
+            if (pos != trimmedPaths.end())
+            {
+                trimmedPaths.erase(pos);
+            }
+        }
+        _fileUtils->setSearchPaths(trimmedPaths);
+    }
+    // Load local manifest in app package
+    _bundleManifestPath = _fileUtils->fullPathForFilename(_manifestUrl);
+    parseManifestFile(_localManifest, _manifestUrl, &bundleHints);
+    if (cachedManifest) {
+        // Restore search paths
+        _fileUtils->setSearchPaths(searchPaths);
+    }
+    if (_localManifest->isLoaded())
+    {
+        // Files of the cached version that differ from the app package, the others resolve the same either way
+        std::unordered_set<std::string> present;
+        ManifestHints *localHints = &bundleHints;
+        // Compare with cached manifest to determine which one to use
+        if (cachedManifest) { //cachedManifest õϴص
+            bool localNewer = _localManifest->versionGreater(cachedManifest, _versionCompareHandle);
+            if (localNewer) //ص İ汾 
+            {
+                // Files the next update may still use are kept aside
+                salvageCachedFiles(cachedManifest);
+                // Recreate storage, to empty the content
+                if (_packStorage)
+                {
+                    _packStorage->clear();
+                }
+                _fileUtils->removeDirectory(_storagePath);
+                _fileUtils->createDirectory(_storagePath);
+                CC_SAFE_RELEASE(cachedManifest);
+            }
+            else //صİ汾
+            {
+                if (AssetsResolutionIndex::getInstance()->isEnabled())
+                {
+                    const auto &bundleAssets = _localManifest->_assets;
+                    for (const auto &it : cachedManifest->_assets)
+                    {
+                        auto bundleIt = bundleAssets.find(it.first);
+                        if (bundleIt == bundleAssets.end() || bundleIt->second.md5 != it.second.md5)
+                        {
+                            present.insert(it.second.path);
+                        }
+                    }
+                }
+                CC_SAFE_RELEASE(_localManifest);
+                _localManifest = cachedManifest;
+                localHints = &cachedHints;
+            }
+        }
+        _localHints.shardDepth = localHints->shardDepth;
+        _localHints.shards = std::move(localHints->shards);
+        _localHints.variants = std::move(localHints->variants);
+        publishResolutionIndex(_localManifest, std::move(present));
+        prepareLocalManifest();
+    }
+
+    // Fail to load local manifest
+    if (!_localManifest->isLoaded())
+    {
+        CCLOG("AssetsManagerEx : No local manifest file found error.\n");
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST);
+    }
+}
+
+void AssetsManagerEx::Core::parseManifestFile(Manifest *manifest, const std::string &manifestUrl, ManifestHints *hints)
+{
+    if (!_streamingParse)
+    {
+        manifest->parse(manifestUrl);
+        return;
+    }
+
+    manifest->clear();
+    if (!_fileUtils->isFileExist(manifestUrl))
+    {
+        CCLOG("AssetsManagerEx : Fail to retrieve manifest file %s\n", manifestUrl.c_str());
+        return;
+    }
+
+    ManifestData data;
+    bool ok = false;
+    std::string fullPath = _fileUtils->fullPathForFilename(manifestUrl);
+    FILE *fp = fopen(_fileUtils->getSuitableFOpen(fullPath).c_str(), "rb");
+    if (fp)
+    {
+        ok = ManifestStreamParser::parseFile(fp, &data);
+        fclose(fp);
+    }
+    else
+    {
+        // Files packed in the Android apk can only be read through FileUtils
+        ok = ManifestStreamParser::parseString(_fileUtils->getStringFromFile(manifestUrl), &data);
+    }
+    if (!ok)
+    {
+        CCLOG("AssetsManagerEx : Fail to parse manifest file %s\n", manifestUrl.c_str());
+        return;
+    }
+
+    // Register the local manifest root
+    size_t found = manifestUrl.find_last_of("/\\");
+    if (found != std::string::npos)
+    {
+        manifest->_manifestRoot = manifestUrl.substr(0, found+1);
+    }
+    manifest->_packageUrl = std::move(data.packageUrl);
+    manifest->_remoteManifestUrl = std::move(data.remoteManifestUrl);
+    manifest->_remoteVersionUrl = std::move(data.remoteVersionUrl);
+    manifest->_version = std::move(data.version);
+    manifest->_engineVer = std::move(data.engineVersion);
+    manifest->_groups = std::move(data.groups);
+    manifest->_groupVer = std::move(data.groupVer);
+    manifest->_assets = std::move(data.assets);
+    manifest->_searchPaths = std::move(data.searchPaths);
+    if (hints)
+    {
+        *hints = std::move(data.hints);
+    }
+    manifest->_versionLoaded = true;
+    manifest->_loaded = true;
+}
+
+void AssetsManagerEx::Core::saveManifest(Manifest *manifest, const std::string &path)
+{
+    // Only a manifest parsed into a DOM can be saved by Manifest::saveToFile, whatever the current setting:
+    // those start() loaded went through the streaming parser, saveToFile would write their empty DOM
+    if (!_streamingParse && manifest->_json.IsObject())
+    {
+        manifest->saveToFile(path);
+        return;
+    }
+
+    ManifestStreamWriter writer;
+    bool ok = writer.begin(_fileUtils->getSuitableFOpen(path),
+                           manifest->_packageUrl,
+                           manifest->_remoteManifestUrl,
+                           manifest->_remoteVersionUrl,
+                           manifest->_version,
+                           manifest->_engineVer,
+                           manifest->_groups,
+                           manifest->_groupVer);
+    if (ok)
+    {
+        for (const auto &it : manifest->_assets)
+        {
+            writer.writeAsset(it.first, it.second);
+        }
+        // The shard table and variant selection stay with the manifest they were read with
+        const ManifestHints *hints = nullptr;
+        if (manifest == _remoteManifest || manifest == _tempManifest)
+            hints = &_remoteHints;
+        else if (manifest == _localManifest)
+            hints = &_localHints;
+        ok = writer.end(manifest->_searchPaths, hints);
+    }
+    if (!ok)
+    {
+        CCLOG("AssetsManagerEx : Fail to save manifest file %s\n", path.c_str());
+    }
+}
+
+std::string AssetsManagerEx::Core::basename(const std::string& path) const
+{
+    size_t found = path.find_last_of("/\\");
+    
+    if (std::string::npos != found)
+    {
+        return path.substr(0, found);
+    }
+    else
+    {
+        return path;
+    }
+}
+
+std::string AssetsManagerEx::Core::get(const std::string& key) const
+{
+    auto it = _assets->find(key);
+    if (it != _assets->cend()) {
+        return _storagePath + it->second.path;
+    }
+    else return "";
+}
+
+const Manifest* AssetsManagerEx::Core::getLocalManifest() const
+{
+    return _localManifest;
+}
+
+const Manifest* AssetsManagerEx::Core::getRemoteManifest() const
+{
+    return _remoteManifest;
+}
+
+const std::string& AssetsManagerEx::Core::getStoragePath() const
+{
+    return _storagePath;
+}
+
+void AssetsManagerEx::Core::setStoragePath(const std::string& storagePath)
+{
+    _storagePath = storagePath;
+    adjustPath(_storagePath);
+    _fileUtils->createDirectory(_storagePath);
+    
+    _tempStoragePath = _storagePath;
+    _tempStoragePath.insert(_storagePath.size() - 1, TEMP_PACKAGE_SUFFIX);
+    _fileUtils->createDirectory(_tempStoragePath);
+    
+    _salvageStoragePath = _storagePath;
+    _salvageStoragePath.insert(_storagePath.size() - 1, SALVAGE_PACKAGE_SUFFIX);
+}
+
+void AssetsManagerEx::Core::adjustPath(std::string &path)
+{
+    if (path.size() > 0 && path[path.size() - 1] != '/')
+    {
+        path.append("/");
+    }
+}
+
+bool AssetsManagerEx::Core::decompress(const std::string &zip)
+{
+    // Find root path for zip file
+    size_t pos = zip.find_last_of("/\\");
+    if (pos == std::string::npos)
+    {
+        CCLOG("AssetsManagerEx : no root path specified for zip file %s\n", zip.c_str());
+        return false;
+    }
+    const std::string rootPath = zip.substr(0, pos+1);
+    
+    // Open the zip file
+    unzFile zipfile = unzOpen(_fileUtils->getSuitableFOpen(zip).c_str());
+    if (! zipfile)
+    {
+        CCLOG("AssetsManagerEx : can not open downloaded zip file %s\n", zip.c_str());
+        return false;
+    }
+    
+    // Get info about the zip file
+    unz_global_info global_info;
+    if (unzGetGlobalInfo(zipfile, &global_info) != UNZ_OK)
+    {
+        CCLOG("AssetsManagerEx : can not read file global info of %s\n", zip.c_str());
+        unzClose(zipfile);
+        return false;
+    }
+    
+    // Buffer to hold data read from the zip file
+    char readBuffer[BUFFER_SIZE];
+    // Loop to extract all files.
+    uLong i;
+    for (i = 0; i < global_info.number_entry; ++i)
+    {
+        // Get info about current file.
+        unz_file_info fileInfo;
+        char fileName[MAX_FILENAME];
+        if (unzGetCurrentFileInfo(zipfile,
+                                  &fileInfo,
+                                  fileName,
+                                  MAX_FILENAME,
+                                  NULL,
+                                  0,
+                                  NULL,
+                                  0) != UNZ_OK)
+        {
+            CCLOG("AssetsManagerEx : can not read compressed file info\n");
+            unzClose(zipfile);
+            return false;
+        }
+        const std::string fullPath = rootPath + fileName;
+        
+        // Check if this entry is a directory or a file.
+        const size_t filenameLength = strlen(fileName);
+        if (fileName[filenameLength-1] == '/')
+        {
+            //There are not directory entry in some case.
+            //So we need to create directory when decompressing file entry
+            if ( !_fileUtils->createDirectory(basename(fullPath)) )
+            {
+                // Failed to create directory
+                CCLOG("AssetsManagerEx : can not create directory %s\n", fullPath.c_str());
+                unzClose(zipfile);
+                return false;
+            }
+        }
+        else
+        {
+            // Create all directories in advance to avoid issue
+            std::string dir = basename(fullPath);
+            if (!_fileUtils->isDirectoryExist(dir)) {
+                if (!_fileUtils->createDirectory(dir)) {
+                    // Failed to create directory
+                    CCLOG("AssetsManagerEx : can not create directory %s\n", fullPath.c_str());
+                    unzClose(zipfile);
+                    return false;
+                }
+            }
+            // Entry is a file, so extract it.
+            // Open current file.
+            if (unzOpenCurrentFile(zipfile) != UNZ_OK)
+            {
+                CCLOG("AssetsManagerEx : can not extract file %s\n", fileName);
+                unzClose(zipfile);
+                return false;
+            }
+            
+            // Replaced rather than truncated, it may be a hard link made by dedupDownloadUnits
+            remove(_fileUtils->getSuitableFOpen(fullPath).c_str());
+            // Create a file to store current file.
+            FILE *out = fopen(_fileUtils->getSuitableFOpen(fullPath).c_str(), "wb");
+            if (!out)
+            {
+                CCLOG("AssetsManagerEx : can not create decompress destination file %s (errno: %d)\n", fullPath.c_str(), errno);
+                unzCloseCurrentFile(zipfile);
+                unzClose(zipfile);
+                return false;
+            }
+            
+            // Write current file content to destinate file.
+            int error = UNZ_OK;
+            do
+            {
+                error = unzReadCurrentFile(zipfile, readBuffer, BUFFER_SIZE);
+                if (error < 0)
+                {
+                    CCLOG("AssetsManagerEx : can not read zip file %s, error code is %d\n", fileName, error);
+                    fclose(out);
+                    unzCloseCurrentFile(zipfile);
+                    unzClose(zipfile);
+                    return false;
+                }
+                
+                if (error > 0)
+                {
+                    fwrite(readBuffer, error, 1, out);
+                }
+            } while(error > 0);
+            
+            fclose(out);
+        }
+        
+        unzCloseCurrentFile(zipfile);
+        
+        // Goto next entry listed in the zip file.
+        if ((i+1) < global_info.number_entry)
+        {
+            if (unzGoToNextFile(zipfile) != UNZ_OK)
+            {
+                CCLOG("AssetsManagerEx : can not read next file for decompressing\n");
+                unzClose(zipfile);
+                return false;
+            }
+        }
+    }
+    
+    unzClose(zipfile);
+    return true;
+}
+
+void AssetsManagerEx::Core::decompressDownloadedZip(const std::string &customId, const std::string &storagePath)//ѹzip
+{
+    struct AsyncData
+    {
+        std::string customId;
+        std::string zipFile;
+        unsigned int generation;
+        double bytes;
+        bool succeed;
+    };
+    
+    auto asyncData = std::make_shared<AsyncData>();
+    asyncData->customId = customId;
+    asyncData->zipFile = storagePath;
+    asyncData->generation = _updateGeneration;
+    long size = _fileUtils->getFileSize(storagePath);
+    asyncData->bytes = size > 0 ? size : 0;
+    asyncData->succeed = false;
+    _pendingExtractions++;
+    _pendingExtractionBytes += asyncData->bytes;
+    
+    std::function<void()> decompressFinished = [this, asyncData]() {
+        auto dataInner = asyncData.get();
+        // Released whatever the outcome, held back archives may go on from here
+        _pendingExtractions--;
+        _pendingExtractionBytes = MAX(0, _pendingExtractionBytes - dataInner->bytes);
+        if (dataInner->generation != _updateGeneration)
+        {
+            // The update was cancelled meanwhile, the unit is downloaded again on resume
+        }
+        else if (dataInner->succeed)
+        {
+            fileSuccess(dataInner->customId, dataInner->zipFile);
+        }
+        else
+        {
+            std::string errorMsg = "Unable to decompress file " + dataInner->zipFile;
+            // Ensure zip file deletion (if decompress failure cause task thread exit anormally)
+            _fileUtils->removeFile(dataInner->zipFile);
+            dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_DECOMPRESS, "", errorMsg);
+            fileError(dataInner->customId, errorMsg);
+        }
+    };
+    runExtraction([this, asyncData]() {
+        // Decompress all compressed files
+        auto startTime = std::chrono::steady_clock::now();
+        if (decompress(asyncData->zipFile))
+        {
+            asyncData->succeed = true;
+        }
+        auto decompressTime = std::chrono::steady_clock::now() - startTime;
+        _metrics.recordDecompress(std::chrono::duration_cast<std::chrono::microseconds>(decompressTime).count());
+        _fileUtils->removeFile(asyncData->zipFile);
+    }, decompressFinished);
+}
+
+//ʱַ
+void AssetsManagerEx::Core::dispatchUpdateEvent(EventAssetsManagerEx::EventCode code, const std::string &assetId/* = ""*/, const std::string &message/* = ""*/, int curle_code/* = CURLE_OK*/, int curlm_code/* = CURLM_OK*/)
+{
+    switch (code)
+    {
+        case EventAssetsManagerEx::EventCode::ERROR_PARSE_MANIFEST:
+        case EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST:
+        case EventAssetsManagerEx::EventCode::ERROR_DOWNLOAD_MANIFEST:
+            _metrics.recordError(AssetsUpdateMetrics::ErrorCategory::MANIFEST);
+            break;
+        case EventAssetsManagerEx::EventCode::ERROR_DECOMPRESS:
+            _metrics.recordError(AssetsUpdateMetrics::ErrorCategory::DECOMPRESS);
+            break;
+        case EventAssetsManagerEx::EventCode::UPDATE_FAILED:
+            _metrics.recordUpdate(false);
+            break;
+        default:
+            break;
+    }
+
+    switch (code)
+    {
+        case EventAssetsManagerEx::EventCode::ERROR_UPDATING:
+        case EventAssetsManagerEx::EventCode::ERROR_PARSE_MANIFEST:
+        case EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST:
+        case EventAssetsManagerEx::EventCode::ERROR_DECOMPRESS:
+        case EventAssetsManagerEx::EventCode::ERROR_DOWNLOAD_MANIFEST:
+        case EventAssetsManagerEx::EventCode::UPDATE_FAILED:
+        case EventAssetsManagerEx::EventCode::UPDATE_FINISHED:
+        case EventAssetsManagerEx::EventCode::ALREADY_UP_TO_DATE:
+        case EventAssetsManagerEx::EventCode::UPDATE_STAGED:
+            _updateEntry = UpdateEntry::NONE;
+            break;
+        case EventAssetsManagerEx::EventCode::UPDATE_PROGRESSION:
+            break;
+        case EventAssetsManagerEx::EventCode::ASSET_UPDATED:
+            break;
+        case EventAssetsManagerEx::EventCode::NEW_VERSION_FOUND:
+            if (_updateEntry == UpdateEntry::CHECK_UPDATE)
+            {
+                _updateEntry = UpdateEntry::NONE;
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (_worker && _worker->isWorkerThread())
+    {
+        postWorkerEvent(code, assetId, message, curle_code, curlm_code);
+        return;
+    }
+    _owner->deliverUpdateEvent(code, assetId, message, curle_code, curlm_code, _percent, _percentByFile, _pendingExtractions);
+}
+
+bool AssetsManagerEx::Core::postToWorker(const std::function<void()> &task)
+{
+    if (!_worker || _worker->isWorkerThread())
+        return false;
+    _worker->post(task);
+    return true;
+}
+
+AssetsWorkerMessage* AssetsManagerEx::Core::beginWorkerMessage(AssetsWorkerMessage::Type type)
+{
+    AssetsWorkerMessage *message = _worker->beginMessage();
+    if (message)
+    {
+        message->type = type;
+        message->state = (int)_updateState;
+        message->percent = _percent;
+        message->percentByFile = _percentByFile;
+        message->pendingExtractions = _pendingExtractions;
+    }
+    return message;
+}
+
+void AssetsManagerEx::Core::postWorkerEvent(EventAssetsManagerEx::EventCode code, const std::string &assetId, const std::string &message, int curle_code, int curlm_code)
+{
+    switch (code)
+    {
+        case EventAssetsManagerEx::EventCode::ASSET_UPDATED:
+            // Per asset events are not forwarded, see AssetsManagerExEnv::workerThread
+            return;
+        case EventAssetsManagerEx::EventCode::UPDATE_PROGRESSION:
+            if (message.empty())
+            {
+                // Merged with the progressions following it until the main thread takes it
+                _workerProgressAssetId.assign(assetId);
+                _workerProgressDirty = true;
+                flushWorkerProgress(false);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    flushWorkerProgress(true);
+    AssetsWorkerMessage *workerMessage = beginWorkerMessage(AssetsWorkerMessage::Type::EVENT);
+    if (workerMessage)
+    {
+        workerMessage->code = code;
+        workerMessage->assetId.assign(assetId);
+        workerMessage->message.assign(message);
+        workerMessage->curleCode = curle_code;
+        workerMessage->curlmCode = curlm_code;
+        _worker->commitMessage();
+    }
+}
+
+void AssetsManagerEx::Core::flushWorkerProgress(bool force)
+{
+    if (!_workerProgressDirty || (!force && _workerProgressQueued.load(std::memory_order_acquire)))
+        return;
+
+    AssetsWorkerMessage *workerMessage = beginWorkerMessage(AssetsWorkerMessage::Type::PROGRESS);
+    if (workerMessage)
+    {
+        workerMessage->code = EventAssetsManagerEx::EventCode::UPDATE_PROGRESSION;
+        workerMessage->assetId.assign(_workerProgressAssetId);
+        workerMessage->message.clear();
+        workerMessage->curleCode = 0;
+        workerMessage->curlmCode = 0;
+        _workerProgressDirty = false;
+        _workerProgressQueued.store(true, std::memory_order_release);
+        _worker->commitMessage();
+    }
+}
+
+void AssetsManagerEx::Core::drainWorkerMessages()
+{
+    // Listeners may release the manager, which deletes this core
+    _owner->retain();
+    // Bounded, a worker posting faster than the frame rate can't hold the frame
+    for (size_t i = 0; i < AssetsUpdateWorker::MESSAGE_CAPACITY && !_worker->isStopping(); ++i)
+    {
+        AssetsWorkerMessage *message = _worker->frontMessage();
+        if (!message)
+            break;
+
+        _publishedState = (State)message->state;
+        switch (message->type)
+        {
+            case AssetsWorkerMessage::Type::PROGRESS:
+                _workerProgressQueued.store(false, std::memory_order_release);
+                // fall through
+            case AssetsWorkerMessage::Type::EVENT:
+                _owner->deliverUpdateEvent(message->code, message->assetId, message->message, message->curleCode, message->curlmCode, message->percent, message->percentByFile, message->pendingExtractions);
+                break;
+            case AssetsWorkerMessage::Type::DOWNLOAD:
+                _downloader->createDownloadFileTask(message->message, message->storagePath, message->assetId);
+                break;
+            case AssetsWorkerMessage::Type::CANCEL_DOWNLOADS:
+                _downloader->cancelAll();
+                ++_downloadEpoch;
+                break;
+            case AssetsWorkerMessage::Type::SEARCH_PATHS:
+                applySearchPaths(message->assetId, message->searchPaths);
+                break;
+            case AssetsWorkerMessage::Type::REMOVE_SEARCH_PATHS:
+                applySearchPathsRemoval(message->assetId);
+                break;
+            case AssetsWorkerMessage::Type::SCHEDULE_QUEUE:
+                scheduleQueueDownload(message->percent);
+                break;
+            default:
+                break;
+        }
+        _worker->popMessage();
+    }
+    _owner->release();
+}
+
+void AssetsManagerEx::Core::startDownloadTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier)
+{
+    if (!_worker)
+    {
+        _downloader->createDownloadFileTask(srcUrl, storagePath, identifier);
+        return;
+    }
+    AssetsWorkerMessage *message = beginWorkerMessage(AssetsWorkerMessage::Type::DOWNLOAD);
+    if (message)
+    {
+        message->assetId.assign(identifier);
+        message->message.assign(srcUrl);
+        message->storagePath.assign(storagePath);
+        _worker->commitMessage();
+    }
+}
+
+AssetsManagerEx::State AssetsManagerEx::Core::getState() const
+{
+    return _worker ? _publishedState : _updateState;
+}
+
+void AssetsManagerEx::Core::downloadVersion()//versionļ ֻԶ̲Żversionļûversionļ
+{
+    if (_updateState > State::PREDOWNLOAD_VERSION)
+        return;
+
+    std::string versionUrl = _localManifest->getVersionFileUrl();//ͨص manifestԶversionصַ
+
+    if (versionUrl.size() > 0) //versionַ
+    {
+        _updateState = State::DOWNLOADING_VERSION;
+        // Download version file asynchronously
+        startDownloadTask(versionUrl, _tempVersionPath, VERSION_ID); //version
+    }
+    // No version file found
+    else
+    {
+        CCLOG("AssetsManagerEx : No version file found, step skipped\n");
+        _updateState = State::PREDOWNLOAD_MANIFEST;
+        downloadManifest(); //޷ȡmanifestϢȥ Manifest manifest
+    }
+}
+
+void AssetsManagerEx::Core::parseVersion() //汾
+{
+    if (_updateState != State::VERSION_LOADED)
+        return;
+
+    _remoteManifest->parseVersion(_tempVersionPath); //-----------------------
+
+    if (!_remoteManifest->isVersionLoaded()) //ûмManifest İ汾Ϣ
+    {
+        CCLOG("AssetsManagerEx : Fail to parse version file, step skipped\n");
+        _updateState = State::PREDOWNLOAD_MANIFEST;
+        downloadManifest(); //زҼManifest
+    }
+    else
+    {
+        // A new variant selection is fetched from the installed version
+        bool selectionChanged = variantsChanged() && _localManifest->versionEquals(_remoteManifest);
+        if (_localManifest->versionGreater(_remoteManifest, _versionCompareHandle) && !selectionChanged) //ذ汾
+        {
+            _updateState = State::UP_TO_DATE;
+            if (_updateStaged)
+            {
+                discardStagedUpdate();
+            }
+            _fileUtils->removeDirectory(_tempStoragePath);
+            // No update is coming to restore the salvaged files
+            _fileUtils->removeDirectory(_salvageStoragePath);
+            dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ALREADY_UP_TO_DATE);
+        }
+        else if (_updateStaged && _tempManifest->versionEquals(_remoteManifest) && _tempVariants == _variants)
+        {
+            remoteVersionStaged();
+        }
+        else //ذ汾
+        {
+            // The staged version is outdated, the next launch must not apply it whether this update starts or not
+            if (_updateStaged)
+            {
+                discardTempUpdate();
+            }
+            _updateState = State::NEED_UPDATE;
+
+            // Wait to update so continue the process
+            if (_updateEntry == UpdateEntry::DO_UPDATE) //Ҫ
+            {
+                // dispatch after checking update entry because event dispatching may modify the update entry
+                dispatchUpdateEvent(EventAssetsManagerEx::EventCode::NEW_VERSION_FOUND);
+                _updateState = State::PREDOWNLOAD_MANIFEST;
+                downloadManifest(); 
+            }
+            else
+            {
+                dispatchUpdateEvent(EventAssetsManagerEx::EventCode::NEW_VERSION_FOUND);
+            }
+        }
+    }
+}
+
+void AssetsManagerEx::Core::downloadManifest() //manifest
+{
+    if (_updateState != State::PREDOWNLOAD_MANIFEST)
+        return;
+
+    std::string manifestUrl;
+    if (_remoteManifest->isVersionLoaded()) { //Զ̵manifestǷѾversionϢ
+        manifestUrl = _remoteManifest->getManifestFileUrl(); 
+    } else {
+        manifestUrl = _localManifest->getManifestFileUrl();//ȡصManifestõ ԶManifestصַ
+    }
+
+    if (manifestUrl.size() > 0)
+    {
+        _updateState = State::DOWNLOADING_MANIFEST;
+        // Download version file asynchronously
+        startDownloadTask(manifestUrl, _tempManifestPath, MANIFEST_ID); //Զ̵manifest
+    }
+    // No manifest file found
+    else
+    {
+        CCLOG("AssetsManagerEx : No manifest file found, check update failed\n");
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_DOWNLOAD_MANIFEST);
+        _updateState = State::UNCHECKED;
+    }
+}
+
+void AssetsManagerEx::Core::parseManifest()//Manifest
+{
+    if (_updateState != State::MANIFEST_LOADED)
+        return;
+
+    _remoteHints = ManifestHints();
+    _shardedDiff = false;
+    parseManifestFile(_remoteManifest, _tempManifestPath, &_remoteHints);//װmanifest
+
+    if (!_remoteManifest->isLoaded())
+    {
+        CCLOG("AssetsManagerEx : Error parsing manifest file, %s", _tempManifestPath.c_str());
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_PARSE_MANIFEST);
+        _updateState = State::UNCHECKED;//ûмسɹ ٴUNCHECKһ
+    }
+    else
+    {
+        bool selectionChanged = variantsChanged() && _localManifest->versionEquals(_remoteManifest);
+        if (_localManifest->versionGreater(_remoteManifest, _versionCompareHandle) && !selectionChanged) //ǰ汾ȷİ汾
+        {
+            _updateState = State::UP_TO_DATE;
+            if (_updateStaged)
+            {
+                discardStagedUpdate();
+            }
+            _fileUtils->removeDirectory(_tempStoragePath);
+            // No update is coming to restore the salvaged files
+            _fileUtils->removeDirectory(_salvageStoragePath);
+            dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ALREADY_UP_TO_DATE);
+        }
+        else if (_updateStaged && _tempManifest->versionEquals(_remoteManifest) && _tempVariants == _variants)
+        {
+            remoteVersionStaged();
+        }
+        else
+        {
+            // The staged version is outdated, the next launch must not apply it whether this update starts or not
+            if (_updateStaged)
+            {
+                discardTempUpdate();
+            }
+            if (!_remoteHints.shards.empty())
+            {
+                loadRemoteShards();
+            }
+            else
+            {
+                newVersionFound();
+            }
+        }
+    }
+}
+
+void AssetsManagerEx::Core::loadRemoteShards()
+{
+    // Shards only compare when cut at the same depth
+    int depth = _remoteHints.shardDepth;
+    std::unordered_map<std::string, const ManifestShard*> localShards;
+    // Local shards filtered with another variant selection don't compare either
+    _shardedDiff = _localHints.shardDepth == depth && !_localHints.shards.empty() && !variantsChanged();
+    if (_shardedDiff)
+    {
+        for (const auto &shard : _localHints.shards)
+        {
+            localShards.emplace(shard.path, &shard);
+        }
+    }
+    std::unordered_set<std::string> unchanged;
+    std::vector<const ManifestShard*> changed;
+    for (const auto &shard : _remoteHints.shards)
+    {
+        auto localIt = localShards.find(shard.path);
+        if (localIt != localShards.end() && localIt->second->md5 == shard.md5)
+            unchanged.insert(shard.path);
+        else
+            changed.push_back(&shard);
+    }
+
+    // Assets of the unchanged shards are the local ones, they're neither downloaded nor diffed
+    auto &remoteAssets = _remoteManifest->_assets;
+    _shardRemoteKeys.clear();
+    _shardLocalKeys.clear();
+    std::string shardPath;
+    for (const auto &it : _localManifest->_assets)
+    {
+        ManifestShard::pathOf(it.first, depth, &shardPath);
+        if (unchanged.find(shardPath) != unchanged.end())
+        {
+            Manifest::Asset &asset = remoteAssets.emplace(it.first, it.second).first->second;
+            asset.downloadState = (int)Manifest::DownloadState::UNMARKED;
+        }
+        else
+        {
+            _shardLocalKeys.push_back(it.first);
+        }
+    }
+    CCLOG("AssetsManagerEx : %d of %d manifest shards changed\n", (int)changed.size(), (int)_remoteHints.shards.size());
+
+    _pendingShards = (int)changed.size();
+    if (_pendingShards == 0)
+    {
+        remoteShardsLoaded();
+        return;
+    }
+    _updateState = State::DOWNLOADING_MANIFEST;
+    const std::string &manifestUrl = _remoteManifest->getManifestFileUrl();
+    std::string baseUrl = manifestUrl.substr(0, manifestUrl.find_last_of('/') + 1);
+    for (const ManifestShard *shard : changed)
+    {
+        std::string url = shard->url.find("://") != std::string::npos ? shard->url : baseUrl + shard->url;
+        startDownloadTask(url, _tempStoragePath + SHARD_FILE_PREFIX + shard->md5 + ".manifest", SHARD_ID_PREFIX + shard->path);
+    }
+}
+
+void AssetsManagerEx::Core::onShardLoaded(const std::string &storagePath)
+{
+    ManifestData data;
+    bool ok = false;
+    FILE *fp = fopen(_fileUtils->getSuitableFOpen(storagePath).c_str(), "rb");
+    if (fp)
+    {
+        ok = ManifestStreamParser::parseFile(fp, &data);
+        fclose(fp);
+    }
+    _fileUtils->removeFile(storagePath);
+    // Another shard failed
+    if (_updateState != State::DOWNLOADING_MANIFEST)
+        return;
+    if (!ok)
+    {
+        CCLOG("AssetsManagerEx : Error parsing manifest shard, %s", storagePath.c_str());
+        dropRemoteShards();
+        _updateState = State::UNCHECKED;
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_PARSE_MANIFEST);
+        return;
+    }
+
+    auto &remoteAssets = _remoteManifest->_assets;
+    _shardRemoteKeys.reserve(_shardRemoteKeys.size() + data.assets.size());
+    for (auto &it : data.assets)
+    {
+        _shardRemoteKeys.push_back(it.first);
+        remoteAssets[it.first] = std::move(it.second);
+    }
+    for (auto &it : data.hints.tags)
+    {
+        _remoteHints.tags[it.first] = std::move(it.second);
+    }
+    if (--_pendingShards == 0)
+    {
+        remoteShardsLoaded();
+    }
+}
+
+void AssetsManagerEx::Core::remoteShardsLoaded()
+{
+    _updateState = State::MANIFEST_LOADED;
+    saveManifest(_remoteManifest, _tempManifestPath);
+    newVersionFound();
+}
+
+void AssetsManagerEx::Core::dropRemoteShards()
+{
+    if (_remoteManifest != _tempManifest)
+    {
+        CC_SAFE_RELEASE(_remoteManifest);
+    }
+    _remoteManifest = new (std::nothrow) Manifest();
+    _remoteHints = ManifestHints();
+    _shardedDiff = false;
+    _shardRemoteKeys.clear();
+    _shardLocalKeys.clear();
+    _pendingShards = 0;
+}
+
+void AssetsManagerEx::Core::newVersionFound()
+{
+    _updateState = State::NEED_UPDATE;//ǰ汾ȷİ汾;Ϳʼ
+    dispatchUpdateEvent(EventAssetsManagerEx::EventCode::NEW_VERSION_FOUND);
+
+    if (_updateEntry == UpdateEntry::DO_UPDATE)
+    {
+        startUpdate();
+    }
+}
+
+void AssetsManagerEx::Core::setVariant(const std::string &dimension, const std::string &value)
+{
+    if (value.empty())
+        _variants.erase(dimension);
+    else
+        _variants[dimension] = value;
+}
+
+bool AssetsManagerEx::Core::variantsChanged() const
+{
+    return _variants != _localHints.variants;
+}
+
+void AssetsManagerEx::Core::filterVariants()
+{
+    _remoteHints.variants = _variants;
+    if (_variants.empty())
+        return;
+
+    auto &assets = _remoteManifest->_assets;
+    int removed = 0;
+    std::string selected;
+    for (const auto &it : _remoteHints.tags)
+    {
+        const std::vector<std::string> &tags = it.second;
+        bool keep = true;
+        for (size_t i = 0; i < tags.size() && keep; ++i)
+        {
+            size_t colon = tags[i].find(':');
+            if (colon == std::string::npos)
+                continue;
+            auto variantIt = _variants.find(tags[i].substr(0, colon));
+            if (variantIt == _variants.end())
+                continue;
+            // One of the tags of the asset for this dimension must be the selected variant
+            selected.assign(variantIt->first).append(1, ':').append(variantIt->second);
+            keep = std::find(tags.begin(), tags.end(), selected) != tags.end();
+        }
+        if (!keep)
+        {
+            removed += (int)assets.erase(it.first);
+        }
+    }
+    CCLOG("AssetsManagerEx : %d assets of other variants skipped\n", removed);
+}
+
+std::unordered_map<std::string, Manifest::AssetDiff> AssetsManagerEx::Core::genShardedDiff() const
+{
+    std::unordered_map<std::string, Manifest::AssetDiff> diff;
+    const auto &localAssets = _localManifest->_assets;
+    const auto &remoteAssets = _remoteManifest->_assets;
+    Manifest::AssetDiff assetDiff;
+    for (const auto &key : _shardLocalKeys)
+    {
+        if (remoteAssets.find(key) == remoteAssets.end())
+        {
+            assetDiff.asset = localAssets.at(key);
+            assetDiff.type = Manifest::DiffType::DELETED;
+            diff.emplace(key, assetDiff);
+        }
+    }
+    for (const auto &key : _shardRemoteKeys)
+    {
+        // Filtered out, see filterVariants
+        auto remoteIt = remoteAssets.find(key);
+        if (remoteIt == remoteAssets.end())
+            continue;
+        const Manifest::Asset &asset = remoteIt->second;
+        auto localIt = localAssets.find(key);
+        if (localIt == localAssets.end() || localIt->second.md5 != asset.md5)
+        {
+            assetDiff.asset = asset;
+            assetDiff.type = localIt == localAssets.end() ? Manifest::DiffType::ADDED : Manifest::DiffType::MODIFIED;
+            diff.emplace(key, assetDiff);
+        }
+    }
+    return diff;
+}
+
+void AssetsManagerEx::Core::startUpdate()
+{
+    if (_updateState != State::NEED_UPDATE)
+        return;
+
+    _updateState = State::UPDATING;
+    // Clean up before update
+	//ԼʼһЩصĻ
+    _failedUnits.clear();
+    _downloadUnits.clear();
+    _contentAliases.clear();
+    _totalWaitToDownload = _totalToDownload = 0;
+    _nextSavePoint = 0;
+    _percent = _percentByFile = _sizeCollected = _totalSize = 0;
+    _downloadedSize.clear();
+    _totalEnabled = false;
+    _criticalReady = false;
+    
+    filterVariants();
+    
+    // Temporary manifest exists, resuming previous download
+    if (_tempManifest && _tempManifest->isLoaded() && _tempManifest->versionEquals(_remoteManifest) && _tempVariants == _variants) //groupVersion GroupVersion ȫƥ
+    {
+        revalidateResumedAssets();
+        saveManifest(_tempManifest, _tempManifestPath); //ʱmanifest
+        genResumeUnits();//Ҫص asset manifestȫasset
+        dedupDownloadUnits();
+        _totalWaitToDownload = _totalToDownload = (int)_downloadUnits.size(); //Ҫصļ
+        this->batchDownload();
+        
+        std::string msg = StringUtils::format("Resuming from previous unfinished update, %d files remains to be finished.", _totalToDownload);
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_PROGRESSION, "", msg);
+    }
+    else
+    {
+        // Temporary manifest exists, but can't be parsed or version doesn't equals remote manifest (out of date)
+        if (_tempManifest)
+        {
+            discardTempUpdate();
+        }
+        
+        // Temporary manifest will be used to register the download states of each asset,
+        // in this case, it equals remote manifest.
+        _tempManifest = _remoteManifest; //ʱʼ tempManifest ʱmanifestʵǵȼ۵
+        _tempVariants = _variants;
+        // Filtered by filterVariants, it becomes the installed one if nothing needs to be downloaded.
+        // Only here: a resumed temporary manifest holds download states the remote one doesn't
+        if (!_variants.empty())
+        {
+            saveManifest(_tempManifest, _tempManifestPath);
+        }
+        
+        // Check difference between local manifest and remote manifest
+        std::unordered_map<std::string, Manifest::AssetDiff> diff_map = _shardedDiff ? genShardedDiff() : _localManifest->genDiff(_remoteManifest); //ȡҪصļ
+        restoreSalvagedFiles(&diff_map);
+        if (diff_map.size() == 0)
+        {
+            updateSucceed();
+        }
+        else
+        {
+            // Generate download units for all assets that need to be updated or added
+            std::string packageUrl = _remoteManifest->getPackageUrl();
+            // Save current download manifest information for resuming
+            //_tempManifest->saveToFile(_tempManifestPath); //ûбļ״̬
+            // Preprocessing local files in previous version and creating download folders
+            for (auto it = diff_map.begin(); it != diff_map.end(); ++it)
+            {
+                const Manifest::AssetDiff &diff = it->second;
+                if (diff.type != Manifest::DiffType::DELETED)
+                {
+                    _downloadUnits.add(it->first, packageUrl, _tempStoragePath, diff.asset.path, diff.asset.size);
+                    _tempManifest->setAssetDownloadState(it->first, Manifest::DownloadState::UNSTARTED);
+                }
+            }
+            dedupDownloadUnits();
+			saveManifest(_tempManifest, _tempManifestPath);//ڴʱűļ״̬
+            _totalWaitToDownload = _totalToDownload = (int)_downloadUnits.size();
+            this->batchDownload();
+            
+            std::string msg = StringUtils::format("Start to update %d files from remote package.", _totalToDownload);
+            dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_PROGRESSION, "", msg);
+        }
+    }
+}
+
+void AssetsManagerEx::Core::updateSucceed()
+{
+    if (_stagedUpdate && !_repairing)
+    {
+        stageUpdate();
+        return;
+    }
+    // Every thing is correctly downloaded, do the following
+    // 0. pack the downloaded files first, the installed version is untouched if that fails
+    std::unordered_set<std::string> merged;
+    if (_packStorage && !commitPacks(&merged, false))
+    {
+        // Everything is downloaded, the next update() only retries the commit
+        saveManifest(_tempManifest, _tempManifestPath);
+        _updateState = State::FAIL_TO_UPDATE;
+        _metrics.recordError(AssetsUpdateMetrics::ErrorCategory::STORAGE);
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_FAILED, "", "Fail to write the pack storage");
+        return;
+    }
+    // 1. rename temporary manifest to valid manifest
+    std::string tempFileName = TEMP_MANIFEST_FILENAME;
+    std::string fileName = MANIFEST_FILENAME;
+    _fileUtils->renameFile(_tempStoragePath, tempFileName, fileName);
+    // 2. merge temporary storage path to storage path so that temporary version turns to cached version
+    mergeTempStorage(&merged);
+    saveVerifyCache();
+    // Hinted assets downloaded by this update, highest priority first
+    std::vector<std::string> warmUpPaths;
+    if (_warmUpEnabled && !_repairing)
+    {
+        std::vector<std::pair<std::string, int>> &warmUpHints = _remoteHints.warmUp;
+        std::stable_sort(warmUpHints.begin(), warmUpHints.end(), [](const std::pair<std::string, int> &a, const std::pair<std::string, int> &b) {
+            return a.second > b.second;
+        });
+        const auto &assets = _remoteManifest->_assets;
+        for (const auto &hint : warmUpHints)
+        {
+            auto it = assets.find(hint.first);
+            if (it != assets.end() && !it->second.compressed && merged.find(it->second.path) != merged.end())
+            {
+                warmUpPaths.push_back(_storagePath + it->second.path);
+            }
+        }
+    }
+    // 3. remove the assets deleted by this version, then swap the localManifest
+    removeDeletedAssets(_localManifest, _remoteManifest);
+    if (AssetsResolutionIndex::getInstance()->isEnabled())
+    {
+        // Keep the files of previous versions the new one still uses
+        auto previous = AssetsResolutionIndex::getInstance()->getRoot(_storagePath);
+        for (const auto &it : _remoteManifest->_assets)
+        {
+            if (!previous || previous->paths.find(it.second.path) != previous->paths.end())
+            {
+                merged.insert(it.second.path);
+            }
+        }
+        publishResolutionIndex(_remoteManifest, std::move(merged));
+    }
+    CC_SAFE_RELEASE(_localManifest);
+    _localManifest = _remoteManifest;
+    _localManifest->setManifestRoot(_storagePath);
+    _remoteManifest = nullptr;
+    // 4. make local manifest take effect
+    prepareLocalManifest();
+    if (_tempSearchPathsApplied)
+    {
+        // Critical assets were used from the temporary storage, they're merged now
+        removeSearchPaths(_tempStoragePath);
+        _tempSearchPathsApplied = false;
+    }
+    if (!_repairing)
+    {
+        float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - _updateStartTime).count();
+        _timeToComplete = elapsed;
+        _dedupTimeSaved = _totalSize > 0 ? (float)(elapsed * _dedupBytesSaved / _totalSize) : 0;
+        _metrics.recordUpdate(true, (uint64_t)(elapsed * 1000));
+        if (!_criticalReady)
+        {
+            _timeToPlayable = elapsed;
+        }
+        CCLOG("AssetsManagerEx : Time to playable %.2fs, time to complete %.2fs\n", (float)_timeToPlayable, elapsed);
+    }
+    _localHints.shardDepth = _remoteHints.shardDepth;
+    _localHints.shards = std::move(_remoteHints.shards);
+    _localHints.variants = std::move(_remoteHints.variants);
+    _shardedDiff = false;
+    _shardRemoteKeys.clear();
+    _shardLocalKeys.clear();
+    _remoteHints = ManifestHints();
+    _criticalUnits.clear();
+    _criticalReady = false;
+    // 5. Set update state
+    _updateState = State::UP_TO_DATE;
+    if (_repairing)
+    {
+        // The repair didn't check the remote version, keep the state it started from
+        _repairing = false;
+        _updateState = _stateBeforeRepair;
+        _remoteManifest = new (std::nothrow) Manifest();
+    }
+    // 6. Notify finished event
+    dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_FINISHED);
+    // 7. Warm up the hinted assets
+    if (!warmUpPaths.empty())
+    {
+        warmUp(warmUpPaths);
+    }
+}
+
+void AssetsManagerEx::Core::removeDeletedAssets(const Manifest *outgoing, const Manifest *incoming)
+{
+    const auto &incomingAssets = incoming->_assets;
+    std::unordered_set<std::string> incomingPaths;
+    incomingPaths.reserve(incomingAssets.size());
+    for (const auto &it : incomingAssets)
+    {
+        incomingPaths.insert(it.second.path);
+    }
+
+    int removed = 0;
+    for (const auto &it : outgoing->_assets)
+    {
+        const Manifest::Asset &asset = it.second;
+        // Content extracted from archives isn't listed, it's left to the new version to overwrite
+        if (asset.compressed || incomingPaths.find(asset.path) != incomingPaths.end())
+            continue;
+        const std::string path = _storagePath + asset.path;
+        if (_fileUtils->isFileExist(path) && _fileUtils->removeFile(path))
+        {
+            _verifyCache.remove(it.first);
+            ++removed;
+        }
+    }
+    if (removed > 0)
+    {
+        CCLOG("AssetsManagerEx : %d deleted assets removed from storage\n", removed);
+    }
+}
+
+void AssetsManagerEx::Core::mergeTempStorage(std::unordered_set<std::string> *merged, const std::unordered_set<std::string> &kept)
+{
+    if (!_fileUtils->isDirectoryExist(_tempStoragePath))
+        return;
+
+    // Merging all files in temp storage path to storage path
+    std::vector<std::string> files;
+    _fileUtils->listFilesRecursively(_tempStoragePath, &files);
+    merged->reserve(merged->size() + files.size());
+    int baseOffset = (int)_tempStoragePath.length();
+    std::string relativePath, dstPath;
+    for (std::vector<std::string>::iterator it = files.begin(); it != files.end(); ++it)
+    {
+        relativePath.assign((*it).substr(baseOffset));
+        if (kept.find(relativePath) != kept.end())
+            continue;
+        dstPath.assign(_storagePath + relativePath);
+        // Create directory
+        if (relativePath.back() == '/')
+        {
+            _fileUtils->createDirectory(dstPath);
+        }
+        // Copy file
+        else
+        {
+            if (_fileUtils->isFileExist(dstPath))
+            {
+                _fileUtils->removeFile(dstPath);
+            }
+            // Packed files are removed with the temporary storage
+            if (merged->find(relativePath) == merged->end())
+            {
+                _fileUtils->renameFile(*it, dstPath);
+                merged->insert(relativePath);
+            }
+        }
+    }
+    // Remove temp storage path
+    if (kept.empty())
+    {
+        _fileUtils->removeDirectory(_tempStoragePath);
+    }
+}
+
+void AssetsManagerEx::Core::stageUpdate()
+{
+    // 1. with a pack storage the downloaded files go to a staged index, the next launch only switches to it
+    std::unordered_set<std::string> packed;
+    bool staged = !_packStorage || commitPacks(&packed, true);
+    // 2. the marker completes the staged version, it's only applied with its manifest
+    if (staged && !_fileUtils->writeStringToFile(_packStorage ? STAGED_PACKED : STAGED_FILES, _tempStoragePath + STAGED_FILENAME))
+    {
+        if (_packStorage)
+        {
+            _packStorage->discardStaged();
+        }
+        staged = false;
+    }
+    if (!staged)
+    {
+        // Everything is downloaded, the next update() only retries staging
+        saveManifest(_tempManifest, _tempManifestPath);
+        _updateState = State::FAIL_TO_UPDATE;
+        _metrics.recordError(AssetsUpdateMetrics::ErrorCategory::STORAGE);
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_FAILED, "", "Fail to stage the update");
+        return;
+    }
+    std::string tempFileName = TEMP_MANIFEST_FILENAME;
+    std::string fileName = MANIFEST_FILENAME;
+    _fileUtils->renameFile(_tempStoragePath, tempFileName, fileName);
+    for (const auto &path : packed)
+    {
+        _fileUtils->removeFile(_tempStoragePath + path);
+    }
+    saveVerifyCache();
+
+    // 3. the current version stays in use, the temporary manifest is the staged one from now on
+    _updateStaged = true;
+    if (_remoteManifest != _tempManifest)
+    {
+        CC_SAFE_RELEASE(_remoteManifest);
+    }
+    _remoteManifest = new (std::nothrow) Manifest();
+    _timeToComplete = std::chrono::duration<float>(std::chrono::steady_clock::now() - _updateStartTime).count();
+    _dedupTimeSaved = _totalSize > 0 ? (float)(_timeToComplete * _dedupBytesSaved / _totalSize) : 0;
+    _metrics.recordUpdate(true, (uint64_t)(_timeToComplete * 1000));
+    _remoteHints = ManifestHints();
+    _criticalUnits.clear();
+    _criticalReady = false;
+    // Checking again looks for a newer remote version
+    _updateState = State::UNCHECKED;
+    std::string msg = StringUtils::format("Version %s is staged, it's applied at the next launch.", _tempManifest->getVersion().c_str());
+    CCLOG("AssetsManagerEx : %s\n", msg.c_str());
+    dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_STAGED, "", msg);
+}
+
+void AssetsManagerEx::Core::applyStagedUpdate()
+{
+    Manifest *staged = new (std::nothrow) Manifest();
+    if (!staged)
+        return;
+    parseManifestFile(staged, _tempStoragePath + MANIFEST_FILENAME);
+    // Files staged for a pack storage aren't in the temporary storage anymore, and plain files would be shadowed by packs
+    bool packed = _fileUtils->getStringFromFile(_tempStoragePath + STAGED_FILENAME) == STAGED_PACKED;
+    // Each step is run again by the next launch if this one is killed halfway,
+    // packs without a staged index left were already switched to it
+    bool applied = staged->isLoaded() && packed == (_packStorage != nullptr)
+        && (!packed || !_packStorage->hasStaged() || _packStorage->applyStaged());
+    if (applied)
+    {
+        // 1. plain files of the outgoing version the staged one doesn't use anymore, the cached manifest is the outgoing one until 3.
+        Manifest *outgoing = new (std::nothrow) Manifest();
+        if (outgoing && _fileUtils->isFileExist(_cacheManifestPath))
+        {
+            parseManifestFile(outgoing, _cacheManifestPath);
+            if (outgoing->isLoaded())
+            {
+                removeDeletedAssets(outgoing, staged);
+            }
+        }
+        CC_SAFE_RELEASE(outgoing);
+        // 2. the files, except the manifest and the marker
+        std::unordered_set<std::string> merged;
+        std::unordered_set<std::string> kept;
+        kept.insert(MANIFEST_FILENAME);
+        kept.insert(STAGED_FILENAME);
+        mergeTempStorage(&merged, kept);
+        // 3. the manifest makes the staged version the cached one
+        if (_fileUtils->renameFile(_tempStoragePath + MANIFEST_FILENAME, _cacheManifestPath))
+        {
+            // 4. the marker last, nothing is left to apply
+            _fileUtils->removeFile(_tempStoragePath + STAGED_FILENAME);
+            _fileUtils->removeDirectory(_tempStoragePath);
+            CCLOG("AssetsManagerEx : Staged version %s applied, %d files moved\n", staged->getVersion().c_str(), (int)merged.size());
+        }
+        else
+        {
+            CCLOGERROR("AssetsManagerEx : Fail to move the staged manifest, it's applied again at the next launch\n");
+        }
+    }
+    else
+    {
+        // Also when a previous launch was killed between 3. and 4., the temporary storage only holds leftovers then
+        CCLOGERROR("AssetsManagerEx : Fail to apply the staged version, it's discarded\n");
+        discardStagedUpdate();
+        _fileUtils->removeDirectory(_tempStoragePath);
+    }
+    CC_SAFE_RELEASE(staged);
+}
+
+void AssetsManagerEx::Core::discardStagedUpdate()
+{
+    // The marker first, a marker left without a staged index means the packs were switched
+    _fileUtils->removeFile(_tempStoragePath + STAGED_FILENAME);
+    if (_packStorage)
+    {
+        _packStorage->discardStaged();
+    }
+    if (_updateStaged)
+    {
+        // Every asset of the staged manifest is downloaded, it must not be resumed
+        if (_tempManifest != _localManifest && _tempManifest != _remoteManifest)
+        {
+            CC_SAFE_RELEASE(_tempManifest);
+        }
+        _tempManifest = nullptr;
+        _updateStaged = false;
+    }
+}
+
+void AssetsManagerEx::Core::discardTempUpdate()
+{
+    // A newer version than the staged one
+    if (_updateStaged)
+    {
+        discardStagedUpdate();
+    }
+    // Remove all temp files
+    if (_tempSearchPathsApplied)
+    {
+        removeSearchPaths(_tempStoragePath);
+        _tempSearchPathsApplied = false;
+    }
+    _fileUtils->removeDirectory(_tempStoragePath); //ԭtempļȫƳ
+    CC_SAFE_RELEASE_NULL(_tempManifest);
+    // Recreate temp storage path and save remote manifest
+    _fileUtils->createDirectory(_tempStoragePath); //µtempļ
+    // Only the version is known after the version file, the manifest is downloaded there next
+    if (_remoteManifest->isLoaded())
+    {
+        saveManifest(_remoteManifest, _tempManifestPath);//ոµmanifest
+    }
+}
+
+void AssetsManagerEx::Core::remoteVersionStaged()
+{
+    // Nothing to download until the next launch applies it, the remote manifest may have overwritten the temporary one
+    std::string msg = StringUtils::format("Version %s is staged, it's applied at the next launch.", _tempManifest->getVersion().c_str());
+    CC_SAFE_RELEASE(_remoteManifest);
+    _remoteManifest = new (std::nothrow) Manifest();
+    _fileUtils->removeFile(_tempManifestPath);
+    // Checking again looks for a newer remote version
+    _updateState = State::UNCHECKED;
+    dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_STAGED, "", msg);
+}
+
+bool AssetsManagerEx::Core::commitPacks(std::unordered_set<std::string> *packed, bool staged)
+{
+    std::vector<std::string> added;
+    if (_fileUtils->isDirectoryExist(_tempStoragePath))
+    {
+        std::vector<std::string> files;
+        _fileUtils->listFilesRecursively(_tempStoragePath, &files);
+        size_t baseOffset = _tempStoragePath.length();
+        for (const auto &file : files)
+        {
+            std::string relativePath = file.substr(baseOffset);
+            // Manifests are read by the manager itself, they stay plain files
+            if (relativePath.empty() || relativePath.back() == '/' || relativePath == MANIFEST_FILENAME
+                || relativePath == TEMP_MANIFEST_FILENAME || relativePath == VERSION_FILENAME)
+                continue;
+            added.push_back(relativePath);
+        }
+    }
+
+    // Dropped in the same commit, as removeDeletedAssets does for plain files
+    std::unordered_set<std::string> incomingPaths;
+    incomingPaths.reserve(_remoteManifest->_assets.size());
+    for (const auto &it : _remoteManifest->_assets)
+    {
+        incomingPaths.insert(it.second.path);
+    }
+    std::vector<std::string> removed;
+    for (const auto &it : _localManifest->_assets)
+    {
+        const Manifest::Asset &asset = it.second;
+        if (!asset.compressed && incomingPaths.find(asset.path) == incomingPaths.end())
+        {
+            removed.push_back(asset.path);
+        }
+    }
+
+    _fileUtils->createDirectory(_storagePath + AssetsPackStorage::PACK_DIRECTORY);
+    const std::string sourceRoot = _fileUtils->getSuitableFOpen(_tempStoragePath);
+    if (!(staged ? _packStorage->stage(sourceRoot, added, removed) : _packStorage->commit(sourceRoot, added, removed)))
+    {
+        CCLOGERROR("AssetsManagerEx : Fail to commit %d files to the pack storage\n", (int)added.size());
+        return false;
+    }
+    packed->insert(added.begin(), added.end());
+    CCLOG("AssetsManagerEx : %d files packed, %d files in %d packs\n", (int)added.size(),
+          (int)_packStorage->getEntryCount(), (int)_packStorage->getPackCount());
+    return true;
+}
+
+void AssetsManagerEx::Core::warmUp(const std::vector<std::string> &paths)
+{
+    static const char *textureExtensions[] = {".png", ".jpg", ".jpeg", ".webp", ".pvr", ".ccz", ".pkm", ".tga", ".tif", ".tiff"};
+
+    std::vector<std::string> textures, files, packedFiles;
+    for (const auto &path : paths)
+    {
+        size_t dot = path.find_last_of('.');
+        std::string ext = dot != std::string::npos ? path.substr(dot) : "";
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        bool isTexture = false;
+        for (const char *textureExt : textureExtensions)
+        {
+            if (ext == textureExt)
+            {
+                isTexture = true;
+                break;
+            }
+        }
+        std::string relativePath = path.substr(_storagePath.size());
+        if (isTexture && _textureWarmUp)
+            textures.push_back(path);
+        else if (_packStorage && _packStorage->contains(relativePath))
+            packedFiles.push_back(relativePath);
+        else
+            files.push_back(_fileUtils->getSuitableFOpen(path));
+    }
+    CCLOG("AssetsManagerEx : Warming up %d textures and %d files\n", (int)textures.size(), (int)(files.size() + packedFiles.size()));
+
+    // Neither step refers to this manager, it may be released before they end
+    if (!files.empty() || !packedFiles.empty())
+    {
+        std::shared_ptr<AssetsPackStorage> packs = _packStorage;
+        _taskRunner->runAsync([files, packedFiles, packs]() {
+            std::vector<char> buffer(65536);
+            for (const auto &path : files)
+            {
+                FILE *fp = fopen(path.c_str(), "rb");
+                if (!fp)
+                    continue;
+                while (fread(buffer.data(), 1, buffer.size(), fp) == buffer.size())
+                {
+                }
+                fclose(fp);
+            }
+            std::string content;
+            ResizableBufferAdapter<std::string> adapter(&content);
+            for (const auto &path : packedFiles)
+            {
+                packs->read(path, &adapter);
+            }
+        }, []() {});
+    }
+    if (!textures.empty())
+    {
+        // The owner hands them to the TextureCache, which needs the main thread
+        _scheduler->performInDriverThread([textures]() {
+            AssetsManagerEx::warmUpTextures(textures);
+        });
+    }
+}
+
+void AssetsManagerEx::Core::publishResolutionIndex(const Manifest *installed, std::unordered_set<std::string> &&present)
+{
+    AssetsResolutionIndex *index = AssetsResolutionIndex::getInstance();
+    if (!index->isEnabled())
+        return;
+
+    auto root = std::make_shared<AssetsResolutionIndex::Root>();
+    root->root = _storagePath;
+    root->paths = std::move(present);
+    root->paths.insert(MANIFEST_FILENAME);
+    root->paths.insert(VERSION_FILENAME);
+    root->packs = _packStorage;
+    if (installed)
+    {
+        std::unordered_set<std::string> probeDirs;
+        for (const auto &it : installed->_assets)
+        {
+            const Manifest::Asset &asset = it.second;
+            if (!asset.compressed)
+                continue;
+            size_t slash = asset.path.find_last_of('/');
+            // An archive at the storage root may extract anything anywhere
+            probeDirs.insert(slash == std::string::npos ? "" : asset.path.substr(0, slash + 1));
+        }
+        root->probeDirs.assign(probeDirs.begin(), probeDirs.end());
+    }
+    index->setRoot(std::move(root));
+}
+
+void AssetsManagerEx::Core::collectGarbage()
+{
+    if (postToWorker([this]() { collectGarbage(); }))
+        return;
+
+    if (_updateEntry != UpdateEntry::NONE || (_updateState != State::UNCHECKED && _updateState != State::UP_TO_DATE))
+    {
+        CCLOGERROR("AssetsManagerEx::collectGarbage, an update is running");
+        return;
+    }
+    if (!_inited || !_localManifest->isLoaded())
+    {
+        CCLOG("AssetsManagerEx : No local manifest file found error.\n");
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST);
+        return;
+    }
+
+    struct SweepData
+    {
+        std::unordered_set<std::string> referenced;
+        std::vector<std::string> protectedDirs;
+        int removed;
+        double removedBytes;
+    };
+    auto data = std::make_shared<SweepData>();
+    data->referenced.reserve(_localManifest->_assets.size() + 2);
+    for (const auto &it : _localManifest->_assets)
+    {
+        const Manifest::Asset &asset = it.second;
+        data->referenced.insert(_storagePath + asset.path);
+        if (asset.compressed)
+        {
+            data->protectedDirs.push_back(_storagePath + asset.path.substr(0, asset.path.find_last_of("/\\") + 1));
+        }
+    }
+    data->referenced.insert(_cacheManifestPath);
+    data->referenced.insert(_verifyCachePath);
+    if (_packStorage)
+    {
+        data->protectedDirs.push_back(_storagePath + AssetsPackStorage::PACK_DIRECTORY);
+    }
+    data->removed = 0;
+    data->removedBytes = 0;
+
+    _updateEntry = UpdateEntry::MAINTENANCE;
+    _sweeping = true;
+    FileUtils *fileUtils = _fileUtils;
+    const std::string storagePath = _storagePath;
+    runInBackground([data, fileUtils, storagePath]() {
+        std::vector<std::string> files;
+        fileUtils->listFilesRecursively(storagePath, &files);
+        for (const auto &file : files)
+        {
+            if (file.empty() || file.back() == '/' || data->referenced.find(file) != data->referenced.end())
+                continue;
+            bool isProtected = false;
+            for (const auto &dir : data->protectedDirs)
+            {
+                if (file.compare(0, dir.size(), dir) == 0)
+                {
+                    isProtected = true;
+                    break;
+                }
+            }
+            if (isProtected)
+                continue;
+            long size = fileUtils->getFileSize(file);
+            if (fileUtils->removeFile(file))
+            {
+                data->removed++;
+                data->removedBytes += MAX(0, size);
+            }
+        }
+    }, [this, data]() {
+        _sweeping = false;
+        _updateEntry = UpdateEntry::NONE;
+        std::string msg = StringUtils::format("Removed %d unreferenced files, %.1f MB", data->removed, data->removedBytes / (1024 * 1024));
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::GARBAGE_COLLECTED, "", msg);
+    });
+}
+
+void AssetsManagerEx::Core::checkUpdate()
+{
+    if (postToWorker([this]() { checkUpdate(); }))
+        return;
+
+    if (_updateEntry != UpdateEntry::NONE)
+    {
+        CCLOGERROR("AssetsManagerEx::checkUpdate, updateEntry isn't NONE");
+        return;
+    }
+
+    if (!_inited){ //صmanifestûгʼ
+        CCLOG("AssetsManagerEx : Manifests uninited.\n");
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST);
+        return;
+    }
+    if (!_localManifest->isLoaded())
+    {
+        CCLOG("AssetsManagerEx : No local manifest file found error.\n");
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST);
+        return;
+    }
+
+    _updateEntry = UpdateEntry::CHECK_UPDATE;
+
+	//updateState ʼΪUNCHECKED
+    switch (_updateState) {
+        case State::UNCHECKED:
+        case State::PREDOWNLOAD_VERSION:
+        {
+            downloadVersion();
+        }
+            break;
+        case State::UP_TO_DATE:
+        {
+            dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ALREADY_UP_TO_DATE);
+        }
+            break;
+        case State::FAIL_TO_UPDATE:
+        case State::NEED_UPDATE:
+        {
+            dispatchUpdateEvent(EventAssetsManagerEx::EventCode::NEW_VERSION_FOUND);
+        }
+            break;
+        default:
+            break;
+    }
+}
+
+void AssetsManagerEx::Core::update()
+{
+    if (postToWorker([this]() { update(); }))
+        return;
+
+    if (_updateEntry != UpdateEntry::NONE)
+    {
+        CCLOGERROR("AssetsManagerEx::update, updateEntry isn't NONE");
+        return;
+    }
+
+    if (!_inited){
+        CCLOG("AssetsManagerEx : Manifests uninited.\n");
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST);
+        return;
+    }
+    if (!_localManifest->isLoaded())
+    {
+        CCLOG("AssetsManagerEx : No local manifest file found error.\n");
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST);
+        return;
+    }
+
+    _updateEntry = UpdateEntry::DO_UPDATE;
+    _updateStartTime = std::chrono::steady_clock::now();
+    _timeToPlayable = -1;
+    _timeToComplete = -1;
+    _dedupBytesSaved = 0;
+    _dedupTimeSaved = 0;
+
+    switch (_updateState) {
+        case State::UNCHECKED: //  UNCHECK 
+        {
+            _updateState = State::PREDOWNLOAD_VERSION;
+        }
+        case State::PREDOWNLOAD_VERSION:
+        {
+            downloadVersion(); //UNCKECK ĻͿʼversion 
+        }
+            break;
+        case State::VERSION_LOADED:
+        {
+            parseVersion();
+        }
+            break;
+        case State::PREDOWNLOAD_MANIFEST:
+        {
+            downloadManifest();
+        }
+            break;
+        case State::MANIFEST_LOADED:
+        {
+            parseManifest();
+        }
+            break;
+        case State::FAIL_TO_UPDATE:
+        case State::NEED_UPDATE:
+        {
+            // Shards missing, the manifest is downloaded again
+            if (_pendingShards > 0)
+            {
+                dropRemoteShards();
+            }
+            // Manifest not loaded yet
+            if (!_remoteManifest->isLoaded())
+            {
+                _updateState = State::PREDOWNLOAD_MANIFEST;
+                downloadManifest();
+            }
+            else
+            {
+                startUpdate();
+            }
+        }
+            break;
+        case State::UP_TO_DATE:
+        case State::UPDATING:
+        case State::UNZIPPING:
+            _updateEntry = UpdateEntry::NONE;
+            break;
+        default:
+            break;
+    }
+}
+
+void AssetsManagerEx::Core::pause()
+{
+    if (postToWorker([this]() { pause(); }))
+        return;
+
+    if (_updateState != State::UPDATING || _paused)
+        return;
+
+    _paused = true;
+    abortDownloads();
+    // Flush download states so the progress survives if the app is killed while paused
+    saveManifest(_tempManifest, _tempManifestPath);
+    saveVerifyCache();
+}
+
+void AssetsManagerEx::Core::resume()
+{
+    if (postToWorker([this]() { resume(); }))
+        return;
+
+    if (!_paused)
+        return;
+
+    _paused = false;
+    if (_updateState == State::UPDATING)
+    {
+        queueDowload();
+    }
+}
+
+void AssetsManagerEx::Core::cancel()
+{
+    if (postToWorker([this]() { cancel(); }))
+        return;
+
+    // The sweep can't be interrupted, files merged by a new update would be swept too
+    if (_sweeping)
+        return;
+
+    // Batches still running stop after their current items and are ignored when they finish
+    if (_verifySession)
+    {
+        _verifySession->cancelled = true;
+        _verifySession = nullptr;
+    }
+    _paused = false;
+    switch (_updateState)
+    {
+        case State::PREDOWNLOAD_VERSION:
+        case State::DOWNLOADING_VERSION:
+        case State::VERSION_LOADED:
+        case State::PREDOWNLOAD_MANIFEST:
+        case State::DOWNLOADING_MANIFEST:
+        case State::MANIFEST_LOADED:
+        {
+            abortDownloads();
+            _updateState = State::UNCHECKED;
+        }
+            break;
+        case State::UPDATING:
+        {
+            abortDownloads();
+            _queue.clear();
+            // Units still being decompressed are dropped too
+            _currConcurrentTask = 0;
+            ++_updateGeneration;
+            saveManifest(_tempManifest, _tempManifestPath);
+            saveVerifyCache();
+            // The remote manifest stays loaded, so the next update() resumes from the temp manifest
+            // without downloading the version and manifest files or generating the diff again
+            _updateState = State::NEED_UPDATE;
+        }
+            break;
+        default:
+            break;
+    }
+    _updateEntry = UpdateEntry::NONE;
+}
+
+void AssetsManagerEx::Core::verifyInstalled(int maxThreads)
+{
+    if (postToWorker([this, maxThreads]() { verifyInstalled(maxThreads); }))
+        return;
+
+    if (_updateEntry != UpdateEntry::NONE || (_updateState != State::UNCHECKED && _updateState != State::UP_TO_DATE))
+    {
+        CCLOGERROR("AssetsManagerEx::verifyInstalled, an update is running");
+        return;
+    }
+    if (!_inited || !_localManifest->isLoaded())
+    {
+        CCLOG("AssetsManagerEx : No local manifest file found error.\n");
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST);
+        return;
+    }
+
+    // Assets identical in the app package are not in the storage
+    Manifest *bundleManifest = new (std::nothrow) Manifest();
+    if (!bundleManifest)
+        return;
+    if (_bundleManifestPath.size() > 0)
+    {
+        parseManifestFile(bundleManifest, _bundleManifestPath);
+    }
+    const std::unordered_map<std::string, Manifest::Asset> emptyAssets;
+    const auto &bundleAssets = bundleManifest->isLoaded() ? bundleManifest->_assets : emptyAssets;
+
+    auto session = std::make_shared<VerifySession>();
+    for (const auto &it : _localManifest->_assets)
+    {
+        // Archives are removed once decompressed, their content isn't listed
+        if (it.second.compressed)
+            continue;
+        auto bundleIt = bundleAssets.find(it.first);
+        if (bundleIt != bundleAssets.end() && bundleIt->second.md5 == it.second.md5)
+            continue;
+
+        VerifySession::Item item;
+        item.key = it.first;
+        item.path = _storagePath + it.second.path;
+        item.asset = it.second;
+        item.hasCachedStat = _verifyCacheEnabled && _verifyCache.find(it.first, it.second.md5, &item.cachedStat);
+        item.bytes = 0;
+        item.result = VerifySession::Result::UNCHECKED;
+        session->items.push_back(std::move(item));
+    }
+    CC_SAFE_RELEASE(bundleManifest);
+
+    int threads = maxThreads > 0 ? maxThreads : (int)std::thread::hardware_concurrency() - 1;
+    session->threads = MAX(1, threads);
+    session->verifyCallback = _verifyCallback;
+    session->next = 0;
+    session->pendingTasks = 0;
+    session->cancelled = false;
+    session->bytesHashed = 0;
+    session->start = std::chrono::steady_clock::now();
+
+    // Kept across batches and runs, its threads are only created again for another thread count
+    if (!_verifyPool || _verifyPoolThreads != session->threads)
+    {
+        _verifyPool.reset(new (std::nothrow) ThreadPoolRunner(session->threads, [this](const std::function<void()> &done) {
+            if (_worker)
+            {
+                _worker->post(done);
+            }
+            else
+            {
+                _scheduler->performInDriverThread(done);
+            }
+        }));
+        _verifyPoolThreads = _verifyPool ? session->threads : 0;
+        if (!_verifyPool)
+            return;
+    }
+
+    _updateEntry = UpdateEntry::MAINTENANCE;
+    _verifySession = session;
+    _percent = _percentByFile = 0;
+    verifyNextBatch(session);
+}
+
+void AssetsManagerEx::Core::verifyNextBatch(const std::shared_ptr<VerifySession> &session)
+{
+    const size_t begin = session->next;
+    const size_t end = MIN(begin + VERIFY_BATCH_SIZE, session->items.size());
+    if (begin >= end)
+    {
+        finishVerify(session);
+        return;
+    }
+
+    // Every pool thread claims items of the batch until none is left, the last done handles the batch
+    FileUtils *fileUtils = _fileUtils;
+    std::shared_ptr<AssetsPackStorage> packs = _packStorage;
+    std::function<void()> work = [session, fileUtils, packs, end]() {
+        size_t i;
+        while (!session->cancelled.load(std::memory_order_relaxed) && (i = session->claimed.fetch_add(1)) < end)
+        {
+            VerifySession::Item &item = session->items[i];
+            VerifySession::check(item, fileUtils->getSuitableFOpen(item.path), packs.get(), session->verifyCallback);
+        }
+    };
+    std::function<void()> done = [this, session, begin, end]() {
+        if (--session->pendingTasks > 0 || session != _verifySession)
+            return;
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            const VerifySession::Item &item = session->items[i];
+            switch (item.result)
+            {
+                case VerifySession::Result::VERIFIED:
+                    session->bytesHashed += item.bytes;
+                    if (_verifyCacheEnabled)
+                    {
+                        _verifyCache.markVerified(item.key, _fileUtils->getSuitableFOpen(item.path), item.asset.md5);
+                    }
+                    break;
+                case VerifySession::Result::BROKEN:
+                    session->bytesHashed += item.bytes;
+                    _verifyCache.remove(item.key);
+                    session->broken.push_back(item.key);
+                    break;
+                default:
+                    break;
+            }
+        }
+        session->next = end;
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - session->start).count();
+        double hashedMB = session->bytesHashed / (1024.0 * 1024.0);
+        _percent = _percentByFile = 100 * (float)end / session->items.size();
+        std::string msg = StringUtils::format("Checked %d/%d installed files, %d broken, %.1f MB hashed at %.1f MB/s",
+                                              (int)end, (int)session->items.size(), (int)session->broken.size(),
+                                              hashedMB, seconds > 0 ? hashedMB / seconds : 0.0);
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::VERIFY_PROGRESSION, "", msg);
+
+        // Listeners may have cancelled
+        if (session == _verifySession)
+        {
+            verifyNextBatch(session);
+        }
+    };
+    session->claimed = begin;
+    session->pendingTasks = (int)MIN((size_t)session->threads, end - begin);
+    for (int t = session->pendingTasks; t > 0; --t)
+    {
+        _verifyPool->runAsync(work, done);
+    }
+}
+
+void AssetsManagerEx::Core::finishVerify(const std::shared_ptr<VerifySession> &session)
+{
+    _verifySession = nullptr;
+    saveVerifyCache();
+
+    const std::vector<std::string> &broken = session->broken;
+    if (broken.empty())
+    {
+        _updateEntry = UpdateEntry::NONE;
+        std::string msg = StringUtils::format("All %d installed files are intact.", (int)session->items.size());
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::VERIFY_FINISHED, "", msg);
+        return;
+    }
+
+    // The temporary storage of an unfinished update must not be merged with the repair
+    if (_updateStaged || _fileUtils->isFileExist(_tempManifestPath))
+    {
+        _updateEntry = UpdateEntry::NONE;
+        std::string msg = StringUtils::format("%d installed files are broken, they can't be repaired before the pending update is finished.", (int)broken.size());
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::VERIFY_FINISHED, "", msg);
+        return;
+    }
+    AssetsDownloadTable units;
+    if (!prepareRepair(broken, &units))
+    {
+        _updateEntry = UpdateEntry::NONE;
+        std::string msg = StringUtils::format("%d installed files are broken, fail to prepare their repair.", (int)broken.size());
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::VERIFY_FINISHED, "", msg);
+        return;
+    }
+
+    _updateEntry = UpdateEntry::DO_UPDATE;
+    std::string msg = StringUtils::format("%d installed files are broken, downloading them again.", (int)broken.size());
+    dispatchUpdateEvent(EventAssetsManagerEx::EventCode::VERIFY_FINISHED, "", msg);
+    // Listeners may have started something else
+    if (_updateEntry == UpdateEntry::DO_UPDATE && _updateState != State::UPDATING)
+    {
+        _repairing = true;
+        _stateBeforeRepair = _updateState;
+        updateUnits([&units](AssetsDownloadTable *table) {
+            *table = std::move(units);
+        });
+    }
+}
+
+bool AssetsManagerEx::Core::prepareRepair(const std::vector<std::string> &brokenKeys, AssetsDownloadTable *units)
+{
+    // The repair is an update from the local manifest to itself, rewrite the cached copy
+    // in case it was removed too and load it as remote manifest
+    saveManifest(_localManifest, _cacheManifestPath);
+    if (_tempManifest != _localManifest && _tempManifest != _remoteManifest)
+    {
+        CC_SAFE_RELEASE(_tempManifest);
+    }
+    _tempManifest = nullptr;
+    if (!_remoteManifest)
+    {
+        _remoteManifest = new (std::nothrow) Manifest();
+        if (!_remoteManifest)
+            return false;
+    }
+    _remoteHints = ManifestHints();
+    parseManifestFile(_remoteManifest, _cacheManifestPath, &_remoteHints);
+    if (!_remoteManifest->isLoaded())
+        return false;
+    _tempManifest = _remoteManifest;
+
+    const std::string &packageUrl = _remoteManifest->getPackageUrl();
+    const auto &assets = _remoteManifest->getAssets();
+    for (const auto &key : brokenKeys)
+    {
+        auto assetIt = assets.find(key);
+        if (assetIt == assets.end())
+            continue;
+        units->add(key, packageUrl, _tempStoragePath, assetIt->second.path, assetIt->second.size);
+        _tempManifest->setAssetDownloadState(key, Manifest::DownloadState::UNSTARTED);
+    }
+    _fileUtils->createDirectory(_tempStoragePath);
+    saveManifest(_tempManifest, _tempManifestPath);
+    return units->size() > 0;
+}
+
+void AssetsManagerEx::Core::updateAssets(const DownloadUnits& assets)
+{
+    updateUnits([&assets](AssetsDownloadTable *units) {
+        units->clear();
+        for (const auto &it : assets)
+        {
+            units->addPaths(it.second.customId, it.second.srcUrl, it.second.storagePath, it.second.size);
+        }
+    });
+}
+
+void AssetsManagerEx::Core::updateUnits(const std::function<void(AssetsDownloadTable *units)> &fill)
+{
+    if (!_inited){
+        CCLOG("AssetsManagerEx : Manifests uninited.\n");
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST);
+        return;
+    }
+    
+    if (_updateState != State::UPDATING && _localManifest->isLoaded() && _remoteManifest->isLoaded())
+    {
+        _updateState = State::UPDATING;
+        fill(&_downloadUnits);
+        _downloadedSize.clear();
+        _percent = _percentByFile = _sizeCollected = _totalSize = 0;
+        _totalWaitToDownload = _totalToDownload = (int)_downloadUnits.size();
+        _nextSavePoint = 0;
+        _totalEnabled = false;
+        if (_totalToDownload > 0)
+        {
+            this->batchDownload();
+        }
+        else if (_totalToDownload == 0)
+        {
+            onDownloadUnitsFinished();
+        }
+    }
+}
+
+const DownloadUnits& AssetsManagerEx::Core::getFailedAssets() const
+{
+    _failedAssets.clear();
+    for (const auto &key : _failedUnits)
+    {
+        auto unitIt = _downloadUnits.find(key);
+        if (unitIt == _downloadUnits.end())
+            continue;
+        DownloadUnit unit;
+        unit.customId = key;
+        _downloadUnits.getSrcUrl(key, unitIt->second, &unit.srcUrl);
+        _downloadUnits.getStoragePath(key, unitIt->second, &unit.storagePath);
+        unit.size = unitIt->second.size;
+        _failedAssets.emplace(key, std::move(unit));
+    }
+    return _failedAssets;
+}
+
+void AssetsManagerEx::Core::genResumeUnits()
+{
+    const std::string &packageUrl = _tempManifest->getPackageUrl();
+    for (const auto &it : _tempManifest->_assets)
+    {
+        const Manifest::Asset &asset = it.second;
+        if (asset.downloadState != (int)Manifest::DownloadState::SUCCESSED && asset.downloadState != (int)Manifest::DownloadState::UNMARKED)
+        {
+            _downloadUnits.add(it.first, packageUrl, _tempStoragePath, asset.path, asset.size);
+        }
+    }
+}
+
+void AssetsManagerEx::Core::downloadFailedAssets()
+{
+    if (postToWorker([this]() { downloadFailedAssets(); }))
+        return;
+
+    CCLOG("AssetsManagerEx : Start update %lu failed assets.\n", static_cast<unsigned long>(_failedUnits.size()));
+    _metrics.recordRetries(_failedUnits.size());
+    updateUnits([this](AssetsDownloadTable *units) {
+        units->retain(_failedUnits);
+    });
+}
+
+void AssetsManagerEx::Core::fileError(const std::string& identifier, const std::string& errorStr, int errorCode, int errorCodeInternal)
+{
+    auto unitIt = _downloadUnits.find(identifier);
+    // Found unit and add it to failed units
+    if (unitIt != _downloadUnits.end())
+    {
+        _totalWaitToDownload--;
+        
+        _failedUnits.insert(unitIt->first);
+    }
+    dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_UPDATING, identifier, errorStr, errorCode, errorCodeInternal);
+    _tempManifest->setAssetDownloadState(identifier, Manifest::DownloadState::UNSTARTED);
+    
+    _currConcurrentTask = MAX(0, _currConcurrentTask-1);
+    queueDowload();
+}
+
+void AssetsManagerEx::Core::fileSuccess(const std::string &customId, const std::string &storagePath)
+{
+    // Set download state to SUCCESSED
+    _tempManifest->setAssetDownloadState(customId, Manifest::DownloadState::SUCCESSED);
+    
+    // Remove from failed units list
+    _failedUnits.erase(customId);
+    
+    auto unitIt = _downloadUnits.find(customId);
+    if (unitIt != _downloadUnits.end())
+    {
+        // Reduce count only when unit found in _downloadUnits
+        _totalWaitToDownload--;
+        
+        _percentByFile = 100 * (float)(_totalToDownload - _totalWaitToDownload) / _totalToDownload;
+
+        // Notify progression event
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_PROGRESSION, "");
+    }
+    // Notify asset updated event
+    dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ASSET_UPDATED, customId);
+    
+    if (_criticalUnits.erase(customId) > 0 && _criticalUnits.empty() && !_criticalReady)
+    {
+        criticalSetReady();
+    }
+    
+    _currConcurrentTask = MAX(0, _currConcurrentTask-1);
+    queueDowload();
+}
+
+void AssetsManagerEx::Core::onError(const network::DownloadTask& task,
+                              int errorCode,
+                              int errorCodeInternal,
+                              const std::string& errorStr)
+{
+    // Skip version error occurred
+    if (task.identifier == VERSION_ID)
+    {
+        CCLOG("AssetsManagerEx : Fail to download version file, step skipped\n");
+        _updateState = State::PREDOWNLOAD_MANIFEST;
+        downloadManifest();
+    }
+    else if (task.identifier == MANIFEST_ID)
+    {
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_DOWNLOAD_MANIFEST, task.identifier, errorStr, errorCode, errorCodeInternal);
+        _updateState = State::FAIL_TO_UPDATE;
+    }
+    else if (task.identifier.compare(0, sizeof(SHARD_ID_PREFIX) - 1, SHARD_ID_PREFIX) == 0)
+    {
+        // Reported once, the other shards are dropped as they come
+        if (_updateState == State::DOWNLOADING_MANIFEST)
+        {
+            // The next update checks again from the start
+            dropRemoteShards();
+            _updateState = State::UNCHECKED;
+            dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ERROR_DOWNLOAD_MANIFEST, task.identifier, errorStr, errorCode, errorCodeInternal);
+        }
+    }
+    else
+    {
+        unitDownloadEnded(task.identifier, task.storagePath, false);
+        _metrics.recordError(AssetsUpdateMetrics::ErrorCategory::NETWORK);
+        fileError(task.identifier, errorStr, errorCode, errorCodeInternal);
+    }
+}
+
+void AssetsManagerEx::Core::onProgress(double total, double downloaded, const std::string& /*url*/, const std::string &customId)
+{
+    // Shards are small, the progression of the update starts with its assets
+    if (customId.compare(0, sizeof(SHARD_ID_PREFIX) - 1, SHARD_ID_PREFIX) == 0)
+        return;
+    if (customId == VERSION_ID || customId == MANIFEST_ID)
+    {
+        _percent = 100 * downloaded / total;
+		if (_percent < 0) {
+			_percent = _percentByFile;
+		};
+        // Notify progression event
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_PROGRESSION, customId);
+        return;
+    }
+    else
+    {
+        // Calcul total downloaded
+        bool found = false;
+        double totalDownloaded = 0;
+        for (auto it = _downloadedSize.begin(); it != _downloadedSize.end(); ++it)
+        {
+            if (it->first == customId)
+            {
+                it->second = downloaded;
+                found = true;
+            }
+            totalDownloaded += it->second;
+        }
+        // Collect information if not registed
+        if (!found)
+        {
+            // Set download state to DOWNLOADING, this will run only once in the download process
+            _tempManifest->setAssetDownloadState(customId, Manifest::DownloadState::DOWNLOADING);
+            // Register the download size information
+            _downloadedSize.emplace(customId, downloaded);
+            // Check download unit size existance, if not exist collect size in total size
+            auto unitIt = _downloadUnits.find(customId);
+            if (unitIt != _downloadUnits.end() && unitIt->second.size == 0)
+            {
+                _totalSize += total;
+                _sizeCollected++;
+                // All collected, enable total size
+                if (_sizeCollected == _totalToDownload)
+                {
+                    _totalEnabled = true;
+                }
+            }
+        }
+        
+        if (_totalEnabled && _updateState == State::UPDATING)
+        {
+            float currentPercent = 100 * totalDownloaded / _totalSize;
+            // Notify at integer level change
+            if ((int)currentPercent != (int)_percent) {
+                _percent = currentPercent;
+				if (_percent < 0) {
+					_percent = _percentByFile;
+				};
+                // Notify progression event
+                dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_PROGRESSION, customId);
+            }
+        }
+    }
+}
+
+void AssetsManagerEx::Core::onSuccess(const std::string &/*srcUrl*/, const std::string &storagePath, const std::string &customId)
+{
+    if (customId == VERSION_ID)
+    {
+        _updateState = State::VERSION_LOADED;
+        parseVersion();
+    }
+    else if (customId == MANIFEST_ID)
+    {
+        _updateState = State::MANIFEST_LOADED;
+        parseManifest();
+    }
+    else if (customId.compare(0, sizeof(SHARD_ID_PREFIX) - 1, SHARD_ID_PREFIX) == 0)
+    {
+        onShardLoaded(storagePath);
+    }
+    else
+    {
+        unitDownloadEnded(customId, storagePath, true);
+        bool ok = true;
+        auto &assets = _remoteManifest->getAssets();
+        auto assetIt = assets.find(customId);
+        if (assetIt != assets.end())
+        {
+            if (_verifyCallback != nullptr)
+            {
+                ok = verifyAsset(customId, storagePath, assetIt->second);
+            }
+        }
+        
+        if (ok)
+        {
+            bool compressed = assetIt != assets.end() ? assetIt->second.compressed : false;
+            if (compressed)
+            {
+                decompressDownloadedZip(customId, storagePath);
+            }
+            else
+            {
+                materializeAliases(customId, storagePath);
+                fileSuccess(customId, storagePath);
+            }
+        }
+        else
+        {
+            _metrics.recordError(AssetsUpdateMetrics::ErrorCategory::VERIFY);
+            fileError(customId, "Asset file verification failed after downloaded");
+        }
+    }
+}
+
+void AssetsManagerEx::Core::destroyDownloadedVersion()
+{
+    if (_packStorage)
+    {
+        _packStorage->clear();
+    }
+    _fileUtils->removeDirectory(_storagePath);
+    _fileUtils->removeDirectory(_tempStoragePath);
+    _fileUtils->removeDirectory(_salvageStoragePath);
+    _verifyCache.clear();
+    publishResolutionIndex(nullptr, std::unordered_set<std::string>());
+}
+
+bool AssetsManagerEx::Core::verifyAsset(const std::string &key, const std::string &path, const Manifest::Asset &asset)
+{
+    if (_verifyCallback == nullptr)
+        return true;
+
+    // Archives are removed once decompressed, only plain files are worth indexing
+    bool cacheable = _verifyCacheEnabled && !asset.compressed;
+    const std::string statPath = _fileUtils->getSuitableFOpen(path);
+    if (cacheable && _verifyCache.isVerified(key, statPath, asset.md5))
+        return true;
+
+    auto startTime = std::chrono::steady_clock::now();
+    bool ok = _verifyCallback(path, asset);
+    auto verifyTime = std::chrono::steady_clock::now() - startTime;
+    _metrics.recordVerify(std::chrono::duration_cast<std::chrono::microseconds>(verifyTime).count());
+    if (ok && cacheable)
+    {
+        _verifyCache.markVerified(key, statPath, asset.md5);
+    }
+    else
+    {
+        _verifyCache.remove(key);
+    }
+    return ok;
+}
+
+void AssetsManagerEx::Core::runInBackground(const std::function<void()> &work, std::function<void()> done)
+{
+    auto alive = _alive;
+    if (_worker)
+    {
+        // Finish on the worker with the rest of the state machine
+        std::function<void()> doneOnWorker = std::move(done);
+        done = [this, alive, doneOnWorker]() {
+            if (alive->load(std::memory_order_acquire))
+                _worker->post(doneOnWorker);
+        };
+    }
+    else
+    {
+        std::function<void()> doneOnCaller = std::move(done);
+        done = [alive, doneOnCaller]() {
+            if (alive->load(std::memory_order_acquire))
+                doneOnCaller();
+        };
+    }
+    _taskRunner->runAsync(work, done);
+}
+
+void AssetsManagerEx::Core::runExtraction(const std::function<void()> &work, const std::function<void()> &done)
+{
+    if (!_extractionPool)
+    {
+        runInBackground(work, done);
+        return;
+    }
+    // The pool delivers done to the worker or the main thread itself
+    _extractionPool->runAsync(work, done);
+}
+
+bool AssetsManagerEx::Core::extractionBudgetExceeded() const
+{
+    return _extractionBudget > 0 && _pendingExtractionBytes >= _extractionBudget;
+}
+
+void AssetsManagerEx::Core::saveVerifyCache()
+{
+    if (_verifyCacheEnabled && !_verifyCache.save(_fileUtils->getSuitableFOpen(_verifyCachePath)))
+    {
+        CCLOG("AssetsManagerEx : Fail to save verify cache %s\n", _verifyCachePath.c_str());
+    }
+}
+
+void AssetsManagerEx::Core::revalidateResumedAssets()
+{
+    if (_verifyCallback == nullptr)
+        return;
+
+    // Files downloaded by a previous session are checked again, one stat each while the cache knows them
+    for (const auto &it : _tempManifest->_assets)
+    {
+        const Manifest::Asset &asset = it.second;
+        if (asset.downloadState != (int)Manifest::DownloadState::SUCCESSED || asset.compressed)
+            continue;
+        if (!verifyAsset(it.first, _tempStoragePath + asset.path, asset))
+        {
+            CCLOG("AssetsManagerEx : %s changed since downloaded, download it again\n", it.first.c_str());
+            _tempManifest->setAssetDownloadState(it.first, Manifest::DownloadState::UNSTARTED);
+        }
+    }
+    saveVerifyCache();
+}
+
+void AssetsManagerEx::Core::salvageCachedFiles(Manifest *cached)
+{
+    _fileUtils->removeDirectory(_salvageStoragePath);
+
+    const auto &bundleAssets = _localManifest->_assets;
+    int salvaged = 0;
+    double salvagedBytes = 0;
+    std::string content, srcPath, dstPath;
+    ResizableBufferAdapter<std::string> adapter(&content);
+    for (const auto &it : cached->_assets)
+    {
+        const Manifest::Asset &asset = it.second;
+        // Archives are removed once decompressed
+        if (asset.compressed || asset.md5.empty())
+            continue;
+        // The app package ships it again
+        auto bundleIt = bundleAssets.find(it.first);
+        if (bundleIt != bundleAssets.end() && bundleIt->second.md5 == asset.md5)
+            continue;
+
+        dstPath.assign(_salvageStoragePath + asset.path);
+        _fileUtils->createDirectory(basename(dstPath) + "/");
+        bool ok = false;
+        if (_packStorage && _packStorage->contains(asset.path))
+        {
+            ok = _packStorage->read(asset.path, &adapter) && _fileUtils->writeStringToFile(content, dstPath);
+        }
+        else
+        {
+            srcPath.assign(_storagePath + asset.path);
+            ok = _fileUtils->isFileExist(srcPath) && _fileUtils->renameFile(srcPath, dstPath);
+        }
+        if (ok)
+        {
+            salvaged++;
+            salvagedBytes += MAX(0, _fileUtils->getFileSize(dstPath));
+        }
+    }
+    if (salvaged > 0)
+    {
+        saveManifest(cached, _salvageStoragePath + MANIFEST_FILENAME);
+        CCLOG("AssetsManagerEx : Salvaged %d cached files, %.1f MB\n", salvaged, salvagedBytes / (1024 * 1024));
+    }
+    else
+    {
+        _fileUtils->removeDirectory(_salvageStoragePath);
+    }
+}
+
+void AssetsManagerEx::Core::restoreSalvagedFiles(std::unordered_map<std::string, Manifest::AssetDiff> *diff)
+{
+    const std::string salvageManifestPath = _salvageStoragePath + MANIFEST_FILENAME;
+    if (!_fileUtils->isFileExist(salvageManifestPath))
+        return;
+
+    Manifest *salvage = new (std::nothrow) Manifest();
+    if (salvage)
+    {
+        parseManifestFile(salvage, salvageManifestPath);
+    }
+    if (salvage && salvage->isLoaded())
+    {
+        const auto &salvagedAssets = salvage->_assets;
+        int restored = 0;
+        double restoredBytes = 0;
+        std::string srcPath, dstPath;
+        for (auto it = diff->begin(); it != diff->end();)
+        {
+            const Manifest::AssetDiff &assetDiff = it->second;
+            auto salvagedIt = salvagedAssets.find(it->first);
+            if (assetDiff.type == Manifest::DiffType::DELETED || assetDiff.asset.compressed
+                || salvagedIt == salvagedAssets.end() || salvagedIt->second.md5 != assetDiff.asset.md5)
+            {
+                ++it;
+                continue;
+            }
+            srcPath.assign(_salvageStoragePath + salvagedIt->second.path);
+            dstPath.assign(_tempStoragePath + assetDiff.asset.path);
+            _fileUtils->createDirectory(basename(dstPath) + "/");
+            if (!_fileUtils->isFileExist(srcPath) || !_fileUtils->renameFile(srcPath, dstPath))
+            {
+                ++it;
+                continue;
+            }
+            // Checked like a downloaded file
+            if (!verifyAsset(it->first, dstPath, assetDiff.asset))
+            {
+                _fileUtils->removeFile(dstPath);
+                ++it;
+                continue;
+            }
+            restored++;
+            restoredBytes += MAX(0, _fileUtils->getFileSize(dstPath));
+            _tempManifest->setAssetDownloadState(it->first, Manifest::DownloadState::SUCCESSED);
+            it = diff->erase(it);
+        }
+        CCLOG("AssetsManagerEx : Restored %d salvaged files, %.1f MB not downloaded again\n", restored, restoredBytes / (1024 * 1024));
+    }
+    CC_SAFE_RELEASE(salvage);
+    // The remote version supersedes the one the files were salvaged from
+    _fileUtils->removeDirectory(_salvageStoragePath);
+}
+
+void AssetsManagerEx::Core::dedupDownloadUnits()
+{
+    // Content on disk by hash: the installed version, and what the temporary storage already holds
+    std::unordered_multimap<std::string, std::string> onDisk;
+    for (const auto &it : _localManifest->_assets)
+    {
+        if (!it.second.compressed && !it.second.md5.empty())
+            onDisk.emplace(it.second.md5, _storagePath + it.second.path);
+    }
+    const auto &assets = _tempManifest->_assets;
+    for (const auto &it : assets)
+    {
+        if (!it.second.compressed && !it.second.md5.empty() && it.second.downloadState == (int)Manifest::DownloadState::SUCCESSED)
+            onDisk.emplace(it.second.md5, _tempStoragePath + it.second.path);
+    }
+
+    // md5 to the key of the unit downloading it
+    std::unordered_map<std::string, std::string> downloading;
+    std::string content;
+    ResizableBufferAdapter<std::string> adapter(&content);
+    int reused = 0, aliased = 0;
+    std::string dstPath;
+    for (auto it = _downloadUnits.begin(); it != _downloadUnits.end();)
+    {
+        auto assetIt = assets.find(it->first);
+        if (assetIt == assets.end() || assetIt->second.compressed || assetIt->second.md5.empty())
+        {
+            ++it;
+            continue;
+        }
+        const Manifest::Asset &asset = assetIt->second;
+        _downloadUnits.getStoragePath(it->first, it->second, &dstPath);
+
+        bool copied = false;
+        auto range = onDisk.equal_range(asset.md5);
+        for (auto diskIt = range.first; diskIt != range.second && !copied; ++diskIt)
+        {
+            const std::string &srcPath = diskIt->second;
+            if (srcPath == dstPath)
+                continue;
+            _fileUtils->createDirectory(basename(dstPath) + "/");
+            std::string relativePath = srcPath.compare(0, _storagePath.size(), _storagePath) == 0 ? srcPath.substr(_storagePath.size()) : "";
+            if (_packStorage && !relativePath.empty() && _packStorage->contains(relativePath))
+                copied = _packStorage->read(relativePath, &adapter) && _fileUtils->writeStringToFile(content, dstPath);
+            else
+                copied = _fileUtils->isFileExist(srcPath) && linkOrCopyFile(srcPath, dstPath);
+        }
+        if (copied)
+        {
+            // Checked like a downloaded file
+            if (verifyAsset(it->first, dstPath, asset))
+            {
+                _tempManifest->setAssetDownloadState(it->first, Manifest::DownloadState::SUCCESSED);
+                _dedupBytesSaved = _dedupBytesSaved + MAX(0, asset.size);
+                reused++;
+                it = _downloadUnits.erase(it);
+                continue;
+            }
+            _fileUtils->removeFile(dstPath);
+        }
+
+        auto downloadingIt = downloading.emplace(asset.md5, it->first);
+        if (!downloadingIt.second)
+        {
+            _contentAliases[downloadingIt.first->second].push_back(it->first);
+            _dedupBytesSaved = _dedupBytesSaved + MAX(0, asset.size);
+            aliased++;
+            it = _downloadUnits.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    if (reused > 0 || aliased > 0)
+    {
+        CCLOG("AssetsManagerEx : %d files copied from disk, %d files downloaded once for several paths, %.1f MB saved\n",
+              reused, aliased, (double)_dedupBytesSaved / (1024 * 1024));
+    }
+}
+
+void AssetsManagerEx::Core::materializeAliases(const std::string &customId, const std::string &storagePath)
+{
+    auto aliasIt = _contentAliases.find(customId);
+    if (aliasIt == _contentAliases.end())
+        return;
+    std::vector<std::string> aliases = std::move(aliasIt->second);
+    _contentAliases.erase(aliasIt);
+
+    const auto &assets = _tempManifest->_assets;
+    for (const auto &key : aliases)
+    {
+        auto assetIt = assets.find(key);
+        if (assetIt == assets.end())
+            continue;
+        const Manifest::Asset &asset = assetIt->second;
+        std::string dstPath = _tempStoragePath + asset.path;
+        _fileUtils->createDirectory(basename(dstPath) + "/");
+        if (linkOrCopyFile(storagePath, dstPath))
+        {
+            _tempManifest->setAssetDownloadState(key, Manifest::DownloadState::SUCCESSED);
+            dispatchUpdateEvent(EventAssetsManagerEx::EventCode::ASSET_UPDATED, key);
+            continue;
+        }
+
+        // Downloaded on its own after all
+        CCLOG("AssetsManagerEx : Fail to copy %s to %s, download it\n", storagePath.c_str(), dstPath.c_str());
+        _dedupBytesSaved = _dedupBytesSaved - MAX(0, asset.size);
+        _downloadUnits.add(key, _tempManifest->getPackageUrl(), _tempStoragePath, asset.path, asset.size);
+        _queue.push_back(key);
+        _totalToDownload++;
+        _totalWaitToDownload++;
+    }
+}
+
+bool AssetsManagerEx::Core::linkOrCopyFile(const std::string &srcPath, const std::string &dstPath)
+{
+    if (_fileUtils->isFileExist(dstPath))
+    {
+        _fileUtils->removeFile(dstPath);
+    }
+#if (CC_TARGET_PLATFORM != CC_PLATFORM_WIN32)
+    // Storage files are only ever replaced by rename, never rewritten in place, so they can share an inode
+    if (link(_fileUtils->getSuitableFOpen(srcPath).c_str(), _fileUtils->getSuitableFOpen(dstPath).c_str()) == 0)
+        return true;
+#endif
+    std::string content;
+    ResizableBufferAdapter<std::string> adapter(&content);
+    return _fileUtils->getContents(srcPath, &adapter) == FileUtils::Status::OK && _fileUtils->writeStringToFile(content, dstPath);
+}
+
+void AssetsManagerEx::Core::unitDownloadStarted(const std::string &key)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (_downloadingUnits.empty())
+    {
+        _transferStartTime = now;
+    }
+    _downloadingUnits[key] = now;
+    _metrics.recordConcurrency((int)_downloadingUnits.size());
+}
+
+void AssetsManagerEx::Core::unitDownloadEnded(const std::string &key, const std::string &storagePath, bool succeeded)
+{
+    auto it = _downloadingUnits.find(key);
+    if (it == _downloadingUnits.end())
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (succeeded)
+    {
+        // Archives are removed once decompressed, the size is taken before
+        long size = _fileUtils->getFileSize(storagePath);
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - it->second).count();
+        _metrics.recordDownload(size > 0 ? size : 0, latency);
+    }
+    _downloadingUnits.erase(it);
+    if (_downloadingUnits.empty())
+    {
+        _metrics.recordTransferTime(std::chrono::duration_cast<std::chrono::microseconds>(now - _transferStartTime).count());
+    }
+}
+
+void AssetsManagerEx::Core::batchDownload() //ļ
+{	//_downloadUnits ΪҪassetб
+    _queue.clear();
+    _throttledUnits.clear();
+    for(const auto &iter : _downloadUnits) 
+    {
+        const AssetsDownloadTable::Unit &unit = iter.second;
+        if (unit.size > 0)
+        {
+            _totalSize += unit.size;
+            _sizeCollected++;
+        }
+        
+        _queue.push_back(iter.first);
+    }
+    // All collected, enable total size
+    if (_sizeCollected == _totalToDownload)
+    {
+        _totalEnabled = true;
+    }
+    
+    // Critical units are queued last, the queue is consumed from the back
+    _criticalUnits.clear();
+    bool criticalGating = !_repairing && !_stagedUpdate && (!_remoteHints.critical.empty() || !_remoteHints.deferred.empty());
+    if (!_repairing && _stagedUpdate)
+    {
+        // The whole staged version is deferred
+        _budgetBytes = 0;
+        _budgetTime = _scheduler->now();
+    }
+    if (criticalGating)
+    {
+        const auto &assets = _remoteManifest->_assets;
+        auto isCriticalUnit = [this, &assets](const std::string &key) {
+            auto it = assets.find(key);
+            if (it != assets.end() && isCriticalAsset(it->second.path))
+                return true;
+            // A unit downloading the content of a critical alias, see dedupDownloadUnits, is critical too
+            auto aliasIt = _contentAliases.find(key);
+            if (aliasIt != _contentAliases.end())
+            {
+                for (const auto &alias : aliasIt->second)
+                {
+                    auto assetIt = assets.find(alias);
+                    if (assetIt != assets.end() && isCriticalAsset(assetIt->second.path))
+                        return true;
+                }
+            }
+            return false;
+        };
+        std::stable_partition(_queue.begin(), _queue.end(), [&isCriticalUnit](const std::string &key) {
+            return !isCriticalUnit(key);
+        });
+        for (auto it = _queue.rbegin(); it != _queue.rend(); ++it)
+        {
+            if (!isCriticalUnit(*it))
+                break;
+            _criticalUnits.insert(*it);
+        }
+        // Nothing critical left to download, e.g. when resuming
+        if (_criticalUnits.empty() && !_criticalReady)
+        {
+            criticalSetReady();
+        }
+    }
+    
+    queueDowload(); //ضļ
+}
+
+void AssetsManagerEx::Core::queueDowload()
+{
+    // Late results of units finishing after cancel() must not restart or finish the update
+    if (_updateState != State::UPDATING)
+        return;
+
+    if (_totalWaitToDownload == 0)
+    {
+        this->onDownloadUnitsFinished();
+        return;
+    }
+    
+    int maxConcurrentTask = _maxConcurrentTask;
+    bool deferred = _criticalReady || (_stagedUpdate && !_repairing);
+    bool budgeted = deferred && _deferredBytesPerSecond > 0;
+    if (deferred && _deferredMaxConcurrentTask > 0)
+    {
+        maxConcurrentTask = MIN(maxConcurrentTask, _deferredMaxConcurrentTask);
+    }
+    const auto &assets = _remoteManifest->getAssets();
+    while (!_paused && _currConcurrentTask < maxConcurrentTask)
+    {
+        // Archives held back by the extraction budget go first once extractions caught up
+        bool extractionFull = extractionBudgetExceeded();
+        std::vector<std::string> &source = !extractionFull && !_throttledUnits.empty() ? _throttledUnits : _queue;
+        if (source.empty())
+            break;
+        if (extractionFull)
+        {
+            auto assetIt = assets.find(source.back());
+            if (assetIt != assets.end() && assetIt->second.compressed)
+            {
+                _throttledUnits.push_back(std::move(source.back()));
+                source.pop_back();
+                continue;
+            }
+        }
+        if (budgeted)
+        {
+            auto unitIt = _downloadUnits.find(source.back());
+            float delay = takeDownloadBudget(unitIt != _downloadUnits.end() ? unitIt->second.size : 0);
+            if (delay > 0)
+            {
+                scheduleQueueDownload(delay);
+                break;
+            }
+        }
+        std::string key = std::move(source.back()); //ȡļ
+        source.pop_back();
+        
+        auto unitIt = _downloadUnits.find(key);
+        if (unitIt == _downloadUnits.end())
+            continue;
+        
+        _currConcurrentTask++; //ǰ
+        _downloadUnits.getSrcUrl(key, unitIt->second, &_unitUrl);
+        _downloadUnits.getStoragePath(key, unitIt->second, &_unitStoragePath);
+        _fileUtils->createDirectory(basename(_unitStoragePath)); //صʼ·
+        startDownloadTask(_unitUrl, _unitStoragePath, key); //
+        unitDownloadStarted(key);
+        
+        _tempManifest->setAssetDownloadState(key, Manifest::DownloadState::DOWNLOADING);
+    }
+    if (_percentByFile / 100 > _nextSavePoint)
+    {
+        // Save current download manifest information for resuming
+        saveManifest(_tempManifest, _tempManifestPath);
+        saveVerifyCache();
+        _nextSavePoint += SAVE_POINT_INTERVAL;
+    }
+}
+
+bool AssetsManagerEx::Core::isCriticalAsset(const std::string &path) const
+{
+    for (const auto &prefix : _remoteHints.critical)
+    {
+        if (path.compare(0, prefix.size(), prefix) == 0)
+            return true;
+    }
+    if (_remoteHints.deferred.empty())
+        return false;
+    for (const auto &prefix : _remoteHints.deferred)
+    {
+        if (path.compare(0, prefix.size(), prefix) == 0)
+            return false;
+    }
+    return true;
+}
+
+void AssetsManagerEx::Core::criticalSetReady()
+{
+    _criticalReady = true;
+    // Saved first, a restart resumes without downloading the critical units again
+    saveManifest(_tempManifest, _tempManifestPath);
+    saveVerifyCache();
+    if (!_tempSearchPathsApplied)
+    {
+        prependSearchPaths(_tempStoragePath, _remoteManifest->_searchPaths);
+        _tempSearchPathsApplied = true;
+    }
+    _budgetBytes = 0;
+    _budgetTime = _scheduler->now();
+
+    float elapsed = std::chrono::duration<float>(_budgetTime - _updateStartTime).count();
+    _timeToPlayable = elapsed;
+    std::string msg = StringUtils::format("Critical assets ready in %.2fs, %d files remain to be finished.", elapsed, _totalWaitToDownload);
+    CCLOG("AssetsManagerEx : %s\n", msg.c_str());
+    dispatchUpdateEvent(EventAssetsManagerEx::EventCode::CRITICAL_SET_READY, "", msg);
+}
+
+float AssetsManagerEx::Core::takeDownloadBudget(float size)
+{
+    auto now = _scheduler->now();
+    double elapsed = std::chrono::duration<double>(now - _budgetTime).count();
+    _budgetTime = now;
+    // At most one second of budget is saved up while nothing starts
+    _budgetBytes = MIN(_budgetBytes + elapsed * _deferredBytesPerSecond, (double)_deferredBytesPerSecond);
+    if (_budgetBytes < 0)
+        return (float)(-_budgetBytes / _deferredBytesPerSecond);
+    _budgetBytes -= size;
+    return 0;
+}
+
+void AssetsManagerEx::Core::scheduleQueueDownload(float delay)
+{
+    if (_worker && _worker->isWorkerThread())
+    {
+        AssetsWorkerMessage *message = beginWorkerMessage(AssetsWorkerMessage::Type::SCHEDULE_QUEUE);
+        if (message)
+        {
+            message->percent = delay;
+            _worker->commitMessage();
+        }
+        return;
+    }
+    _queueScheduled = true;
+    _scheduler->schedule([this](float /*dt*/) {
+        _queueScheduled = false;
+        _scheduler->unschedule(QUEUE_SCHEDULE_KEY, this);
+        if (!postToWorker([this]() { queueDowload(); }))
+        {
+            queueDowload();
+        }
+    }, this, delay, QUEUE_SCHEDULE_KEY);
+}
+
+void AssetsManagerEx::Core::onDownloadUnitsFinished()
+{
+    // Finished with error check
+    if (_failedUnits.size() > 0)
+    {
+        // Save current download manifest information for resuming
+        saveManifest(_tempManifest, _tempManifestPath);
+        saveVerifyCache();
+    
+        _updateState = State::FAIL_TO_UPDATE;
+        dispatchUpdateEvent(EventAssetsManagerEx::EventCode::UPDATE_FAILED);
+    }
+    else if (_updateState == State::UPDATING)
+    {
+        updateSucceed();
+    }
+}
+
+NS_CC_EXT_END
@@ -0,0 +1,735 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsManagerExCore__
+#define __AssetsManagerExCore__
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "platform/CCFileUtils.h"
+#include "network/CCDownloader.h"
+
+#include "AssetsDownloadTable.h"
+#include "AssetsManagerEx.h"
+#include "AssetsManagerExWorker.h"
+#include "AssetsPackStorage.h"
+#include "AssetsVerifyCache.h"
+#include "ManifestStream.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   Update state machine behind AssetsManagerEx. It only reaches the engine through the environment
+ *          its owner resolved, events and texture warm-up are handed back to the owner.
+ */
+class AssetsManagerEx::Core
+{
+public:
+    
+    /** @param env   Environment with every member set, see AssetsManagerEx::create
+     */
+    Core(AssetsManagerEx *owner, const std::string& manifestUrl, const std::string& storagePath, const AssetsManagerExEnv& env);
+    
+    ~Core();
+    
+    /** @brief Load the manifests. Events may be dispatched, so the owner calls it once it holds this core.
+     */
+    void start();
+    
+    // Same as the AssetsManagerEx methods of the same name
+    
+    void checkUpdate();
+    
+    void update();
+    
+    void downloadFailedAssets();
+    
+    void pause();
+    
+    void resume();
+    
+    void cancel();
+    
+    void verifyInstalled(int maxThreads);
+    
+    void collectGarbage();
+    
+    bool isPaused() const {return _paused;};
+    
+    State getState() const;
+    
+    const std::string& getStoragePath() const;
+    
+    const Manifest* getLocalManifest() const;
+    
+    const Manifest* getRemoteManifest() const;
+    
+    int getMaxConcurrentTask() const {return _maxConcurrentTask;};
+    
+    void setMaxConcurrentTask(int max) {_maxConcurrentTask = max;};
+    
+    void setVersionCompareHandle(const std::function<int(const std::string& versionA, const std::string& versionB)>& handle) {_versionCompareHandle = handle;};
+    
+    void setVerifyCallback(const std::function<bool(const std::string& path, const Manifest::Asset& asset)>& callback) {_verifyCallback = callback;};
+    
+    void setStreamingManifestParse(bool enabled) {_streamingParse = enabled;};
+    
+    void setVerifyCacheEnabled(bool enabled) {_verifyCacheEnabled = enabled;};
+    
+    void setWarmUpEnabled(bool enabled) {_warmUpEnabled = enabled;};
+    
+    void setDeferredDownloadBudget(int maxConcurrentTask, int bytesPerSecond) {_deferredMaxConcurrentTask = maxConcurrentTask; _deferredBytesPerSecond = bytesPerSecond;};
+    
+    float getTimeToPlayable() const {return _timeToPlayable;};
+    
+    float getTimeToComplete() const {return _timeToComplete;};
+    
+    double getDedupBytesSaved() const {return _dedupBytesSaved;};
+    
+    float getDedupTimeSaved() const {return _dedupTimeSaved;};
+    
+    AssetsUpdateMetrics& getMetrics() {return _metrics;};
+    
+    void setExtractionBudget(double bytes) {_extractionBudget = bytes;};
+    
+    double getExtractionBudget() const {return _extractionBudget;};
+    
+    int getPendingExtractions() const {return _pendingExtractions;};
+    
+    void setStagedUpdate(bool enabled) {_stagedUpdate = enabled;};
+    
+    bool isUpdateStaged() const {return _updateStaged;};
+    
+    void setVariant(const std::string &dimension, const std::string &value);
+    
+    const std::unordered_map<std::string, std::string>& getVariants() const {return _variants;};
+    
+private:
+    
+    std::string basename(const std::string& path) const;
+    
+    std::string get(const std::string& key) const;
+    
+    void initManifests(const std::string& manifestUrl);
+    
+    void loadLocalManifest(const std::string& manifestUrl);
+    
+    void prepareLocalManifest();
+    
+    /** @brief Prepend the search paths of a manifest, like Manifest::prependSearchPaths but through _fileUtils
+     */
+    void prependSearchPaths(const Manifest *manifest);
+    
+    void prependSearchPaths(const std::string &manifestRoot, const std::vector<std::string> &manifestSearchPaths);
+    
+    void applySearchPaths(const std::string &manifestRoot, const std::vector<std::string> &manifestSearchPaths);
+    
+    /** @brief Remove the search paths under root, through the main thread in worker thread mode
+     */
+    void removeSearchPaths(const std::string &root);
+    
+    void applySearchPathsRemoval(const std::string &root);
+    
+    void initDownloader();
+    
+    /** @brief Abort all running download tasks and put their units back in the download queue
+     */
+    void abortDownloads();
+    
+    /** @brief Parse a manifest file into the given manifest, replacing its content.
+     *         The streaming parser fills the asset table directly from the file, without a DOM.
+     */
+    void parseManifestFile(Manifest *manifest, const std::string &manifestUrl, ManifestHints *hints = nullptr);
+    
+    /** @brief Save a manifest with the download state of its assets, for resuming
+     */
+    void saveManifest(Manifest *manifest, const std::string &path);
+    
+    void setStoragePath(const std::string& storagePath);
+    
+    void adjustPath(std::string &path);
+    
+    void dispatchUpdateEvent(EventAssetsManagerEx::EventCode code, const std::string &message = "", const std::string &assetId = "", int curle_code = 0, int curlm_code = 0);
+    
+    /** @brief Start a download task, from the main thread in worker thread mode
+     */
+    void startDownloadTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier);
+    
+    void downloadVersion();
+    void parseVersion();
+    void downloadManifest();
+    void parseManifest();
+    
+    /** @brief Take the unchanged shards of a sharded remote manifest from the local one and download the others,
+     *         see ManifestHints::shards
+     */
+    void loadRemoteShards();
+    
+    /** @brief Add the assets of a downloaded shard to the remote manifest
+     */
+    void onShardLoaded(const std::string &storagePath);
+    
+    /** @brief Every shard is in, save the whole remote manifest for resuming and go on with it
+     */
+    void remoteShardsLoaded();
+    
+    /** @brief A shard failed, drop the partly loaded remote manifest so that a retry downloads it again.
+     *         Diffing it would take the assets of the missing shards for deleted ones.
+     */
+    void dropRemoteShards();
+    
+    /** @brief The remote version is newer, notify it and start the update if requested
+     */
+    void newVersionFound();
+    
+    /** @brief Same as Manifest::genDiff, limited to the assets of the shards which changed
+     */
+    std::unordered_map<std::string, Manifest::AssetDiff> genShardedDiff() const;
+    
+    /** @brief Whether the installed version was filtered with another variant selection than the current one
+     */
+    bool variantsChanged() const;
+    
+    /** @brief Remove from the remote manifest the assets of the variants not selected, see setVariant
+     */
+    void filterVariants();
+    
+    void startUpdate();
+    void updateSucceed();
+    
+    /** @brief Remove from the storage the files of the outgoing local manifest the incoming one doesn't use anymore
+     */
+    void removeDeletedAssets(const Manifest *outgoing, const Manifest *incoming);
+    
+    /** @brief Append the files of the temporary storage to a new pack, and drop the assets the remote manifest deleted
+     @param packed  Receives the paths relative to the storage of the packed files
+     @param staged  Whether the new index is only staged, see AssetsPackStorage::stage
+     @return    false if the pack storage couldn't be written, it's unchanged then
+     */
+    bool commitPacks(std::unordered_set<std::string> *packed, bool staged);
+    
+    /** @brief Move the files of the temporary storage to the storage, then remove it
+     @param merged  Receives the paths relative to the storage of the moved files, those it contains are skipped
+     @param kept    Paths relative to the temporary storage left in place, the temporary storage isn't removed then
+     */
+    void mergeTempStorage(std::unordered_set<std::string> *merged, const std::unordered_set<std::string> &kept = std::unordered_set<std::string>());
+    
+    /** @brief Keep the downloaded version in the temporary storage for applyStagedUpdate, see setStagedUpdate
+     */
+    void stageUpdate();
+    
+    /** @brief Install the version staged by a previous run, before the local manifest is loaded
+     */
+    void applyStagedUpdate();
+    
+    /** @brief Forget the staged version, the caller removes the temporary storage
+     */
+    void discardStagedUpdate();
+    
+    /** @brief Drop the version of the temporary storage, staged or partly downloaded,
+     *         and start it again with the remote manifest once it's loaded
+     */
+    void discardTempUpdate();
+    
+    /** @brief The version found by a check is the staged one
+     */
+    void remoteVersionStaged();
+    
+    /** @brief Publish the files of the storage to AssetsResolutionIndex, when it's enabled
+     @param installed   Manifest of the storage content, its compressed assets are always probed on disk
+     @param present     Paths relative to the storage of the files written there
+     */
+    void publishResolutionIndex(const Manifest *installed, std::unordered_set<std::string> &&present);
+    bool decompress(const std::string &filename);
+    void decompressDownloadedZip(const std::string &customId, const std::string &storagePath);
+    
+    /** @brief Update a list of assets under the current AssetsManagerEx context
+     */
+    void updateAssets(const DownloadUnits& assets);
+    
+    /** @brief Update the units fill leaves in _downloadUnits, like updateAssets
+     */
+    void updateUnits(const std::function<void(AssetsDownloadTable *units)> &fill);
+    
+    /** @brief Retrieve all failed assets during the last update, built from the unit table on each call
+     */
+    const DownloadUnits& getFailedAssets() const;
+    
+    /** @brief Units of the assets of the temporary manifest not downloaded yet, like Manifest::genResumeAssetsList
+     */
+    void genResumeUnits();
+    
+    /** @brief Function for destroying the downloaded version file and manifest file
+     */
+    void destroyDownloadedVersion();
+    
+    /** @brief Check a file with the verify callback, unless the verification cache already trusts it
+     @param key     Asset key in the manifest
+     @param path    Path of the file
+     @param asset   Asset description in the manifest
+     */
+    bool verifyAsset(const std::string &key, const std::string &path, const Manifest::Asset &asset);
+    
+    void saveVerifyCache();
+    
+    /** @brief Whether the asset is needed to play according to the remote manifest hints
+     */
+    bool isCriticalAsset(const std::string &path) const;
+    
+    /** @brief All critical units are downloaded: make them usable and go on with the deferred ones
+     */
+    void criticalSetReady();
+    
+    /** @brief Take a deferred unit of the given size from the bandwidth budget
+     @return    0 if it can start now, otherwise the delay in seconds until the budget allows it
+     */
+    float takeDownloadBudget(float size);
+    
+    /** @brief Run queueDowload again after delay seconds, from the scheduler of the driving thread
+     */
+    void scheduleQueueDownload(float delay);
+    
+    /** @brief Load installed files in the background so the game doesn't pay for it on first use
+     @param paths   Full paths, in the order they should be loaded
+     */
+    void warmUp(const std::vector<std::string> &paths);
+    
+    /** @brief Check again the files a previous session downloaded before resuming it,
+     *         the changed ones are downloaded again
+     */
+    void revalidateResumedAssets();
+    
+    /** @brief Before a newer app package empties the storage, move the cached files it doesn't ship
+     *         to the salvage storage, with the cached manifest to know their hashes
+     */
+    void salvageCachedFiles(Manifest *cached);
+    
+    /** @brief Move the salvaged files matching the remote manifest to the temporary storage instead of
+     *         downloading them again, then remove the salvage storage
+     @param diff    Difference with the remote manifest, the salvaged assets are removed from it
+     */
+    void restoreSalvagedFiles(std::unordered_map<std::string, Manifest::AssetDiff> *diff);
+    
+    /** @brief Download each content once. Units whose content is already on disk under another path
+     *         are copied from there, units sharing their content with another unit wait for its download.
+     */
+    void dedupDownloadUnits();
+    
+    /** @brief Give the downloaded file of a unit to the assets waiting for the same content
+     */
+    void materializeAliases(const std::string &customId, const std::string &storagePath);
+    
+    /** @brief Track a unit given to the downloader, for the metrics
+     */
+    void unitDownloadStarted(const std::string &key);
+    
+    /** @brief Stop tracking a unit whose task ended, recording its latency and size if it succeeded
+     */
+    void unitDownloadEnded(const std::string &key, const std::string &storagePath, bool succeeded);
+    
+    /** @brief Hard link dstPath to srcPath where the platform allows it, copy otherwise
+     */
+    bool linkOrCopyFile(const std::string &srcPath, const std::string &dstPath);
+    
+    /** @brief Run work on a background thread, then done on the thread driving this manager.
+     *         done is skipped if the manager was released in the meantime.
+     */
+    void runInBackground(const std::function<void()> &work, std::function<void()> done);
+    
+    /** @brief Run an archive extraction on the extraction pool, on runInBackground without one
+     */
+    void runExtraction(const std::function<void()> &work, const std::function<void()> &done);
+    
+    /** @brief Whether compressed units are held back, see setExtractionBudget
+     */
+    bool extractionBudgetExceeded() const;
+    
+    /** @brief Download items in queue with max concurrency setting
+     */
+    void queueDowload();
+    
+    void fileError(const std::string& identifier, const std::string& errorStr, int errorCode = 0, int errorCodeInternal = 0);
+    
+    void fileSuccess(const std::string &customId, const std::string &storagePath);
+    
+    /** @brief  Call back function for error handling,
+     the error will then be reported to user's listener registed in addUpdateEventListener
+     @param error   The error object contains ErrorCode, message, asset url, asset key
+     @warning AssetsManagerEx internal use only
+     */
+    void onError(const network::DownloadTask& task,
+                         int errorCode,
+                         int errorCodeInternal,
+                         const std::string& errorStr);
+    
+    /** @brief  Call back function for recording downloading percent of the current asset,
+     the progression will then be reported to user's listener registed in addUpdateProgressEventListener
+     @param total       Total size to download for this asset
+     @param downloaded  Total size already downloaded for this asset
+     @param url         The url of this asset
+     @param customId    The key of this asset
+     @warning AssetsManagerEx internal use only
+     */
+    void onProgress(double total, double downloaded, const std::string &url, const std::string &customId);
+    
+    /** @brief  Call back function for success of the current asset
+     the success event will then be send to user's listener registed in addUpdateEventListener
+     @param srcUrl      The url of this asset
+     @param customId    The key of this asset
+     @warning AssetsManagerEx internal use only
+     */
+    void onSuccess(const std::string &srcUrl, const std::string &storagePath, const std::string &customId);
+    
+    void batchDownload();
+
+    // Called when one DownloadUnits finished
+    void onDownloadUnitsFinished();
+    
+    //! State of a verifyInstalled run
+    struct VerifySession;
+    
+    void verifyNextBatch(const std::shared_ptr<VerifySession> &session);
+    
+    void finishVerify(const std::shared_ptr<VerifySession> &session);
+    
+    /** @brief Set up an update from the local manifest to itself for the broken assets
+     @param units   Output, download units of the broken assets
+     */
+    bool prepareRepair(const std::vector<std::string> &brokenKeys, AssetsDownloadTable *units);
+    
+    /** @brief In worker thread mode, post task to the worker unless already running on it
+     @return    Whether the task was posted, the caller returns then
+     */
+    bool postToWorker(const std::function<void()> &task);
+    
+    AssetsWorkerMessage* beginWorkerMessage(AssetsWorkerMessage::Type type);
+    
+    void postWorkerEvent(EventAssetsManagerEx::EventCode code, const std::string &assetId, const std::string &message, int curle_code, int curlm_code);
+    
+    /** @brief Queue the pending progression for the main thread
+     @param force   Queue it even if the previous one wasn't received yet, to keep it ordered before another event
+     */
+    void flushWorkerProgress(bool force);
+    
+    /** @brief Run the messages posted by the worker, scheduled every frame on the main thread
+     */
+    void drainWorkerMessages();
+    
+    /** @brief Run the downloader progressions coalesced by the main thread, on the worker
+     */
+    void drainDownloadProgress();
+    
+    //! Manager this core updates, events and textures go through it
+    AssetsManagerEx *_owner;
+    
+    //! Reference to the file utils, the global one by default
+    FileUtils *_fileUtils;
+    //! Runner for background work such as decompression
+    std::shared_ptr<IAssetsTaskRunner> _taskRunner;
+    //! Timers and hand-off to the driving thread, the Director's scheduler by default
+    std::shared_ptr<IAssetsScheduler> _scheduler;
+    //! Whether warmUp decodes textures, only with the Director's scheduler
+    bool _textureWarmUp;
+    //! Threads extracting the downloaded archives, see AssetsManagerExEnv::extractionThreads
+    std::unique_ptr<ThreadPoolRunner> _extractionPool;
+    
+    //! State of update
+    State _updateState;
+    
+    //! Downloader
+    std::shared_ptr<IAssetsDownloader> _downloader;
+    
+    //! The reference to the local assets
+    const std::unordered_map<std::string, Manifest::Asset> *_assets;
+    
+    //! The path to store successfully downloaded version.
+    std::string _storagePath;
+    
+    //! The path to store downloading version.
+    std::string _tempStoragePath;
+    
+    //! The path to keep the files of a cached version a newer app package replaced, until the next update
+    std::string _salvageStoragePath;
+    
+    //! The local path of cached temporary version file
+    std::string _tempVersionPath;
+    
+    //! The local path of cached manifest file
+    std::string _cacheManifestPath;
+    
+    //! The local path of cached temporary manifest file
+    std::string _tempManifestPath;
+    
+    //! The path of local manifest file
+    std::string _manifestUrl;
+    
+    //! Full path of the manifest in app package, resolved without the storage search paths
+    std::string _bundleManifestPath;
+    
+    //! Local manifest
+    Manifest *_localManifest;
+    
+    //! Local temporary manifest for download resuming
+    Manifest *_tempManifest;
+    
+    //! Remote manifest
+    Manifest *_remoteManifest;
+    
+    //! Whether user have requested to update
+    enum class UpdateEntry : char
+    {
+        NONE,
+        CHECK_UPDATE,
+        DO_UPDATE,
+        //! verifyInstalled or collectGarbage is running
+        MAINTENANCE
+    };
+
+    UpdateEntry _updateEntry;
+    
+    //! All assets unit to download
+    AssetsDownloadTable _downloadUnits;
+    
+    //! Keys of all failed units, they stay in _downloadUnits
+    std::unordered_set<std::string> _failedUnits;
+    
+    //! Failed units returned by getFailedAssets
+    mutable DownloadUnits _failedAssets;
+    
+    //! Url and storage path of the unit being started, reused for every task
+    std::string _unitUrl;
+    std::string _unitStoragePath;
+    
+    //! Download queue
+    std::vector<std::string> _queue;
+    
+    //! Compressed units taken from the queue while the extraction budget was exceeded, issued first afterwards
+    std::vector<std::string> _throttledUnits;
+    
+    //! Units which have a running task in the downloader, with the time it was given to the downloader
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> _downloadingUnits;
+    
+    //! Time the first of the running tasks started
+    std::chrono::steady_clock::time_point _transferStartTime;
+    
+    //! Assets with the same content as a unit to download, by the key of that unit
+    std::unordered_map<std::string, std::vector<std::string>> _contentAliases;
+    
+    //! Max concurrent task count for downloading
+    std::atomic<int> _maxConcurrentTask;
+    
+    //! Current concurrent task count
+    int _currConcurrentTask;
+    
+    //! Download percent
+    float _percent;
+    
+    //! Download percent by file
+    float _percentByFile;
+    
+    //! Indicate whether the total size should be enabled
+    int _totalEnabled;
+    
+    //! Indicate the number of file whose total size have been collected
+    int _sizeCollected;
+    
+    //! Total file size need to be downloaded (sum of all file)
+    double _totalSize;
+    
+    //! Downloaded size for each file
+    std::unordered_map<std::string, double> _downloadedSize;
+    
+    //! Total number of assets to download
+    int _totalToDownload;
+    //! Total number of assets still waiting to be downloaded
+    int _totalWaitToDownload;
+    //! Next target percent for saving the manifest file
+    float _nextSavePoint;
+    
+    //! Handle function to compare versions between different manifests
+    std::function<int(const std::string& versionA, const std::string& versionB)> _versionCompareHandle;
+    
+    //! Callback function to verify the downloaded assets
+    std::function<bool(const std::string& path, const Manifest::Asset& asset)> _verifyCallback;
+    
+    //! Whether manifests are parsed with ManifestStreamParser instead of a DOM
+    bool _streamingParse;
+    
+    //! Assets accepted by the verify callback with the stat of their file
+    AssetsVerifyCache _verifyCache;
+    
+    //! Whether _verifyCache is used
+    bool _verifyCacheEnabled;
+    
+    //! The local path of the verification cache file
+    std::string _verifyCachePath;
+    
+    //! Running verifyInstalled, nullptr otherwise
+    std::shared_ptr<VerifySession> _verifySession;
+    
+    //! Threads calling the verify callback for verifyInstalled, created by its first run
+    std::unique_ptr<ThreadPoolRunner> _verifyPool;
+    int _verifyPoolThreads;
+    
+    //! Whether the running update repairs the storage, see verifyInstalled()
+    bool _repairing;
+    
+    //! State to restore once the repair is finished
+    State _stateBeforeRepair;
+    
+    //! Whether collectGarbage is running
+    bool _sweeping;
+    
+    //! Packs of the installed files, nullptr unless AssetsManagerExEnv::packStorage is set
+    std::shared_ptr<AssetsPackStorage> _packStorage;
+    
+    //! Whether updated assets are warmed up, see setWarmUpEnabled
+    bool _warmUpEnabled;
+    
+    //! Whether updates are staged for the next launch, see setStagedUpdate
+    bool _stagedUpdate;
+    
+    //! Whether the temporary storage holds a staged version, _tempManifest is its manifest then
+    bool _updateStaged;
+    
+    //! Scheduling hints of the remote manifest
+    ManifestHints _remoteHints;
+    
+    //! Shard table and variant selection of the local manifest, its other hints aren't kept
+    ManifestHints _localHints;
+    
+    //! Selected variants, by dimension
+    std::unordered_map<std::string, std::string> _variants;
+    
+    //! Variant selection of the unfinished update in the temporary storage
+    std::unordered_map<std::string, std::string> _tempVariants;
+    
+    //! Whether the remote manifest was diffed shard by shard, then the keys genShardedDiff compares:
+    //! assets of the changed remote shards, and local assets out of the unchanged ones
+    bool _shardedDiff;
+    std::vector<std::string> _shardRemoteKeys;
+    std::vector<std::string> _shardLocalKeys;
+    
+    //! Changed shards still downloading
+    int _pendingShards;
+    
+    //! Critical units not downloaded yet, see setDeferredDownloadBudget
+    std::unordered_set<std::string> _criticalUnits;
+    
+    //! Whether CRITICAL_SET_READY was dispatched for the running update
+    bool _criticalReady;
+    
+    //! Whether the temporary storage was prepended to the search paths by criticalSetReady
+    bool _tempSearchPathsApplied;
+    
+    //! Whether scheduleQueueDownload has a timer pending, main thread only
+    bool _queueScheduled;
+    
+    //! Budget of deferred units, 0 for no limit
+    int _deferredMaxConcurrentTask;
+    int _deferredBytesPerSecond;
+    
+    //! Bytes left in the bandwidth budget at _budgetTime, negative when overdrawn
+    double _budgetBytes;
+    std::chrono::steady_clock::time_point _budgetTime;
+    
+    //! Time of the last update() call, and the metrics of that update in seconds
+    std::chrono::steady_clock::time_point _updateStartTime;
+    std::atomic<float> _timeToPlayable;
+    std::atomic<float> _timeToComplete;
+    
+    //! Deduplication metrics of the last update
+    std::atomic<double> _dedupBytesSaved;
+    std::atomic<float> _dedupTimeSaved;
+    
+    //! Runtime metrics of all updates, see getMetrics
+    AssetsUpdateMetrics _metrics;
+    
+    //! See setExtractionBudget
+    double _extractionBudget;
+    
+    //! Archives handed to extraction and not finished yet, with their size
+    std::atomic<int> _pendingExtractions;
+    double _pendingExtractionBytes;
+    
+    //! Whether the update is paused, see pause()
+    std::atomic<bool> _paused;
+    
+    //! Bumped by cancel() so that units decompressed for a cancelled update are ignored
+    unsigned int _updateGeneration;
+    
+    //! Thread running the state machine in worker thread mode, see AssetsManagerExEnv::workerThread
+    std::unique_ptr<AssetsUpdateWorker> _worker;
+    
+    //! Number of downloader cancellations run on the main thread, callbacks report it to the worker
+    unsigned int _downloadEpoch;
+    
+    //! Number of downloader cancellations requested by the worker, older callbacks are dropped
+    unsigned int _issuedEpoch;
+    
+    //! Last progression of a download task, kept by the main thread until the worker runs it
+    struct DownloadProgress
+    {
+        std::string requestURL;
+        int64_t totalBytesReceived;
+        int64_t totalBytesExpected;
+        unsigned int epoch;
+    };
+    
+    //! Downloader progressions not run by the worker yet, one per task, guarded by _downloadProgressMutex
+    std::unordered_map<std::string, DownloadProgress> _downloadProgress;
+    std::mutex _downloadProgressMutex;
+    
+    //! Whether a drainDownloadProgress task is posted to the worker and not started yet
+    bool _downloadProgressPosted;
+    
+    //! Whether a progression message is in the worker ring and not received yet
+    std::atomic<bool> _workerProgressQueued;
+    
+    //! Whether a progression is waiting for the previous one to be received
+    bool _workerProgressDirty;
+    
+    //! Asset id of the waiting progression
+    std::string _workerProgressAssetId;
+    
+    //! State as of the last message received from the worker
+    State _publishedState;
+    
+    //! Marker for whether the assets manager is inited
+    bool _inited;
+    
+    //! Cleared on destruction, done of runInBackground delivered afterwards is skipped then
+    std::shared_ptr<std::atomic<bool>> _alive;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsManagerExCore__) */
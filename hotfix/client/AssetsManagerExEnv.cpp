@@ -0,0 +1,308 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsManagerExEnv.h"
+#include "base/CCAsyncTaskPool.h"
+#include "base/CCDirector.h"
+#include "base/CCScheduler.h"
+
+NS_CC_EXT_BEGIN
+
+// Implementation of NetworkAssetsDownloader
+
+NetworkAssetsDownloader::NetworkAssetsDownloader(int maxConcurrentTask, int timeoutInSeconds)
+{
+    _hints.countOfMaxProcessingTasks = static_cast<uint32_t>(maxConcurrentTask);
+    _hints.timeoutInSeconds = static_cast<uint32_t>(timeoutInSeconds);
+    _hints.tempFileNameSuffix = ".tmp";
+    initDownloader();
+}
+
+NetworkAssetsDownloader::~NetworkAssetsDownloader()
+{
+    _downloader->onTaskError = (nullptr);
+    _downloader->onFileTaskSuccess = (nullptr);
+    _downloader->onTaskProgress = (nullptr);
+}
+
+void NetworkAssetsDownloader::initDownloader()
+{
+    _downloader = std::shared_ptr<network::Downloader>(new network::Downloader(_hints));
+    // Forward through this object, so callbacks set after creation are used
+    _downloader->onTaskError = [this](const network::DownloadTask& task,
+                                      int errorCode,
+                                      int errorCodeInternal,
+                                      const std::string& errorStr)
+    {
+        if (onTaskError)
+            onTaskError(task, errorCode, errorCodeInternal, errorStr);
+    };
+    _downloader->onTaskProgress = [this](const network::DownloadTask& task,
+                                         int64_t bytesReceived,
+                                         int64_t totalBytesReceived,
+                                         int64_t totalBytesExpected)
+    {
+        if (onTaskProgress)
+            onTaskProgress(task, bytesReceived, totalBytesReceived, totalBytesExpected);
+    };
+    _downloader->onFileTaskSuccess = [this](const network::DownloadTask& task)
+    {
+        if (onFileTaskSuccess)
+            onFileTaskSuccess(task);
+    };
+}
+
+void NetworkAssetsDownloader::createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier)
+{
+    _downloader->createDownloadFileTask(srcUrl, storagePath, identifier);
+}
+
+void NetworkAssetsDownloader::cancelAll()
+{
+    _downloader->onTaskError = (nullptr);
+    _downloader->onFileTaskSuccess = (nullptr);
+    _downloader->onTaskProgress = (nullptr);
+    _downloader.reset();
+    initDownloader();
+}
+
+// Implementation of AsyncTaskPoolRunner
+
+void AsyncTaskPoolRunner::runAsync(const std::function<void()> &work, const std::function<void()> &done)
+{
+    std::function<void(void*)> callback = [done](void* /*param*/) {
+        done();
+    };
+    AsyncTaskPool::getInstance()->enqueue(AsyncTaskPool::TaskType::TASK_OTHER, std::move(callback), nullptr, work);
+}
+
+// Implementation of DirectorAssetsScheduler
+
+void DirectorAssetsScheduler::schedule(const std::function<void(float)> &callback, void *target, float interval, const std::string &key)
+{
+    Director::getInstance()->getScheduler()->schedule(callback, target, interval, false, key);
+}
+
+void DirectorAssetsScheduler::unschedule(const std::string &key, void *target)
+{
+    Director::getInstance()->getScheduler()->unschedule(key, target);
+}
+
+void DirectorAssetsScheduler::performInDriverThread(const std::function<void()> &function)
+{
+    Director::getInstance()->getScheduler()->performFunctionInCocosThread(function);
+}
+
+// Implementation of ManualAssetsScheduler
+
+ManualAssetsScheduler::ManualAssetsScheduler()
+: _nextTimerId(0)
+, _time(std::chrono::steady_clock::now().time_since_epoch().count())
+{
+}
+
+void ManualAssetsScheduler::schedule(const std::function<void(float)> &callback, void *target, float interval, const std::string &key)
+{
+    for (auto &timer : _timers)
+    {
+        if (timer.target == target && timer.key == key)
+        {
+            // Same as the Director's scheduler, the timer starts again
+            timer.callback = callback;
+            timer.interval = interval;
+            timer.elapsed = 0;
+            return;
+        }
+    }
+    Timer timer;
+    timer.callback = callback;
+    timer.target = target;
+    timer.key = key;
+    timer.interval = interval;
+    timer.elapsed = 0;
+    timer.id = _nextTimerId++;
+    _timers.push_back(std::move(timer));
+}
+
+void ManualAssetsScheduler::unschedule(const std::string &key, void *target)
+{
+    for (auto it = _timers.begin(); it != _timers.end(); ++it)
+    {
+        if (it->target == target && it->key == key)
+        {
+            _timers.erase(it);
+            return;
+        }
+    }
+}
+
+void ManualAssetsScheduler::performInDriverThread(const std::function<void()> &function)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _functions.push_back(function);
+}
+
+std::chrono::steady_clock::time_point ManualAssetsScheduler::now()
+{
+    return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(_time.load()));
+}
+
+void ManualAssetsScheduler::update(float dt)
+{
+    _time += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(dt)).count();
+
+    // Callbacks may schedule and unschedule timers, so a due timer is looked up again before its call
+    std::vector<uint64_t> due;
+    for (auto &timer : _timers)
+    {
+        timer.elapsed += dt;
+        if (timer.elapsed >= timer.interval)
+        {
+            due.push_back(timer.id);
+        }
+    }
+    for (auto id : due)
+    {
+        for (auto &timer : _timers)
+        {
+            if (timer.id == id)
+            {
+                float elapsed = timer.elapsed;
+                timer.elapsed = 0;
+                // Copied, the callback may unschedule its own timer
+                std::function<void(float)> callback = timer.callback;
+                callback(elapsed);
+                break;
+            }
+        }
+    }
+
+    std::vector<std::function<void()>> functions;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        functions.swap(_functions);
+    }
+    for (const auto &function : functions)
+    {
+        function();
+    }
+}
+
+float ManualAssetsScheduler::getNextDelay() const
+{
+    float next = -1;
+    for (const auto &timer : _timers)
+    {
+        if (timer.interval <= 0)
+            continue;
+        float delay = timer.interval > timer.elapsed ? timer.interval - timer.elapsed : 0;
+        if (next < 0 || delay < next)
+            next = delay;
+    }
+    return next;
+}
+
+bool ManualAssetsScheduler::hasPendingFunctions()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return !_functions.empty();
+}
+
+// Implementation of ThreadPoolRunner
+
+ThreadPoolRunner::ThreadPoolRunner(int threads, const std::function<void(const std::function<void()> &done)> &deliver)
+: _stopping(false)
+, _deliver(deliver)
+, _alive(std::make_shared<std::atomic<bool>>(true))
+{
+    for (int i = 0; i < (threads > 0 ? threads : 1); ++i)
+    {
+        _threads.emplace_back(&ThreadPoolRunner::run, this);
+    }
+}
+
+ThreadPoolRunner::~ThreadPoolRunner()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+        _tasks.clear();
+    }
+    _condition.notify_all();
+    for (auto &thread : _threads)
+    {
+        thread.join();
+    }
+    _alive->store(false, std::memory_order_release);
+}
+
+void ThreadPoolRunner::runAsync(const std::function<void()> &work, const std::function<void()> &done)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.emplace_back(work, done);
+    }
+    _condition.notify_one();
+}
+
+size_t ThreadPoolRunner::getQueuedCount()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _tasks.size();
+}
+
+void ThreadPoolRunner::run()
+{
+    while (true)
+    {
+        std::pair<std::function<void()>, std::function<void()>> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+            if (_stopping)
+                return;
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task.first();
+        if (task.second)
+        {
+            auto alive = _alive;
+            std::function<void()> done = std::move(task.second);
+            _deliver([alive, done]() {
+                if (alive->load(std::memory_order_acquire))
+                    done();
+            });
+        }
+    }
+}
+
+// Implementation of InlineTaskRunner
+
+void InlineTaskRunner::runAsync(const std::function<void()> &work, const std::function<void()> &done)
+{
+    work();
+    done();
+}
+
+NS_CC_EXT_END
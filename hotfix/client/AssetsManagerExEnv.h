@@ -0,0 +1,309 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsManagerExEnv__
+#define __AssetsManagerExEnv__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "platform/CCFileUtils.h"
+#include "network/CCDownloader.h"
+
+#include "CCEventAssetsManagerEx.h"
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   Download backend of AssetsManagerEx.
+ *          Callbacks have the signatures of network::Downloader and must be invoked
+ *          on the thread driving the AssetsManagerEx, except for the backend of
+ *          AssetsDownloadScheduler, see AssetsDownloadScheduler::setBackend.
+ */
+class CC_EX_DLL IAssetsDownloader
+{
+public:
+    virtual ~IAssetsDownloader() {}
+
+    /** @brief Start downloading srcUrl to storagePath, the task is reported with the given identifier
+     */
+    virtual void createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier) = 0;
+
+    /** @brief Abort all running tasks, none of their callbacks may be invoked afterwards
+     */
+    virtual void cancelAll() = 0;
+
+    std::function<void(const network::DownloadTask& task)> onFileTaskSuccess;
+
+    std::function<void(const network::DownloadTask& task,
+                       int64_t bytesReceived,
+                       int64_t totalBytesReceived,
+                       int64_t totalBytesExpected)> onTaskProgress;
+
+    std::function<void(const network::DownloadTask& task,
+                       int errorCode,
+                       int errorCodeInternal,
+                       const std::string& errorStr)> onTaskError;
+};
+
+/**
+ * @brief   Runs background work, e.g. zip extraction, for AssetsManagerEx.
+ *          done must be invoked on the thread driving the AssetsManagerEx.
+ */
+class CC_EX_DLL IAssetsTaskRunner
+{
+public:
+    virtual ~IAssetsTaskRunner() {}
+
+    virtual void runAsync(const std::function<void()> &work, const std::function<void()> &done) = 0;
+};
+
+/**
+ * @brief   Timers and clock of AssetsManagerEx, and the hand-off of work to the thread driving it.
+ */
+class CC_EX_DLL IAssetsScheduler
+{
+public:
+    virtual ~IAssetsScheduler() {}
+
+    /** @brief Call callback every interval seconds, every frame for 0, on the thread driving the AssetsManagerEx
+     *         until unscheduled. Scheduling the key of target again restarts its timer.
+     */
+    virtual void schedule(const std::function<void(float)> &callback, void *target, float interval, const std::string &key) = 0;
+
+    virtual void unschedule(const std::string &key, void *target) = 0;
+
+    /** @brief Run function on the thread driving the AssetsManagerEx, may be called from any thread
+     */
+    virtual void performInDriverThread(const std::function<void()> &function) = 0;
+
+    /** @brief Clock of the timers, used for the deferred download budget
+     */
+    virtual std::chrono::steady_clock::time_point now() { return std::chrono::steady_clock::now(); }
+};
+
+/**
+ * @brief   IAssetsDownloader over network::Downloader, the default backend.
+ */
+class CC_EX_DLL NetworkAssetsDownloader : public IAssetsDownloader
+{
+public:
+    NetworkAssetsDownloader(int maxConcurrentTask, int timeoutInSeconds);
+
+    virtual ~NetworkAssetsDownloader();
+
+    virtual void createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier) override;
+
+    /** network::Downloader can't cancel a single task, destroying it aborts all of them.
+     *  Partial files keep the temp suffix so they are resumed on the next request.
+     */
+    virtual void cancelAll() override;
+
+private:
+    void initDownloader();
+
+    network::DownloaderHints _hints;
+    std::shared_ptr<network::Downloader> _downloader;
+};
+
+/**
+ * @brief   IAssetsTaskRunner over the engine AsyncTaskPool, the default runner.
+ */
+class CC_EX_DLL AsyncTaskPoolRunner : public IAssetsTaskRunner
+{
+public:
+    virtual void runAsync(const std::function<void()> &work, const std::function<void()> &done) override;
+};
+
+/**
+ * @brief   IAssetsTaskRunner running work and completion immediately on the calling thread,
+ *          for headless use where no engine thread pool is running.
+ */
+class CC_EX_DLL InlineTaskRunner : public IAssetsTaskRunner
+{
+public:
+    virtual void runAsync(const std::function<void()> &work, const std::function<void()> &done) override;
+};
+
+/**
+ * @brief   IAssetsScheduler over the Director's scheduler, the default one.
+ */
+class CC_EX_DLL DirectorAssetsScheduler : public IAssetsScheduler
+{
+public:
+    virtual void schedule(const std::function<void(float)> &callback, void *target, float interval, const std::string &key) override;
+
+    virtual void unschedule(const std::string &key, void *target) override;
+
+    virtual void performInDriverThread(const std::function<void()> &function) override;
+};
+
+/**
+ * @brief   IAssetsScheduler driven by its owner for headless use: timers fire and performed functions run
+ *          in update(), on the thread calling it, and the clock only moves forward with update().
+ */
+class CC_EX_DLL ManualAssetsScheduler : public IAssetsScheduler
+{
+public:
+    ManualAssetsScheduler();
+
+    virtual void schedule(const std::function<void(float)> &callback, void *target, float interval, const std::string &key) override;
+
+    virtual void unschedule(const std::string &key, void *target) override;
+
+    virtual void performInDriverThread(const std::function<void()> &function) override;
+
+    virtual std::chrono::steady_clock::time_point now() override;
+
+    /** @brief Move the clock dt seconds forward, call the timers due then the performed functions
+     */
+    void update(float dt);
+
+    /** @brief Seconds until the next timer with an interval is due, -1 if there is none.
+     *         Timers called every frame are due at every update().
+     */
+    float getNextDelay() const;
+
+    /** @brief Whether performed functions wait for update()
+     */
+    bool hasPendingFunctions();
+
+private:
+    struct Timer
+    {
+        std::function<void(float)> callback;
+        void *target;
+        std::string key;
+        float interval;
+        float elapsed;
+        //! Identifies the timer across callbacks which schedule and unschedule
+        uint64_t id;
+    };
+
+    std::vector<Timer> _timers;
+    uint64_t _nextTimerId;
+
+    //! Clock in steady_clock ticks, read by now() from the worker thread too
+    std::atomic<std::chrono::steady_clock::rep> _time;
+
+    //! Guards _functions, the only member used from other threads
+    std::mutex _mutex;
+    std::vector<std::function<void()>> _functions;
+};
+
+/**
+ * @brief   IAssetsTaskRunner over threads of its own, so that its work doesn't wait behind unrelated engine tasks
+ *          and several works run at once. AssetsManagerEx owns one to extract the downloaded archives.
+ */
+class CC_EX_DLL ThreadPoolRunner : public IAssetsTaskRunner
+{
+public:
+    /**
+     @param threads     Number of threads, at least 1
+     @param deliver     Called from a pool thread to run done on the thread driving the AssetsManagerEx
+     */
+    ThreadPoolRunner(int threads, const std::function<void(const std::function<void()> &done)> &deliver);
+
+    /** @brief Wait for the running works, the queued ones are dropped and no done is run afterwards
+     */
+    virtual ~ThreadPoolRunner();
+
+    virtual void runAsync(const std::function<void()> &work, const std::function<void()> &done) override;
+
+    /** @brief Number of works waiting for a thread
+     */
+    size_t getQueuedCount();
+
+private:
+    void run();
+
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<std::pair<std::function<void()>, std::function<void()>>> _tasks;
+    bool _stopping;
+    std::function<void(const std::function<void()> &done)> _deliver;
+    //! Cleared on destruction, done delivered but not run yet is skipped then
+    std::shared_ptr<std::atomic<bool>> _alive;
+};
+
+/**
+ * @brief   Everything AssetsManagerEx needs from the engine. Members left empty are filled
+ *          with the engine defaults: FileUtils::getInstance(), a downloader of the process wide
+ *          AssetsDownloadScheduler, AsyncTaskPool, the Director's scheduler and EventDispatcher.
+ *          A headless AssetsManagerEx, running without Director, sets all of them.
+ */
+struct CC_EX_DLL AssetsManagerExEnv
+{
+    //! File system used for storage, manifests and search paths
+    FileUtils *fileUtils = nullptr;
+
+    //! Download backend, AssetsDownloadScheduler::createDownloader with a custom priority for instance
+    std::shared_ptr<IAssetsDownloader> downloader;
+
+    std::shared_ptr<IAssetsTaskRunner> taskRunner;
+
+    /** Timers and hand-off to the driving thread, a ManualAssetsScheduler updated by the host loop when headless.
+     *  Textures are only warmed up with the Director's scheduler, there is no renderer to upload them to otherwise.
+     */
+    std::shared_ptr<IAssetsScheduler> scheduler;
+
+    /** Threads of the ThreadPoolRunner the manager owns to extract downloaded archives, several at once
+     *  and without waiting behind other engine tasks. Only used when taskRunner is left empty, archives
+     *  are extracted on taskRunner otherwise. 0 extracts them on the AsyncTaskPool like the other background work.
+     */
+    int extractionThreads = 2;
+
+    //! Receives all update events instead of the EventDispatcher when set
+    std::function<void(EventAssetsManagerEx *event)> eventCallback;
+
+    /** Run the update state machine, manifest parsing and saving, verification and the final
+     *  file merge on a dedicated thread. The main thread only starts download tasks and receives
+     *  coalesced events, drained once per frame by the scheduler: UPDATE_PROGRESSION is
+     *  merged to at most one event per frame and ASSET_UPDATED isn't sent.
+     *  The verify and version compare callbacks are called on the worker, and manifests returned by
+     *  getLocalManifest and getRemoteManifest must not be read while updating.
+     */
+    bool workerThread = false;
+
+    /** Install updated files in a few pack files, see AssetsPackStorage, instead of one file each.
+     *  Manifests stay plain files. Packed files are only readable through HotUpdateFileUtils, which must be
+     *  installed before the manager is created, the storage keeps plain files otherwise.
+     */
+    bool packStorage = false;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsManagerExEnv__) */
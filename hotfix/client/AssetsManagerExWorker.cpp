@@ -0,0 +1,108 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsManagerExWorker.h"
+
+NS_CC_EXT_BEGIN
+
+// Implementation of AssetsUpdateWorker
+
+AssetsUpdateWorker::AssetsUpdateWorker(const std::function<void()> &onIdle)
+: _stopping(false)
+, _onIdle(onIdle)
+{
+    _thread = std::thread(&AssetsUpdateWorker::run, this);
+}
+
+AssetsUpdateWorker::~AssetsUpdateWorker()
+{
+    stop();
+}
+
+void AssetsUpdateWorker::post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stopping.load(std::memory_order_relaxed))
+            return;
+        _tasks.push_back(std::move(task));
+    }
+    _condition.notify_one();
+}
+
+void AssetsUpdateWorker::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping.store(true, std::memory_order_release);
+        _tasks.clear();
+    }
+    _condition.notify_one();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+AssetsWorkerMessage* AssetsUpdateWorker::beginMessage()
+{
+    AssetsWorkerMessage *message = _messages.beginPush();
+    // The main thread drains the ring every frame, a full ring only happens on error storms
+    while (!message)
+    {
+        if (isStopping())
+            return nullptr;
+        std::this_thread::yield();
+        message = _messages.beginPush();
+    }
+    return message;
+}
+
+void AssetsUpdateWorker::run()
+{
+    std::function<void()> task;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_tasks.empty() && !_stopping.load(std::memory_order_relaxed))
+            {
+                lock.unlock();
+                if (_onIdle)
+                    _onIdle();
+                lock.lock();
+            }
+            _condition.wait(lock, [this]() {
+                return !_tasks.empty() || _stopping.load(std::memory_order_relaxed);
+            });
+            if (_stopping.load(std::memory_order_relaxed))
+                return;
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+        task = nullptr;
+    }
+}
+
+NS_CC_EXT_END
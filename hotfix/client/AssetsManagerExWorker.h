@@ -0,0 +1,197 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsManagerExWorker__
+#define __AssetsManagerExWorker__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CCEventAssetsManagerEx.h"
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   Bounded single producer / single consumer ring without locks.
+ *          Slots are constructed once and reused, so pushing a message into a warm ring
+ *          doesn't allocate as long as its strings fit in the capacity of the slot.
+ *          Capacity must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class SpscRing
+{
+public:
+    SpscRing() : _head(0), _tail(0)
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+    }
+
+    /** @brief Producer side, slot to fill or nullptr when the ring is full
+     */
+    T* beginPush()
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == Capacity)
+            return nullptr;
+        return &_slots[tail & (Capacity - 1)];
+    }
+
+    /** @brief Producer side, publish the slot returned by beginPush
+     */
+    void commitPush()
+    {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** @brief Consumer side, oldest published slot or nullptr when the ring is empty
+     */
+    T* front()
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+            return nullptr;
+        return &_slots[head & (Capacity - 1)];
+    }
+
+    /** @brief Consumer side, release the slot returned by front
+     */
+    void pop()
+    {
+        _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    T _slots[Capacity];
+    std::atomic<size_t> _head;
+    std::atomic<size_t> _tail;
+};
+
+/**
+ * @brief   Work the update worker thread hands to the main thread.
+ */
+struct AssetsWorkerMessage
+{
+    enum class Type : char
+    {
+        //! Update event for the listeners
+        EVENT,
+        //! Coalesced UPDATE_PROGRESSION, at most one is queued at any time
+        PROGRESS,
+        //! Start a download task, network::Downloader must be driven from the main thread
+        DOWNLOAD,
+        //! Abort all running download tasks
+        CANCEL_DOWNLOADS,
+        //! Prepend manifest search paths to FileUtils
+        SEARCH_PATHS,
+        //! Remove the search paths under assetId from FileUtils
+        REMOVE_SEARCH_PATHS,
+        //! Post queueDowload back to the worker after percent seconds
+        SCHEDULE_QUEUE
+    };
+
+    Type type;
+    EventAssetsManagerEx::EventCode code;
+    //! Update state of the manager when the message was posted
+    int state;
+    float percent;
+    float percentByFile;
+    //! Archives waiting for or in extraction when the message was posted
+    int pendingExtractions;
+    int curleCode;
+    int curlmCode;
+    //! Event asset id, download identifier or manifest root
+    std::string assetId;
+    //! Event message or download url
+    std::string message;
+    //! Download storage path
+    std::string storagePath;
+    //! Manifest search paths
+    std::vector<std::string> searchPaths;
+};
+
+/**
+ * @brief   Thread running the AssetsManagerEx state machine in worker thread mode.
+ *          Tasks are posted from any thread and run in order on the worker, messages for the
+ *          main thread go through a lock-free ring drained once per frame.
+ */
+class CC_EX_DLL AssetsUpdateWorker
+{
+public:
+    static const size_t MESSAGE_CAPACITY = 1024;
+
+    /** @param onIdle    Called on the worker each time it runs out of tasks
+     */
+    explicit AssetsUpdateWorker(const std::function<void()> &onIdle = nullptr);
+
+    ~AssetsUpdateWorker();
+
+    /** @brief Run task on the worker thread, after all tasks posted before
+     */
+    void post(std::function<void()> task);
+
+    /** @brief Stop the thread, tasks not started yet are dropped. Called from the main thread.
+     */
+    void stop();
+
+    bool isWorkerThread() const { return std::this_thread::get_id() == _thread.get_id(); }
+
+    bool isStopping() const { return _stopping.load(std::memory_order_acquire); }
+
+    /** @brief Worker side, slot for the next main thread message.
+     *         Waits while the main thread catches up with a full ring, returns nullptr once stopping.
+     */
+    AssetsWorkerMessage* beginMessage();
+
+    void commitMessage() { _messages.commitPush(); }
+
+    /** @brief Main thread side, see SpscRing::front and SpscRing::pop
+     */
+    AssetsWorkerMessage* frontMessage() { return _messages.front(); }
+
+    void popMessage() { _messages.pop(); }
+
+private:
+    void run();
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<std::function<void()>> _tasks;
+    std::atomic<bool> _stopping;
+    std::function<void()> _onIdle;
+
+    SpscRing<AssetsWorkerMessage, MESSAGE_CAPACITY> _messages;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsManagerExWorker__) */
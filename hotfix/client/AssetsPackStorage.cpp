@@ -0,0 +1,719 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsPackStorage.h"
+#include "platform/CCPlatformConfig.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+NS_CC_EXT_BEGIN
+
+#define PACK_INDEX_MAGIC            "AMPI"
+#define PACK_INDEX_VERSION          1
+#define PACK_INDEX_FILENAME         "index.dat"
+#define PACK_INDEX_TEMP_FILENAME    "index.tmp"
+#define PACK_INDEX_STAGED_FILENAME  "index.staged"
+#define PACK_COPY_BUFFER_SIZE       65536
+
+// Layout of the index file: header, pack records, buckets, then the relative paths
+
+struct PackIndexHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t packCount;
+    uint32_t bucketCount;
+    uint32_t entryCount;
+    uint32_t stringBytes;
+};
+
+struct PackRecord
+{
+    uint32_t id;
+    //! Live files in the pack, 0 once retired
+    uint32_t entries;
+    uint64_t size;
+};
+
+struct PackBucket
+{
+    //! 0 for an empty bucket
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;
+    //! Index of the pack record
+    uint32_t pack;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(PackIndexHeader) == 24 && sizeof(PackRecord) == 16 && sizeof(PackBucket) == 40,
+              "Pack index records are mapped, they must not be padded");
+
+static uint64_t hashPath(const char *path, size_t length)
+{
+    // FNV-1a, 0 is kept for empty buckets
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= (unsigned char)path[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+static bool syncFile(FILE *fp)
+{
+    if (fflush(fp) != 0)
+        return false;
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+static bool removeIfPresent(const std::string &path)
+{
+    return remove(path.c_str()) == 0 || errno == ENOENT;
+}
+
+struct AssetsPackStorage::Index
+{
+    const PackIndexHeader *header = nullptr;
+    const PackRecord *packs = nullptr;
+    const PackBucket *buckets = nullptr;
+    const char *strings = nullptr;
+
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+    // No pread, reads of one pack are serialized
+    std::vector<uint64_t> content;
+    std::vector<FILE*> files;
+    std::unique_ptr<std::mutex[]> fileMutexes;
+#else
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+    std::vector<int> files;
+#endif
+
+    ~Index()
+    {
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+        for (FILE *fp : files)
+        {
+            if (fp)
+                fclose(fp);
+        }
+#else
+        for (int fd : files)
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+        if (mapping)
+        {
+            munmap(mapping, mappingSize);
+        }
+#endif
+    }
+
+    const PackBucket* lookup(const std::string &relativePath) const
+    {
+        if (header->bucketCount == 0)
+            return nullptr;
+        const uint32_t mask = header->bucketCount - 1;
+        const uint64_t hash = hashPath(relativePath.data(), relativePath.size());
+        // The load factor is below 1, probing ends on an empty bucket
+        for (uint32_t i = (uint32_t)hash & mask; ; i = (i + 1) & mask)
+        {
+            const PackBucket &bucket = buckets[i];
+            if (bucket.hash == 0)
+                return nullptr;
+            if (bucket.hash == hash && bucket.nameLength == relativePath.size()
+                && memcmp(strings + bucket.nameOffset, relativePath.data(), relativePath.size()) == 0)
+                return &bucket;
+        }
+    }
+
+    bool readAt(uint32_t pack, uint64_t offset, void *buffer, uint64_t size) const
+    {
+        char *cursor = (char*)buffer;
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+        FILE *fp = files[pack];
+        if (!fp)
+            return false;
+        std::lock_guard<std::mutex> lock(fileMutexes[pack]);
+        if (_fseeki64(fp, (__int64)offset, SEEK_SET) != 0)
+            return false;
+        return fread(cursor, 1, (size_t)size, fp) == (size_t)size;
+#else
+        int fd = files[pack];
+        if (fd < 0)
+            return false;
+        while (size > 0)
+        {
+            ssize_t read = pread(fd, cursor, (size_t)size, (off_t)offset);
+            if (read < 0 && errno == EINTR)
+                continue;
+            if (read <= 0)
+                return false;
+            cursor += read;
+            offset += read;
+            size -= read;
+        }
+        return true;
+#endif
+    }
+};
+
+// Implementation of AssetsPackStorage
+
+const std::string AssetsPackStorage::PACK_DIRECTORY = "packs/";
+
+AssetsPackStorage::AssetsPackStorage(const std::string &root)
+: _root(root)
+{
+}
+
+AssetsPackStorage::~AssetsPackStorage()
+{
+}
+
+std::string AssetsPackStorage::indexPath() const
+{
+    return _root + PACK_DIRECTORY + PACK_INDEX_FILENAME;
+}
+
+std::string AssetsPackStorage::stagedIndexPath() const
+{
+    return _root + PACK_DIRECTORY + PACK_INDEX_STAGED_FILENAME;
+}
+
+std::string AssetsPackStorage::packPath(uint32_t id) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "pack-%u.dat", (unsigned)id);
+    return _root + PACK_DIRECTORY + name;
+}
+
+std::shared_ptr<AssetsPackStorage::Index> AssetsPackStorage::openIndex(const std::string &path) const
+{
+    auto index = std::make_shared<Index>();
+    const char *data = nullptr;
+    size_t size = 0;
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return nullptr;
+    _fseeki64(fp, 0, SEEK_END);
+    size = (size_t)_ftelli64(fp);
+    _fseeki64(fp, 0, SEEK_SET);
+    // uint64_t storage keeps the records aligned
+    index->content.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    bool ok = size > 0 && fread(index->content.data(), 1, size, fp) == size;
+    fclose(fp);
+    if (!ok)
+        return nullptr;
+    data = (const char*)index->content.data();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct ::stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+    size = (size_t)info.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return nullptr;
+    index->mapping = mapping;
+    index->mappingSize = size;
+    data = (const char*)mapping;
+#endif
+
+    // Check everything lookups rely on once, they trust the index afterwards
+    if (size < sizeof(PackIndexHeader))
+        return nullptr;
+    const PackIndexHeader *header = (const PackIndexHeader*)data;
+    if (memcmp(header->magic, PACK_INDEX_MAGIC, 4) != 0 || header->version != PACK_INDEX_VERSION)
+        return nullptr;
+    if ((header->bucketCount & (header->bucketCount - 1)) != 0 || header->entryCount >= std::max(header->bucketCount, 1u))
+        return nullptr;
+    const uint64_t expected = sizeof(PackIndexHeader) + (uint64_t)header->packCount * sizeof(PackRecord)
+                            + (uint64_t)header->bucketCount * sizeof(PackBucket) + header->stringBytes;
+    if (expected != size)
+        return nullptr;
+    index->header = header;
+    index->packs = (const PackRecord*)(data + sizeof(PackIndexHeader));
+    index->buckets = (const PackBucket*)(index->packs + header->packCount);
+    index->strings = (const char*)(index->buckets + header->bucketCount);
+    uint32_t entries = 0;
+    for (uint32_t i = 0; i < header->bucketCount; ++i)
+    {
+        const PackBucket &bucket = index->buckets[i];
+        if (bucket.hash == 0)
+            continue;
+        if (bucket.pack >= header->packCount
+            || (uint64_t)bucket.nameOffset + bucket.nameLength > header->stringBytes
+            || bucket.offset + bucket.size > index->packs[bucket.pack].size)
+            return nullptr;
+        ++entries;
+    }
+    if (entries != header->entryCount)
+        return nullptr;
+
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+    index->files.assign(header->packCount, nullptr);
+    index->fileMutexes.reset(new std::mutex[header->packCount]);
+#else
+    index->files.assign(header->packCount, -1);
+#endif
+    for (uint32_t i = 0; i < header->packCount; ++i)
+    {
+        const PackRecord &record = index->packs[i];
+        if (record.entries == 0)
+            continue;
+        const std::string pack = packPath(record.id);
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+        FILE *packFile = fopen(pack.c_str(), "rb");
+        if (!packFile)
+            return nullptr;
+        index->files[i] = packFile;
+        _fseeki64(packFile, 0, SEEK_END);
+        if ((uint64_t)_ftelli64(packFile) < record.size)
+            return nullptr;
+#else
+        int packFd = open(pack.c_str(), O_RDONLY);
+        if (packFd < 0)
+            return nullptr;
+        index->files[i] = packFd;
+        struct ::stat packInfo;
+        if (fstat(packFd, &packInfo) != 0 || (uint64_t)packInfo.st_size < record.size)
+            return nullptr;
+#endif
+    }
+    return index;
+}
+
+bool AssetsPackStorage::load()
+{
+    std::shared_ptr<const Index> index = openIndex(indexPath());
+    std::atomic_store(&_index, index);
+    if (!index)
+        return false;
+    for (uint32_t i = 0; i < index->header->packCount; ++i)
+    {
+        if (index->packs[i].entries == 0)
+        {
+            removeIfPresent(packPath(index->packs[i].id));
+        }
+    }
+    return true;
+}
+
+bool AssetsPackStorage::contains(const std::string &relativePath) const
+{
+    std::shared_ptr<const Index> index = std::atomic_load(&_index);
+    return index && index->lookup(relativePath);
+}
+
+int64_t AssetsPackStorage::getSize(const std::string &relativePath) const
+{
+    std::shared_ptr<const Index> index = std::atomic_load(&_index);
+    const PackBucket *bucket = index ? index->lookup(relativePath) : nullptr;
+    return bucket ? (int64_t)bucket->size : -1;
+}
+
+bool AssetsPackStorage::read(const std::string &relativePath, ResizableBuffer *buffer) const
+{
+    std::shared_ptr<const Index> index = std::atomic_load(&_index);
+    const PackBucket *bucket = index ? index->lookup(relativePath) : nullptr;
+    if (!bucket)
+        return false;
+    buffer->resize((size_t)bucket->size);
+    return bucket->size == 0 || index->readAt(bucket->pack, bucket->offset, buffer->buffer(), bucket->size);
+}
+
+size_t AssetsPackStorage::getEntryCount() const
+{
+    std::shared_ptr<const Index> index = std::atomic_load(&_index);
+    return index ? index->header->entryCount : 0;
+}
+
+size_t AssetsPackStorage::getPackCount() const
+{
+    std::shared_ptr<const Index> index = std::atomic_load(&_index);
+    size_t count = 0;
+    if (index)
+    {
+        for (uint32_t i = 0; i < index->header->packCount; ++i)
+        {
+            if (index->packs[i].entries > 0)
+                ++count;
+        }
+    }
+    return count;
+}
+
+bool AssetsPackStorage::commit(const std::string &sourceRoot, const std::vector<std::string> &added, const std::vector<std::string> &removed)
+{
+    discardStaged();
+    std::vector<uint32_t> emptied;
+    if (!build(sourceRoot, added, removed, indexPath(), &emptied))
+        return false;
+
+    std::shared_ptr<const Index> index = openIndex(indexPath());
+    std::atomic_store(&_index, index);
+    if (!index)
+        return false;
+    // Readers of the previous index may still hold them open, retired records get them on the next commit
+    for (uint32_t id : emptied)
+    {
+        removeIfPresent(packPath(id));
+    }
+    return true;
+}
+
+bool AssetsPackStorage::stage(const std::string &sourceRoot, const std::vector<std::string> &added, const std::vector<std::string> &removed)
+{
+    discardStaged();
+    // Packs emptied by the staged index are still read through the committed one, load() deletes them once applied
+    std::vector<uint32_t> emptied;
+    return build(sourceRoot, added, removed, stagedIndexPath(), &emptied);
+}
+
+bool AssetsPackStorage::hasStaged() const
+{
+    FILE *fp = fopen(stagedIndexPath().c_str(), "rb");
+    if (!fp)
+        return false;
+    fclose(fp);
+    return true;
+}
+
+bool AssetsPackStorage::applyStaged()
+{
+    if (!hasStaged())
+        return false;
+    const std::string staged = stagedIndexPath();
+    const std::string path = indexPath();
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+    // rename doesn't replace an existing file
+    if (!removeIfPresent(path))
+        return false;
+#endif
+    if (rename(staged.c_str(), path.c_str()) != 0)
+        return false;
+    return load();
+}
+
+void AssetsPackStorage::discardStaged()
+{
+    const std::string staged = stagedIndexPath();
+    std::vector<uint32_t> written;
+    std::shared_ptr<Index> stagedIndex = openIndex(staged);
+    if (stagedIndex)
+    {
+        // Packs written for the staged index are the ones the committed index doesn't list
+        std::unordered_set<uint32_t> committed;
+        std::shared_ptr<const Index> current = std::atomic_load(&_index);
+        if (current)
+        {
+            for (uint32_t i = 0; i < current->header->packCount; ++i)
+            {
+                committed.insert(current->packs[i].id);
+            }
+        }
+        for (uint32_t i = 0; i < stagedIndex->header->packCount; ++i)
+        {
+            if (committed.find(stagedIndex->packs[i].id) == committed.end())
+                written.push_back(stagedIndex->packs[i].id);
+        }
+        // Closes the packs before they're deleted
+        stagedIndex.reset();
+    }
+    for (uint32_t id : written)
+    {
+        removeIfPresent(packPath(id));
+    }
+    removeIfPresent(staged);
+}
+
+bool AssetsPackStorage::build(const std::string &sourceRoot, const std::vector<std::string> &added, const std::vector<std::string> &removed,
+                              const std::string &target, std::vector<uint32_t> *emptied)
+{
+    struct Entry
+    {
+        //! Pack id
+        uint32_t pack;
+        uint64_t offset;
+        uint64_t size;
+    };
+    std::shared_ptr<const Index> current = std::atomic_load(&_index);
+
+    // 1. Current content, without the removed and replaced files
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<uint32_t, uint32_t> currentPacks;
+    std::vector<uint32_t> retired;
+    uint32_t nextId = 1;
+    if (current)
+    {
+        const PackIndexHeader *header = current->header;
+        entries.reserve(header->entryCount + added.size());
+        for (uint32_t i = 0; i < header->packCount; ++i)
+        {
+            const PackRecord &record = current->packs[i];
+            nextId = std::max(nextId, record.id + 1);
+            if (record.entries > 0)
+                currentPacks.emplace(record.id, i);
+            // Retired packs are listed until they could be deleted
+            else if (!removeIfPresent(packPath(record.id)))
+                retired.push_back(record.id);
+        }
+        for (uint32_t i = 0; i < header->bucketCount; ++i)
+        {
+            const PackBucket &bucket = current->buckets[i];
+            if (bucket.hash == 0)
+                continue;
+            Entry entry = {current->packs[bucket.pack].id, bucket.offset, bucket.size};
+            entries.emplace(std::string(current->strings + bucket.nameOffset, bucket.nameLength), entry);
+        }
+    }
+    for (const auto &path : removed)
+    {
+        entries.erase(path);
+    }
+    for (const auto &path : added)
+    {
+        entries.erase(path);
+    }
+
+    // 2. Packs with more than half of their bytes replaced are compacted into the new pack
+    std::unordered_map<uint32_t, uint64_t> liveBytes;
+    for (const auto &it : entries)
+    {
+        liveBytes[it.second.pack] += it.second.size;
+    }
+    std::unordered_set<uint32_t> compacted;
+    for (const auto &it : currentPacks)
+    {
+        auto live = liveBytes.find(it.first);
+        if (live != liveBytes.end() && live->second * 2 < current->packs[it.second].size)
+            compacted.insert(it.first);
+    }
+
+    // 3. Write the new pack
+    const uint32_t newId = nextId;
+    uint64_t newSize = 0;
+    if (!added.empty() || !compacted.empty())
+    {
+        const std::string path = packPath(newId);
+        FILE *out = fopen(path.c_str(), "wb");
+        if (!out)
+            return false;
+        std::vector<char> buffer(PACK_COPY_BUFFER_SIZE);
+        bool ok = true;
+        for (const auto &relativePath : added)
+        {
+            FILE *in = fopen((sourceRoot + relativePath).c_str(), "rb");
+            if (!in)
+            {
+                ok = false;
+                break;
+            }
+            Entry entry = {newId, newSize, 0};
+            size_t read = 0;
+            while (ok && (read = fread(buffer.data(), 1, buffer.size(), in)) > 0)
+            {
+                ok = fwrite(buffer.data(), 1, read, out) == read;
+                entry.size += read;
+            }
+            ok = ok && !ferror(in);
+            fclose(in);
+            if (!ok)
+                break;
+            newSize += entry.size;
+            entries[relativePath] = entry;
+        }
+        for (auto it = entries.begin(); ok && it != entries.end(); ++it)
+        {
+            Entry &entry = it->second;
+            if (compacted.find(entry.pack) == compacted.end())
+                continue;
+            uint32_t pack = currentPacks[entry.pack];
+            for (uint64_t copied = 0; ok && copied < entry.size; )
+            {
+                size_t chunk = (size_t)std::min((uint64_t)buffer.size(), entry.size - copied);
+                ok = current->readAt(pack, entry.offset + copied, buffer.data(), chunk)
+                     && fwrite(buffer.data(), 1, chunk, out) == chunk;
+                copied += chunk;
+            }
+            entry.pack = newId;
+            entry.offset = newSize;
+            newSize += entry.size;
+        }
+        ok = syncFile(out) && ok;
+        ok = (fclose(out) == 0) && ok;
+        if (!ok)
+        {
+            remove(path.c_str());
+            return false;
+        }
+    }
+
+    // 4. Pack records, the packs left without files are retired
+    std::vector<PackRecord> records;
+    std::unordered_map<uint32_t, uint32_t> recordOf;
+    for (const auto &it : entries)
+    {
+        auto record = recordOf.find(it.second.pack);
+        if (record == recordOf.end())
+        {
+            const uint32_t id = it.second.pack;
+            uint64_t size = id == newId ? newSize : current->packs[currentPacks[id]].size;
+            PackRecord packRecord = {id, 0, size};
+            record = recordOf.emplace(id, (uint32_t)records.size()).first;
+            records.push_back(packRecord);
+        }
+        records[record->second].entries++;
+    }
+    for (const auto &it : currentPacks)
+    {
+        if (recordOf.find(it.first) == recordOf.end())
+            emptied->push_back(it.first);
+    }
+    for (uint32_t id : retired)
+    {
+        PackRecord packRecord = {id, 0, 0};
+        records.push_back(packRecord);
+    }
+    for (uint32_t id : *emptied)
+    {
+        PackRecord packRecord = {id, 0, 0};
+        records.push_back(packRecord);
+    }
+
+    // 5. Hash table with a load factor below 2/3, then the paths
+    uint32_t bucketCount = 1;
+    while (bucketCount < entries.size() + entries.size() / 2 + 1)
+    {
+        bucketCount <<= 1;
+    }
+    std::vector<PackBucket> buckets(bucketCount);
+    memset(buckets.data(), 0, buckets.size() * sizeof(PackBucket));
+    std::string strings;
+    for (const auto &it : entries)
+    {
+        const std::string &path = it.first;
+        uint64_t hash = hashPath(path.data(), path.size());
+        uint32_t i = (uint32_t)hash & (bucketCount - 1);
+        while (buckets[i].hash != 0)
+        {
+            i = (i + 1) & (bucketCount - 1);
+        }
+        PackBucket &bucket = buckets[i];
+        bucket.hash = hash;
+        bucket.offset = it.second.offset;
+        bucket.size = it.second.size;
+        bucket.pack = recordOf[it.second.pack];
+        bucket.nameOffset = (uint32_t)strings.size();
+        bucket.nameLength = (uint32_t)path.size();
+        strings.append(path);
+    }
+    PackIndexHeader header;
+    memcpy(header.magic, PACK_INDEX_MAGIC, 4);
+    header.version = PACK_INDEX_VERSION;
+    header.packCount = (uint32_t)records.size();
+    header.bucketCount = bucketCount;
+    header.entryCount = (uint32_t)entries.size();
+    header.stringBytes = (uint32_t)strings.size();
+
+    // 6. Write the index aside then move it to target with a rename
+    const std::string tempPath = _root + PACK_DIRECTORY + PACK_INDEX_TEMP_FILENAME;
+    const std::string &path = target;
+    FILE *fp = fopen(tempPath.c_str(), "wb");
+    bool ok = fp != nullptr;
+    if (ok)
+    {
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+        ok = ok && (records.empty() || fwrite(records.data(), sizeof(PackRecord), records.size(), fp) == records.size());
+        ok = ok && fwrite(buckets.data(), sizeof(PackBucket), buckets.size(), fp) == buckets.size();
+        ok = ok && (strings.empty() || fwrite(strings.data(), 1, strings.size(), fp) == strings.size());
+        ok = syncFile(fp) && ok;
+        ok = (fclose(fp) == 0) && ok;
+    }
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+    // rename doesn't replace an existing file
+    ok = ok && removeIfPresent(path);
+#endif
+    ok = ok && rename(tempPath.c_str(), path.c_str()) == 0;
+    if (!ok)
+    {
+        remove(tempPath.c_str());
+        if (recordOf.find(newId) != recordOf.end())
+        {
+            remove(packPath(newId).c_str());
+        }
+        return false;
+    }
+    return true;
+}
+
+void AssetsPackStorage::clear()
+{
+    discardStaged();
+    std::shared_ptr<const Index> current = std::atomic_load(&_index);
+    std::atomic_store(&_index, std::shared_ptr<const Index>());
+    removeIfPresent(indexPath());
+    if (current)
+    {
+        for (uint32_t i = 0; i < current->header->packCount; ++i)
+        {
+            removeIfPresent(packPath(current->packs[i].id));
+        }
+    }
+}
+
+NS_CC_EXT_END
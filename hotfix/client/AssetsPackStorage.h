@@ -0,0 +1,142 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsPackStorage__
+#define __AssetsPackStorage__
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "platform/CCFileUtils.h"
+
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   Storage of installed assets in a few large pack files instead of one file per asset.
+ *          Each commit appends the files of an update to a new pack and rewrites the index, a hash table
+ *          from relative path to pack range that is mapped in memory and switched with a single rename,
+ *          so installing and uninstalling cost a handful of file operations whatever the asset count.
+ *          Packs whose content is mostly replaced are compacted into the next one, packs left without
+ *          any live file are deleted. The engine reads packed files through HotUpdateFileUtils.
+ *          Lookups and reads are lock-free and may come from any thread, commits come from one thread.
+ *          Files are written in the byte order of the device, they're never shared between devices.
+ */
+class CC_EX_DLL AssetsPackStorage
+{
+public:
+
+    //! Directory of the packs and their index, relative to the storage
+    static const std::string PACK_DIRECTORY;
+
+    /** @param root    Storage path with the trailing slash, suitable for fopen
+     */
+    explicit AssetsPackStorage(const std::string &root);
+
+    ~AssetsPackStorage();
+
+    /** @brief Map the committed index. A missing or inconsistent index leaves the storage empty.
+     *         Packs retired by previous commits which couldn't be deleted then are deleted.
+     */
+    bool load();
+
+    /** @brief Whether a file is packed, relativePath is relative to the storage
+     */
+    bool contains(const std::string &relativePath) const;
+
+    /** @brief Size of a packed file, -1 if it isn't packed
+     */
+    int64_t getSize(const std::string &relativePath) const;
+
+    /** @brief Read a packed file into buffer
+     @return    false if it isn't packed or the pack can't be read
+     */
+    bool read(const std::string &relativePath, ResizableBuffer *buffer) const;
+
+    /** @brief Append the files at sourceRoot + added to a new pack, drop the removed ones, then switch to the new index.
+     *         A file both packed and added is replaced, a staged index is discarded.
+     @param sourceRoot  Directory of the added files with the trailing slash, suitable for fopen
+     @return    false on I/O error, the committed index is unchanged then
+     */
+    bool commit(const std::string &sourceRoot, const std::vector<std::string> &added, const std::vector<std::string> &removed);
+
+    /** @brief Same as commit, except the new index is only written aside. The committed one stays in use
+     *         until applyStaged, at the next launch typically. Nothing else may be committed in between.
+     */
+    bool stage(const std::string &sourceRoot, const std::vector<std::string> &added, const std::vector<std::string> &removed);
+
+    /** @brief Whether an index is staged, applyStaged hasn't switched to it yet
+     */
+    bool hasStaged() const;
+
+    /** @brief Switch to the staged index with a rename
+     @return    false if nothing is staged or it can't be loaded
+     */
+    bool applyStaged();
+
+    /** @brief Delete the staged index and the pack written for it, if any
+     */
+    void discardStaged();
+
+    /** @brief Delete the index, the staged one and all packs
+     */
+    void clear();
+
+    size_t getEntryCount() const;
+
+    size_t getPackCount() const;
+
+private:
+    struct Index;
+
+    std::string indexPath() const;
+
+    std::string stagedIndexPath() const;
+
+    std::string packPath(uint32_t id) const;
+
+    /** @brief Map an index file and open its packs, nullptr if it's missing or inconsistent
+     */
+    std::shared_ptr<Index> openIndex(const std::string &path) const;
+
+    /** @brief Write the new pack and the index of the current content with the changes at target
+     @param emptied     Receives the ids of the packs the new index doesn't use anymore
+     */
+    bool build(const std::string &sourceRoot, const std::vector<std::string> &added, const std::vector<std::string> &removed,
+               const std::string &target, std::vector<uint32_t> *emptied);
+
+    //! Storage path, suitable for fopen
+    std::string _root;
+
+    //! Read with std::atomic_load, replaced with std::atomic_store by load, commit and clear
+    std::shared_ptr<const Index> _index;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsPackStorage__) */
@@ -0,0 +1,148 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsResolutionIndex.h"
+
+#include <thread>
+
+NS_CC_EXT_BEGIN
+
+// Implementation of AssetsResolutionIndex
+
+AssetsResolutionIndex* AssetsResolutionIndex::getInstance()
+{
+    // Never destroyed, FileUtils may still resolve paths during exit
+    static AssetsResolutionIndex *s_sharedIndex = new AssetsResolutionIndex();
+    return s_sharedIndex;
+}
+
+AssetsResolutionIndex::AssetsResolutionIndex()
+: _enabled(false)
+{
+    _writeLock.clear();
+}
+
+void AssetsResolutionIndex::setRoot(std::shared_ptr<const Root> root)
+{
+    while (_writeLock.test_and_set(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+    std::shared_ptr<const Snapshot> current = std::atomic_load(&_snapshot);
+    auto snapshot = std::make_shared<Snapshot>();
+    if (current)
+    {
+        for (const auto &it : *current)
+        {
+            if (it->root != root->root)
+            {
+                snapshot->push_back(it);
+            }
+        }
+    }
+    snapshot->push_back(std::move(root));
+    std::atomic_store(&_snapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+    _writeLock.clear(std::memory_order_release);
+}
+
+void AssetsResolutionIndex::removeRoot(const std::string &root)
+{
+    while (_writeLock.test_and_set(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+    std::shared_ptr<const Snapshot> current = std::atomic_load(&_snapshot);
+    if (current)
+    {
+        auto snapshot = std::make_shared<Snapshot>();
+        for (const auto &it : *current)
+        {
+            if (it->root != root)
+            {
+                snapshot->push_back(it);
+            }
+        }
+        std::atomic_store(&_snapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+    }
+    _writeLock.clear(std::memory_order_release);
+}
+
+std::shared_ptr<const AssetsResolutionIndex::Root> AssetsResolutionIndex::getRoot(const std::string &root) const
+{
+    std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&_snapshot);
+    if (snapshot)
+    {
+        for (const auto &it : *snapshot)
+        {
+            if (it->root == root)
+                return it;
+        }
+    }
+    return nullptr;
+}
+
+bool AssetsResolutionIndex::Root::mayContain(const std::string &relative) const
+{
+    if (paths.find(relative) != paths.end())
+        return true;
+    for (const auto &dir : probeDirs)
+    {
+        if (relative.compare(0, dir.size(), dir) == 0)
+            return true;
+    }
+    return false;
+}
+
+std::shared_ptr<const AssetsResolutionIndex::Root> AssetsResolutionIndex::findRoot(const std::string &path) const
+{
+    if (!isEnabled())
+        return nullptr;
+
+    std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&_snapshot);
+    if (snapshot)
+    {
+        for (const auto &root : *snapshot)
+        {
+            const std::string &rootPath = root->root;
+            if (path.size() >= rootPath.size() && path.compare(0, rootPath.size(), rootPath) == 0)
+                return root;
+        }
+    }
+    return nullptr;
+}
+
+bool AssetsResolutionIndex::mayExist(const std::string &directory, const std::string &filename) const
+{
+    std::shared_ptr<const Root> root = findRoot(directory);
+    // Not a hot update storage
+    if (!root)
+        return true;
+
+    std::string relative;
+    relative.reserve(directory.size() - root->root.size() + filename.size());
+    relative.append(directory, root->root.size(), std::string::npos);
+    relative.append(filename);
+    return root->mayContain(relative);
+}
+
+NS_CC_EXT_END
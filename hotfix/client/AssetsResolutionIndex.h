@@ -0,0 +1,113 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsResolutionIndex__
+#define __AssetsResolutionIndex__
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+
+NS_CC_EXT_BEGIN
+
+class AssetsPackStorage;
+
+/**
+ * @brief   Process wide index of the files present in hot update storages.
+ *          Each AssetsManagerEx publishes the files of its storage, known from its manifests,
+ *          and HotUpdateFileUtils asks the index before probing a storage directory on disk,
+ *          so the common miss of a file that was never hot updated costs a hash lookup instead of a stat.
+ *          Lookups are lock-free and may come from any thread, a manager replaces its whole entry at once.
+ */
+class CC_EX_DLL AssetsResolutionIndex
+{
+public:
+
+    //! Files known under one storage root
+    struct Root
+    {
+        //! Storage path, with the trailing slash
+        std::string root;
+        //! Paths of the present files relative to root
+        std::unordered_set<std::string> paths;
+        //! Directories relative to root whose content isn't listed, e.g. extracted archives, always probed
+        std::vector<std::string> probeDirs;
+        //! Packs holding the files of the storage, see AssetsManagerExEnv::packStorage
+        std::shared_ptr<AssetsPackStorage> packs;
+
+        /** @brief Whether the file at relative path has to be looked for, in the packs or on disk
+         */
+        bool mayContain(const std::string &relative) const;
+    };
+
+    static AssetsResolutionIndex* getInstance();
+
+    /** @brief Enable the index, done by HotUpdateFileUtils when it's installed.
+     *         Managers only maintain their entry while the index is enabled.
+     */
+    void setEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_release); }
+
+    bool isEnabled() const { return _enabled.load(std::memory_order_acquire); }
+
+    /** @brief Publish the files of a storage, replacing those published before for the same root
+     */
+    void setRoot(std::shared_ptr<const Root> root);
+
+    void removeRoot(const std::string &root);
+
+    /** @brief Files currently published for a storage, nullptr if none
+     */
+    std::shared_ptr<const Root> getRoot(const std::string &root) const;
+
+    /** @brief Published storage containing path, nullptr if none or the index isn't enabled
+     */
+    std::shared_ptr<const Root> findRoot(const std::string &path) const;
+
+    /** @brief Whether directory + filename has to be probed on disk.
+     *         false only when directory is in an indexed storage and the file isn't known there.
+     */
+    bool mayExist(const std::string &directory, const std::string &filename) const;
+
+private:
+    typedef std::vector<std::shared_ptr<const Root>> Snapshot;
+
+    AssetsResolutionIndex();
+
+    std::atomic<bool> _enabled;
+
+    //! Read with std::atomic_load, replaced with std::atomic_store under _writeLock
+    std::shared_ptr<const Snapshot> _snapshot;
+
+    //! Serializes writers, readers never take it
+    std::atomic_flag _writeLock;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsResolutionIndex__) */
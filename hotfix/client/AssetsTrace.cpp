@@ -0,0 +1,483 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsTrace.h"
+#include "base/ccUTF8.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+
+NS_CC_EXT_BEGIN
+
+// Trace lines, fields separated by tabs, times in microseconds since the recorder was created:
+//   <time> task <identifier> <url>
+//   <time> progress <identifier> <bytesReceived> <totalBytesReceived> <totalBytesExpected>
+//   <time> success <identifier> <file in FILES_DIRNAME, empty if it couldn't be copied>
+//   <time> error <identifier> <errorCode> <errorCodeInternal> <message>
+//   <time> cancel
+#define TRACE_HEADER "# AssetsTrace 1"
+
+static std::string escapeField(const std::string &value)
+{
+    std::string escaped = value;
+    for (auto &c : escaped)
+    {
+        if (c == '\t' || c == '\n' || c == '\r')
+            c = ' ';
+    }
+    return escaped;
+}
+
+static int64_t toMicros(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+// Implementation of AssetsTraceRecorder
+
+const char* const AssetsTraceRecorder::TRACE_FILENAME = "trace.log";
+
+const char* const AssetsTraceRecorder::FILES_DIRNAME = "files/";
+
+AssetsTraceRecorder::AssetsTraceRecorder(const std::shared_ptr<IAssetsDownloader> &downloader, const std::string &traceDir, FileUtils *fileUtils)
+: _downloader(downloader)
+, _fileUtils(fileUtils ? fileUtils : FileUtils::getInstance())
+, _traceDir(traceDir)
+, _file(nullptr)
+, _startTime(std::chrono::steady_clock::now())
+, _fileCount(0)
+{
+    _fileUtils->removeDirectory(_traceDir);
+    _fileUtils->createDirectory(_traceDir + FILES_DIRNAME);
+    _file = fopen(_fileUtils->getSuitableFOpen(_traceDir + TRACE_FILENAME).c_str(), "wb");
+    if (!_file)
+    {
+        CCLOGERROR("AssetsTraceRecorder : Fail to create the trace in %s", _traceDir.c_str());
+    }
+    writeLine(TRACE_HEADER);
+
+    // Times are taken before forwarding, so the manager's handling isn't counted as network time
+    _downloader->onTaskProgress = [this](const network::DownloadTask& task,
+                                         int64_t bytesReceived,
+                                         int64_t totalBytesReceived,
+                                         int64_t totalBytesExpected)
+    {
+        writeLine(StringUtils::format("%lld\tprogress\t%s\t%lld\t%lld\t%lld", (long long)elapsed(), escapeField(task.identifier).c_str(),
+                                      (long long)bytesReceived, (long long)totalBytesReceived, (long long)totalBytesExpected));
+        if (onTaskProgress)
+            onTaskProgress(task, bytesReceived, totalBytesReceived, totalBytesExpected);
+    };
+    _downloader->onFileTaskSuccess = [this](const network::DownloadTask& task)
+    {
+        int64_t time = elapsed();
+        std::string fileName = StringUtils::format("%d", _fileCount++);
+        std::string content;
+        ResizableBufferAdapter<std::string> adapter(&content);
+        if (_fileUtils->getContents(task.storagePath, &adapter) != FileUtils::Status::OK
+            || !_fileUtils->writeStringToFile(content, _traceDir + FILES_DIRNAME + fileName))
+        {
+            CCLOGERROR("AssetsTraceRecorder : Fail to copy %s into the trace", task.storagePath.c_str());
+            fileName.clear();
+        }
+        writeLine(StringUtils::format("%lld\tsuccess\t%s\t%s", (long long)time, escapeField(task.identifier).c_str(), fileName.c_str()));
+        if (onFileTaskSuccess)
+            onFileTaskSuccess(task);
+    };
+    _downloader->onTaskError = [this](const network::DownloadTask& task,
+                                      int errorCode,
+                                      int errorCodeInternal,
+                                      const std::string& errorStr)
+    {
+        writeLine(StringUtils::format("%lld\terror\t%s\t%d\t%d\t%s", (long long)elapsed(), escapeField(task.identifier).c_str(),
+                                      errorCode, errorCodeInternal, escapeField(errorStr).c_str()));
+        if (onTaskError)
+            onTaskError(task, errorCode, errorCodeInternal, errorStr);
+    };
+}
+
+AssetsTraceRecorder::~AssetsTraceRecorder()
+{
+    _downloader->onTaskError = (nullptr);
+    _downloader->onFileTaskSuccess = (nullptr);
+    _downloader->onTaskProgress = (nullptr);
+    if (_file)
+    {
+        fclose(_file);
+    }
+}
+
+int64_t AssetsTraceRecorder::elapsed() const
+{
+    return toMicros(std::chrono::steady_clock::now() - _startTime);
+}
+
+void AssetsTraceRecorder::writeLine(const std::string &line)
+{
+    if (!_file)
+        return;
+    fputs(line.c_str(), _file);
+    fputc('\n', _file);
+}
+
+void AssetsTraceRecorder::flush()
+{
+    if (_file)
+    {
+        fflush(_file);
+    }
+}
+
+void AssetsTraceRecorder::createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier)
+{
+    writeLine(StringUtils::format("%lld\ttask\t%s\t%s", (long long)elapsed(), escapeField(identifier).c_str(), escapeField(srcUrl).c_str()));
+    _downloader->createDownloadFileTask(srcUrl, storagePath, identifier);
+}
+
+void AssetsTraceRecorder::cancelAll()
+{
+    writeLine(StringUtils::format("%lld\tcancel", (long long)elapsed()));
+    _downloader->cancelAll();
+}
+
+// Implementation of AssetsTraceReplayer
+
+double AssetsTraceReplayer::Report::totalHandlerSeconds() const
+{
+    double total = 0;
+    for (int i = 0; i < (int)Phase::COUNT; ++i)
+    {
+        total += handlerSeconds[i];
+    }
+    return total;
+}
+
+AssetsTraceReplayer::AssetsTraceReplayer(const std::string &traceDir, FileUtils *fileUtils)
+: _fileUtils(fileUtils ? fileUtils : FileUtils::getInstance())
+, _traceDir(traceDir)
+, _loaded(false)
+, _recordedMicros(0)
+, _sequence(0)
+, _virtualTime(0)
+, _inHandler(false)
+, _schedulerTime(0)
+, _report(nullptr)
+{
+    _loaded = load();
+    if (!_loaded)
+    {
+        CCLOGERROR("AssetsTraceReplayer : No trace in %s", _traceDir.c_str());
+    }
+}
+
+bool AssetsTraceReplayer::load()
+{
+    std::string content = _fileUtils->getStringFromFile(_traceDir + AssetsTraceRecorder::TRACE_FILENAME);
+    if (content.compare(0, sizeof(TRACE_HEADER) - 1, TRACE_HEADER) != 0)
+        return false;
+
+    // Attempt each identifier is in, with the time it started
+    std::unordered_map<std::string, std::pair<int64_t, std::shared_ptr<Attempt>>> open;
+    std::vector<std::string> fields;
+    int64_t first = -1, last = 0;
+    size_t lineStart = 0;
+    while (lineStart < content.size())
+    {
+        size_t lineEnd = content.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            lineEnd = content.size();
+        fields.clear();
+        if (content[lineStart] != '#')
+        {
+            size_t fieldStart = lineStart;
+            while (fieldStart <= lineEnd)
+            {
+                size_t fieldEnd = content.find('\t', fieldStart);
+                if (fieldEnd == std::string::npos || fieldEnd > lineEnd)
+                    fieldEnd = lineEnd;
+                fields.push_back(content.substr(fieldStart, fieldEnd - fieldStart));
+                fieldStart = fieldEnd + 1;
+            }
+        }
+        lineStart = lineEnd + 1;
+        if (fields.size() < 2)
+            continue;
+
+        int64_t time = strtoll(fields[0].c_str(), nullptr, 10);
+        if (first < 0)
+            first = time;
+        last = time;
+        const std::string &type = fields[1];
+        if (type == "cancel")
+        {
+            open.clear();
+            continue;
+        }
+        if (fields.size() < 3)
+            continue;
+        const std::string &identifier = fields[2];
+        if (type == "task")
+        {
+            auto attempt = std::make_shared<Attempt>();
+            _attempts[identifier].push_back(attempt);
+            open[identifier] = std::make_pair(time, attempt);
+            continue;
+        }
+
+        auto it = open.find(identifier);
+        if (it == open.end())
+            continue;
+        RecordedEvent event;
+        event.offset = time - it->second.first;
+        event.bytesReceived = event.totalBytesReceived = event.totalBytesExpected = 0;
+        event.errorCode = event.errorCodeInternal = 0;
+        if (type == "progress" && fields.size() >= 6)
+        {
+            event.phase = Phase::PROGRESS;
+            event.bytesReceived = strtoll(fields[3].c_str(), nullptr, 10);
+            event.totalBytesReceived = strtoll(fields[4].c_str(), nullptr, 10);
+            event.totalBytesExpected = strtoll(fields[5].c_str(), nullptr, 10);
+        }
+        else if (type == "success")
+        {
+            event.phase = Phase::SUCCEEDED;
+            if (fields.size() >= 4)
+                event.text = fields[3];
+        }
+        else if (type == "error" && fields.size() >= 5)
+        {
+            event.phase = Phase::FAILED;
+            event.errorCode = atoi(fields[3].c_str());
+            event.errorCodeInternal = atoi(fields[4].c_str());
+            if (fields.size() >= 6)
+                event.text = fields[5];
+        }
+        else
+        {
+            continue;
+        }
+        it->second.second->events.push_back(event);
+        if (event.phase != Phase::PROGRESS)
+        {
+            it->second.second->finished = true;
+            open.erase(it);
+        }
+    }
+    _recordedMicros = first < 0 ? 0 : last - first;
+    return true;
+}
+
+int64_t AssetsTraceReplayer::now() const
+{
+    if (!_inHandler)
+        return _virtualTime;
+    return _virtualTime + toMicros(std::chrono::steady_clock::now() - _handlerStart);
+}
+
+void AssetsTraceReplayer::createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier)
+{
+    RunningTask running;
+    running.task.identifier = identifier;
+    running.task.requestURL = srcUrl;
+    running.task.storagePath = storagePath;
+    auto it = _attempts.find(identifier);
+    if (it != _attempts.end() && !it->second.empty())
+    {
+        running.attempt = it->second.front();
+        it->second.pop_front();
+    }
+    if (_report)
+    {
+        _report->tasks++;
+        if (!running.attempt)
+            _report->unmatchedTasks++;
+        else if (!running.attempt->finished)
+            _report->unfinishedTasks++;
+    }
+    if (!running.attempt)
+    {
+        // The session diverged from the recorded one, fail like a task the server doesn't know
+        RecordedEvent event;
+        event.offset = 0;
+        event.phase = Phase::FAILED;
+        event.bytesReceived = event.totalBytesReceived = event.totalBytesExpected = 0;
+        event.errorCode = network::DownloadTask::ERROR_IMPL_INTERNAL;
+        event.errorCodeInternal = 0;
+        event.text = "Task not in the trace";
+        running.attempt = std::make_shared<Attempt>();
+        running.attempt->events.push_back(event);
+        running.attempt->finished = true;
+    }
+
+    size_t index = _tasks.size();
+    _tasks.push_back(std::move(running));
+    int64_t start = now();
+    const auto &events = _tasks[index].attempt->events;
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        schedule(index, i, start + events[i].offset);
+    }
+}
+
+void AssetsTraceReplayer::cancelAll()
+{
+    // Tasks cancelled while recording stay unfinished, like running ones here
+    _events = decltype(_events)();
+}
+
+void AssetsTraceReplayer::schedule(size_t task, size_t event, int64_t time)
+{
+    ScheduledEvent scheduled;
+    scheduled.time = time;
+    scheduled.sequence = _sequence++;
+    scheduled.task = task;
+    scheduled.event = event;
+    _events.push(scheduled);
+}
+
+void AssetsTraceReplayer::measure(Phase phase, const std::function<void()> &handler)
+{
+    _handlerStart = std::chrono::steady_clock::now();
+    _inHandler = true;
+    handler();
+    int64_t spent = toMicros(std::chrono::steady_clock::now() - _handlerStart);
+    _inHandler = false;
+    // The manager's time delays everything it does next, like on the device
+    _virtualTime += spent;
+    if (_report)
+    {
+        _report->handlerSeconds[(int)phase] += spent / 1000000.0;
+        _report->calls[(int)phase]++;
+    }
+}
+
+void AssetsTraceReplayer::advance(int64_t time)
+{
+    if (time > _virtualTime)
+    {
+        _virtualTime = time;
+    }
+    if (!_scheduler)
+        return;
+    // The manager's time since the last update counts too, the scheduler clock follows the virtual one
+    float dt = (_virtualTime - _schedulerTime) / 1000000.0f;
+    _schedulerTime = _virtualTime;
+    measure(Phase::SCHEDULED, [this, dt]() {
+        _scheduler->update(dt);
+    });
+}
+
+void AssetsTraceReplayer::deliver(const ScheduledEvent &scheduled)
+{
+    // Copied, handlers may start tasks and grow _tasks
+    network::DownloadTask task = _tasks[scheduled.task].task;
+    std::shared_ptr<Attempt> attempt = _tasks[scheduled.task].attempt;
+    const RecordedEvent &event = attempt->events[scheduled.event];
+    switch (event.phase)
+    {
+        case Phase::PROGRESS:
+            if (onTaskProgress)
+            {
+                measure(Phase::PROGRESS, [&]() {
+                    onTaskProgress(task, event.bytesReceived, event.totalBytesReceived, event.totalBytesExpected);
+                });
+            }
+            break;
+        case Phase::SUCCEEDED:
+        {
+            // Stands for the downloader writing the file, not counted as the manager's time
+            std::string content;
+            ResizableBufferAdapter<std::string> adapter(&content);
+            bool copied = !event.text.empty()
+                && _fileUtils->getContents(_traceDir + AssetsTraceRecorder::FILES_DIRNAME + event.text, &adapter) == FileUtils::Status::OK
+                && _fileUtils->writeStringToFile(content, task.storagePath);
+            if (copied && onFileTaskSuccess)
+            {
+                measure(Phase::SUCCEEDED, [&]() {
+                    onFileTaskSuccess(task);
+                });
+            }
+            else if (!copied && onTaskError)
+            {
+                measure(Phase::FAILED, [&]() {
+                    onTaskError(task, network::DownloadTask::ERROR_FILE_OP_FAILED, 0, "Downloaded content not in the trace");
+                });
+            }
+        }
+            break;
+        case Phase::FAILED:
+            if (onTaskError)
+            {
+                measure(Phase::FAILED, [&]() {
+                    onTaskError(task, event.errorCode, event.errorCodeInternal, event.text);
+                });
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void AssetsTraceReplayer::run(const std::function<void()> &start, Report *report)
+{
+    *report = Report();
+    report->recordedSeconds = _recordedMicros / 1000000.0;
+    _report = report;
+    int64_t begin = _virtualTime;
+
+    _schedulerTime = _virtualTime;
+    measure(Phase::START, start);
+    while (true)
+    {
+        int64_t next = _events.empty() ? -1 : _events.top().time;
+        if (_scheduler)
+        {
+            // A timer due before the next callback goes first, at least a microsecond later so time moves on
+            float delay = _scheduler->getNextDelay();
+            int64_t due = delay < 0 ? -1 : _schedulerTime + std::max((int64_t)1, (int64_t)std::ceil(delay * 1000000.0));
+            if (due >= 0 && (next < 0 || due < next))
+            {
+                advance(due);
+                continue;
+            }
+            if (next < 0 && _scheduler->hasPendingFunctions())
+            {
+                advance(_virtualTime);
+                continue;
+            }
+        }
+        if (next < 0)
+            break;
+
+        ScheduledEvent scheduled = _events.top();
+        _events.pop();
+        advance(scheduled.time);
+        deliver(scheduled);
+    }
+
+    report->replayedSeconds = (_virtualTime - begin) / 1000000.0;
+    _report = nullptr;
+    _tasks.clear();
+}
+
+NS_CC_EXT_END
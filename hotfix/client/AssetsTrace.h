@@ -0,0 +1,250 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsTrace__
+#define __AssetsTrace__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AssetsManagerExEnv.h"
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   IAssetsDownloader recording the tasks and callbacks of another downloader, with their time,
+ *          into a trace directory that AssetsTraceReplayer replays. Each downloaded file is copied into
+ *          the trace, so the replayed session parses, verifies and decompresses the same content.
+ *          Set it as AssetsManagerExEnv::downloader over the real one.
+ */
+class CC_EX_DLL AssetsTraceRecorder : public IAssetsDownloader
+{
+public:
+    static const char* const TRACE_FILENAME;
+
+    static const char* const FILES_DIRNAME;
+
+    /**
+     @param downloader  Downloader doing the work, its callbacks are taken over
+     @param traceDir    Directory of the trace, with a trailing slash, replaced if it exists
+     @param fileUtils   File system of the manager, FileUtils::getInstance() if nullptr
+     */
+    AssetsTraceRecorder(const std::shared_ptr<IAssetsDownloader> &downloader, const std::string &traceDir, FileUtils *fileUtils = nullptr);
+
+    virtual ~AssetsTraceRecorder();
+
+    virtual void createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier) override;
+
+    virtual void cancelAll() override;
+
+    /** @brief Write what is buffered to the trace file, it's also done on destruction
+     */
+    void flush();
+
+    bool isRecording() const { return _file != nullptr; }
+
+protected:
+    //! Microseconds since the recorder was created
+    int64_t elapsed() const;
+
+    //! Write one trace line, fields separated by tabs
+    void writeLine(const std::string &line);
+
+    std::shared_ptr<IAssetsDownloader> _downloader;
+    FileUtils *_fileUtils;
+    std::string _traceDir;
+    FILE *_file;
+    std::chrono::steady_clock::time_point _startTime;
+    //! Number of files copied into the trace
+    int _fileCount;
+};
+
+/**
+ * @brief   IAssetsDownloader replaying a trace of AssetsTraceRecorder on a virtual clock, without network.
+ *          A task the manager starts is matched to the next recorded attempt of the same identifier, and its
+ *          recorded callbacks are replayed at the same offsets from the start of the task. The time the manager
+ *          spends handling each callback is measured and added to the virtual clock, so a policy change shows up
+ *          as a different replayed duration of the same session.
+ *          run() drives everything from the calling thread. Give the manager a headless AssetsManagerExEnv with
+ *          this replayer as downloader, an InlineTaskRunner so that decompression is measured too, and the
+ *          ManualAssetsScheduler given to setScheduler, without the worker thread. The scheduler is updated on
+ *          the virtual clock, so scheduled work like the deferred download budget is replayed in virtual time.
+ */
+class CC_EX_DLL AssetsTraceReplayer : public IAssetsDownloader
+{
+public:
+
+    //! What the manager was handling
+    enum class Phase
+    {
+        //! The start function given to run(), update() usually
+        START,
+        PROGRESS,
+        SUCCEEDED,
+        FAILED,
+        //! Timers and performed functions of the scheduler, see setScheduler
+        SCHEDULED,
+        COUNT
+    };
+
+    struct Report
+    {
+        //! From the first to the last line of the trace
+        double recordedSeconds;
+        //! Virtual time when the last callback was handled
+        double replayedSeconds;
+        //! Time the manager spent handling each phase, real time on this device
+        double handlerSeconds[(int)Phase::COUNT];
+        //! Number of calls of each phase
+        uint64_t calls[(int)Phase::COUNT];
+        //! Tasks started by the manager
+        size_t tasks;
+        //! Tasks without a recorded attempt left, replayed as errors
+        size_t unmatchedTasks;
+        //! Tasks whose recorded attempt has no end, cancelled while recording
+        size_t unfinishedTasks;
+
+        double totalHandlerSeconds() const;
+    };
+
+    /**
+     @param traceDir    Directory written by AssetsTraceRecorder, with a trailing slash
+     @param fileUtils   File system of the manager, FileUtils::getInstance() if nullptr
+     */
+    AssetsTraceReplayer(const std::string &traceDir, FileUtils *fileUtils = nullptr);
+
+    /** @brief Whether the trace was read, a replayer without a trace fails every task
+     */
+    bool isLoaded() const { return _loaded; }
+
+    virtual void createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier) override;
+
+    virtual void cancelAll() override;
+
+    /** @brief Update this scheduler on the virtual clock while replaying, set it as AssetsManagerExEnv::scheduler
+     */
+    void setScheduler(const std::shared_ptr<ManualAssetsScheduler> &scheduler) { _scheduler = scheduler; }
+
+    /** @brief Call start, then replay the callbacks of the started tasks and the timers of the scheduler
+     *         in virtual time order until none is left.
+     *         May be called again for another session of the same trace, attempts already replayed are skipped.
+     */
+    void run(const std::function<void()> &start, Report *report);
+
+    /** @brief Current virtual time in microseconds
+     */
+    int64_t now() const;
+
+protected:
+
+    struct RecordedEvent
+    {
+        //! Microseconds from the start of the attempt
+        int64_t offset;
+        Phase phase;
+        int64_t bytesReceived;
+        int64_t totalBytesReceived;
+        int64_t totalBytesExpected;
+        int errorCode;
+        int errorCodeInternal;
+        //! Error message, or file of the trace with the downloaded content
+        std::string text;
+    };
+
+    //! One recorded task and its callbacks
+    struct Attempt
+    {
+        std::vector<RecordedEvent> events;
+        bool finished = false;
+    };
+
+    struct ScheduledEvent
+    {
+        int64_t time;
+        uint64_t sequence;
+        //! Index in _tasks
+        size_t task;
+        size_t event;
+
+        bool operator>(const ScheduledEvent &other) const
+        {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    struct RunningTask
+    {
+        network::DownloadTask task;
+        std::shared_ptr<Attempt> attempt;
+    };
+
+    bool load();
+
+    void schedule(size_t task, size_t event, int64_t time);
+
+    void deliver(const ScheduledEvent &scheduled);
+
+    void measure(Phase phase, const std::function<void()> &handler);
+
+    /** @brief Move the virtual clock to time, if it's behind, and update the scheduler up to it
+     */
+    void advance(int64_t time);
+
+    FileUtils *_fileUtils;
+    std::string _traceDir;
+    bool _loaded;
+
+    //! Attempts not replayed yet, by identifier, in recorded order
+    std::unordered_map<std::string, std::deque<std::shared_ptr<Attempt>>> _attempts;
+    int64_t _recordedMicros;
+
+    std::vector<RunningTask> _tasks;
+    std::priority_queue<ScheduledEvent, std::vector<ScheduledEvent>, std::greater<ScheduledEvent>> _events;
+    uint64_t _sequence;
+
+    //! Virtual time when the current handler was called, and the real time it was
+    int64_t _virtualTime;
+    std::chrono::steady_clock::time_point _handlerStart;
+    bool _inHandler;
+
+    std::shared_ptr<ManualAssetsScheduler> _scheduler;
+    //! Virtual time the scheduler was last updated to
+    int64_t _schedulerTime;
+
+    Report *_report;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsTrace__) */
@@ -0,0 +1,261 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsUpdateMetrics.h"
+#include "json/stringbuffer.h"
+#include "json/writer.h"
+
+NS_CC_EXT_BEGIN
+
+// Implementation of AssetsMetricsHistogram
+
+AssetsMetricsHistogram::AssetsMetricsHistogram()
+{
+    reset();
+}
+
+void AssetsMetricsHistogram::record(uint64_t value)
+{
+    int bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && (value >> bucket) != 0)
+    {
+        ++bucket;
+    }
+    _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void AssetsMetricsHistogram::snapshot(Snapshot *snapshot) const
+{
+    snapshot->count = _count.load(std::memory_order_relaxed);
+    snapshot->sum = _sum.load(std::memory_order_relaxed);
+    snapshot->max = _max.load(std::memory_order_relaxed);
+    for (int i = 0; i < BUCKET_COUNT; ++i)
+    {
+        snapshot->buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+void AssetsMetricsHistogram::reset()
+{
+    for (auto &bucket : _buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t AssetsMetricsHistogram::Snapshot::quantile(double q) const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i)
+    {
+        total += buckets[i];
+    }
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(q * total + 0.5);
+    rank = rank < 1 ? 1 : (rank > total ? total : rank);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT - 1; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t upper = i == 0 ? 0 : ((uint64_t)1 << i) - 1;
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+// Implementation of AssetsUpdateMetrics
+
+AssetsUpdateMetrics::AssetsUpdateMetrics()
+{
+    reset();
+}
+
+const char* AssetsUpdateMetrics::errorCategoryName(ErrorCategory category)
+{
+    switch (category)
+    {
+        case ErrorCategory::NETWORK:
+            return "network";
+        case ErrorCategory::VERIFY:
+            return "verify";
+        case ErrorCategory::DECOMPRESS:
+            return "decompress";
+        case ErrorCategory::MANIFEST:
+            return "manifest";
+        case ErrorCategory::STORAGE:
+            return "storage";
+        default:
+            return "";
+    }
+}
+
+void AssetsUpdateMetrics::recordDownload(uint64_t bytes, uint64_t latencyMicros)
+{
+    _bytesDownloaded.fetch_add(bytes, std::memory_order_relaxed);
+    _filesDownloaded.fetch_add(1, std::memory_order_relaxed);
+    _downloadSize.record(bytes);
+    _downloadLatency.record(latencyMicros);
+}
+
+void AssetsUpdateMetrics::recordUpdate(bool succeeded, uint64_t millis)
+{
+    if (succeeded)
+    {
+        _updatesFinished.fetch_add(1, std::memory_order_relaxed);
+        _updateTime.record(millis);
+    }
+    else
+    {
+        _updatesFailed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void AssetsUpdateMetrics::snapshot(Snapshot *snapshot) const
+{
+    snapshot->bytesDownloaded = _bytesDownloaded.load(std::memory_order_relaxed);
+    snapshot->filesDownloaded = _filesDownloaded.load(std::memory_order_relaxed);
+    snapshot->retries = _retries.load(std::memory_order_relaxed);
+    for (int i = 0; i < (int)ErrorCategory::COUNT; ++i)
+    {
+        snapshot->errors[i] = _errors[i].load(std::memory_order_relaxed);
+    }
+    snapshot->updatesFinished = _updatesFinished.load(std::memory_order_relaxed);
+    snapshot->updatesFailed = _updatesFailed.load(std::memory_order_relaxed);
+    snapshot->transferSeconds = _transferMicros.load(std::memory_order_relaxed) / 1000000.0;
+    snapshot->bytesPerSecond = snapshot->transferSeconds > 0 ? snapshot->bytesDownloaded / snapshot->transferSeconds : 0;
+    _downloadLatency.snapshot(&snapshot->downloadLatency);
+    _downloadSize.snapshot(&snapshot->downloadSize);
+    _verifyTime.snapshot(&snapshot->verifyTime);
+    _decompressTime.snapshot(&snapshot->decompressTime);
+    _concurrency.snapshot(&snapshot->concurrency);
+    _updateTime.snapshot(&snapshot->updateTime);
+}
+
+static void writeHistogram(rapidjson::Writer<rapidjson::StringBuffer> &writer, const char *name, const AssetsMetricsHistogram::Snapshot &histogram)
+{
+    writer.Key(name);
+    writer.StartObject();
+    writer.Key("count");
+    writer.Uint64(histogram.count);
+    writer.Key("sum");
+    writer.Uint64(histogram.sum);
+    writer.Key("max");
+    writer.Uint64(histogram.max);
+    writer.Key("mean");
+    writer.Double(histogram.mean());
+    writer.Key("p50");
+    writer.Uint64(histogram.quantile(0.5));
+    writer.Key("p90");
+    writer.Uint64(histogram.quantile(0.9));
+    writer.Key("p99");
+    writer.Uint64(histogram.quantile(0.99));
+    int used = AssetsMetricsHistogram::BUCKET_COUNT;
+    while (used > 0 && histogram.buckets[used - 1] == 0)
+    {
+        --used;
+    }
+    writer.Key("buckets");
+    writer.StartArray();
+    for (int i = 0; i < used; ++i)
+    {
+        writer.Uint64(histogram.buckets[i]);
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+
+std::string AssetsUpdateMetrics::toJson() const
+{
+    Snapshot current;
+    snapshot(&current);
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("bytesDownloaded");
+    writer.Uint64(current.bytesDownloaded);
+    writer.Key("filesDownloaded");
+    writer.Uint64(current.filesDownloaded);
+    writer.Key("retries");
+    writer.Uint64(current.retries);
+    writer.Key("updatesFinished");
+    writer.Uint64(current.updatesFinished);
+    writer.Key("updatesFailed");
+    writer.Uint64(current.updatesFailed);
+    writer.Key("transferSeconds");
+    writer.Double(current.transferSeconds);
+    writer.Key("bytesPerSecond");
+    writer.Double(current.bytesPerSecond);
+    writer.Key("errors");
+    writer.StartObject();
+    for (int i = 0; i < (int)ErrorCategory::COUNT; ++i)
+    {
+        writer.Key(errorCategoryName((ErrorCategory)i));
+        writer.Uint64(current.errors[i]);
+    }
+    writer.EndObject();
+    writeHistogram(writer, "downloadLatencyUs", current.downloadLatency);
+    writeHistogram(writer, "downloadSizeBytes", current.downloadSize);
+    writeHistogram(writer, "verifyTimeUs", current.verifyTime);
+    writeHistogram(writer, "decompressTimeUs", current.decompressTime);
+    writeHistogram(writer, "concurrency", current.concurrency);
+    writeHistogram(writer, "updateTimeMs", current.updateTime);
+    writer.EndObject();
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+void AssetsUpdateMetrics::reset()
+{
+    _bytesDownloaded.store(0, std::memory_order_relaxed);
+    _filesDownloaded.store(0, std::memory_order_relaxed);
+    _retries.store(0, std::memory_order_relaxed);
+    for (auto &errors : _errors)
+    {
+        errors.store(0, std::memory_order_relaxed);
+    }
+    _updatesFinished.store(0, std::memory_order_relaxed);
+    _updatesFailed.store(0, std::memory_order_relaxed);
+    _transferMicros.store(0, std::memory_order_relaxed);
+    _downloadLatency.reset();
+    _downloadSize.reset();
+    _verifyTime.reset();
+    _decompressTime.reset();
+    _concurrency.reset();
+    _updateTime.reset();
+}
+
+NS_CC_EXT_END
@@ -0,0 +1,183 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsUpdateMetrics__
+#define __AssetsUpdateMetrics__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   Histogram with fixed power of two buckets, recorded from any thread without locks.
+ *          Bucket 0 counts the zeros, bucket i > 0 the values in [2^(i-1), 2^i), the last one everything above.
+ */
+class CC_EX_DLL AssetsMetricsHistogram
+{
+public:
+    static const int BUCKET_COUNT = 40;
+
+    struct Snapshot
+    {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+        uint64_t buckets[BUCKET_COUNT];
+
+        double mean() const { return count > 0 ? (double)sum / count : 0; }
+
+        /** @brief Upper bound of the bucket holding the q quantile, capped by max
+         @param q   Between 0 and 1, 0.99 for p99
+         */
+        uint64_t quantile(double q) const;
+    };
+
+    AssetsMetricsHistogram();
+
+    void record(uint64_t value);
+
+    /** @brief Read all buckets, values recorded meanwhile may be missing from some fields
+     */
+    void snapshot(Snapshot *snapshot) const;
+
+    void reset();
+
+private:
+    std::atomic<uint64_t> _buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _max;
+};
+
+/**
+ * @brief   Runtime counters of an AssetsManagerEx: bytes, files, retries and errors by category,
+ *          with histograms of the download latencies, sizes, verify and decompress times and concurrency.
+ *          Recorded with relaxed atomics by the thread running the update and the background tasks,
+ *          a snapshot or its json can be taken from any thread at any time.
+ */
+class CC_EX_DLL AssetsUpdateMetrics
+{
+public:
+
+    enum class ErrorCategory
+    {
+        //! Download of an asset failed
+        NETWORK,
+        //! Downloaded asset rejected by the verify callback
+        VERIFY,
+        //! Downloaded archive couldn't be decompressed
+        DECOMPRESS,
+        //! Version or manifest missing, not downloaded or not parsed
+        MANIFEST,
+        //! Update downloaded but the pack storage or the staging couldn't be written
+        STORAGE,
+        COUNT
+    };
+
+    struct Snapshot
+    {
+        uint64_t bytesDownloaded;
+        uint64_t filesDownloaded;
+        //! Failed assets downloaded again by downloadFailedAssets
+        uint64_t retries;
+        uint64_t errors[(int)ErrorCategory::COUNT];
+        //! Updates finished or staged, repairs excluded
+        uint64_t updatesFinished;
+        uint64_t updatesFailed;
+        //! Seconds during which at least one asset download was running
+        double transferSeconds;
+        //! bytesDownloaded over transferSeconds
+        double bytesPerSecond;
+        //! Microseconds from the task given to the downloader to the downloaded file, per asset
+        AssetsMetricsHistogram::Snapshot downloadLatency;
+        //! Bytes per downloaded asset
+        AssetsMetricsHistogram::Snapshot downloadSize;
+        //! Microseconds per verify callback call
+        AssetsMetricsHistogram::Snapshot verifyTime;
+        //! Microseconds per decompressed archive
+        AssetsMetricsHistogram::Snapshot decompressTime;
+        //! Asset downloads running when one starts, itself included
+        AssetsMetricsHistogram::Snapshot concurrency;
+        //! Milliseconds from update() to UPDATE_FINISHED or UPDATE_STAGED
+        AssetsMetricsHistogram::Snapshot updateTime;
+    };
+
+    AssetsUpdateMetrics();
+
+    static const char* errorCategoryName(ErrorCategory category);
+
+    void snapshot(Snapshot *snapshot) const;
+
+    /** @brief Snapshot as a json object, histograms with their count, sum, max, mean, p50, p90, p99
+     *         and their buckets up to the last non empty one
+     */
+    std::string toJson() const;
+
+    /** @brief Zero everything, values recorded meanwhile may be partly kept
+     */
+    void reset();
+
+    void recordDownload(uint64_t bytes, uint64_t latencyMicros);
+
+    void recordTransferTime(uint64_t micros) { _transferMicros.fetch_add(micros, std::memory_order_relaxed); }
+
+    void recordConcurrency(int running) { _concurrency.record(running > 0 ? running : 0); }
+
+    void recordVerify(uint64_t micros) { _verifyTime.record(micros); }
+
+    void recordDecompress(uint64_t micros) { _decompressTime.record(micros); }
+
+    void recordRetries(uint64_t count) { _retries.fetch_add(count, std::memory_order_relaxed); }
+
+    void recordError(ErrorCategory category) { _errors[(int)category].fetch_add(1, std::memory_order_relaxed); }
+
+    /** @param millis  Duration of the update, only for succeeded ones
+     */
+    void recordUpdate(bool succeeded, uint64_t millis = 0);
+
+private:
+    std::atomic<uint64_t> _bytesDownloaded;
+    std::atomic<uint64_t> _filesDownloaded;
+    std::atomic<uint64_t> _retries;
+    std::atomic<uint64_t> _errors[(int)ErrorCategory::COUNT];
+    std::atomic<uint64_t> _updatesFinished;
+    std::atomic<uint64_t> _updatesFailed;
+    std::atomic<uint64_t> _transferMicros;
+
+    AssetsMetricsHistogram _downloadLatency;
+    AssetsMetricsHistogram _downloadSize;
+    AssetsMetricsHistogram _verifyTime;
+    AssetsMetricsHistogram _decompressTime;
+    AssetsMetricsHistogram _concurrency;
+    AssetsMetricsHistogram _updateTime;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsUpdateMetrics__) */
@@ -0,0 +1,195 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "AssetsVerifyCache.h"
+#include "platform/CCPlatformConfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+NS_CC_EXT_BEGIN
+
+#define VERIFY_CACHE_HEADER "verify-cache 1"
+
+// Implementation of AssetsVerifyCache
+
+AssetsVerifyCache::AssetsVerifyCache()
+: _dirty(false)
+{
+}
+
+bool AssetsVerifyCache::statFile(const std::string &path, FileStat *stat)
+{
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32)
+    struct _stat64 info;
+    if (_stat64(path.c_str(), &info) != 0)
+        return false;
+    stat->mtime = (int64_t)info.st_mtime;
+#else
+    struct ::stat info;
+    if (::stat(path.c_str(), &info) != 0)
+        return false;
+#if defined(__APPLE__)
+    stat->mtime = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    stat->mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+    stat->size = (int64_t)info.st_size;
+    stat->inode = (uint64_t)info.st_ino;
+    return true;
+}
+
+bool AssetsVerifyCache::load(const std::string &path)
+{
+    _entries.clear();
+    _dirty = false;
+
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+    std::string content;
+    char buffer[8192];
+    size_t read = 0;
+    while ((read = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+        content.append(buffer, read);
+    }
+    fclose(fp);
+
+    // One entry per line: key, size, mtime, inode and md5 separated by tabs
+    size_t lineStart = content.find('\n');
+    if (lineStart == std::string::npos || content.compare(0, lineStart, VERIFY_CACHE_HEADER) != 0)
+    {
+        return false;
+    }
+    ++lineStart;
+    while (lineStart < content.size())
+    {
+        size_t lineEnd = content.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            break;
+        size_t keyEnd = content.find('\t', lineStart);
+        if (keyEnd != std::string::npos && keyEnd < lineEnd)
+        {
+            Entry entry;
+            char *cursor = &content[keyEnd + 1];
+            entry.stat.size = strtoll(cursor, &cursor, 10);
+            entry.stat.mtime = strtoll(cursor, &cursor, 10);
+            entry.stat.inode = strtoull(cursor, &cursor, 10);
+            if (*cursor == '\t')
+            {
+                ++cursor;
+                entry.md5.assign(cursor, &content[lineEnd] - cursor);
+                _entries.emplace(content.substr(lineStart, keyEnd - lineStart), std::move(entry));
+            }
+        }
+        lineStart = lineEnd + 1;
+    }
+    return true;
+}
+
+bool AssetsVerifyCache::save(const std::string &path)
+{
+    if (!_dirty)
+        return true;
+
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool ok = fprintf(fp, "%s\n", VERIFY_CACHE_HEADER) > 0;
+    for (const auto &it : _entries)
+    {
+        if (!ok)
+            break;
+        ok = fprintf(fp, "%s\t%lld\t%lld\t%llu\t%s\n",
+                     it.first.c_str(),
+                     (long long)it.second.stat.size,
+                     (long long)it.second.stat.mtime,
+                     (unsigned long long)it.second.stat.inode,
+                     it.second.md5.c_str()) > 0;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (ok)
+    {
+        _dirty = false;
+    }
+    return ok;
+}
+
+bool AssetsVerifyCache::isVerified(const std::string &key, const std::string &path, const std::string &md5) const
+{
+    auto it = _entries.find(key);
+    if (it == _entries.end() || it->second.md5 != md5)
+        return false;
+
+    FileStat stat;
+    if (!statFile(path, &stat))
+        return false;
+    return sameStat(stat, it->second.stat);
+}
+
+bool AssetsVerifyCache::find(const std::string &key, const std::string &md5, FileStat *stat) const
+{
+    auto it = _entries.find(key);
+    if (it == _entries.end() || it->second.md5 != md5)
+        return false;
+    *stat = it->second.stat;
+    return true;
+}
+
+void AssetsVerifyCache::markVerified(const std::string &key, const std::string &path, const std::string &md5)
+{
+    // Keys are stored one per line
+    if (key.find_first_of("\t\n") != std::string::npos)
+        return;
+
+    Entry entry;
+    if (!statFile(path, &entry.stat))
+        return;
+    entry.md5 = md5;
+    _entries[key] = std::move(entry);
+    _dirty = true;
+}
+
+void AssetsVerifyCache::remove(const std::string &key)
+{
+    if (_entries.erase(key) > 0)
+    {
+        _dirty = true;
+    }
+}
+
+void AssetsVerifyCache::clear()
+{
+    if (!_entries.empty())
+    {
+        _entries.clear();
+        _dirty = true;
+    }
+}
+
+NS_CC_EXT_END
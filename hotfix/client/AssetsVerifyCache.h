@@ -0,0 +1,114 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __AssetsVerifyCache__
+#define __AssetsVerifyCache__
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   Index of the assets already accepted by the verify callback, with the stat metadata
+ *          of their file at that time. While size, modification time and inode are unchanged the
+ *          file is trusted again for the same md5, so checking it costs one stat instead of a full read.
+ *          Entries are keyed by asset key, so they stay valid when the file is moved from the
+ *          temporary storage to the storage by a rename.
+ */
+class CC_EX_DLL AssetsVerifyCache
+{
+public:
+
+    struct FileStat
+    {
+        int64_t size;
+        //! Modification time in nanoseconds, or seconds where the platform has nothing finer
+        int64_t mtime;
+        uint64_t inode;
+    };
+
+    AssetsVerifyCache();
+
+    /** @brief stat a file
+     @param path    Path suitable for fopen, see FileUtils::getSuitableFOpen
+     */
+    static bool statFile(const std::string &path, FileStat *stat);
+
+    /** @brief Replace the content by the index file at path, a missing or broken file leaves it empty
+     */
+    bool load(const std::string &path);
+
+    /** @brief Write the index file if anything changed since the last load or save
+     */
+    bool save(const std::string &path);
+
+    /** @brief Whether the file of the asset was verified for this md5 and hasn't changed since
+     @param key     Asset key in the manifest
+     @param path    Current path of the file, suitable for fopen
+     @param md5     md5 of the asset in the manifest
+     */
+    bool isVerified(const std::string &key, const std::string &path, const std::string &md5) const;
+
+    /** @brief Stat recorded when the asset was verified for this md5, to be compared with
+     *         statFile on another thread. The cache itself isn't thread safe.
+     @return    false if the asset isn't in the cache for this md5
+     */
+    bool find(const std::string &key, const std::string &md5, FileStat *stat) const;
+
+    static bool sameStat(const FileStat &a, const FileStat &b)
+    {
+        return a.size == b.size && a.mtime == b.mtime && a.inode == b.inode;
+    }
+
+    /** @brief Record that the file of the asset was accepted by the verify callback
+     */
+    void markVerified(const std::string &key, const std::string &path, const std::string &md5);
+
+    void remove(const std::string &key);
+
+    void clear();
+
+    size_t size() const { return _entries.size(); }
+
+private:
+    struct Entry
+    {
+        FileStat stat;
+        std::string md5;
+    };
+
+    std::unordered_map<std::string, Entry> _entries;
+
+    //! Whether entries changed since the last load or save
+    bool _dirty;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__AssetsVerifyCache__) */
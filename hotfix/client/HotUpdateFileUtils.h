@@ -0,0 +1,125 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __HotUpdateFileUtils__
+#define __HotUpdateFileUtils__
+
+#include "platform/CCFileUtils.h"
+
+#include "AssetsPackStorage.h"
+#include "AssetsResolutionIndex.h"
+#include "extensions/ExtensionMacros.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   FileUtils of the platform which skips the hot update storages for files they don't contain,
+ *          according to AssetsResolutionIndex, instead of probing them on disk.
+ *          Install it at launch, before creating any AssetsManagerEx:
+ *
+ *          FileUtils::setDelegate(HotUpdateFileUtils<FileUtilsAndroid>::create());
+ *
+ *          Files written to a storage by anything but AssetsManagerEx are not found through search paths then.
+ *          It also reads the files of storages kept in packs, see AssetsManagerExEnv::packStorage.
+ */
+template <class PlatformFileUtils>
+class HotUpdateFileUtils : public PlatformFileUtils
+{
+public:
+    static HotUpdateFileUtils* create()
+    {
+        HotUpdateFileUtils *ret = new (std::nothrow) HotUpdateFileUtils();
+        if (ret && ret->init())
+        {
+            AssetsResolutionIndex::getInstance()->setEnabled(true);
+            return ret;
+        }
+        delete ret;
+        return nullptr;
+    }
+
+    using PlatformFileUtils::getContents;
+
+    virtual FileUtils::Status getContents(const std::string& filename, ResizableBuffer* buffer) override
+    {
+        std::string relative;
+        auto packs = findPacks(this->fullPathForFilename(filename), &relative);
+        if (packs && packs->read(relative, buffer))
+            return FileUtils::Status::OK;
+        return PlatformFileUtils::getContents(filename, buffer);
+    }
+
+    virtual long getFileSize(const std::string& filepath) override
+    {
+        std::string relative;
+        auto packs = findPacks(this->isAbsolutePath(filepath) ? filepath : this->fullPathForFilename(filepath), &relative);
+        int64_t size = packs ? packs->getSize(relative) : -1;
+        if (size >= 0)
+            return (long)size;
+        return PlatformFileUtils::getFileSize(filepath);
+    }
+
+protected:
+    virtual std::string getFullPathForDirectoryAndFilename(const std::string& directory, const std::string& filename) const override
+    {
+        auto root = AssetsResolutionIndex::getInstance()->findRoot(directory);
+        if (root)
+        {
+            std::string relative;
+            relative.reserve(directory.size() - root->root.size() + filename.size());
+            relative.append(directory, root->root.size(), std::string::npos);
+            relative.append(filename);
+            if (!root->mayContain(relative))
+                return "";
+            if (root->packs && root->packs->contains(relative))
+                return directory + filename;
+        }
+        return PlatformFileUtils::getFullPathForDirectoryAndFilename(directory, filename);
+    }
+
+    virtual bool isFileExistInternal(const std::string& filePath) const override
+    {
+        std::string relative;
+        auto packs = findPacks(filePath, &relative);
+        if (packs && packs->contains(relative))
+            return true;
+        return PlatformFileUtils::isFileExistInternal(filePath);
+    }
+
+private:
+    /** @brief Packs of the storage containing fullPath, with the path relative to it
+     */
+    static std::shared_ptr<AssetsPackStorage> findPacks(const std::string &fullPath, std::string *relative)
+    {
+        auto root = AssetsResolutionIndex::getInstance()->findRoot(fullPath);
+        if (!root || !root->packs)
+            return nullptr;
+        relative->assign(fullPath, root->root.size(), std::string::npos);
+        return root->packs;
+    }
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__HotUpdateFileUtils__) */
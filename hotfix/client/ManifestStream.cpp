@@ -0,0 +1,534 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+#include "ManifestStream.h"
+#include "json/filereadstream.h"
+#include "json/reader.h"
+
+NS_CC_EXT_BEGIN
+
+#define KEY_VERSION             "version"
+#define KEY_PACKAGE_URL         "packageUrl"
+#define KEY_MANIFEST_URL        "remoteManifestUrl"
+#define KEY_VERSION_URL         "remoteVersionUrl"
+#define KEY_GROUP_VERSIONS      "groupVersions"
+#define KEY_ENGINE_VERSION      "engineVersion"
+#define KEY_ASSETS              "assets"
+#define KEY_SEARCH_PATHS        "searchPaths"
+#define KEY_WARM_UP             "warmUp"
+#define KEY_CRITICAL            "critical"
+#define KEY_DEFERRED            "deferred"
+#define KEY_SHARD_DEPTH         "shardDepth"
+#define KEY_SHARDS              "shards"
+#define KEY_URL                 "url"
+#define KEY_TAGS                "tags"
+#define KEY_VARIANTS            "variants"
+
+#define KEY_PATH                "path"
+#define KEY_MD5                 "md5"
+#define KEY_COMPRESSED          "compressed"
+#define KEY_SIZE                "size"
+#define KEY_DOWNLOAD_STATE      "downloadState"
+
+#define READ_BUFFER_SIZE        65536
+
+// Implementation of ManifestShard
+
+void ManifestShard::pathOf(const std::string &key, int depth, std::string *path)
+{
+    size_t end = 0;
+    for (int i = 0; i < depth; ++i)
+    {
+        end = key.find('/', end);
+        if (end == std::string::npos)
+        {
+            path->clear();
+            return;
+        }
+        ++end;
+    }
+    path->assign(key, 0, end);
+}
+
+// Implementation of ManifestStreamParser
+
+bool ManifestStreamParser::parseFile(FILE *fp, ManifestData *data)
+{
+    char buffer[READ_BUFFER_SIZE];
+    rapidjson::FileReadStream stream(fp, buffer, sizeof(buffer));
+    ManifestStreamParser handler(data);
+    rapidjson::Reader reader;
+    return !reader.Parse(stream, handler).IsError() && data->loaded;
+}
+
+bool ManifestStreamParser::parseString(const std::string &content, ManifestData *data)
+{
+    rapidjson::StringStream stream(content.c_str());
+    ManifestStreamParser handler(data);
+    rapidjson::Reader reader;
+    return !reader.Parse(stream, handler).IsError() && data->loaded;
+}
+
+ManifestStreamParser::ManifestStreamParser(ManifestData *data)
+: _data(data)
+, _depth(0)
+, _section(Section::ROOT)
+, _skipDepth(0)
+, _resumeSection(Section::ROOT)
+{
+}
+
+bool ManifestStreamParser::Null()
+{
+    return true;
+}
+
+bool ManifestStreamParser::Bool(bool b)
+{
+    if (_section == Section::ASSETS && _depth == 3 && _fieldKey == KEY_COMPRESSED)
+    {
+        _asset.compressed = b;
+    }
+    return true;
+}
+
+bool ManifestStreamParser::Int(int i)
+{
+    return number(i);
+}
+
+bool ManifestStreamParser::Uint(unsigned u)
+{
+    return number(u);
+}
+
+bool ManifestStreamParser::Int64(int64_t i)
+{
+    return number((double)i);
+}
+
+bool ManifestStreamParser::Uint64(uint64_t u)
+{
+    return number((double)u);
+}
+
+bool ManifestStreamParser::Double(double d)
+{
+    return number(d);
+}
+
+bool ManifestStreamParser::RawNumber(const char *str, rapidjson::SizeType /*length*/, bool /*copy*/)
+{
+    return number(atof(str));
+}
+
+bool ManifestStreamParser::number(double value)
+{
+    if (_section == Section::ASSETS && _depth == 3)
+    {
+        if (_fieldKey == KEY_SIZE)
+        {
+            _asset.size = (float)value;
+        }
+        else if (_fieldKey == KEY_DOWNLOAD_STATE)
+        {
+            _asset.downloadState = (int)value;
+        }
+    }
+    else if (_section == Section::GROUP_VERSIONS && _depth == 2)
+    {
+        // Same as Manifest::loadVersion, non string group versions are taken as "0"
+        _data->groups.push_back(_memberKey);
+        _data->groupVer.emplace(_memberKey, "0");
+    }
+    else if (_section == Section::WARM_UP && _depth == 2)
+    {
+        _data->hints.warmUp.emplace_back(_memberKey, (int)value);
+    }
+    else if (_section == Section::ROOT && _depth == 1 && _rootKey == KEY_SHARD_DEPTH)
+    {
+        _data->hints.shardDepth = (int)value;
+    }
+    return true;
+}
+
+bool ManifestStreamParser::String(const char *str, rapidjson::SizeType length, bool /*copy*/)
+{
+    switch (_section)
+    {
+        case Section::ROOT:
+            if (_depth != 1)
+                break;
+            if (_rootKey == KEY_PACKAGE_URL)
+            {
+                _data->packageUrl.assign(str, length);
+                // Append automatically "/"
+                if (_data->packageUrl.size() && _data->packageUrl[_data->packageUrl.size() - 1] != '/')
+                {
+                    _data->packageUrl.append("/");
+                }
+            }
+            else if (_rootKey == KEY_MANIFEST_URL)
+                _data->remoteManifestUrl.assign(str, length);
+            else if (_rootKey == KEY_VERSION_URL)
+                _data->remoteVersionUrl.assign(str, length);
+            else if (_rootKey == KEY_VERSION)
+                _data->version.assign(str, length);
+            else if (_rootKey == KEY_ENGINE_VERSION)
+                _data->engineVersion.assign(str, length);
+            break;
+        case Section::GROUP_VERSIONS:
+            if (_depth == 2)
+            {
+                _data->groups.push_back(_memberKey);
+                _data->groupVer.emplace(_memberKey, std::string(str, length));
+            }
+            break;
+        case Section::ASSETS:
+            if (_depth == 3)
+            {
+                if (_fieldKey == KEY_MD5)
+                    _asset.md5.assign(str, length);
+                else if (_fieldKey == KEY_PATH)
+                    _asset.path.assign(str, length);
+            }
+            break;
+        case Section::SEARCH_PATHS:
+            if (_depth == 2)
+            {
+                _data->searchPaths.emplace_back(str, length);
+            }
+            break;
+        case Section::CRITICAL:
+            if (_depth == 2)
+            {
+                _data->hints.critical.emplace_back(str, length);
+            }
+            break;
+        case Section::DEFERRED:
+            if (_depth == 2)
+            {
+                _data->hints.deferred.emplace_back(str, length);
+            }
+            break;
+        case Section::ASSET_TAGS:
+            if (_depth == 4)
+            {
+                _data->hints.tags[_memberKey].emplace_back(str, length);
+            }
+            break;
+        case Section::VARIANTS:
+            if (_depth == 2)
+            {
+                _data->hints.variants.emplace(_memberKey, std::string(str, length));
+            }
+            break;
+        case Section::SHARDS:
+            if (_depth == 3)
+            {
+                if (_fieldKey == KEY_MD5)
+                    _data->hints.shards.back().md5.assign(str, length);
+                else if (_fieldKey == KEY_URL)
+                    _data->hints.shards.back().url.assign(str, length);
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+bool ManifestStreamParser::Key(const char *str, rapidjson::SizeType length, bool /*copy*/)
+{
+    if (_section == Section::SKIP)
+        return true;
+
+    switch (_depth)
+    {
+        case 1:
+            _rootKey.assign(str, length);
+            break;
+        case 2:
+            _memberKey.assign(str, length);
+            break;
+        case 3:
+            _fieldKey.assign(str, length);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+bool ManifestStreamParser::StartObject()
+{
+    return enter(true);
+}
+
+bool ManifestStreamParser::EndObject(rapidjson::SizeType /*memberCount*/)
+{
+    if (_section == Section::ASSETS && _depth == 3)
+    {
+        _data->assets.emplace(std::move(_memberKey), std::move(_asset));
+    }
+    return leave();
+}
+
+bool ManifestStreamParser::StartArray()
+{
+    return enter(false);
+}
+
+bool ManifestStreamParser::EndArray(rapidjson::SizeType /*elementCount*/)
+{
+    return leave();
+}
+
+bool ManifestStreamParser::enter(bool isObject)
+{
+    ++_depth;
+    if (_section == Section::SKIP)
+        return true;
+
+    if (_depth == 1)
+    {
+        // The manifest root must be an object, same as Manifest::parse
+        return isObject;
+    }
+
+    Section next = Section::SKIP;
+    if (_depth == 2 && _section == Section::ROOT)
+    {
+        if (isObject && _rootKey == KEY_GROUP_VERSIONS)
+            next = Section::GROUP_VERSIONS;
+        else if (isObject && _rootKey == KEY_ASSETS)
+            next = Section::ASSETS;
+        else if (!isObject && _rootKey == KEY_SEARCH_PATHS)
+            next = Section::SEARCH_PATHS;
+        else if (isObject && _rootKey == KEY_WARM_UP)
+            next = Section::WARM_UP;
+        else if (!isObject && _rootKey == KEY_CRITICAL)
+            next = Section::CRITICAL;
+        else if (!isObject && _rootKey == KEY_DEFERRED)
+            next = Section::DEFERRED;
+        else if (isObject && _rootKey == KEY_SHARDS)
+            next = Section::SHARDS;
+        else if (isObject && _rootKey == KEY_VARIANTS)
+            next = Section::VARIANTS;
+    }
+    else if (_depth == 3 && _section == Section::ASSETS && isObject)
+    {
+        next = Section::ASSETS;
+        _fieldKey.clear();
+        _asset.md5.clear();
+        _asset.path = _memberKey;
+        _asset.compressed = false;
+        _asset.size = 0;
+        _asset.downloadState = (int)Manifest::DownloadState::UNMARKED;
+    }
+    else if (_depth == 4 && _section == Section::ASSETS && !isObject && _fieldKey == KEY_TAGS)
+    {
+        next = Section::ASSET_TAGS;
+    }
+    else if (_depth == 3 && _section == Section::SHARDS && isObject)
+    {
+        next = Section::SHARDS;
+        _fieldKey.clear();
+        _data->hints.shards.emplace_back();
+        _data->hints.shards.back().path = _memberKey;
+    }
+
+    if (next == Section::SKIP)
+    {
+        _skipDepth = _depth;
+        _resumeSection = _section;
+    }
+    _section = next;
+    return true;
+}
+
+bool ManifestStreamParser::leave()
+{
+    if (_section == Section::SKIP)
+    {
+        // Back to the section owning the skipped value
+        if (_depth == _skipDepth)
+        {
+            _section = _resumeSection;
+        }
+    }
+    else if (_depth == 4 && _section == Section::ASSET_TAGS)
+    {
+        _section = Section::ASSETS;
+    }
+    else if (_depth == 2)
+    {
+        _section = Section::ROOT;
+    }
+    else if (_depth == 1)
+    {
+        _data->versionLoaded = true;
+        _data->loaded = true;
+    }
+    --_depth;
+    return true;
+}
+
+// Implementation of ManifestStreamWriter
+
+ManifestStreamWriter::ManifestStreamWriter()
+: _fp(nullptr)
+, _stream(nullptr)
+, _writer(nullptr)
+{
+}
+
+ManifestStreamWriter::~ManifestStreamWriter()
+{
+    delete _writer;
+    delete _stream;
+    if (_fp)
+        fclose(_fp);
+}
+
+bool ManifestStreamWriter::begin(const std::string &fullPath,
+                                 const std::string &packageUrl,
+                                 const std::string &remoteManifestUrl,
+                                 const std::string &remoteVersionUrl,
+                                 const std::string &version,
+                                 const std::string &engineVersion,
+                                 const std::vector<std::string> &groups,
+                                 const std::unordered_map<std::string, std::string> &groupVer)
+{
+    _fp = fopen(fullPath.c_str(), "wb");
+    if (!_fp)
+        return false;
+    _stream = new rapidjson::FileWriteStream(_fp, _buffer, sizeof(_buffer));
+    _writer = new rapidjson::Writer<rapidjson::FileWriteStream>(*_stream);
+
+    _writer->StartObject();
+    _writer->Key(KEY_PACKAGE_URL);
+    _writer->String(packageUrl.c_str(), (rapidjson::SizeType)packageUrl.size());
+    _writer->Key(KEY_MANIFEST_URL);
+    _writer->String(remoteManifestUrl.c_str(), (rapidjson::SizeType)remoteManifestUrl.size());
+    _writer->Key(KEY_VERSION_URL);
+    _writer->String(remoteVersionUrl.c_str(), (rapidjson::SizeType)remoteVersionUrl.size());
+    _writer->Key(KEY_VERSION);
+    _writer->String(version.c_str(), (rapidjson::SizeType)version.size());
+    if (!groups.empty())
+    {
+        _writer->Key(KEY_GROUP_VERSIONS);
+        _writer->StartObject();
+        for (const auto &group : groups)
+        {
+            auto it = groupVer.find(group);
+            _writer->Key(group.c_str(), (rapidjson::SizeType)group.size());
+            _writer->String(it != groupVer.end() ? it->second.c_str() : "0");
+        }
+        _writer->EndObject();
+    }
+    _writer->Key(KEY_ENGINE_VERSION);
+    _writer->String(engineVersion.c_str(), (rapidjson::SizeType)engineVersion.size());
+    _writer->Key(KEY_ASSETS);
+    _writer->StartObject();
+    return true;
+}
+
+void ManifestStreamWriter::writeAsset(const std::string &key, const Manifest::Asset &asset)
+{
+    _writer->Key(key.c_str(), (rapidjson::SizeType)key.size());
+    _writer->StartObject();
+    _writer->Key(KEY_MD5);
+    _writer->String(asset.md5.c_str(), (rapidjson::SizeType)asset.md5.size());
+    if (asset.path != key)
+    {
+        _writer->Key(KEY_PATH);
+        _writer->String(asset.path.c_str(), (rapidjson::SizeType)asset.path.size());
+    }
+    if (asset.compressed)
+    {
+        _writer->Key(KEY_COMPRESSED);
+        _writer->Bool(true);
+    }
+    if (asset.size > 0)
+    {
+        _writer->Key(KEY_SIZE);
+        _writer->Int64((int64_t)asset.size);
+    }
+    if (asset.downloadState != (int)Manifest::DownloadState::UNMARKED)
+    {
+        _writer->Key(KEY_DOWNLOAD_STATE);
+        _writer->Int(asset.downloadState);
+    }
+    _writer->EndObject();
+}
+
+bool ManifestStreamWriter::end(const std::vector<std::string> &searchPaths, const ManifestHints *hints)
+{
+    _writer->EndObject();
+    if (hints && !hints->shards.empty())
+    {
+        _writer->Key(KEY_SHARD_DEPTH);
+        _writer->Int(hints->shardDepth);
+        _writer->Key(KEY_SHARDS);
+        _writer->StartObject();
+        for (const auto &shard : hints->shards)
+        {
+            _writer->Key(shard.path.c_str(), (rapidjson::SizeType)shard.path.size());
+            _writer->StartObject();
+            _writer->Key(KEY_MD5);
+            _writer->String(shard.md5.c_str(), (rapidjson::SizeType)shard.md5.size());
+            _writer->Key(KEY_URL);
+            _writer->String(shard.url.c_str(), (rapidjson::SizeType)shard.url.size());
+            _writer->EndObject();
+        }
+        _writer->EndObject();
+    }
+    if (hints && !hints->variants.empty())
+    {
+        _writer->Key(KEY_VARIANTS);
+        _writer->StartObject();
+        for (const auto &it : hints->variants)
+        {
+            _writer->Key(it.first.c_str(), (rapidjson::SizeType)it.first.size());
+            _writer->String(it.second.c_str(), (rapidjson::SizeType)it.second.size());
+        }
+        _writer->EndObject();
+    }
+    _writer->Key(KEY_SEARCH_PATHS);
+    _writer->StartArray();
+    for (const auto &path : searchPaths)
+    {
+        _writer->String(path.c_str(), (rapidjson::SizeType)path.size());
+    }
+    _writer->EndArray();
+    _writer->EndObject();
+    _stream->Flush();
+
+    bool ok = ferror(_fp) == 0;
+    ok = fclose(_fp) == 0 && ok;
+    _fp = nullptr;
+    return ok;
+}
+
+NS_CC_EXT_END
@@ -0,0 +1,218 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __ManifestStream__
+#define __ManifestStream__
+
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Manifest.h"
+#include "extensions/ExtensionMacros.h"
+#include "extensions/ExtensionExport.h"
+#include "json/document-wrapper.h"
+#include "json/filewritestream.h"
+#include "json/writer.h"
+
+NS_CC_EXT_BEGIN
+
+/**
+ * @brief   One shard of a sharded manifest: the assets whose key starts with the same
+ *          ManifestHints::shardDepth directories, listed in a file of their own
+ */
+struct ManifestShard
+{
+    //! Directories shared by the keys of the shard, "" for the keys with fewer directories
+    std::string path;
+    //! md5 of the shard file, it changes with any asset of the shard
+    std::string md5;
+    //! Shard file url, relative to the directory of the manifest url unless absolute
+    std::string url;
+
+    /** @brief Path of the shard an asset key belongs to
+     */
+    static void pathOf(const std::string &key, int depth, std::string *path);
+};
+
+/**
+ * @brief   Optional root keys of a manifest used by AssetsManagerEx to schedule an update, unknown to Manifest
+ */
+struct ManifestHints
+{
+    //! "warmUp": asset keys and priorities, see AssetsManagerEx::setWarmUpEnabled
+    std::vector<std::pair<std::string, int>> warmUp;
+    //! "critical": path prefixes of the assets needed to play
+    std::vector<std::string> critical;
+    //! "deferred": path prefixes of the assets which can wait, all the others are critical
+    std::vector<std::string> deferred;
+    //! "shardDepth" and "shards": the manifest is sharded, a remote one lists no asset but its shards
+    int shardDepth = 0;
+    std::vector<ManifestShard> shards;
+    //! "tags" of each asset: the variants it belongs to, as "dimension:value", see AssetsManagerEx::setVariant
+    std::unordered_map<std::string, std::vector<std::string>> tags;
+    //! "variants": selection the assets of an installed manifest were filtered with
+    std::unordered_map<std::string, std::string> variants;
+};
+
+/**
+ * @brief   Manifest content as read by ManifestStreamParser, laid out like the fields of Manifest
+ *          so AssetsManagerEx can move it in without copying.
+ */
+struct ManifestData
+{
+    bool versionLoaded = false;
+    bool loaded = false;
+    std::string packageUrl;
+    std::string remoteManifestUrl;
+    std::string remoteVersionUrl;
+    std::string version;
+    std::string engineVersion;
+    std::vector<std::string> groups;
+    std::unordered_map<std::string, std::string> groupVer;
+    std::unordered_map<std::string, Manifest::Asset> assets;
+    std::vector<std::string> searchPaths;
+    ManifestHints hints;
+};
+
+/**
+ * @brief   SAX handler filling a ManifestData straight from the json stream.
+ *          No DOM is built and files are read through a fixed size buffer,
+ *          so the asset table is the only full copy of the manifest held in memory.
+ */
+class CC_EX_DLL ManifestStreamParser
+{
+public:
+
+    /** @brief Parse a manifest from an opened file, reading it through a fixed size buffer
+     @param fp      The manifest file, left open
+     @param data    Output, only valid when true is returned
+     */
+    static bool parseFile(FILE *fp, ManifestData *data);
+
+    /** @brief Parse a manifest already loaded in memory, e.g. read from the apk by FileUtils
+     */
+    static bool parseString(const std::string &content, ManifestData *data);
+
+    explicit ManifestStreamParser(ManifestData *data);
+
+    // rapidjson handler interface
+    bool Null();
+    bool Bool(bool b);
+    bool Int(int i);
+    bool Uint(unsigned u);
+    bool Int64(int64_t i);
+    bool Uint64(uint64_t u);
+    bool Double(double d);
+    bool RawNumber(const char *str, rapidjson::SizeType length, bool copy);
+    bool String(const char *str, rapidjson::SizeType length, bool copy);
+    bool StartObject();
+    bool Key(const char *str, rapidjson::SizeType length, bool copy);
+    bool EndObject(rapidjson::SizeType memberCount);
+    bool StartArray();
+    bool EndArray(rapidjson::SizeType elementCount);
+
+private:
+    enum class Section : char
+    {
+        ROOT,
+        GROUP_VERSIONS,
+        ASSETS,
+        SEARCH_PATHS,
+        WARM_UP,
+        CRITICAL,
+        DEFERRED,
+        SHARDS,
+        ASSET_TAGS,
+        VARIANTS,
+        SKIP
+    };
+
+    bool number(double value);
+    bool enter(bool isObject);
+    bool leave();
+
+    ManifestData *_data;
+
+    //! Current nesting level, 1 is the root object
+    int _depth;
+
+    //! Section the parser is in, SKIP for values we don't know about
+    Section _section;
+
+    //! Depth at which the skipped value started, and the section to resume after it
+    int _skipDepth;
+    Section _resumeSection;
+
+    //! Last key read at depth 1, 2 and 3
+    std::string _rootKey;
+    std::string _memberKey;
+    std::string _fieldKey;
+
+    //! Asset being filled while inside an asset object
+    Manifest::Asset _asset;
+};
+
+/**
+ * @brief   Writes a manifest file field by field through a fixed size buffer,
+ *          the reverse of ManifestStreamParser.
+ */
+class CC_EX_DLL ManifestStreamWriter
+{
+public:
+
+    ManifestStreamWriter();
+
+    ~ManifestStreamWriter();
+
+    /** @brief Open the file and write the version header of the manifest
+     */
+    bool begin(const std::string &fullPath,
+               const std::string &packageUrl,
+               const std::string &remoteManifestUrl,
+               const std::string &remoteVersionUrl,
+               const std::string &version,
+               const std::string &engineVersion,
+               const std::vector<std::string> &groups,
+               const std::unordered_map<std::string, std::string> &groupVer);
+
+    void writeAsset(const std::string &key, const Manifest::Asset &asset);
+
+    /** @brief Write the search paths, close the file and report whether everything was written
+     @param hints   Only its shard table and variant selection are written, the other hints are for the update reading them
+     */
+    bool end(const std::vector<std::string> &searchPaths, const ManifestHints *hints = nullptr);
+
+private:
+    FILE *_fp;
+    char _buffer[16384];
+    rapidjson::FileWriteStream *_stream;
+    rapidjson::Writer<rapidjson::FileWriteStream> *_writer;
+};
+
+NS_CC_EXT_END
+
+#endif /* defined(__ManifestStream__) */
@@ -0,0 +1,434 @@
+#!/usr/bin/env python3
+"""Benchmark-grade local asset server for AssetsManagerEx.
+
+Serves an arbitrary asset tree plus its manifests over HTTP/1.1 with
+Range, ETag and gzip support, and can inject per-request latency,
+bandwidth caps, connection resets and 5xx errors. Every request is timed
+and recorded so update throughput can be measured with no real network.
+
+The routes of code.py are kept so the sample manifests work unchanged:
+
+    /remoteManifestUrl   -> <root>/project.manifest
+    /remoteVersionUrl    -> <root>/version.manifest
+    /packageUrl/<path>   -> <root>/<path>
+
+Any other path is served relative to <root>.
+
+Standalone:
+
+    python3 bench_server.py --root file --port 8080 --latency-ms 40 \
+        --bandwidth 262144 --reset-rate 0.01 --error-rate 0.02 --log run.jsonl
+
+Embedded in a benchmark script:
+
+    from bench_server import BenchServer, FaultConfig
+    server = BenchServer('file', port=0, faults=FaultConfig(latency_ms=20))
+    server.start()
+    ...  # point the client at server.url
+    server.stop()
+    print(server.summary())
+"""
+
+import argparse
+import gzip
+import json
+import os
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import unquote, urlsplit
+
+BUF_SIZE = 65536
+
+ALIASES = {
+    '/remoteManifestUrl': 'project.manifest',
+    '/remoteVersionUrl': 'version.manifest',
+}
+PACKAGE_PREFIX = '/packageUrl/'
+
+# Already compressed payloads are never gzipped again
+NO_GZIP_EXT = ('.zip', '.png', '.jpg', '.jpeg', '.webp', '.pkm', '.astc',
+               '.ogg', '.mp3', '.mp4', '.gz')
+
+
+class FaultConfig(object):
+    """Fault injection knobs, may be changed while the server runs."""
+
+    def __init__(self, latency_ms=0, jitter_ms=0, bandwidth=0, reset_rate=0.0,
+                 error_rate=0.0, error_codes=(500, 503), seed=None):
+        # Delay before the response headers are sent
+        self.latency_ms = latency_ms
+        # Uniform random extra delay in [0, jitter_ms]
+        self.jitter_ms = jitter_ms
+        # Per-connection body bandwidth cap in bytes per second, 0 is unlimited
+        self.bandwidth = bandwidth
+        # Probability of resetting the connection in the middle of the body
+        self.reset_rate = reset_rate
+        # Probability of answering with one of error_codes instead of the file
+        self.error_rate = error_rate
+        self.error_codes = tuple(error_codes)
+        self.random = random.Random(seed)
+        self.lock = threading.Lock()
+
+    def roll(self, rate):
+        if rate <= 0:
+            return False
+        with self.lock:
+            return self.random.random() < rate
+
+    def delay(self):
+        with self.lock:
+            jitter = self.random.uniform(0, self.jitter_ms) if self.jitter_ms > 0 else 0
+        return (self.latency_ms + jitter) / 1000.0
+
+    def error_code(self):
+        with self.lock:
+            return self.random.choice(self.error_codes)
+
+
+class RequestRecord(object):
+    __slots__ = ('method', 'path', 'status', 'range', 'gzip', 'bytes_sent',
+                 'fault', 'start', 'ttfb_ms', 'total_ms')
+
+    def __init__(self, method, path):
+        self.method = method
+        self.path = path
+        self.status = 0
+        self.range = None
+        self.gzip = False
+        self.bytes_sent = 0
+        self.fault = None
+        self.start = time.time()
+        self.ttfb_ms = 0.0
+        self.total_ms = 0.0
+
+    def to_dict(self):
+        return dict((k, getattr(self, k)) for k in self.__slots__)
+
+
+class BenchHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    server_version = 'AssetsBenchServer/1.0'
+
+    def log_message(self, fmt, *args):
+        if self.server.bench.verbose:
+            BaseHTTPRequestHandler.log_message(self, fmt, *args)
+
+    def do_HEAD(self):
+        self.handle_get(head=True)
+
+    def do_GET(self):
+        self.handle_get(head=False)
+
+    def handle_get(self, head):
+        bench = self.server.bench
+        record = RequestRecord(self.command, self.path)
+        t0 = time.perf_counter()
+        try:
+            self.serve(bench, record, head, t0)
+        except (ConnectionError, socket.error):
+            if record.fault is None:
+                record.fault = 'client_abort'
+            self.close_connection = True
+        finally:
+            record.total_ms = (time.perf_counter() - t0) * 1000.0
+            bench.record(record)
+
+    def resolve(self, root):
+        path = unquote(urlsplit(self.path).path)
+        if path in ALIASES:
+            rel = ALIASES[path]
+        elif path.startswith(PACKAGE_PREFIX):
+            rel = path[len(PACKAGE_PREFIX):]
+        else:
+            rel = path.lstrip('/')
+        full = os.path.realpath(os.path.join(root, rel))
+        # Never serve anything outside of the asset tree
+        if full != root and not full.startswith(root + os.sep):
+            return None
+        return full
+
+    def serve(self, bench, record, head, t0):
+        faults = bench.faults
+        delay = faults.delay()
+        if delay > 0:
+            time.sleep(delay)
+
+        if faults.roll(faults.error_rate):
+            record.fault = 'error'
+            self.send_status(record, faults.error_code(), t0)
+            return
+
+        path = self.resolve(bench.root)
+        if path is None or not os.path.isfile(path):
+            self.send_status(record, 404, t0)
+            return
+
+        st = os.stat(path)
+        etag = '"%x-%x"' % (st.st_mtime_ns, st.st_size)
+        # The gzip body is a different representation, it gets its own
+        # validator so If-Range never mixes bytes of the two encodings
+        varies = bench.gzip and not path.lower().endswith(NO_GZIP_EXT)
+        body = None
+        size = st.st_size
+        if varies and 'gzip' in self.headers.get('Accept-Encoding', ''):
+            etag = etag[:-1] + '-gz"'
+            body = bench.gzipped(path, etag)
+            size = len(body)
+            record.gzip = True
+        vary = {'Vary': 'Accept-Encoding'} if varies else None
+
+        if self.headers.get('If-None-Match') == etag:
+            self.send_status(record, 304, t0, etag=etag, extra=vary)
+            return
+
+        start, end, status = 0, size - 1, 200
+        range_header = self.headers.get('Range')
+        if_range = self.headers.get('If-Range')
+        if range_header and (not if_range or if_range == etag):
+            parsed = parse_range(range_header, size)
+            if parsed is None:
+                extra = {'Content-Range': 'bytes */%d' % size}
+                extra.update(vary or {})
+                self.send_status(record, 416, t0, extra=extra)
+                return
+            start, end = parsed
+            status = 206
+            record.range = '%d-%d' % (start, end)
+
+        length = end - start + 1
+        self.send_response(status)
+        self.send_header('Content-Type', 'application/octet-stream')
+        self.send_header('Content-Length', str(length))
+        self.send_header('Accept-Ranges', 'bytes')
+        self.send_header('ETag', etag)
+        if varies:
+            self.send_header('Vary', 'Accept-Encoding')
+        if status == 206:
+            self.send_header('Content-Range', 'bytes %d-%d/%d' % (start, end, size))
+        if body is not None:
+            self.send_header('Content-Encoding', 'gzip')
+        self.end_headers()
+        self.wfile.flush()
+        record.status = status
+        record.ttfb_ms = (time.perf_counter() - t0) * 1000.0
+        if head:
+            return
+
+        # Reset somewhere inside the body, so partial downloads are exercised
+        reset_at = -1
+        if faults.roll(faults.reset_rate):
+            with faults.lock:
+                reset_at = faults.random.randint(0, max(0, length - 1))
+
+        if body is not None:
+            self.send_body(record, faults, iter([body[start:end + 1]]), reset_at)
+        else:
+            with open(path, 'rb') as f:
+                f.seek(start)
+                self.send_body(record, faults, read_chunks(f, length), reset_at)
+
+    def send_body(self, record, faults, chunks, reset_at):
+        sent = 0
+        began = time.perf_counter()
+        for chunk in chunks:
+            if reset_at >= 0 and sent + len(chunk) > reset_at:
+                self.wfile.write(chunk[:reset_at - sent])
+                record.bytes_sent = reset_at
+                record.fault = 'reset'
+                self.reset()
+                return
+            self.wfile.write(chunk)
+            sent += len(chunk)
+            record.bytes_sent = sent
+            if faults.bandwidth > 0:
+                # Sleep until the elapsed time matches the configured rate
+                ahead = sent / float(faults.bandwidth) - (time.perf_counter() - began)
+                if ahead > 0:
+                    time.sleep(ahead)
+
+    def send_status(self, record, code, t0, etag=None, extra=None):
+        self.send_response(code)
+        self.send_header('Content-Length', '0')
+        if etag:
+            self.send_header('ETag', etag)
+        for key, value in (extra or {}).items():
+            self.send_header(key, value)
+        self.end_headers()
+        record.status = code
+        record.ttfb_ms = (time.perf_counter() - t0) * 1000.0
+
+    def reset(self):
+        # SO_LINGER with a zero timeout turns close() into a TCP RST
+        self.wfile.flush()
+        self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER,
+                                   struct.pack('ii', 1, 0))
+        self.close_connection = True
+        self.connection.close()
+
+
+def read_chunks(f, length):
+    while length > 0:
+        chunk = f.read(min(BUF_SIZE, length))
+        if not chunk:
+            break
+        length -= len(chunk)
+        yield chunk
+
+
+def parse_range(header, size):
+    """Parse a single 'bytes=' range, returns (start, end) or None if unsatisfiable."""
+    if not header.startswith('bytes=') or ',' in header:
+        return None
+    first, _, last = header[6:].strip().partition('-')
+    try:
+        if first == '':
+            count = int(last)
+            if count <= 0:
+                return None
+            return max(0, size - count), size - 1
+        start = int(first)
+        end = int(last) if last else size - 1
+    except ValueError:
+        return None
+    if start >= size or end < start:
+        return None
+    return start, min(end, size - 1)
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))]
+
+
+class BenchServer(object):
+    """Threaded server that can be embedded in a benchmark or run standalone."""
+
+    def __init__(self, root, host='127.0.0.1', port=8080, faults=None,
+                 gzip_enabled=True, log_path=None, verbose=False):
+        self.root = os.path.realpath(root)
+        self.faults = faults or FaultConfig()
+        self.gzip = gzip_enabled
+        self.verbose = verbose
+        self.records = []
+        self._lock = threading.Lock()
+        self._gzip_cache = {}
+        self._log = open(log_path, 'a') if log_path else None
+        self._httpd = ThreadingHTTPServer((host, port), BenchHandler)
+        self._httpd.daemon_threads = True
+        self._httpd.bench = self
+        self._thread = None
+
+    @property
+    def port(self):
+        return self._httpd.server_address[1]
+
+    @property
+    def url(self):
+        return 'http://%s:%d' % (self._httpd.server_address[0], self.port)
+
+    def gzipped(self, path, etag):
+        key = (path, etag)
+        with self._lock:
+            body = self._gzip_cache.get(key)
+        if body is None:
+            with open(path, 'rb') as f:
+                body = gzip.compress(f.read(), 6)
+            with self._lock:
+                self._gzip_cache[key] = body
+        return body
+
+    def record(self, record):
+        with self._lock:
+            self.records.append(record)
+            if self._log:
+                self._log.write(json.dumps(record.to_dict()) + '\n')
+                self._log.flush()
+
+    def reset_records(self):
+        with self._lock:
+            self.records = []
+
+    def summary(self):
+        with self._lock:
+            records = list(self.records)
+        total = [r.total_ms for r in records]
+        ttfb = [r.ttfb_ms for r in records]
+        faults = {}
+        for r in records:
+            if r.fault:
+                faults[r.fault] = faults.get(r.fault, 0) + 1
+        return {
+            'requests': len(records),
+            'bytes_sent': sum(r.bytes_sent for r in records),
+            'faults': faults,
+            'ttfb_ms_p50': percentile(ttfb, 50),
+            'ttfb_ms_p95': percentile(ttfb, 95),
+            'total_ms_p50': percentile(total, 50),
+            'total_ms_p95': percentile(total, 95),
+            'total_ms_max': max(total) if total else 0.0,
+        }
+
+    def serve_forever(self):
+        self._httpd.serve_forever()
+
+    def start(self):
+        self._thread = threading.Thread(target=self._httpd.serve_forever)
+        self._thread.daemon = True
+        self._thread.start()
+        return self
+
+    def stop(self):
+        self._httpd.shutdown()
+        self._httpd.server_close()
+        if self._thread:
+            self._thread.join()
+            self._thread = None
+        if self._log:
+            self._log.close()
+            self._log = None
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--root', default='file', help='asset tree to serve')
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=8080)
+    parser.add_argument('--latency-ms', type=float, default=0)
+    parser.add_argument('--jitter-ms', type=float, default=0)
+    parser.add_argument('--bandwidth', type=int, default=0,
+                        help='per-connection cap in bytes/s, 0 is unlimited')
+    parser.add_argument('--reset-rate', type=float, default=0.0)
+    parser.add_argument('--error-rate', type=float, default=0.0)
+    parser.add_argument('--error-codes', default='500,503')
+    parser.add_argument('--seed', type=int, default=None)
+    parser.add_argument('--no-gzip', action='store_true')
+    parser.add_argument('--log', default=None, help='append per-request JSON lines here')
+    parser.add_argument('--verbose', action='store_true')
+    args = parser.parse_args(argv)
+
+    faults = FaultConfig(args.latency_ms, args.jitter_ms, args.bandwidth,
+                         args.reset_rate, args.error_rate,
+                         [int(c) for c in args.error_codes.split(',') if c],
+                         args.seed)
+    server = BenchServer(args.root, args.host, args.port, faults,
+                         not args.no_gzip, args.log, args.verbose)
+    print('Serving %s on %s' % (server.root, server.url))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.stop()
+        print(json.dumps(server.summary(), indent=2))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
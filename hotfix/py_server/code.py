@@ -24,7 +24,7 @@ class packageUrl:
 		f = None
 		try:
 			f = open(file_path, "rb")
-			web.header('Content-Length',370000)
+			web.header('Content-Length',os.path.getsize(file_path))
 			web.header('Content-Type','application/octet-stream')
 			web.header('Content-disposition', 'attachment; filename=%s' % file_name)
 			while True:
@@ -48,7 +48,7 @@ class packageUrl2:
 		f = None
 		try:
 			f = open(file_path, "rb")
-			web.header('Content-Length',370000000)
+			web.header('Content-Length',os.path.getsize(file_path))
 			web.header('Content-Type','application/octet-stream')
 			web.header('Content-disposition', 'attachment; filename=%s' % file_name)
 			while True:
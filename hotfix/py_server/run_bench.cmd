@@ -0,0 +1,3 @@
+python bench_server.py --root file --port 8080 --log bench.jsonl
+
+pause
\ No newline at end of file
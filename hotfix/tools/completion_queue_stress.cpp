@@ -0,0 +1,215 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * completion_queue_stress: checks AssetsCompletionQueue under concurrent producers.
+ *
+ * Producer threads play a download backend: each running task pushes many
+ * progress chunks, then a success or an error, from whichever thread owns its
+ * slot. The main thread is the consumer: it pops, checks that the progress of
+ * a slot never goes back and that error strings arrive whole, then releases
+ * the slot and starts a new task in it. Deterministic checks follow: entries
+ * of a released slot are skipped, progress is merged into one entry per slot,
+ * and releaseAll drops everything queued. Build it with -fsanitize=thread to
+ * check the ring for data races.
+ *
+ * Build: g++ -std=c++11 -O1 -g -fsanitize=thread -pthread -I<cocos2d-x> -I<cocos2d-x>/cocos
+ *            completion_queue_stress.cpp ../client/AssetsCompletionQueue.cpp -o completion_queue_stress
+ *
+ * Usage: completion_queue_stress [--tasks N] [--chunks N] [--threads N]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../client/AssetsCompletionQueue.h"
+
+USING_NS_CC_EXT;
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); s_failures++; } } while (0)
+
+static const int SLOT_COUNT = 32;
+
+static const char* const ERROR_STRING = "Connection reset by peer while receiving the body";
+
+static void stress(int taskCount, int chunkCount, int threadCount)
+{
+    AssetsCompletionQueue queue(SLOT_COUNT);
+    // A producer only touches a slot after the consumer handed it a task through ready
+    std::unique_ptr<std::atomic<int>[]> ready(new std::atomic<int>[SLOT_COUNT]);
+    for (int i = 0; i < SLOT_COUNT; ++i)
+    {
+        ready[i] = 0;
+    }
+    for (int i = 0; i < SLOT_COUNT; ++i)
+    {
+        int slot = queue.acquire();
+        CHECK(slot >= 0);
+        ready[slot].store(1, std::memory_order_release);
+    }
+    CHECK(queue.acquire() == -1);
+
+    std::atomic<bool> stopping(false);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        producers.emplace_back([&, t]() {
+            unsigned int task = 0;
+            while (!stopping.load(std::memory_order_acquire))
+            {
+                bool idle = true;
+                for (int slot = t; slot < SLOT_COUNT; slot += threadCount)
+                {
+                    if (ready[slot].load(std::memory_order_acquire) != 1)
+                        continue;
+                    ready[slot].store(0, std::memory_order_relaxed);
+                    idle = false;
+                    for (int chunk = 1; chunk <= chunkCount; ++chunk)
+                    {
+                        queue.pushProgress(slot, (int64_t)chunk * 1024, (int64_t)chunkCount * 1024);
+                    }
+                    if (task++ % 7 == 0)
+                        queue.pushError(slot, 1, 2, ERROR_STRING);
+                    else
+                        queue.pushSuccess(slot);
+                }
+                if (idle)
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    int finished = 0, failed = 0;
+    size_t progressEntries = 0;
+    std::vector<int64_t> lastReceived(SLOT_COUNT, 0);
+    AssetsCompletionQueue::Completion completion;
+    auto start = std::chrono::steady_clock::now();
+    while (finished < taskCount)
+    {
+        if (!queue.pop(&completion))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (completion.type == AssetsCompletionQueue::Type::PROGRESS)
+        {
+            progressEntries++;
+            CHECK(completion.totalBytesReceived >= lastReceived[completion.slot]);
+            CHECK(completion.bytesReceived == completion.totalBytesReceived - lastReceived[completion.slot]);
+            lastReceived[completion.slot] = completion.totalBytesReceived;
+            continue;
+        }
+        if (completion.type == AssetsCompletionQueue::Type::FAILURE)
+        {
+            failed++;
+            CHECK(completion.errorCode == 1 && completion.errorCodeInternal == 2);
+            CHECK(*completion.errorStr == ERROR_STRING);
+        }
+        finished++;
+        queue.release(completion.slot);
+        int slot = queue.acquire();
+        CHECK(slot >= 0);
+        lastReceived[slot] = 0;
+        ready[slot].store(1, std::memory_order_release);
+    }
+    stopping.store(true, std::memory_order_release);
+    for (auto &producer : producers)
+    {
+        producer.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("stress   : %d tasks, %d failed, %zu progress entries for %lld chunks pushed, %.3f s\n",
+           finished, failed, progressEntries, (long long)finished * chunkCount, seconds);
+}
+
+static void checkRelease()
+{
+    AssetsCompletionQueue queue(2);
+    AssetsCompletionQueue::Completion completion;
+
+    // Chunks pushed before the consumer pops are merged in one entry
+    int slot = queue.acquire();
+    for (int chunk = 1; chunk <= 100; ++chunk)
+    {
+        queue.pushProgress(slot, chunk * 10, 1000);
+    }
+    CHECK(queue.pop(&completion) && completion.type == AssetsCompletionQueue::Type::PROGRESS);
+    CHECK(completion.totalBytesReceived == 1000 && completion.bytesReceived == 1000);
+    CHECK(!queue.pop(&completion));
+
+    // Entries of a released slot aren't seen by the next task of the slot
+    queue.pushProgress(slot, 2000, 3000);
+    queue.pushSuccess(slot);
+    queue.release(slot);
+    int again = queue.acquire();
+    CHECK(again >= 0);
+    CHECK(!queue.pop(&completion));
+    queue.pushSuccess(again);
+    CHECK(queue.pop(&completion) && completion.type == AssetsCompletionQueue::Type::SUCCESS && completion.slot == again);
+
+    // releaseAll drops everything queued and frees every slot
+    queue.release(again);
+    int first = queue.acquire(), second = queue.acquire();
+    CHECK(first >= 0 && second >= 0 && queue.acquire() == -1);
+    queue.pushError(first, 3, 4, "aborted");
+    queue.pushProgress(second, 1, 2);
+    queue.releaseAll();
+    CHECK(!queue.pop(&completion));
+    CHECK(queue.acquire() >= 0 && queue.acquire() >= 0 && queue.acquire() == -1);
+    printf("release  : checked\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int taskCount = 5000;
+    int chunkCount = 200;
+    int threadCount = 8;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--tasks") == 0)
+            taskCount = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--chunks") == 0)
+            chunkCount = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0)
+            threadCount = atoi(argv[i + 1]);
+    }
+    if (taskCount <= 0 || chunkCount <= 0 || threadCount <= 0 || threadCount > SLOT_COUNT)
+    {
+        fprintf(stderr, "Usage: completion_queue_stress [--tasks N] [--chunks N] [--threads N]\n");
+        return 1;
+    }
+
+    stress(taskCount, chunkCount, threadCount);
+    checkRelease();
+    printf("%s\n", s_failures == 0 ? "OK" : "FAILED");
+    return s_failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,250 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+/**
+ * download_scheduler_driver: checks how AssetsDownloadScheduler shares and
+ * cancels connections, on a fake backend ended by hand.
+ *
+ * Two downloaders share four connections. One of them is cancelled while its
+ * transfers run: the backend mustn't be aborted since the other one still
+ * downloads, the cancelled transfers keep their connections until the backend
+ * ends them, their results are dropped, and a task queued again for the same
+ * storage path waits for the detached transfer writing it. A cancel while
+ * nobody else runs aborts the backend. Errors and the priority policy are
+ * checked too. Completions are forwarded by the Director's scheduler, updated
+ * here once per simulated frame.
+ *
+ * Build: g++ -std=c++11 -O2 -I<cocos2d-x> -I<cocos2d-x>/cocos
+ *            download_scheduler_driver.cpp ../client/AssetsDownloadScheduler.cpp
+ *            ../client/AssetsCompletionQueue.cpp ../client/AssetsManagerExEnv.cpp
+ *            -lcocos2d -o download_scheduler_driver
+ *
+ * Usage: download_scheduler_driver
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "cocos2d.h"
+#include "../client/AssetsDownloadScheduler.h"
+
+USING_NS_CC;
+USING_NS_CC_EXT;
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); s_failures++; } } while (0)
+
+//! Backend whose tasks run until the driver ends them
+class FakeBackend : public IAssetsDownloader
+{
+public:
+    FakeBackend() : cancels(0) {}
+
+    virtual void createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier) override
+    {
+        network::DownloadTask task;
+        task.requestURL = srcUrl;
+        task.storagePath = storagePath;
+        task.identifier = identifier;
+        tasks.push_back(task);
+    }
+
+    virtual void cancelAll() override
+    {
+        cancels++;
+        tasks.clear();
+    }
+
+    /** @brief End the running task writing storagePath
+     @return    false if no task writes it
+     */
+    bool finish(const std::string &storagePath, bool succeeded)
+    {
+        for (auto it = tasks.begin(); it != tasks.end(); ++it)
+        {
+            if (it->storagePath == storagePath)
+            {
+                network::DownloadTask task = *it;
+                tasks.erase(it);
+                if (succeeded)
+                    onFileTaskSuccess(task);
+                else
+                    onTaskError(task, network::DownloadTask::ERROR_IMPL_INTERNAL, 404, "Not found: " + storagePath);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isRunning(const std::string &storagePath) const
+    {
+        for (const auto &task : tasks)
+        {
+            if (task.storagePath == storagePath)
+                return true;
+        }
+        return false;
+    }
+
+    std::vector<network::DownloadTask> tasks;
+    int cancels;
+};
+
+//! Results a downloader forwarded, by identifier
+struct Results
+{
+    std::vector<std::string> succeeded;
+    std::vector<std::string> failed;
+    std::vector<std::string> errors;
+
+    void listen(SharedAssetsDownloader *downloader)
+    {
+        downloader->onFileTaskSuccess = [this](const network::DownloadTask &task) {
+            succeeded.push_back(task.identifier);
+        };
+        downloader->onTaskError = [this](const network::DownloadTask &task, int /*errorCode*/, int /*errorCodeInternal*/, const std::string &errorStr) {
+            failed.push_back(task.identifier);
+            errors.push_back(errorStr);
+        };
+    }
+};
+
+static void frame()
+{
+    Director::getInstance()->getScheduler()->update(1.0f / 60);
+}
+
+static void checkCancel(AssetsDownloadScheduler *scheduler, const std::shared_ptr<FakeBackend> &backend)
+{
+    auto a = scheduler->createDownloader();
+    auto b = scheduler->createDownloader();
+    Results resultsA, resultsB;
+    resultsA.listen(a.get());
+    resultsB.listen(b.get());
+    for (int i = 0; i < 4; ++i)
+    {
+        a->createDownloadFileTask("url", "a" + std::to_string(i), "idA" + std::to_string(i));
+        b->createDownloadFileTask("url", "b" + std::to_string(i), "idB" + std::to_string(i));
+    }
+    // Fair shares of the four connections
+    CHECK(a->getRunningCount() == 2 && b->getRunningCount() == 2);
+    CHECK(a->getQueuedCount() == 2 && b->getQueuedCount() == 2);
+
+    // b keeps its transfers, a's ones are detached and still hold their connections
+    a->cancelAll();
+    CHECK(backend->cancels == 0);
+    CHECK(a->getRunningCount() == 0 && a->getQueuedCount() == 0);
+    CHECK(scheduler->getRunningCount() == 4);
+    CHECK(backend->isRunning("a0") && backend->isRunning("b0"));
+
+    // Queued again, a0 waits for the detached transfer writing it, a2 doesn't
+    a->createDownloadFileTask("url", "a0", "idA0");
+    a->createDownloadFileTask("url", "a2", "idA2");
+    CHECK(backend->finish("b0", true));
+    frame();
+    CHECK(resultsB.succeeded.size() == 1 && resultsB.succeeded[0] == "idB0");
+    CHECK(b->getRunningCount() == 2);
+    CHECK(a->getQueuedCount() == 2);
+
+    // The detached transfers end: dropped, a0 starts once its file is free
+    CHECK(backend->finish("a0", true));
+    CHECK(backend->finish("a1", false));
+    frame();
+    CHECK(resultsA.succeeded.empty() && resultsA.failed.empty());
+    CHECK(a->getRunningCount() == 2 && a->getQueuedCount() == 0);
+    CHECK(backend->isRunning("a0") && backend->isRunning("a2"));
+
+    for (int round = 0; round < 10 && !backend->tasks.empty(); ++round)
+    {
+        std::vector<std::string> paths;
+        for (const auto &task : backend->tasks)
+        {
+            paths.push_back(task.storagePath);
+        }
+        for (const auto &path : paths)
+        {
+            backend->finish(path, path != "b3");
+        }
+        frame();
+    }
+    CHECK(resultsA.succeeded.size() == 2 && resultsA.failed.empty());
+    CHECK(resultsB.succeeded.size() == 3);
+    CHECK(resultsB.failed.size() == 1 && resultsB.failed[0] == "idB3" && resultsB.errors[0] == "Not found: b3");
+    CHECK(scheduler->getRunningCount() == 0);
+
+    // Nobody else runs, so the backend is aborted and the connection is free at once
+    a->createDownloadFileTask("url", "a4", "idA4");
+    a->cancelAll();
+    CHECK(backend->cancels == 1);
+    CHECK(scheduler->getRunningCount() == 0);
+    frame();
+    CHECK(resultsA.succeeded.size() == 2 && resultsA.failed.empty());
+}
+
+static void checkPriority(AssetsDownloadScheduler *scheduler, const std::shared_ptr<FakeBackend> &backend)
+{
+    scheduler->setPolicy(AssetsDownloadScheduler::Policy::PRIORITY);
+    auto low = scheduler->createDownloader(1);
+    auto high = scheduler->createDownloader(2);
+    Results resultsLow, resultsHigh;
+    resultsLow.listen(low.get());
+    resultsHigh.listen(high.get());
+    for (int i = 0; i < 6; ++i)
+    {
+        low->createDownloadFileTask("url", "low" + std::to_string(i), "low" + std::to_string(i));
+    }
+    CHECK(low->getRunningCount() == 4);
+    for (int i = 0; i < 3; ++i)
+    {
+        high->createDownloadFileTask("url", "high" + std::to_string(i), "high" + std::to_string(i));
+    }
+    // Freed connections go to the higher priority first
+    CHECK(backend->finish("low0", true));
+    CHECK(backend->finish("low1", true));
+    frame();
+    CHECK(high->getRunningCount() == 2 && low->getRunningCount() == 2);
+    CHECK(high->getQueuedCount() == 1 && low->getQueuedCount() == 2);
+    high->cancelAll();
+    low->cancelAll();
+    CHECK(backend->cancels == 2);
+    CHECK(scheduler->getRunningCount() == 0);
+    scheduler->setPolicy(AssetsDownloadScheduler::Policy::FAIR);
+}
+
+int main(int /*argc*/, char * /*argv*/[])
+{
+    auto backend = std::make_shared<FakeBackend>();
+    AssetsDownloadScheduler *scheduler = AssetsDownloadScheduler::getInstance();
+    scheduler->setMaxConnections(4);
+    scheduler->setBackend(backend);
+
+    checkCancel(scheduler, backend);
+    checkPriority(scheduler, backend);
+
+    AssetsDownloadScheduler::destroyInstance();
+    printf("%s\n", s_failures == 0 ? "OK" : "FAILED");
+    return s_failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,210 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * download_table_bench: measures the memory of the download units of an update.
+ *
+ * Builds the units of N changed assets the way AssetsManagerEx used to, an
+ * unordered_map of DownloadUnit with full url and storage path strings, with
+ * the failed ones copied into a second map, then the same units in an
+ * AssetsDownloadTable with the failed ones as a set of keys. Heap bytes and
+ * allocations are counted by replacing the global operator new, so the
+ * numbers exclude the allocator's own overhead per block. Also times building
+ * the url and storage path of every unit, which the table does when a task
+ * starts.
+ *
+ * Build: g++ -std=c++17 -O2 -I<cocos2d-x> -I<cocos2d-x>/cocos
+ *            download_table_bench.cpp ../client/AssetsDownloadTable.cpp -o download_table_bench
+ *
+ * Usage: download_table_bench [--units N] [--failed N]
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../client/AssetsDownloadTable.h"
+
+USING_NS_CC_EXT;
+
+#ifdef __GNUC__
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+static size_t s_liveBytes = 0;
+static size_t s_allocations = 0;
+
+void* operator new(size_t size)
+{
+    // The size is kept in front of the block for operator delete
+    void *block = malloc(size + sizeof(std::max_align_t));
+    if (!block)
+        throw std::bad_alloc();
+    *(size_t*)block = size;
+    s_liveBytes += size;
+    s_allocations++;
+    return (char*)block + sizeof(std::max_align_t);
+}
+
+// Not inlined, so the compiler doesn't pair the free of the block with the malloc of the caller's operator new
+BENCH_NOINLINE void operator delete(void *pointer) noexcept
+{
+    if (!pointer)
+        return;
+    void *block = (char*)pointer - sizeof(std::max_align_t);
+    s_liveBytes -= *(size_t*)block;
+    s_allocations--;
+    free(block);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+//! Same layout as DownloadUnit of the engine
+struct LegacyUnit
+{
+    std::string srcUrl;
+    std::string storagePath;
+    std::string customId;
+    float size;
+};
+
+struct Footprint
+{
+    size_t bytes;
+    size_t allocations;
+};
+
+static Footprint measureLegacy(const std::vector<std::string> &keys, const std::string &packageUrl, const std::string &tempStorage, int failedCount,
+                               std::unordered_map<std::string, LegacyUnit> *units, std::unordered_map<std::string, LegacyUnit> *failed)
+{
+    size_t bytes = s_liveBytes, allocations = s_allocations;
+    for (const auto &key : keys)
+    {
+        LegacyUnit unit;
+        unit.customId = key;
+        unit.srcUrl = packageUrl + key;
+        unit.storagePath = tempStorage + key;
+        unit.size = 4096;
+        units->emplace(unit.customId, unit);
+    }
+    for (int i = 0; i < failedCount; ++i)
+    {
+        failed->emplace(keys[i], units->at(keys[i]));
+    }
+    return { s_liveBytes - bytes, s_allocations - allocations };
+}
+
+static Footprint measureTable(const std::vector<std::string> &keys, const std::string &packageUrl, const std::string &tempStorage, int failedCount,
+                              AssetsDownloadTable *units, std::unordered_set<std::string> *failed)
+{
+    size_t bytes = s_liveBytes, allocations = s_allocations;
+    for (const auto &key : keys)
+    {
+        units->add(key, packageUrl, tempStorage, key, 4096);
+    }
+    for (int i = 0; i < failedCount; ++i)
+    {
+        failed->insert(keys[i]);
+    }
+    return { s_liveBytes - bytes, s_allocations - allocations };
+}
+
+int main(int argc, char *argv[])
+{
+    int unitCount = 100000;
+    int failedCount = 1000;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--units") == 0)
+            unitCount = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--failed") == 0)
+            failedCount = atoi(argv[i + 1]);
+    }
+    if (unitCount <= 0 || failedCount < 0 || failedCount > unitCount)
+    {
+        fprintf(stderr, "Usage: download_table_bench [--units N] [--failed N]\n");
+        return 1;
+    }
+
+    // Prefixes as long as on a device, asset keys spread over subdirectories like a real tree
+    const std::string packageUrl = "https://cdn.example.com/game/android/1.4.2/remote-assets/";
+    const std::string tempStorage = "/data/user/0/com.example.game/files/hotupdate/storage_temp/";
+    std::vector<std::string> keys;
+    keys.reserve(unitCount);
+    for (int i = 0; i < unitCount; ++i)
+    {
+        char key[64];
+        snprintf(key, sizeof(key), "res/dir%02d/asset%06d.png", i % 64, i);
+        keys.push_back(key);
+    }
+
+    Footprint legacy, table;
+    double buildNs;
+    {
+        std::unordered_map<std::string, LegacyUnit> units, failed;
+        legacy = measureLegacy(keys, packageUrl, tempStorage, failedCount, &units, &failed);
+    }
+    {
+        AssetsDownloadTable units;
+        std::unordered_set<std::string> failed;
+        table = measureTable(keys, packageUrl, tempStorage, failedCount, &units, &failed);
+
+        std::string url, path;
+        size_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto &it : units)
+        {
+            units.getSrcUrl(it.first, it.second, &url);
+            units.getStoragePath(it.first, it.second, &path);
+            checksum += url.size() + path.size();
+        }
+        buildNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / unitCount;
+        if (checksum != (size_t)unitCount * (packageUrl.size() + tempStorage.size() + 2 * keys[0].size()))
+        {
+            fprintf(stderr, "Unexpected url or storage path\n");
+            return 2;
+        }
+    }
+
+    printf("%d units, %d failed\n", unitCount, failedCount);
+    printf("DownloadUnit map : %7.1f bytes/unit, %5.2f allocations/unit, %7.2f MB\n",
+           (double)legacy.bytes / unitCount, (double)legacy.allocations / unitCount, legacy.bytes / (1024.0 * 1024.0));
+    printf("unit table       : %7.1f bytes/unit, %5.2f allocations/unit, %7.2f MB\n",
+           (double)table.bytes / unitCount, (double)table.allocations / unitCount, table.bytes / (1024.0 * 1024.0));
+    printf("saved            : %.0f%%\n", legacy.bytes > 0 ? 100.0 * (1.0 - (double)table.bytes / legacy.bytes) : 0.0);
+    printf("url and path     : %7.1f ns/unit when the task starts\n", buildNs);
+    return 0;
+}
@@ -0,0 +1,337 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * drain_bench: times the main thread of an update in worker thread mode.
+ *
+ * Runs a headless AssetsManagerEx on a synthetic update of N assets: a
+ * downloader without network writes each requested file and reports it on the
+ * main thread, a few hundred per frame, and a ManualAssetsScheduler is updated
+ * once per frame like the Director's. Every call of the scheduled
+ * drainWorkerMessages is timed, as well as the whole main thread work of each
+ * frame, then their percentiles are printed. With --no-worker the same update
+ * runs on the main thread, for comparison.
+ *
+ * The trace replayer drives the manager from the calling thread without the
+ * worker, so the synthetic downloader is used instead.
+ *
+ * Build: g++ -std=c++17 -O2 -I<cocos2d-x> -I<cocos2d-x>/cocos -I<cocos2d-x>/external
+ *            -I<cocos2d-x>/extensions/assets-manager drain_bench.cpp
+ *            the sources of ../client but HelloWorldScene.cpp
+ *            -L<cocos2d-x build>/lib -lcocos2d -lpthread -o drain_bench
+ *
+ * Usage: drain_bench [--assets N] [--per-frame N] [--frame-ms N] [--no-worker]
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../client/AssetsManagerEx.h"
+#include "base/CCAutoreleasePool.h"
+
+USING_NS_CC;
+USING_NS_CC_EXT;
+
+//! Same key as the timer of AssetsManagerEx::Core running drainWorkerMessages
+static const char* const WORKER_SCHEDULE_KEY = "AssetsManagerExWorker";
+
+static const int ASSET_SIZE = 64;
+
+/**
+ * @brief   Manual scheduler timing the calls of the worker drain
+ */
+class TimingScheduler : public ManualAssetsScheduler
+{
+public:
+    virtual void schedule(const std::function<void(float)> &callback, void *target, float interval, const std::string &key) override
+    {
+        if (key != WORKER_SCHEDULE_KEY)
+        {
+            ManualAssetsScheduler::schedule(callback, target, interval, key);
+            return;
+        }
+        std::vector<double> *drains = &_drains;
+        ManualAssetsScheduler::schedule([callback, drains](float dt) {
+            auto start = std::chrono::steady_clock::now();
+            callback(dt);
+            drains->push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }, target, interval, key);
+    }
+
+    std::vector<double>& getDrains() { return _drains; }
+
+private:
+    std::vector<double> _drains;
+};
+
+/**
+ * @brief   Downloader without network: the manifest is copied from a file, assets are written with
+ *          ASSET_SIZE bytes. Tasks are completed by complete(), on the main thread like network::Downloader.
+ */
+class SyntheticDownloader : public IAssetsDownloader
+{
+public:
+    explicit SyntheticDownloader(const std::string &remoteManifestPath)
+    : _remoteManifestPath(remoteManifestPath)
+    {
+    }
+
+    virtual void createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier) override
+    {
+        network::DownloadTask task;
+        task.requestURL = srcUrl;
+        task.storagePath = storagePath;
+        task.identifier = identifier;
+        _tasks.push_back(task);
+    }
+
+    virtual void cancelAll() override
+    {
+        _tasks.clear();
+    }
+
+    //! Complete at most count tasks, the manifest first
+    void complete(int count)
+    {
+        for (int i = 0; i < count && !_tasks.empty(); ++i)
+        {
+            network::DownloadTask task = _tasks.front();
+            _tasks.pop_front();
+            if (!writeFile(task))
+            {
+                if (onTaskError)
+                    onTaskError(task, network::DownloadTask::ERROR_FILE_OP_FAILED, 0, "Can't write " + task.storagePath);
+                continue;
+            }
+            int64_t size = task.identifier == AssetsManagerEx::MANIFEST_ID ? _manifestSize : ASSET_SIZE;
+            if (onTaskProgress)
+                onTaskProgress(task, size, size, size);
+            if (onFileTaskSuccess)
+                onFileTaskSuccess(task);
+        }
+    }
+
+    size_t getPendingCount() const { return _tasks.size(); }
+
+private:
+    bool writeFile(const network::DownloadTask &task)
+    {
+        FILE *fp = fopen(task.storagePath.c_str(), "wb");
+        if (!fp)
+            return false;
+        bool written;
+        if (task.identifier == AssetsManagerEx::MANIFEST_ID)
+        {
+            FILE *src = fopen(_remoteManifestPath.c_str(), "rb");
+            written = src != nullptr;
+            char buffer[65536];
+            size_t read;
+            _manifestSize = 0;
+            while (src && (read = fread(buffer, 1, sizeof(buffer), src)) > 0)
+            {
+                written = written && fwrite(buffer, 1, read, fp) == read;
+                _manifestSize += read;
+            }
+            if (src)
+                fclose(src);
+        }
+        else
+        {
+            char content[ASSET_SIZE];
+            memset(content, 'a', sizeof(content));
+            written = fwrite(content, 1, sizeof(content), fp) == sizeof(content);
+        }
+        return fclose(fp) == 0 && written;
+    }
+
+    std::string _remoteManifestPath;
+    std::deque<network::DownloadTask> _tasks;
+    int64_t _manifestSize = 0;
+};
+
+static bool writeManifest(const std::string &path, const char *version, int assetCount)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    fprintf(fp, "{\n\t\"packageUrl\" : \"https://cdn.example.com/game/remote-assets/\",\n"
+                "\t\"remoteManifestUrl\" : \"https://cdn.example.com/game/project.manifest\",\n"
+                "\t\"version\" : \"%s\",\n\t\"engineVersion\" : \"3.x\",\n\t\"assets\" : {\n", version);
+    for (int i = 0; i < assetCount; ++i)
+    {
+        fprintf(fp, "\t\t\"res/dir%02d/asset%06d.png\" : {\n\t\t\t\"md5\" : \"%08x%08x%08x%08x\",\n\t\t\t\"size\" : %d\n\t\t}%s\n",
+                i % 64, i, i, i * 7, i * 13, i * 31, ASSET_SIZE, i + 1 < assetCount ? "," : "");
+    }
+    fprintf(fp, "\t},\n\t\"searchPaths\" : [\n\t]\n}\n");
+    return fclose(fp) == 0;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+    return values[index];
+}
+
+static void printTimes(const char *name, const std::vector<double> &times)
+{
+    double total = 0, max = 0;
+    size_t overMs = 0;
+    for (double time : times)
+    {
+        total += time;
+        max = std::max(max, time);
+        if (time > 1000)
+            overMs++;
+    }
+    printf("%-18s: %6zu calls, mean %8.1f us, p50 %8.1f us, p95 %8.1f us, p99 %8.1f us, max %8.1f us, %zu over 1 ms\n",
+           name, times.size(), times.empty() ? 0 : total / times.size(), percentile(times, 0.5), percentile(times, 0.95),
+           percentile(times, 0.99), max, overMs);
+}
+
+int main(int argc, char *argv[])
+{
+    int assetCount = 50000;
+    int perFrame = 200;
+    int frameMs = 16;
+    bool workerThread = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--no-worker") == 0)
+            workerThread = false;
+        else if (i + 1 < argc && strcmp(argv[i], "--assets") == 0)
+            assetCount = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--per-frame") == 0)
+            perFrame = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--frame-ms") == 0)
+            frameMs = atoi(argv[++i]);
+    }
+    if (assetCount <= 0 || perFrame <= 0 || frameMs < 0)
+    {
+        fprintf(stderr, "Usage: drain_bench [--assets N] [--per-frame N] [--frame-ms N] [--no-worker]\n");
+        return 1;
+    }
+
+    char dirTemplate[] = "/tmp/drain_bench_XXXXXX";
+    if (!mkdtemp(dirTemplate))
+    {
+        fprintf(stderr, "Can't create a temporary directory\n");
+        return 1;
+    }
+    const std::string dir = std::string(dirTemplate) + "/";
+    if (!writeManifest(dir + "project.manifest", "1.0.0", 0) || !writeManifest(dir + "remote.manifest", "1.0.1", assetCount))
+    {
+        fprintf(stderr, "Can't write the manifests in %s\n", dir.c_str());
+        return 1;
+    }
+
+    auto scheduler = std::make_shared<TimingScheduler>();
+    auto downloader = std::make_shared<SyntheticDownloader>(dir + "remote.manifest");
+    bool finished = false;
+    int updated = 0;
+    EventAssetsManagerEx::EventCode result = EventAssetsManagerEx::EventCode::UPDATE_FAILED;
+
+    AssetsManagerExEnv env;
+    env.fileUtils = FileUtils::getInstance();
+    env.downloader = downloader;
+    env.taskRunner = std::make_shared<InlineTaskRunner>();
+    env.scheduler = scheduler;
+    env.workerThread = workerThread;
+    env.eventCallback = [&](EventAssetsManagerEx *event) {
+        switch (event->getEventCode())
+        {
+            case EventAssetsManagerEx::EventCode::ASSET_UPDATED:
+                updated++;
+                break;
+            case EventAssetsManagerEx::EventCode::UPDATE_FINISHED:
+            case EventAssetsManagerEx::EventCode::UPDATE_FAILED:
+            case EventAssetsManagerEx::EventCode::ALREADY_UP_TO_DATE:
+            case EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST:
+            case EventAssetsManagerEx::EventCode::ERROR_DOWNLOAD_MANIFEST:
+            case EventAssetsManagerEx::EventCode::ERROR_PARSE_MANIFEST:
+                result = event->getEventCode();
+                finished = true;
+                break;
+            default:
+                break;
+        }
+    };
+
+    AssetsManagerEx *manager = AssetsManagerEx::create(dir + "project.manifest", dir + "storage/", env);
+    if (!manager)
+    {
+        fprintf(stderr, "Can't create the manager\n");
+        return 1;
+    }
+    manager->retain();
+
+    std::vector<double> frames;
+    auto start = std::chrono::steady_clock::now();
+    auto frameStart = start;
+    manager->update();
+    // A stuck update is given up after a minute of frames without download
+    int idleFrames = 0;
+    while (!finished && idleFrames < 60 * 60)
+    {
+        auto workStart = std::chrono::steady_clock::now();
+        idleFrames = downloader->getPendingCount() > 0 ? 0 : idleFrames + 1;
+        downloader->complete(perFrame);
+        scheduler->update(frameMs / 1000.0f);
+        auto workEnd = std::chrono::steady_clock::now();
+        frames.push_back(std::chrono::duration<double, std::micro>(workEnd - workStart).count());
+
+        frameStart += std::chrono::milliseconds(frameMs);
+        if (frameStart > workEnd)
+            std::this_thread::sleep_for(frameStart - workEnd);
+        else
+            frameStart = workEnd;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%d assets, %d per frame, %d ms frames, %s\n", assetCount, perFrame, frameMs, workerThread ? "worker thread" : "main thread");
+    printf("result            : %s in %.2f s, %zu frames, %d ASSET_UPDATED events\n",
+           result == EventAssetsManagerEx::EventCode::UPDATE_FINISHED ? "finished" : finished ? "failed" : "stuck",
+           seconds, frames.size(), updated);
+    printTimes("main thread/frame", frames);
+    if (workerThread)
+    {
+        printTimes("drain/frame", scheduler->getDrains());
+    }
+
+    manager->release();
+    PoolManager::getInstance()->getCurrentPool()->clear();
+    FileUtils::getInstance()->removeDirectory(dir);
+    return result == EventAssetsManagerEx::EventCode::UPDATE_FINISHED ? 0 : 2;
+}
@@ -0,0 +1,735 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * manifest_gen: generates project.manifest and version.manifest for AssetsManagerEx.
+ *
+ * Scans an asset tree, hashes every file with md5 on all cores and writes the
+ * md5, size and compressed flag of each asset. Hashes are cached by
+ * (path, mtime, size) so regenerating a large tree after a small change only
+ * reads the changed files.
+ *
+ * With --shard-depth, assets are also split by their first directories into
+ * shard files named by their md5, listed by a root manifest without assets.
+ * Clients pointed at the root manifest only download the shards that changed,
+ * so every manifest written then has the root manifest as remoteManifestUrl.
+ *
+ * Build: g++ -std=c++17 -O2 -pthread manifest_gen.cpp -o manifest_gen
+ *        (MSVC: cl /std:c++17 /O2 /EHsc manifest_gen.cpp)
+ *
+ * Usage: manifest_gen --root <asset dir> --package-url <url> [options]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+#define MANIFEST_FILENAME       "project.manifest"
+#define COMPACT_MANIFEST_NAME   "project.min.manifest"
+#define VERSION_FILENAME        "version.manifest"
+#define SHARDED_MANIFEST_NAME   "project.shards.manifest"
+#define SHARD_DIRECTORY         "shards"
+#define CACHE_FILENAME          ".manifest_cache"
+
+#define READ_BUFFER_SIZE        (1 << 20)
+
+// MD5 (RFC 1321)
+
+namespace {
+
+struct Md5
+{
+    uint32_t state[4];
+    uint64_t length;
+    unsigned char pending[64];
+    size_t pendingSize;
+
+    Md5() : length(0), pendingSize(0)
+    {
+        state[0] = 0x67452301;
+        state[1] = 0xefcdab89;
+        state[2] = 0x98badcfe;
+        state[3] = 0x10325476;
+    }
+
+    static inline uint32_t rotl(uint32_t x, int c) { return (x << c) | (x >> (32 - c)); }
+
+    // Rounds are fully unrolled with constant shifts and sines so the compiler
+    // keeps the whole block in registers.
+    void block(const unsigned char *p)
+    {
+        uint32_t x[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            x[i] = (uint32_t)p[i*4] | ((uint32_t)p[i*4+1] << 8) | ((uint32_t)p[i*4+2] << 16) | ((uint32_t)p[i*4+3] << 24);
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define MD5_STEP(f, a, b, c, d, k, s, t) a = b + rotl(a + f(b, c, d) + x[k] + t, s)
+
+        MD5_STEP(MD5_F, a, b, c, d,  0,  7, 0xd76aa478); MD5_STEP(MD5_F, d, a, b, c,  1, 12, 0xe8c7b756);
+        MD5_STEP(MD5_F, c, d, a, b,  2, 17, 0x242070db); MD5_STEP(MD5_F, b, c, d, a,  3, 22, 0xc1bdceee);
+        MD5_STEP(MD5_F, a, b, c, d,  4,  7, 0xf57c0faf); MD5_STEP(MD5_F, d, a, b, c,  5, 12, 0x4787c62a);
+        MD5_STEP(MD5_F, c, d, a, b,  6, 17, 0xa8304613); MD5_STEP(MD5_F, b, c, d, a,  7, 22, 0xfd469501);
+        MD5_STEP(MD5_F, a, b, c, d,  8,  7, 0x698098d8); MD5_STEP(MD5_F, d, a, b, c,  9, 12, 0x8b44f7af);
+        MD5_STEP(MD5_F, c, d, a, b, 10, 17, 0xffff5bb1); MD5_STEP(MD5_F, b, c, d, a, 11, 22, 0x895cd7be);
+        MD5_STEP(MD5_F, a, b, c, d, 12,  7, 0x6b901122); MD5_STEP(MD5_F, d, a, b, c, 13, 12, 0xfd987193);
+        MD5_STEP(MD5_F, c, d, a, b, 14, 17, 0xa679438e); MD5_STEP(MD5_F, b, c, d, a, 15, 22, 0x49b40821);
+
+        MD5_STEP(MD5_G, a, b, c, d,  1,  5, 0xf61e2562); MD5_STEP(MD5_G, d, a, b, c,  6,  9, 0xc040b340);
+        MD5_STEP(MD5_G, c, d, a, b, 11, 14, 0x265e5a51); MD5_STEP(MD5_G, b, c, d, a,  0, 20, 0xe9b6c7aa);
+        MD5_STEP(MD5_G, a, b, c, d,  5,  5, 0xd62f105d); MD5_STEP(MD5_G, d, a, b, c, 10,  9, 0x02441453);
+        MD5_STEP(MD5_G, c, d, a, b, 15, 14, 0xd8a1e681); MD5_STEP(MD5_G, b, c, d, a,  4, 20, 0xe7d3fbc8);
+        MD5_STEP(MD5_G, a, b, c, d,  9,  5, 0x21e1cde6); MD5_STEP(MD5_G, d, a, b, c, 14,  9, 0xc33707d6);
+        MD5_STEP(MD5_G, c, d, a, b,  3, 14, 0xf4d50d87); MD5_STEP(MD5_G, b, c, d, a,  8, 20, 0x455a14ed);
+        MD5_STEP(MD5_G, a, b, c, d, 13,  5, 0xa9e3e905); MD5_STEP(MD5_G, d, a, b, c,  2,  9, 0xfcefa3f8);
+        MD5_STEP(MD5_G, c, d, a, b,  7, 14, 0x676f02d9); MD5_STEP(MD5_G, b, c, d, a, 12, 20, 0x8d2a4c8a);
+
+        MD5_STEP(MD5_H, a, b, c, d,  5,  4, 0xfffa3942); MD5_STEP(MD5_H, d, a, b, c,  8, 11, 0x8771f681);
+        MD5_STEP(MD5_H, c, d, a, b, 11, 16, 0x6d9d6122); MD5_STEP(MD5_H, b, c, d, a, 14, 23, 0xfde5380c);
+        MD5_STEP(MD5_H, a, b, c, d,  1,  4, 0xa4beea44); MD5_STEP(MD5_H, d, a, b, c,  4, 11, 0x4bdecfa9);
+        MD5_STEP(MD5_H, c, d, a, b,  7, 16, 0xf6bb4b60); MD5_STEP(MD5_H, b, c, d, a, 10, 23, 0xbebfbc70);
+        MD5_STEP(MD5_H, a, b, c, d, 13,  4, 0x289b7ec6); MD5_STEP(MD5_H, d, a, b, c,  0, 11, 0xeaa127fa);
+        MD5_STEP(MD5_H, c, d, a, b,  3, 16, 0xd4ef3085); MD5_STEP(MD5_H, b, c, d, a,  6, 23, 0x04881d05);
+        MD5_STEP(MD5_H, a, b, c, d,  9,  4, 0xd9d4d039); MD5_STEP(MD5_H, d, a, b, c, 12, 11, 0xe6db99e5);
+        MD5_STEP(MD5_H, c, d, a, b, 15, 16, 0x1fa27cf8); MD5_STEP(MD5_H, b, c, d, a,  2, 23, 0xc4ac5665);
+
+        MD5_STEP(MD5_I, a, b, c, d,  0,  6, 0xf4292244); MD5_STEP(MD5_I, d, a, b, c,  7, 10, 0x432aff97);
+        MD5_STEP(MD5_I, c, d, a, b, 14, 15, 0xab9423a7); MD5_STEP(MD5_I, b, c, d, a,  5, 21, 0xfc93a039);
+        MD5_STEP(MD5_I, a, b, c, d, 12,  6, 0x655b59c3); MD5_STEP(MD5_I, d, a, b, c,  3, 10, 0x8f0ccc92);
+        MD5_STEP(MD5_I, c, d, a, b, 10, 15, 0xffeff47d); MD5_STEP(MD5_I, b, c, d, a,  1, 21, 0x85845dd1);
+        MD5_STEP(MD5_I, a, b, c, d,  8,  6, 0x6fa87e4f); MD5_STEP(MD5_I, d, a, b, c, 15, 10, 0xfe2ce6e0);
+        MD5_STEP(MD5_I, c, d, a, b,  6, 15, 0xa3014314); MD5_STEP(MD5_I, b, c, d, a, 13, 21, 0x4e0811a1);
+        MD5_STEP(MD5_I, a, b, c, d,  4,  6, 0xf7537e82); MD5_STEP(MD5_I, d, a, b, c, 11, 10, 0xbd3af235);
+        MD5_STEP(MD5_I, c, d, a, b,  2, 15, 0x2ad7d2bb); MD5_STEP(MD5_I, b, c, d, a,  9, 21, 0xeb86d391);
+
+#undef MD5_STEP
+#undef MD5_I
+#undef MD5_H
+#undef MD5_G
+#undef MD5_F
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    }
+
+    void update(const unsigned char *data, size_t size)
+    {
+        length += size;
+        if (pendingSize > 0)
+        {
+            size_t n = std::min(size, 64 - pendingSize);
+            memcpy(pending + pendingSize, data, n);
+            pendingSize += n;
+            data += n;
+            size -= n;
+            if (pendingSize < 64)
+                return;
+            block(pending);
+            pendingSize = 0;
+        }
+        // Hash full blocks straight from the caller's buffer
+        for (; size >= 64; data += 64, size -= 64)
+        {
+            block(data);
+        }
+        memcpy(pending, data, size);
+        pendingSize = size;
+    }
+
+    std::string hex()
+    {
+        uint64_t bits = length * 8;
+        unsigned char pad[72] = { 0x80 };
+        size_t padSize = (pendingSize < 56 ? 56 : 120) - pendingSize;
+        for (int i = 0; i < 8; ++i)
+        {
+            pad[padSize + i] = (unsigned char)(bits >> (8 * i));
+        }
+        update(pad, padSize + 8);
+
+        static const char digits[] = "0123456789abcdef";
+        std::string out(32, '0');
+        for (int i = 0; i < 16; ++i)
+        {
+            unsigned char byte = (unsigned char)(state[i / 4] >> (8 * (i % 4)));
+            out[i*2] = digits[byte >> 4];
+            out[i*2+1] = digits[byte & 0xf];
+        }
+        return out;
+    }
+};
+
+// Scanning and caching
+
+struct Entry
+{
+    std::string path;       // relative, '/' separated
+    uint64_t size;
+    int64_t mtime;
+    std::string md5;
+    bool compressed;
+    std::vector<std::string> tags;
+};
+
+struct CacheKey
+{
+    uint64_t size;
+    int64_t mtime;
+    std::string md5;
+};
+
+struct Options
+{
+    std::string root;
+    std::string out;
+    std::string cache;
+    std::string packageUrl;
+    std::string manifestUrl;
+    std::string versionUrl;
+    std::string version = "1.0.0";
+    std::string engineVersion;
+    std::vector<std::string> searchPaths;
+    std::vector<std::string> compressedExts;
+    std::vector<std::pair<std::string, std::string>> tags;   // tag, path pattern
+    unsigned jobs = 0;
+    bool compact = false;
+    int shardDepth = 0;
+};
+
+struct Shard
+{
+    std::string path;       // shared directories, "" for shallower assets
+    std::string md5;        // of the shard file
+    std::vector<const Entry*> entries;
+};
+
+bool hashFile(const std::string &path, std::vector<unsigned char> &buffer, std::string *md5)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+    Md5 ctx;
+    size_t n;
+    while ((n = fread(buffer.data(), 1, buffer.size(), fp)) > 0)
+    {
+        ctx.update(buffer.data(), n);
+    }
+    bool ok = !ferror(fp);
+    fclose(fp);
+    if (ok)
+        *md5 = ctx.hex();
+    return ok;
+}
+
+bool endsWith(const std::string &s, const std::string &suffix)
+{
+    if (suffix.size() > s.size())
+        return false;
+    return std::equal(suffix.rbegin(), suffix.rend(), s.rbegin(), [](char a, char b) {
+        return tolower((unsigned char)a) == tolower((unsigned char)b);
+    });
+}
+
+void loadCache(const std::string &path, std::unordered_map<std::string, CacheKey> *cache)
+{
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        // mtime \t size \t md5 \t path
+        std::istringstream fields(line);
+        CacheKey key;
+        std::string rel;
+        if (fields >> key.mtime >> key.size >> key.md5 && fields.get() == '\t' && std::getline(fields, rel))
+        {
+            cache->emplace(rel, key);
+        }
+    }
+}
+
+void saveCache(const std::string &path, const std::vector<Entry> &entries)
+{
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (const auto &e : entries)
+        {
+            out << e.mtime << '\t' << e.size << '\t' << e.md5 << '\t' << e.path << '\n';
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+}
+
+std::string escape(const std::string &s)
+{
+    std::string out;
+    out.reserve(s.size() + 2);
+    for (char c : s)
+    {
+        switch (c)
+        {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20)
+                {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                }
+                else
+                {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+// With shards, the root manifest next to the one at --manifest-url
+std::string remoteManifestUrl(const Options &opt)
+{
+    if (opt.shardDepth <= 0 || opt.manifestUrl.empty())
+        return opt.manifestUrl;
+    return opt.manifestUrl.substr(0, opt.manifestUrl.find_last_of('/') + 1) + SHARDED_MANIFEST_NAME;
+}
+
+void writeHeader(std::string &out, const Options &opt, const char *nl, const char *indent, const char *sep)
+{
+    out += "{"; out += nl;
+    out += indent; out += "\"packageUrl\""; out += sep; out += "\"" + escape(opt.packageUrl) + "\","; out += nl;
+    out += indent; out += "\"remoteManifestUrl\""; out += sep; out += "\"" + escape(remoteManifestUrl(opt)) + "\","; out += nl;
+    out += indent; out += "\"remoteVersionUrl\""; out += sep; out += "\"" + escape(opt.versionUrl) + "\","; out += nl;
+    out += indent; out += "\"version\""; out += sep; out += "\"" + escape(opt.version) + "\","; out += nl;
+    out += indent; out += "\"engineVersion\""; out += sep; out += "\"" + escape(opt.engineVersion) + "\"";
+}
+
+// Same cut as ManifestShard::pathOf on the client
+std::string shardOf(const std::string &path, int depth)
+{
+    size_t end = 0;
+    for (int i = 0; i < depth; ++i)
+    {
+        end = path.find('/', end);
+        if (end == std::string::npos)
+            return "";
+        ++end;
+    }
+    return path.substr(0, end);
+}
+
+void writeAssets(std::string &out, const std::vector<const Entry*> &entries, bool compact)
+{
+    const char *nl = compact ? "" : "\n";
+    const char *sep = compact ? ":" : " : ";
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const Entry &e = *entries[i];
+        if (!compact) out += "        ";
+        out += "\"" + escape(e.path) + "\""; out += sep; out += "{";
+        out += "\"md5\""; out += sep; out += "\"" + e.md5 + "\",";
+        if (!compact) out += " ";
+        out += "\"size\""; out += sep; out += std::to_string(e.size);
+        if (e.compressed)
+        {
+            out += ",";
+            if (!compact) out += " ";
+            out += "\"compressed\""; out += sep; out += "true";
+        }
+        if (!e.tags.empty())
+        {
+            out += ",";
+            if (!compact) out += " ";
+            out += "\"tags\""; out += sep; out += "[";
+            for (size_t t = 0; t < e.tags.size(); ++t)
+            {
+                out += "\"" + escape(e.tags[t]) + "\"";
+                if (t + 1 < e.tags.size()) out += ",";
+            }
+            out += "]";
+        }
+        out += "}";
+        if (i + 1 < entries.size()) out += ",";
+        out += nl;
+    }
+}
+
+void writeShards(std::string &out, const Options &opt, const std::vector<Shard> &shards, const char *nl, const char *indent, const char *sep)
+{
+    out += indent; out += "\"shardDepth\""; out += sep; out += std::to_string(opt.shardDepth); out += ","; out += nl;
+    out += indent; out += "\"shards\""; out += sep; out += "{"; out += nl;
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        const Shard &shard = shards[i];
+        if (*nl) out += "        ";
+        out += "\"" + escape(shard.path) + "\""; out += sep; out += "{";
+        out += "\"md5\""; out += sep; out += "\"" + shard.md5 + "\",";
+        if (*nl) out += " ";
+        out += "\"url\""; out += sep; out += "\"" SHARD_DIRECTORY "/" + shard.md5 + ".manifest\"";
+        out += "}";
+        if (i + 1 < shards.size()) out += ",";
+        out += nl;
+    }
+    out += indent; out += "},"; out += nl;
+}
+
+void writeFooter(std::string &out, const Options &opt, const char *nl, const char *indent, const char *sep)
+{
+    out += indent; out += "\"searchPaths\""; out += sep; out += "[";
+    for (size_t i = 0; i < opt.searchPaths.size(); ++i)
+    {
+        out += "\"" + escape(opt.searchPaths[i]) + "\"";
+        if (i + 1 < opt.searchPaths.size()) out += ",";
+    }
+    out += "]"; out += nl;
+    out += "}"; out += nl;
+}
+
+std::string renderManifest(const Options &opt, const std::vector<const Entry*> &entries, const std::vector<Shard> &shards, bool compact)
+{
+    const char *nl = compact ? "" : "\n";
+    const char *indent = compact ? "" : "    ";
+    const char *sep = compact ? ":" : " : ";
+    std::string out;
+    out.reserve(entries.size() * 96 + shards.size() * 128 + 512);
+    writeHeader(out, opt, nl, indent, sep);
+    out += ","; out += nl;
+    out += indent; out += "\"assets\""; out += sep; out += "{"; out += nl;
+    writeAssets(out, entries, compact);
+    out += indent; out += "},"; out += nl;
+    if (!shards.empty())
+        writeShards(out, opt, shards, nl, indent, sep);
+    writeFooter(out, opt, nl, indent, sep);
+    return out;
+}
+
+// Root of a sharded manifest: the header and the shard table, no asset
+std::string renderShardedManifest(const Options &opt, const std::vector<Shard> &shards)
+{
+    std::string out;
+    out.reserve(shards.size() * 128 + 512);
+    writeHeader(out, opt, "\n", "    ", " : ");
+    out += ",\n";
+    writeShards(out, opt, shards, "\n", "    ", " : ");
+    writeFooter(out, opt, "\n", "    ", " : ");
+    return out;
+}
+
+// Shard file, compact since it's only read by clients
+std::string renderShard(const Shard &shard)
+{
+    std::string out;
+    out.reserve(shard.entries.size() * 96 + 16);
+    out += "{\"assets\":{";
+    writeAssets(out, shard.entries, true);
+    out += "}}";
+    return out;
+}
+
+std::string renderVersion(const Options &opt)
+{
+    std::string out;
+    writeHeader(out, opt, "\n", "    ", " : ");
+    out += "\n}\n";
+    return out;
+}
+
+bool writeFile(const std::string &path, const std::string &content)
+{
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write(content.data(), (std::streamsize)content.size());
+        if (!out)
+            return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    return !ec;
+}
+
+void usage()
+{
+    fprintf(stderr,
+            "Usage: manifest_gen --root <dir> --package-url <url> [options]\n"
+            "  --out <dir>              output directory (default: root)\n"
+            "  --manifest-url <url>     remoteManifestUrl, with --shard-depth its file name is\n"
+            "                           replaced by " SHARDED_MANIFEST_NAME "\n"
+            "  --version-url <url>      remoteVersionUrl\n"
+            "  --version <ver>          manifest version (default 1.0.0)\n"
+            "  --engine-version <ver>   engineVersion\n"
+            "  --search-path <path>     add a search path, repeatable\n"
+            "  --compressed-ext <ext>   mark files with this suffix compressed (default .zip), repeatable\n"
+            "  --tag <dim:value> <pat>  tag the files whose path contains pat with a variant, repeatable\n"
+            "  --cache <file>           hash cache (default <out>/" CACHE_FILENAME ")\n"
+            "  --jobs <n>               hashing threads (default: all cores)\n"
+            "  --compact                also write minified " COMPACT_MANIFEST_NAME "\n"
+            "  --shard-depth <n>        also write " SHARDED_MANIFEST_NAME " and its shards under " SHARD_DIRECTORY "/,\n"
+            "                           one per directory <n> levels deep\n");
+}
+
+bool parseArgs(int argc, char **argv, Options *opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        auto next = [&](std::string *dst) {
+            if (i + 1 >= argc)
+                return false;
+            *dst = argv[++i];
+            return true;
+        };
+        std::string value;
+        bool ok = true;
+        if (arg == "--root") ok = next(&opt->root);
+        else if (arg == "--out") ok = next(&opt->out);
+        else if (arg == "--cache") ok = next(&opt->cache);
+        else if (arg == "--package-url") ok = next(&opt->packageUrl);
+        else if (arg == "--manifest-url") ok = next(&opt->manifestUrl);
+        else if (arg == "--version-url") ok = next(&opt->versionUrl);
+        else if (arg == "--version") ok = next(&opt->version);
+        else if (arg == "--engine-version") ok = next(&opt->engineVersion);
+        else if (arg == "--search-path") { ok = next(&value); opt->searchPaths.push_back(value); }
+        else if (arg == "--compressed-ext") { ok = next(&value); opt->compressedExts.push_back(value); }
+        else if (arg == "--tag")
+        {
+            std::string pattern;
+            ok = next(&value) && next(&pattern) && value.find(':') != std::string::npos;
+            opt->tags.emplace_back(value, pattern);
+        }
+        else if (arg == "--jobs") { ok = next(&value); opt->jobs = (unsigned)atoi(value.c_str()); }
+        else if (arg == "--compact") opt->compact = true;
+        else if (arg == "--shard-depth") { ok = next(&value); opt->shardDepth = atoi(value.c_str()); ok = ok && opt->shardDepth > 0; }
+        else ok = false;
+        if (!ok)
+        {
+            fprintf(stderr, "manifest_gen: bad argument %s\n", arg.c_str());
+            return false;
+        }
+    }
+    if (opt->root.empty() || opt->packageUrl.empty())
+        return false;
+    if (opt->out.empty())
+        opt->out = opt->root;
+    if (opt->cache.empty())
+        opt->cache = (fs::path(opt->out) / CACHE_FILENAME).string();
+    if (opt->compressedExts.empty())
+        opt->compressedExts.push_back(".zip");
+    if (opt->jobs == 0)
+        opt->jobs = std::max(1u, std::thread::hardware_concurrency());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    if (!parseArgs(argc, argv, &opt))
+    {
+        usage();
+        return 1;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    const fs::path root(opt.root);
+    std::error_code ec;
+    if (!fs::is_directory(root, ec))
+    {
+        fprintf(stderr, "manifest_gen: %s is not a directory\n", opt.root.c_str());
+        return 1;
+    }
+    const fs::path outDir = fs::absolute(opt.out);
+    const fs::path cachePath = fs::absolute(opt.cache);
+
+    // 1. Walk the tree, skipping our own outputs
+    std::vector<Entry> entries;
+    for (fs::recursive_directory_iterator it(root, ec), end; it != end; it.increment(ec))
+    {
+        if (ec)
+            break;
+        if (!it->is_regular_file(ec))
+            continue;
+        fs::path abs = fs::absolute(it->path());
+        std::string name = it->path().filename().string();
+        if (abs.parent_path() == outDir &&
+            (name == MANIFEST_FILENAME || name == COMPACT_MANIFEST_NAME || name == VERSION_FILENAME || name == SHARDED_MANIFEST_NAME || endsWith(name, ".tmp")))
+            continue;
+        if (abs.parent_path() == outDir / SHARD_DIRECTORY)
+            continue;
+        if (abs == cachePath)
+            continue;
+
+        Entry e;
+        e.path = fs::relative(it->path(), root, ec).generic_string();
+        e.size = (uint64_t)it->file_size(ec);
+        e.mtime = (int64_t)it->last_write_time(ec).time_since_epoch().count();
+        e.compressed = false;
+        for (const auto &ext : opt.compressedExts)
+        {
+            if (endsWith(e.path, ext))
+                e.compressed = true;
+        }
+        for (const auto &tag : opt.tags)
+        {
+            if (e.path.find(tag.second) != std::string::npos)
+                e.tags.push_back(tag.first);
+        }
+        entries.push_back(std::move(e));
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.path < b.path; });
+
+    // 2. Reuse cached hashes for files whose (mtime, size) did not change
+    std::unordered_map<std::string, CacheKey> cache;
+    loadCache(opt.cache, &cache);
+    std::vector<size_t> work;
+    uint64_t bytesToHash = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        auto cached = cache.find(entries[i].path);
+        if (cached != cache.end() && cached->second.size == entries[i].size && cached->second.mtime == entries[i].mtime)
+        {
+            entries[i].md5 = cached->second.md5;
+        }
+        else
+        {
+            work.push_back(i);
+            bytesToHash += entries[i].size;
+        }
+    }
+    // Largest files first so one big file doesn't finish last on a single core
+    std::sort(work.begin(), work.end(), [&entries](size_t a, size_t b) { return entries[a].size > entries[b].size; });
+
+    // 3. Hash the rest in parallel
+    std::atomic<size_t> cursor(0);
+    std::atomic<int> failures(0);
+    unsigned jobs = (unsigned)std::min<size_t>(opt.jobs, std::max<size_t>(1, work.size()));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < jobs; ++t)
+    {
+        workers.emplace_back([&]() {
+            std::vector<unsigned char> buffer(READ_BUFFER_SIZE);
+            size_t idx;
+            while ((idx = cursor.fetch_add(1)) < work.size())
+            {
+                Entry &e = entries[work[idx]];
+                if (!hashFile((root / e.path).string(), buffer, &e.md5))
+                {
+                    fprintf(stderr, "manifest_gen: can not read %s\n", e.path.c_str());
+                    failures++;
+                }
+            }
+        });
+    }
+    for (auto &w : workers)
+    {
+        w.join();
+    }
+    if (failures > 0)
+        return 2;
+
+    // 4. Cut the shards, each named by the md5 of its file so unchanged ones keep their url
+    std::vector<const Entry*> all;
+    all.reserve(entries.size());
+    std::vector<Shard> shards;
+    std::unordered_map<std::string, size_t> shardIndex;
+    for (const auto &e : entries)
+    {
+        all.push_back(&e);
+        if (opt.shardDepth > 0)
+        {
+            std::string path = shardOf(e.path, opt.shardDepth);
+            auto found = shardIndex.emplace(path, shards.size());
+            if (found.second)
+            {
+                shards.emplace_back();
+                shards.back().path = path;
+            }
+            shards[found.first->second].entries.push_back(&e);
+        }
+    }
+    std::vector<std::string> shardFiles;
+    shardFiles.reserve(shards.size());
+    for (auto &shard : shards)
+    {
+        shardFiles.push_back(renderShard(shard));
+        Md5 ctx;
+        ctx.update((const unsigned char*)shardFiles.back().data(), shardFiles.back().size());
+        shard.md5 = ctx.hex();
+    }
+
+    // 5. Emit manifests side by side, then persist the cache
+    fs::create_directories(outDir, ec);
+    bool ok = writeFile((outDir / MANIFEST_FILENAME).string(), renderManifest(opt, all, shards, false));
+    ok = ok && writeFile((outDir / VERSION_FILENAME).string(), renderVersion(opt));
+    if (opt.compact)
+        ok = ok && writeFile((outDir / COMPACT_MANIFEST_NAME).string(), renderManifest(opt, all, shards, true));
+    if (!shards.empty())
+    {
+        // Shards of earlier versions are kept, clients still checking them may ask for them
+        fs::create_directories(outDir / SHARD_DIRECTORY, ec);
+        for (size_t i = 0; i < shards.size() && ok; ++i)
+        {
+            fs::path shardPath = outDir / SHARD_DIRECTORY / (shards[i].md5 + ".manifest");
+            if (!fs::exists(shardPath, ec))
+                ok = writeFile(shardPath.string(), shardFiles[i]);
+        }
+        ok = ok && writeFile((outDir / SHARDED_MANIFEST_NAME).string(), renderShardedManifest(opt, shards));
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "manifest_gen: can not write manifests to %s\n", outDir.string().c_str());
+        return 3;
+    }
+    saveCache(opt.cache, entries);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    printf("manifest_gen: %zu assets, %zu shards, %zu hashed (%.1f MB), %zu from cache, %u threads, %.3f s\n",
+           entries.size(), shards.size(), work.size(), bytesToHash / 1048576.0, entries.size() - work.size(), jobs, elapsed);
+    return 0;
+}
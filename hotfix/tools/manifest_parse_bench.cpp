@@ -0,0 +1,248 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * manifest_parse_bench: compares the DOM and the streaming parse of a large manifest.
+ *
+ * Writes a manifest of N assets, then loads it in a child process per run the
+ * way Manifest::parse does, reading the whole file into a string, building a
+ * rapidjson Document and filling the asset table from it, or with
+ * ManifestStreamParser::parseFile. Each run is a separate process so its peak
+ * resident set size, reported by wait4, belongs to that parse alone; an idle
+ * child gives the baseline subtracted from both.
+ *
+ * Build: g++ -std=c++17 -O2 -I<cocos2d-x> -I<cocos2d-x>/cocos -I<cocos2d-x>/external
+ *            -I<cocos2d-x>/extensions/assets-manager
+ *            manifest_parse_bench.cpp ../client/ManifestStream.cpp -o manifest_parse_bench
+ *
+ * Usage: manifest_parse_bench [--assets N] [--rounds N] [--manifest path]
+ */
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+#include "../client/ManifestStream.h"
+#include "json/document-wrapper.h"
+
+USING_NS_CC_EXT;
+
+enum class Mode
+{
+    IDLE,
+    DOM,
+    STREAM
+};
+
+struct RunResult
+{
+    double ms;
+    long peakKb;
+    size_t assets;
+};
+
+static bool writeManifest(const std::string &path, int assetCount)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    fprintf(fp, "{\n\t\"packageUrl\" : \"https://cdn.example.com/game/android/1.4.2/remote-assets/\",\n"
+                "\t\"remoteManifestUrl\" : \"https://cdn.example.com/game/android/project.manifest\",\n"
+                "\t\"remoteVersionUrl\" : \"https://cdn.example.com/game/android/version.manifest\",\n"
+                "\t\"version\" : \"1.4.2\",\n\t\"engineVersion\" : \"3.x\",\n\t\"assets\" : {\n");
+    for (int i = 0; i < assetCount; ++i)
+    {
+        // Same field order and value sizes as the manifests of manifest_gen
+        bool archive = i % 100 == 0;
+        fprintf(fp, "\t\t\"res/dir%02d/asset%06d.%s\" : {\n\t\t\t\"md5\" : \"%08x%08x%08x%08x\",\n\t\t\t\"size\" : %d%s\n\t\t}%s\n",
+                i % 64, i, archive ? "zip" : "png", i, i * 7, i * 13, i * 31, 1024 + i % 65536,
+                archive ? ",\n\t\t\t\"compressed\" : true" : "", i + 1 < assetCount ? "," : "");
+    }
+    fprintf(fp, "\t},\n\t\"searchPaths\" : [\n\t]\n}\n");
+    return fclose(fp) == 0;
+}
+
+static std::string readFile(const std::string &path)
+{
+    std::string content;
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return content;
+    fseek(fp, 0, SEEK_END);
+    content.resize(ftell(fp));
+    fseek(fp, 0, SEEK_SET);
+    content.resize(fread(&content[0], 1, content.size(), fp));
+    fclose(fp);
+    return content;
+}
+
+//! What Manifest::parse does: the file as a string, a Document kept alive with the manifest, and the asset table
+static size_t parseDom(const std::string &path)
+{
+    rapidjson::Document json;
+    {
+        std::string content = readFile(path);
+        json.Parse<0>(content.c_str());
+        if (json.HasParseError() || !json.IsObject() || !json.HasMember("assets"))
+            return 0;
+    }
+
+    std::unordered_map<std::string, Manifest::Asset> assets;
+    const rapidjson::Value &list = json["assets"];
+    for (auto it = list.MemberBegin(); it != list.MemberEnd(); ++it)
+    {
+        const rapidjson::Value &value = it->value;
+        Manifest::Asset asset;
+        asset.md5 = value.HasMember("md5") && value["md5"].IsString() ? value["md5"].GetString() : "";
+        asset.path = value.HasMember("path") && value["path"].IsString() ? value["path"].GetString() : it->name.GetString();
+        asset.compressed = value.HasMember("compressed") && value["compressed"].IsBool() && value["compressed"].GetBool();
+        asset.size = value.HasMember("size") && value["size"].IsNumber() ? (float)value["size"].GetDouble() : 0;
+        asset.downloadState = value.HasMember("downloadState") && value["downloadState"].IsInt()
+            ? value["downloadState"].GetInt() : (int)Manifest::DownloadState::UNMARKED;
+        assets.emplace(it->name.GetString(), asset);
+    }
+    return assets.size();
+}
+
+static size_t parseStream(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return 0;
+    ManifestData data;
+    bool ok = ManifestStreamParser::parseFile(fp, &data);
+    fclose(fp);
+    return ok ? data.assets.size() : 0;
+}
+
+static bool run(Mode mode, const std::string &path, RunResult *result)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return false;
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0)
+    {
+        close(fds[0]);
+        auto start = std::chrono::steady_clock::now();
+        RunResult child = {};
+        if (mode == Mode::DOM)
+            child.assets = parseDom(path);
+        else if (mode == Mode::STREAM)
+            child.assets = parseStream(path);
+        child.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        bool written = write(fds[1], &child, sizeof(child)) == (ssize_t)sizeof(child);
+        _exit(written ? 0 : 1);
+    }
+
+    close(fds[1]);
+    bool ok = read(fds[0], result, sizeof(*result)) == (ssize_t)sizeof(*result);
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return false;
+#if defined(__APPLE__)
+    result->peakKb = usage.ru_maxrss / 1024;
+#else
+    result->peakKb = usage.ru_maxrss;
+#endif
+    return ok;
+}
+
+static bool measure(Mode mode, const std::string &path, int rounds, RunResult *best)
+{
+    for (int i = 0; i < rounds; ++i)
+    {
+        RunResult result;
+        if (!run(mode, path, &result))
+            return false;
+        if (i == 0 || result.ms < best->ms)
+            best->ms = result.ms;
+        if (i == 0 || result.peakKb < best->peakKb)
+            best->peakKb = result.peakKb;
+        best->assets = result.assets;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int assetCount = 100000;
+    int rounds = 5;
+    std::string path;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--assets") == 0)
+            assetCount = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--rounds") == 0)
+            rounds = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--manifest") == 0)
+            path = argv[i + 1];
+    }
+    if (assetCount <= 0 || rounds <= 0)
+    {
+        fprintf(stderr, "Usage: manifest_parse_bench [--assets N] [--rounds N] [--manifest path]\n");
+        return 1;
+    }
+
+    bool generated = path.empty();
+    if (generated)
+    {
+        path = "manifest_parse_bench.manifest";
+        if (!writeManifest(path, assetCount))
+        {
+            fprintf(stderr, "Can't write %s\n", path.c_str());
+            return 1;
+        }
+    }
+
+    RunResult idle = {}, dom = {}, stream = {};
+    bool ok = measure(Mode::IDLE, path, rounds, &idle)
+        && measure(Mode::DOM, path, rounds, &dom)
+        && measure(Mode::STREAM, path, rounds, &stream);
+    if (generated)
+        remove(path.c_str());
+    if (!ok || dom.assets == 0 || dom.assets != stream.assets)
+    {
+        fprintf(stderr, "Parse failed or the two parsers disagree (%zu and %zu assets)\n", dom.assets, stream.assets);
+        return 2;
+    }
+
+    printf("%zu assets, best of %d runs, peak RSS above an idle child of %ld KB\n", dom.assets, rounds, idle.peakKb);
+    printf("DOM    : %8.1f ms, %8.1f MB peak\n", dom.ms, (dom.peakKb - idle.peakKb) / 1024.0);
+    printf("stream : %8.1f ms, %8.1f MB peak\n", stream.ms, (stream.peakKb - idle.peakKb) / 1024.0);
+    if (dom.peakKb > idle.peakKb)
+        printf("saved  : %.0f%% peak memory\n", 100.0 * (1.0 - (double)(stream.peakKb - idle.peakKb) / (dom.peakKb - idle.peakKb)));
+    return 0;
+}
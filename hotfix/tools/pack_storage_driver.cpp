@@ -0,0 +1,217 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+/**
+ * pack_storage_driver: checks that AssetsPackStorage keeps the right content
+ * across commits, staging and reloads.
+ *
+ * Commits a thousand files, replaces most of them so the first pack is
+ * compacted, reloads the index in another storage, stages an update and
+ * discards it, stages it again and applies it, then removes everything.
+ * Every read is checked against the content written, and the pack directory
+ * must be empty at the end. Build it with -fsanitize=address so reads past a
+ * mapped range or a pack used after it was closed are reported.
+ *
+ * Build: g++ -std=c++11 -O1 -g -fsanitize=address -I<cocos2d-x> -I<cocos2d-x>/cocos
+ *            pack_storage_driver.cpp ../client/AssetsPackStorage.cpp -o pack_storage_driver
+ *
+ * Usage: pack_storage_driver [--dir path] [--files count]
+ */
+
+#include <dirent.h>
+#include <stdlib.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../client/AssetsPackStorage.h"
+
+USING_NS_CC;
+USING_NS_CC_EXT;
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); s_failures++; } } while (0)
+
+static bool writeFile(const std::string &path, const std::string &content)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool written = fwrite(content.data(), 1, content.size(), fp) == content.size();
+    return fclose(fp) == 0 && written;
+}
+
+static std::string readPacked(const AssetsPackStorage &storage, const std::string &relativePath)
+{
+    std::string content;
+    ResizableBufferAdapter<std::string> buffer(&content);
+    if (!storage.read(relativePath, &buffer))
+        return "<missing>";
+    return content;
+}
+
+static size_t countFiles(const std::string &dir)
+{
+    size_t count = 0;
+    DIR *handle = opendir(dir.c_str());
+    if (!handle)
+        return 0;
+    while (struct dirent *entry = readdir(handle))
+    {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            count++;
+    }
+    closedir(handle);
+    return count;
+}
+
+static std::string assetPath(int i)
+{
+    return "res/asset" + std::to_string(i) + ".png";
+}
+
+static std::string originalContent(int i)
+{
+    return std::string(100 + i % 500, static_cast<char>('a' + i % 26));
+}
+
+int main(int argc, char *argv[])
+{
+    std::string dir = "/tmp/pack_storage_driver";
+    int fileCount = 1000;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--dir") == 0)
+            dir = argv[i + 1];
+        else if (strcmp(argv[i], "--files") == 0)
+            fileCount = atoi(argv[i + 1]);
+    }
+    if (fileCount < 10)
+        fileCount = 10;
+    dir += "/";
+    const std::string root = dir + "storage/";
+    const std::string source = dir + "source/";
+    if (system(("rm -rf '" + dir + "' && mkdir -p '" + root + AssetsPackStorage::PACK_DIRECTORY + "' '" + source + "res'").c_str()) != 0)
+    {
+        fprintf(stderr, "Can't create %s\n", dir.c_str());
+        return 1;
+    }
+
+    AssetsPackStorage storage(root);
+    CHECK(!storage.load());
+    CHECK(!storage.applyStaged());
+
+    // First install, with an empty file
+    std::vector<std::string> added;
+    for (int i = 0; i < fileCount; ++i)
+    {
+        CHECK(writeFile(source + assetPath(i), originalContent(i)));
+        added.push_back(assetPath(i));
+    }
+    CHECK(writeFile(source + "empty", ""));
+    added.push_back("empty");
+    CHECK(storage.commit(source, added, std::vector<std::string>()));
+    CHECK(storage.getEntryCount() == static_cast<size_t>(fileCount) + 1);
+    CHECK(storage.getPackCount() == 1);
+    CHECK(readPacked(storage, assetPath(5)) == originalContent(5));
+    CHECK(readPacked(storage, "empty") == "");
+    CHECK(storage.getSize(assetPath(fileCount - 1)) == static_cast<int64_t>(originalContent(fileCount - 1).size()));
+    CHECK(storage.getSize("res/missing.png") == -1);
+    CHECK(!storage.contains("res/missing.png"));
+
+    // Most files replaced and the last one removed, the first pack is compacted into the new one
+    const int replaced = fileCount * 6 / 10;
+    std::vector<std::string> updated;
+    for (int i = 0; i < replaced; ++i)
+    {
+        CHECK(writeFile(source + assetPath(i), "updated" + std::to_string(i)));
+        updated.push_back(assetPath(i));
+    }
+    CHECK(storage.commit(source, updated, std::vector<std::string>(1, assetPath(fileCount - 1))));
+    CHECK(storage.getEntryCount() == static_cast<size_t>(fileCount));
+    CHECK(storage.getPackCount() == 1);
+    CHECK(readPacked(storage, assetPath(5)) == "updated5");
+    CHECK(readPacked(storage, assetPath(replaced)) == originalContent(replaced));
+    CHECK(readPacked(storage, assetPath(fileCount - 1)) == "<missing>");
+    CHECK(countFiles(root + AssetsPackStorage::PACK_DIRECTORY) == 2);
+
+    // Another storage loads the committed index
+    AssetsPackStorage reloaded(root);
+    CHECK(reloaded.load());
+    CHECK(reloaded.getEntryCount() == static_cast<size_t>(fileCount));
+    CHECK(readPacked(reloaded, assetPath(replaced - 1)) == "updated" + std::to_string(replaced - 1));
+    CHECK(readPacked(reloaded, assetPath(fileCount - 2)) == originalContent(fileCount - 2));
+
+    // A staged update isn't visible until applied, discarding it deletes its pack
+    CHECK(writeFile(source + assetPath(1), "staged1"));
+    CHECK(writeFile(source + "res/new.png", "new"));
+    std::vector<std::string> staged;
+    staged.push_back(assetPath(1));
+    staged.push_back("res/new.png");
+    CHECK(reloaded.stage(source, staged, std::vector<std::string>(1, assetPath(2))));
+    CHECK(readPacked(reloaded, assetPath(1)) == "updated1");
+    CHECK(!reloaded.contains("res/new.png"));
+    CHECK(reloaded.contains(assetPath(2)));
+    reloaded.discardStaged();
+    CHECK(!reloaded.applyStaged());
+    CHECK(countFiles(root + AssetsPackStorage::PACK_DIRECTORY) == 2);
+
+    // Staged again and applied, as the next launch does
+    CHECK(reloaded.stage(source, staged, std::vector<std::string>(1, assetPath(2))));
+    CHECK(reloaded.applyStaged());
+    CHECK(readPacked(reloaded, assetPath(1)) == "staged1");
+    CHECK(readPacked(reloaded, "res/new.png") == "new");
+    CHECK(!reloaded.contains(assetPath(2)));
+    CHECK(reloaded.getEntryCount() == static_cast<size_t>(fileCount));
+    AssetsPackStorage launched(root);
+    CHECK(launched.load());
+    CHECK(readPacked(launched, assetPath(1)) == "staged1");
+    CHECK(readPacked(launched, assetPath(3)) == "updated3");
+
+    // Everything removed leaves no pack, clear deletes the index
+    std::vector<std::string> all;
+    for (int i = 0; i < fileCount - 1; ++i)
+    {
+        if (i != 2)
+            all.push_back(assetPath(i));
+    }
+    all.push_back("empty");
+    all.push_back("res/new.png");
+    CHECK(launched.commit(source, std::vector<std::string>(), all));
+    CHECK(launched.getEntryCount() == 0);
+    CHECK(launched.getPackCount() == 0);
+    launched.clear();
+    CHECK(!AssetsPackStorage(root).load());
+    CHECK(countFiles(root + AssetsPackStorage::PACK_DIRECTORY) == 0);
+
+    if (system(("rm -rf '" + dir + "'").c_str()) != 0)
+    {
+        fprintf(stderr, "Can't remove %s\n", dir.c_str());
+    }
+    printf("%s\n", s_failures == 0 ? "OK" : "FAILED");
+    return s_failures == 0 ? 0 : 2;
+}
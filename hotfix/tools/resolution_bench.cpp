@@ -0,0 +1,334 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * resolution_bench: measures what AssetsResolutionIndex saves on path resolution.
+ *
+ * Creates a storage holding a few hot updated files out of a larger asset
+ * list, then resolves every asset the way FileUtils probes a storage search
+ * path: a stat per lookup, or an index lookup first and a stat only for the
+ * files the index knows. Most lookups miss the storage, as in a game where
+ * only a fraction of the assets was ever hot updated.
+ *
+ * Then the storage takes a number of updates, each changing, deleting and
+ * adding assets under new names, three times: keeping the files the
+ * manifests dropped, as before removeDeletedAssets, removing them at each
+ * commit like removeDeletedAssets, and keeping them until a final sweep like
+ * collectGarbage. For each one the storage footprint and the lookup latency of
+ * the live assets are reported.
+ *
+ * Build: g++ -std=c++17 -O2 -pthread -I<cocos2d-x> -I<cocos2d-x>/cocos
+ *            resolution_bench.cpp ../client/AssetsResolutionIndex.cpp -o resolution_bench
+ *
+ * Usage: resolution_bench [--assets N] [--updated N] [--rounds N] [--dir path]
+ *                         [--updates N] [--changed N] [--deleted N] [--added N] [--file-size N]
+ */
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "../client/AssetsResolutionIndex.h"
+
+namespace fs = std::filesystem;
+
+USING_NS_CC_EXT;
+
+//! How the files the manifests dropped are handled
+enum class Cleanup
+{
+    KEEP,
+    REMOVE_DELETED,
+    COLLECT_GARBAGE
+};
+
+struct Options
+{
+    int assetCount = 20000;
+    int updatedCount = 500;
+    int rounds = 5;
+    int updates = 30;
+    int changed = 400;
+    int deleted = 100;
+    int added = 100;
+    int fileSize = 4096;
+};
+
+struct Lookups
+{
+    double statNs;
+    double indexNs;
+    size_t statHits;
+    size_t indexHits;
+    size_t indexStats;
+};
+
+struct Footprint
+{
+    size_t files;
+    size_t directories;
+    uint64_t bytes;
+};
+
+static bool fileExists(const std::string &path)
+{
+    struct stat info;
+    return ::stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+static void writeAsset(const std::string &path, const std::string &content)
+{
+    fs::create_directories(fs::path(path).parent_path());
+    std::ofstream(path, std::ios::binary) << content;
+}
+
+//! Same sequence on every run, so the three cleanups see the same updates
+static uint32_t nextRandom(uint32_t *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static Lookups measureLookups(const std::string &storage, const std::vector<std::string> &paths, std::unordered_set<std::string> &&present, int rounds)
+{
+    auto root = std::make_shared<AssetsResolutionIndex::Root>();
+    root->root = storage;
+    root->paths = std::move(present);
+    AssetsResolutionIndex *index = AssetsResolutionIndex::getInstance();
+    index->setEnabled(true);
+    index->setRoot(root);
+
+    Lookups result = {};
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (const auto &path : paths)
+        {
+            result.statHits += fileExists(storage + path);
+        }
+    }
+    double statSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (const auto &path : paths)
+        {
+            if (index->mayExist(storage, path))
+            {
+                ++result.indexStats;
+                result.indexHits += fileExists(storage + path);
+            }
+        }
+    }
+    double indexSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    index->removeRoot(storage);
+
+    double lookups = (double)paths.size() * rounds;
+    result.statNs = statSeconds * 1e9 / lookups;
+    result.indexNs = indexSeconds * 1e9 / lookups;
+    return result;
+}
+
+static Footprint measureFootprint(const std::string &storage)
+{
+    Footprint result = {};
+    for (const auto &entry : fs::recursive_directory_iterator(storage))
+    {
+        struct stat info;
+        if (::stat(entry.path().c_str(), &info) != 0)
+            continue;
+        if (S_ISDIR(info.st_mode))
+        {
+            result.directories++;
+        }
+        else
+        {
+            result.files++;
+        }
+        // Allocated blocks, what the storage costs on the device
+        result.bytes += (uint64_t)info.st_blocks * 512;
+    }
+    return result;
+}
+
+/** @brief Run the updates on a storage holding the first hot update
+ @param live    In: assets of the first manifest, out: assets of the last one
+ @param sweepMs Receives the time of the final sweep, with COLLECT_GARBAGE
+ @return    Paths relative to the storage of the live assets it holds, what the index publishes
+ */
+static std::unordered_set<std::string> runUpdates(const std::string &storage, const Options &options, Cleanup cleanup,
+                                                  std::vector<std::string> *live, const std::unordered_set<std::string> &first, double *sweepMs)
+{
+    std::unordered_set<std::string> present = first;
+    std::string content(options.fileSize, 'x');
+    for (const auto &path : first)
+    {
+        writeAsset(storage + path, content);
+    }
+
+    uint32_t random = 12345;
+    for (int u = 1; u <= options.updates; ++u)
+    {
+        content.assign(options.fileSize, (char)('a' + u % 26));
+        for (int i = 0; i < options.changed && !live->empty(); ++i)
+        {
+            const std::string &path = (*live)[nextRandom(&random) % live->size()];
+            writeAsset(storage + path, content);
+            present.insert(path);
+        }
+        for (int i = 0; i < options.deleted && !live->empty(); ++i)
+        {
+            size_t at = nextRandom(&random) % live->size();
+            std::string path = std::move((*live)[at]);
+            (*live)[at] = std::move(live->back());
+            live->pop_back();
+            if (present.erase(path) && cleanup == Cleanup::REMOVE_DELETED)
+            {
+                fs::remove(storage + path);
+            }
+        }
+        for (int i = 0; i < options.added; ++i)
+        {
+            // New assets under new names, like content hashed file names
+            char path[64];
+            int id = (int)(nextRandom(&random) % options.assetCount);
+            snprintf(path, sizeof(path), "res/dir%02d/asset%06d_u%02d_%d.png", id % 64, id, u, i);
+            live->push_back(path);
+            writeAsset(storage + path, content);
+            present.insert(path);
+        }
+    }
+
+    *sweepMs = 0;
+    if (cleanup == Cleanup::COLLECT_GARBAGE)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<fs::path> garbage;
+        for (const auto &entry : fs::recursive_directory_iterator(storage))
+        {
+            if (entry.is_regular_file() && !present.count(entry.path().lexically_relative(storage).generic_string()))
+            {
+                garbage.push_back(entry.path());
+            }
+        }
+        for (const auto &path : garbage)
+        {
+            fs::remove(path);
+        }
+        *sweepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return present;
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    std::string dir = (fs::temp_directory_path() / "resolution_bench").string();
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--assets") == 0)
+            options.assetCount = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--updated") == 0)
+            options.updatedCount = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--rounds") == 0)
+            options.rounds = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--dir") == 0)
+            dir = argv[i + 1];
+        else if (strcmp(argv[i], "--updates") == 0)
+            options.updates = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--changed") == 0)
+            options.changed = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--deleted") == 0)
+            options.deleted = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--added") == 0)
+            options.added = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--file-size") == 0)
+            options.fileSize = atoi(argv[i + 1]);
+    }
+    if (options.assetCount <= 0 || options.updatedCount < 0 || options.updatedCount > options.assetCount || options.rounds <= 0
+        || options.updates < 0 || options.changed < 0 || options.deleted < 0 || options.added < 0 || options.fileSize <= 0)
+    {
+        fprintf(stderr, "Usage: resolution_bench [--assets N] [--updated N] [--rounds N] [--dir path]\n"
+                        "                        [--updates N] [--changed N] [--deleted N] [--added N] [--file-size N]\n");
+        return 1;
+    }
+
+    // Asset paths spread over subdirectories like a real tree, every nth one hot updated
+    std::string storage = dir + "/storage/";
+    fs::remove_all(dir);
+    std::vector<std::string> paths;
+    std::unordered_set<std::string> first;
+    int stride = options.updatedCount > 0 ? options.assetCount / options.updatedCount : 0;
+    for (int i = 0; i < options.assetCount; ++i)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "res/dir%02d/asset%06d.png", i % 64, i);
+        paths.push_back(path);
+        if (stride > 0 && i % stride == 0 && (int)first.size() < options.updatedCount)
+        {
+            writeAsset(storage + path, "x");
+            first.insert(path);
+        }
+    }
+
+    Lookups lookups = measureLookups(storage, paths, std::unordered_set<std::string>(first), options.rounds);
+    printf("%d assets, %zu in storage, %d rounds\n", options.assetCount, first.size(), options.rounds);
+    printf("stat only : %8.1f ns/lookup, %zu hits\n", lookups.statNs, lookups.statHits);
+    printf("index     : %8.1f ns/lookup, %zu hits, %zu stats\n", lookups.indexNs, lookups.indexHits, lookups.indexStats);
+    printf("speedup   : %.1fx\n", lookups.indexNs > 0 ? lookups.statNs / lookups.indexNs : 0.0);
+    bool consistent = lookups.statHits == lookups.indexHits;
+    fs::remove_all(dir);
+
+    if (options.updates > 0)
+    {
+        printf("\nafter %d updates of %d changed, %d deleted, %d added assets of %d bytes\n",
+               options.updates, options.changed, options.deleted, options.added, options.fileSize);
+        printf("%-20s %8s %6s %10s %10s %10s %8s\n", "cleanup", "files", "dirs", "MB", "stat ns", "index ns", "sweep ms");
+        const Cleanup cleanups[] = { Cleanup::KEEP, Cleanup::REMOVE_DELETED, Cleanup::COLLECT_GARBAGE };
+        const char *names[] = { "keep dropped files", "removeDeletedAssets", "collectGarbage" };
+        for (int c = 0; c < 3; ++c)
+        {
+            std::vector<std::string> live = paths;
+            double sweepMs;
+            std::unordered_set<std::string> present = runUpdates(storage, options, cleanups[c], &live, first, &sweepMs);
+            Footprint footprint = measureFootprint(storage);
+            Lookups lookups = measureLookups(storage, live, std::move(present), options.rounds);
+            consistent = consistent && lookups.statHits == lookups.indexHits;
+            printf("%-20s %8zu %6zu %10.1f %10.1f %10.1f %8.1f\n", names[c], footprint.files, footprint.directories,
+                   footprint.bytes / (1024.0 * 1024.0), lookups.statNs, lookups.indexNs, sweepMs);
+            fs::remove_all(dir);
+        }
+    }
+    return consistent ? 0 : 2;
+}
@@ -0,0 +1,377 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+/**
+ * salvage_bench: measures the bytes downloaded again after a store upgrade,
+ * with and without the salvage of the cached files.
+ *
+ * A device holds a hot updated version of N assets. The store build shipping
+ * a newer package includes part of those files unchanged (--rolled percent),
+ * the other ones are back to the content of the store build. The next remote
+ * version carries part of the hot updated files forward unchanged (--carried
+ * percent) and replaces the rest. A headless AssetsManagerEx loads the new
+ * package, which wipes the storage, then runs that remote update on a
+ * downloader without network. The carried files were on the device before the
+ * upgrade: every byte downloaded for them is downloaded again. The update runs
+ * twice, with the salvaged files and with the salvage directory removed before
+ * the update, as without salvageCachedFiles.
+ *
+ * Build: g++ -std=c++17 -O2 -I<cocos2d-x> -I<cocos2d-x>/cocos -I<cocos2d-x>/external
+ *            -I<cocos2d-x>/extensions/assets-manager salvage_bench.cpp
+ *            the sources of ../client but HelloWorldScene.cpp
+ *            -L<cocos2d-x build>/lib -lcocos2d -lpthread -o salvage_bench
+ *
+ * Usage: salvage_bench [--assets N] [--file-size N] [--rolled percent] [--carried percent]
+ *
+ * Not run yet: it needs libcocos2d and the engine's Manifest, so there are no
+ * bytes downloaded again to report for salvageCachedFiles so far.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "../client/AssetsManagerEx.h"
+#include "base/CCAutoreleasePool.h"
+
+USING_NS_CC;
+USING_NS_CC_EXT;
+
+static const char* const PACKAGE_URL = "https://cdn.example.com/game/remote-assets/";
+
+//! Which manifest an asset is described by
+enum class Version
+{
+    //! The hot updated version cached before the store upgrade
+    CACHED,
+    //! The package of the store build
+    PACKAGE,
+    //! The next remote version
+    REMOTE
+};
+
+struct Scenario
+{
+    int assetCount = 5000;
+    int fileSize = 32 * 1024;
+    //! Percent of the cached files the store build ships unchanged
+    int rolled = 40;
+    //! Percent of the cached files the remote version keeps while the store build doesn't ship them
+    int carried = 40;
+
+    /** @brief Content generation of an asset in a version, the md5 and the file content derive from it.
+     *         1 is the content of the cached version.
+     */
+    int contentOf(int i, Version version) const
+    {
+        int bucket = i % 100;
+        if (version == Version::CACHED || bucket < rolled)
+            return 1;
+        if (version == Version::PACKAGE)
+            return 0;
+        return bucket < rolled + carried ? 1 : 2;
+    }
+};
+
+static std::string assetPath(int i)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "res/dir%02d/asset%06d.png", i % 64, i);
+    return path;
+}
+
+static bool writeContent(const std::string &path, int size, int generation)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    std::vector<char> content(size, (char)('a' + generation));
+    bool written = fwrite(content.data(), 1, content.size(), fp) == content.size();
+    return fclose(fp) == 0 && written;
+}
+
+static bool writeManifest(const std::string &path, const char *version, const Scenario &scenario, Version of)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    fprintf(fp, "{\n\t\"packageUrl\" : \"%s\",\n"
+                "\t\"remoteManifestUrl\" : \"https://cdn.example.com/game/project.manifest\",\n"
+                "\t\"version\" : \"%s\",\n\t\"engineVersion\" : \"3.x\",\n\t\"assets\" : {\n", PACKAGE_URL, version);
+    for (int i = 0; i < scenario.assetCount; ++i)
+    {
+        int generation = scenario.contentOf(i, of);
+        fprintf(fp, "\t\t\"%s\" : {\n\t\t\t\"md5\" : \"%08x%08x%08x%08x\",\n\t\t\t\"size\" : %d\n\t\t}%s\n",
+                assetPath(i).c_str(), i, generation, i * 7, i * 13, scenario.fileSize, i + 1 < scenario.assetCount ? "," : "");
+    }
+    fprintf(fp, "\t},\n\t\"searchPaths\" : [\n\t]\n}\n");
+    return fclose(fp) == 0;
+}
+
+/**
+ * @brief   Downloader without network: the manifest is copied from a file, assets are written with the content
+ *          of the remote version. Counts what is downloaded, and which part of it the device held before the upgrade.
+ */
+class CountingDownloader : public IAssetsDownloader
+{
+public:
+    CountingDownloader(const std::string &remoteManifestPath, const Scenario &scenario)
+    : _remoteManifestPath(remoteManifestPath)
+    , _scenario(scenario)
+    {
+        for (int i = 0; i < scenario.assetCount; ++i)
+        {
+            _generations.push_back(scenario.contentOf(i, Version::REMOTE));
+        }
+    }
+
+    virtual void createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier) override
+    {
+        network::DownloadTask task;
+        task.requestURL = srcUrl;
+        task.storagePath = storagePath;
+        task.identifier = identifier;
+        _tasks.push_back(task);
+    }
+
+    virtual void cancelAll() override
+    {
+        _tasks.clear();
+    }
+
+    void completeAll()
+    {
+        while (!_tasks.empty())
+        {
+            network::DownloadTask task = _tasks.front();
+            _tasks.pop_front();
+            int64_t size = 0;
+            if (!writeFile(task, &size))
+            {
+                if (onTaskError)
+                    onTaskError(task, network::DownloadTask::ERROR_FILE_OP_FAILED, 0, "Can't write " + task.storagePath);
+                continue;
+            }
+            if (onTaskProgress)
+                onTaskProgress(task, size, size, size);
+            if (onFileTaskSuccess)
+                onFileTaskSuccess(task);
+        }
+    }
+
+    size_t getPendingCount() const { return _tasks.size(); }
+
+    int downloadedFiles = 0;
+    int64_t downloadedBytes = 0;
+    int redownloadedFiles = 0;
+    int64_t redownloadedBytes = 0;
+
+private:
+    bool writeFile(const network::DownloadTask &task, int64_t *size)
+    {
+        if (task.identifier == AssetsManagerEx::MANIFEST_ID)
+        {
+            std::string manifest = FileUtils::getInstance()->getStringFromFile(_remoteManifestPath);
+            *size = (int64_t)manifest.size();
+            return !manifest.empty() && FileUtils::getInstance()->writeStringToFile(manifest, task.storagePath);
+        }
+        int index = -1;
+        if (task.requestURL.compare(0, strlen(PACKAGE_URL), PACKAGE_URL) == 0)
+        {
+            const std::string path = task.requestURL.substr(strlen(PACKAGE_URL));
+            size_t digits = path.rfind("asset");
+            if (digits != std::string::npos)
+                index = atoi(path.c_str() + digits + 5);
+        }
+        if (index < 0 || index >= (int)_generations.size())
+            return false;
+        *size = _scenario.fileSize;
+        downloadedFiles++;
+        downloadedBytes += *size;
+        if (_generations[index] == 1)
+        {
+            redownloadedFiles++;
+            redownloadedBytes += *size;
+        }
+        return writeContent(task.storagePath, _scenario.fileSize, _generations[index]);
+    }
+
+    std::string _remoteManifestPath;
+    Scenario _scenario;
+    std::vector<int> _generations;
+    std::deque<network::DownloadTask> _tasks;
+};
+
+struct Result
+{
+    bool finished = false;
+    int salvagedFiles = 0;
+    int downloadedFiles = 0;
+    int64_t downloadedBytes = 0;
+    int redownloadedFiles = 0;
+    int64_t redownloadedBytes = 0;
+};
+
+/** @brief Install the cached version, load the store package over it, then update to the remote version
+ */
+static Result run(const std::string &dir, const Scenario &scenario, bool salvage)
+{
+    Result result;
+    FileUtils *fileUtils = FileUtils::getInstance();
+    const std::string storage = dir + "storage/";
+    const std::string salvageStorage = dir + "storage_salvage/";
+    fileUtils->removeDirectory(dir);
+    fileUtils->createDirectory(storage);
+    for (int i = 0; i < scenario.assetCount; ++i)
+    {
+        const std::string path = storage + assetPath(i);
+        fileUtils->createDirectory(path.substr(0, path.rfind('/') + 1));
+        if (!writeContent(path, scenario.fileSize, scenario.contentOf(i, Version::CACHED)))
+        {
+            fprintf(stderr, "Can't write %s\n", path.c_str());
+            return result;
+        }
+    }
+    if (!writeManifest(storage + "project.manifest", "1.0.1", scenario, Version::CACHED)
+        || !writeManifest(dir + "project.manifest", "1.1.0", scenario, Version::PACKAGE)
+        || !writeManifest(dir + "remote.manifest", "1.1.1", scenario, Version::REMOTE))
+    {
+        fprintf(stderr, "Can't write the manifests in %s\n", dir.c_str());
+        return result;
+    }
+
+    auto scheduler = std::make_shared<ManualAssetsScheduler>();
+    auto downloader = std::make_shared<CountingDownloader>(dir + "remote.manifest", scenario);
+    bool done = false;
+    AssetsManagerExEnv env;
+    env.fileUtils = fileUtils;
+    env.downloader = downloader;
+    env.taskRunner = std::make_shared<InlineTaskRunner>();
+    env.scheduler = scheduler;
+    env.eventCallback = [&](EventAssetsManagerEx *event) {
+        switch (event->getEventCode())
+        {
+            case EventAssetsManagerEx::EventCode::UPDATE_FINISHED:
+                result.finished = true;
+                done = true;
+                break;
+            case EventAssetsManagerEx::EventCode::UPDATE_FAILED:
+            case EventAssetsManagerEx::EventCode::ALREADY_UP_TO_DATE:
+            case EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST:
+            case EventAssetsManagerEx::EventCode::ERROR_DOWNLOAD_MANIFEST:
+            case EventAssetsManagerEx::EventCode::ERROR_PARSE_MANIFEST:
+                done = true;
+                break;
+            default:
+                break;
+        }
+    };
+
+    // The package is newer than the cached version: the storage is salvaged then wiped
+    AssetsManagerEx *manager = AssetsManagerEx::create(dir + "project.manifest", storage, env);
+    if (!manager)
+    {
+        fprintf(stderr, "Can't create the manager\n");
+        return result;
+    }
+    manager->retain();
+    std::vector<std::string> salvaged;
+    fileUtils->listFilesRecursively(salvageStorage, &salvaged);
+    for (const auto &path : salvaged)
+    {
+        if (path.back() != '/' && path.compare(path.size() - strlen("project.manifest"), std::string::npos, "project.manifest") != 0)
+            result.salvagedFiles++;
+    }
+    if (!salvage)
+    {
+        fileUtils->removeDirectory(salvageStorage);
+    }
+
+    manager->update();
+    for (int frame = 0; !done && frame < 60 * 60; ++frame)
+    {
+        downloader->completeAll();
+        scheduler->update(1.0f / 60);
+    }
+    result.downloadedFiles = downloader->downloadedFiles;
+    result.downloadedBytes = downloader->downloadedBytes;
+    result.redownloadedFiles = downloader->redownloadedFiles;
+    result.redownloadedBytes = downloader->redownloadedBytes;
+
+    manager->release();
+    PoolManager::getInstance()->getCurrentPool()->clear();
+    fileUtils->removeDirectory(dir);
+    return result;
+}
+
+static void printResult(const char *name, const Result &result)
+{
+    printf("%-16s: %s, %5d salvaged, %5d files %8.1f MB downloaded, %5d files %8.1f MB downloaded again\n",
+           name, result.finished ? "finished" : "failed  ", result.salvagedFiles,
+           result.downloadedFiles, result.downloadedBytes / (1024.0 * 1024.0),
+           result.redownloadedFiles, result.redownloadedBytes / (1024.0 * 1024.0));
+}
+
+int main(int argc, char *argv[])
+{
+    Scenario scenario;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--assets") == 0)
+            scenario.assetCount = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--file-size") == 0)
+            scenario.fileSize = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--rolled") == 0)
+            scenario.rolled = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--carried") == 0)
+            scenario.carried = atoi(argv[i + 1]);
+    }
+    if (scenario.assetCount <= 0 || scenario.fileSize <= 0 || scenario.rolled < 0 || scenario.carried < 0
+        || scenario.rolled + scenario.carried > 100)
+    {
+        fprintf(stderr, "Usage: salvage_bench [--assets N] [--file-size N] [--rolled percent] [--carried percent]\n");
+        return 1;
+    }
+
+    char dirTemplate[] = "/tmp/salvage_bench_XXXXXX";
+    if (!mkdtemp(dirTemplate))
+    {
+        fprintf(stderr, "Can't create a temporary directory\n");
+        return 1;
+    }
+    const std::string dir = std::string(dirTemplate) + "/";
+
+    printf("%d assets of %d bytes, %d%% shipped by the store build, %d%% carried by the remote version\n",
+           scenario.assetCount, scenario.fileSize, scenario.rolled, scenario.carried);
+    Result withSalvage = run(dir, scenario, true);
+    Result withoutSalvage = run(dir, scenario, false);
+    printResult("with salvage", withSalvage);
+    printResult("without salvage", withoutSalvage);
+    FileUtils::getInstance()->removeDirectory(dir);
+    return withSalvage.finished && withoutSalvage.finished ? 0 : 2;
+}
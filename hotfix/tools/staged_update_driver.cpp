@@ -0,0 +1,310 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+/**
+ * staged_update_driver: checks that a staged version is only applied while it's
+ * still the remote one.
+ *
+ * A headless AssetsManagerEx stages version 1.0.1 over the packaged 1.0.0,
+ * then checks again: while the remote version is 1.0.1 the check reports
+ * UPDATE_STAGED and the staged version stays, once the remote version is 1.0.2
+ * a checkUpdate() alone, without update(), must discard it. The next launch,
+ * a new manager on the same storage, must then still run 1.0.0 instead of
+ * applying the outdated 1.0.1. The check is run through the version file and,
+ * with --no-version-file, through the manifest.
+ *
+ * Build: g++ -std=c++17 -O2 -I<cocos2d-x> -I<cocos2d-x>/cocos -I<cocos2d-x>/external
+ *            -I<cocos2d-x>/extensions/assets-manager staged_update_driver.cpp
+ *            the sources of ../client but HelloWorldScene.cpp
+ *            -L<cocos2d-x build>/lib -lcocos2d -lpthread -o staged_update_driver
+ *
+ * Usage: staged_update_driver [--no-version-file]
+ */
+
+#include <stdlib.h>
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <string>
+
+#include "../client/AssetsManagerEx.h"
+#include "base/CCAutoreleasePool.h"
+
+USING_NS_CC;
+USING_NS_CC_EXT;
+
+static const int ASSET_COUNT = 20;
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); s_failures++; } } while (0)
+
+static std::string renderManifest(const std::string &version, bool versionFile, bool withAssets)
+{
+    std::string out = "{\n\t\"packageUrl\" : \"https://cdn.example.com/game/remote-assets/\",\n"
+                      "\t\"remoteManifestUrl\" : \"https://cdn.example.com/game/project.manifest\",\n";
+    if (versionFile)
+        out += "\t\"remoteVersionUrl\" : \"https://cdn.example.com/game/version.manifest\",\n";
+    out += "\t\"version\" : \"" + version + "\",\n\t\"engineVersion\" : \"3.x\"";
+    if (withAssets)
+    {
+        out += ",\n\t\"assets\" : {\n";
+        for (int i = 0; i < ASSET_COUNT; ++i)
+        {
+            char asset[160];
+            // Each version changes every asset
+            snprintf(asset, sizeof(asset), "\t\t\"res/asset%02d.png\" : { \"md5\" : \"%s-%02d\", \"size\" : %d }%s\n",
+                     i, version.c_str(), i, (int)version.size(), i + 1 < ASSET_COUNT ? "," : "");
+            out += asset;
+        }
+        out += "\t},\n\t\"searchPaths\" : [\n\t]";
+    }
+    out += "\n}\n";
+    return out;
+}
+
+/**
+ * @brief   Downloader without network serving the version file and manifest of remoteVersion,
+ *          assets hold the version they belong to. Tasks are completed by completeAll().
+ */
+class ServingDownloader : public IAssetsDownloader
+{
+public:
+    ServingDownloader(bool versionFile) : _versionFile(versionFile) {}
+
+    virtual void createDownloadFileTask(const std::string &srcUrl, const std::string &storagePath, const std::string &identifier) override
+    {
+        network::DownloadTask task;
+        task.requestURL = srcUrl;
+        task.storagePath = storagePath;
+        task.identifier = identifier;
+        _tasks.push_back(task);
+    }
+
+    virtual void cancelAll() override
+    {
+        _tasks.clear();
+    }
+
+    void completeAll()
+    {
+        while (!_tasks.empty())
+        {
+            network::DownloadTask task = _tasks.front();
+            _tasks.pop_front();
+            std::string content = remoteVersion;
+            if (task.identifier == AssetsManagerEx::VERSION_ID)
+                content = renderManifest(remoteVersion, _versionFile, false);
+            else if (task.identifier == AssetsManagerEx::MANIFEST_ID)
+                content = renderManifest(remoteVersion, _versionFile, true);
+            if (!FileUtils::getInstance()->writeStringToFile(content, task.storagePath))
+            {
+                if (onTaskError)
+                    onTaskError(task, network::DownloadTask::ERROR_FILE_OP_FAILED, 0, "Can't write " + task.storagePath);
+                continue;
+            }
+            if (onTaskProgress)
+                onTaskProgress(task, (int64_t)content.size(), (int64_t)content.size(), (int64_t)content.size());
+            if (onFileTaskSuccess)
+                onFileTaskSuccess(task);
+        }
+    }
+
+    std::string remoteVersion;
+
+private:
+    bool _versionFile;
+    std::deque<network::DownloadTask> _tasks;
+};
+
+class Launch
+{
+public:
+    Launch(const std::string &dir, const std::shared_ptr<ServingDownloader> &downloader)
+    : _downloader(downloader)
+    , _scheduler(std::make_shared<ManualAssetsScheduler>())
+    , _result(EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST)
+    , _done(false)
+    {
+        AssetsManagerExEnv env;
+        env.fileUtils = FileUtils::getInstance();
+        env.downloader = downloader;
+        env.taskRunner = std::make_shared<InlineTaskRunner>();
+        env.scheduler = _scheduler;
+        env.eventCallback = [this](EventAssetsManagerEx *event) {
+            switch (event->getEventCode())
+            {
+                case EventAssetsManagerEx::EventCode::NEW_VERSION_FOUND:
+                    // Only ends a check, update() goes on downloading
+                    if (_checking)
+                    {
+                        _result = event->getEventCode();
+                        _done = true;
+                    }
+                    break;
+                case EventAssetsManagerEx::EventCode::UPDATE_STAGED:
+                case EventAssetsManagerEx::EventCode::UPDATE_FINISHED:
+                case EventAssetsManagerEx::EventCode::UPDATE_FAILED:
+                case EventAssetsManagerEx::EventCode::ALREADY_UP_TO_DATE:
+                case EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST:
+                case EventAssetsManagerEx::EventCode::ERROR_DOWNLOAD_MANIFEST:
+                case EventAssetsManagerEx::EventCode::ERROR_PARSE_MANIFEST:
+                    _result = event->getEventCode();
+                    _done = true;
+                    break;
+                default:
+                    break;
+            }
+        };
+        _manager = AssetsManagerEx::create(dir + "project.manifest", dir + "storage/", env);
+        if (_manager)
+        {
+            _manager->retain();
+            _manager->setStagedUpdate(true);
+        }
+    }
+
+    ~Launch()
+    {
+        CC_SAFE_RELEASE(_manager);
+        PoolManager::getInstance()->getCurrentPool()->clear();
+    }
+
+    AssetsManagerEx* manager() const { return _manager; }
+
+    EventAssetsManagerEx::EventCode update()
+    {
+        _checking = false;
+        return run([this]() { _manager->update(); });
+    }
+
+    EventAssetsManagerEx::EventCode checkUpdate()
+    {
+        _checking = true;
+        return run([this]() { _manager->checkUpdate(); });
+    }
+
+private:
+    EventAssetsManagerEx::EventCode run(const std::function<void()> &start)
+    {
+        _done = false;
+        _result = EventAssetsManagerEx::EventCode::ERROR_NO_LOCAL_MANIFEST;
+        start();
+        for (int frame = 0; !_done && frame < 600; ++frame)
+        {
+            _downloader->completeAll();
+            _scheduler->update(1.0f / 60);
+        }
+        return _result;
+    }
+
+    std::shared_ptr<ServingDownloader> _downloader;
+    std::shared_ptr<ManualAssetsScheduler> _scheduler;
+    AssetsManagerEx *_manager = nullptr;
+    EventAssetsManagerEx::EventCode _result;
+    bool _done;
+    bool _checking = false;
+};
+
+int main(int argc, char *argv[])
+{
+    bool versionFile = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--no-version-file") == 0)
+            versionFile = false;
+    }
+
+    char dirTemplate[] = "/tmp/staged_update_driver_XXXXXX";
+    if (!mkdtemp(dirTemplate))
+    {
+        fprintf(stderr, "Can't create a temporary directory\n");
+        return 1;
+    }
+    const std::string dir = std::string(dirTemplate) + "/";
+    FileUtils *fileUtils = FileUtils::getInstance();
+    const std::string marker = dir + "storage_temp/update.staged";
+    const std::string stagedManifest = dir + "storage_temp/project.manifest";
+    if (!fileUtils->writeStringToFile(renderManifest("1.0.0", versionFile, true), dir + "project.manifest"))
+    {
+        fprintf(stderr, "Can't write the manifest in %s\n", dir.c_str());
+        return 1;
+    }
+    auto downloader = std::make_shared<ServingDownloader>(versionFile);
+
+    {
+        Launch launch(dir, downloader);
+        CHECK(launch.manager() != nullptr);
+        if (!launch.manager())
+            return 1;
+
+        // 1.0.1 is staged, the running version stays 1.0.0
+        downloader->remoteVersion = "1.0.1";
+        CHECK(launch.update() == EventAssetsManagerEx::EventCode::UPDATE_STAGED);
+        CHECK(launch.manager()->isUpdateStaged());
+        CHECK(fileUtils->isFileExist(marker));
+        CHECK(fileUtils->isFileExist(stagedManifest));
+        CHECK(launch.manager()->getLocalManifest()->getVersion() == "1.0.0");
+
+        // Checked again while it's still the remote version
+        CHECK(launch.checkUpdate() == EventAssetsManagerEx::EventCode::UPDATE_STAGED);
+        CHECK(launch.manager()->isUpdateStaged());
+        CHECK(fileUtils->isFileExist(marker));
+
+        // 1.0.2 is out: the check alone discards 1.0.1
+        downloader->remoteVersion = "1.0.2";
+        CHECK(launch.checkUpdate() == EventAssetsManagerEx::EventCode::NEW_VERSION_FOUND);
+        CHECK(!launch.manager()->isUpdateStaged());
+        CHECK(!fileUtils->isFileExist(marker));
+        CHECK(!fileUtils->isFileExist(stagedManifest));
+    }
+
+    {
+        // The next launch runs 1.0.0, then updates to 1.0.2 as usual
+        Launch launch(dir, downloader);
+        CHECK(launch.manager() != nullptr);
+        if (launch.manager())
+        {
+            CHECK(launch.manager()->getLocalManifest()->getVersion() == "1.0.0");
+            CHECK(!fileUtils->isFileExist(dir + "storage/res/asset00.png"));
+            CHECK(launch.update() == EventAssetsManagerEx::EventCode::UPDATE_STAGED);
+            CHECK(fileUtils->getStringFromFile(stagedManifest).find("1.0.2") != std::string::npos);
+        }
+    }
+
+    {
+        Launch launch(dir, downloader);
+        if (launch.manager())
+        {
+            CHECK(launch.manager()->getLocalManifest()->getVersion() == "1.0.2");
+            CHECK(fileUtils->getStringFromFile(dir + "storage/res/asset00.png") == "1.0.2");
+        }
+    }
+
+    fileUtils->removeDirectory(dir);
+    printf("%s\n", s_failures == 0 ? "OK" : "FAILED");
+    return s_failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,227 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * success_path_bench: counts the heap allocations made for each downloaded file.
+ *
+ * Replays the main thread work of AssetsManagerEx::onSuccess for N files, the
+ * way it was done before and after the success path stopped copying: the
+ * manifest asset copied and passed by value to the verify callback, then an
+ * event built for UPDATE_PROGRESSION and for ASSET_UPDATED, against the asset
+ * passed by const reference and one pooled event refilled in place. The event
+ * and asset types mirror the layout of EventAssetsManagerEx and
+ * Manifest::Asset so the bench builds without the engine. Allocations are
+ * counted by replacing the global operator new.
+ *
+ * Build: g++ -std=c++17 -O2 success_path_bench.cpp -o success_path_bench
+ *
+ * Usage: success_path_bench [--files N]
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+static size_t s_allocations = 0;
+
+void* operator new(size_t size)
+{
+    // The size is kept in front of the block, as in download_table_bench
+    void *block = malloc(size + sizeof(std::max_align_t));
+    if (!block)
+        throw std::bad_alloc();
+    *(size_t*)block = size;
+    s_allocations++;
+    return (char*)block + sizeof(std::max_align_t);
+}
+
+// Not inlined, so the compiler doesn't pair the free of the block with the operator new of the caller
+BENCH_NOINLINE void operator delete(void *pointer) noexcept
+{
+    if (!pointer)
+        return;
+    free((char*)pointer - sizeof(std::max_align_t));
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+//! Same layout as Manifest::Asset of the engine
+struct Asset
+{
+    std::string md5;
+    std::string path;
+    bool compressed;
+    float size;
+    int downloadState;
+};
+
+//! Same strings as EventAssetsManagerEx and its EventCustom base
+struct Event
+{
+    Event(const std::string &eventName, int code, float percent, const std::string &assetId, const std::string &message)
+    : eventName(eventName), code(code), percent(percent), assetId(assetId), message(message)
+    {
+    }
+
+    std::string eventName;
+    int code;
+    float percent;
+    std::string assetId;
+    std::string message;
+};
+
+enum
+{
+    UPDATE_PROGRESSION = 5,
+    ASSET_UPDATED = 6
+};
+
+//! What a listener typically reads, so the events can't be optimized away
+static size_t s_checksum = 0;
+
+static BENCH_NOINLINE void dispatch(const Event &event)
+{
+    s_checksum += event.code + event.assetId.size() + event.message.size();
+}
+
+struct Result
+{
+    double allocations;
+    double ns;
+};
+
+static Result runCopying(const std::unordered_map<std::string, Asset> &assets, const std::vector<std::string> &keys,
+                         const std::string &eventName, const std::string &storage)
+{
+    std::function<bool(const std::string&, Asset)> verify = [](const std::string &path, Asset asset) {
+        return !path.empty() && asset.md5.size() == 32;
+    };
+    std::string path;
+    size_t allocations = s_allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &key : keys)
+    {
+        path.assign(storage).append(key);
+        auto it = assets.find(key);
+        Asset asset = it->second;
+        bool ok = verify(path, asset);
+        Event progress(eventName, UPDATE_PROGRESSION, 50.0f, key, "");
+        dispatch(progress);
+        if (ok)
+        {
+            Event updated(eventName, ASSET_UPDATED, 50.0f, key, "");
+            dispatch(updated);
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return { (double)(s_allocations - allocations) / keys.size(), ns / keys.size() };
+}
+
+static Result runPooled(const std::unordered_map<std::string, Asset> &assets, const std::vector<std::string> &keys,
+                        const std::string &eventName, const std::string &storage)
+{
+    std::function<bool(const std::string&, const Asset&)> verify = [](const std::string &path, const Asset &asset) {
+        return !path.empty() && asset.md5.size() == 32;
+    };
+    std::string path;
+    Event pooled(eventName, 0, 0, "", "");
+    auto refill = [&pooled](int code, const std::string &assetId) {
+        pooled.code = code;
+        pooled.percent = 50.0f;
+        pooled.assetId.assign(assetId);
+        pooled.message.clear();
+        dispatch(pooled);
+    };
+    size_t allocations = s_allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &key : keys)
+    {
+        path.assign(storage).append(key);
+        auto it = assets.find(key);
+        bool ok = verify(path, it->second);
+        refill(UPDATE_PROGRESSION, key);
+        if (ok)
+        {
+            refill(ASSET_UPDATED, key);
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return { (double)(s_allocations - allocations) / keys.size(), ns / keys.size() };
+}
+
+int main(int argc, char *argv[])
+{
+    int fileCount = 100000;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--files") == 0)
+            fileCount = atoi(argv[i + 1]);
+    }
+    if (fileCount <= 0)
+    {
+        fprintf(stderr, "Usage: success_path_bench [--files N]\n");
+        return 1;
+    }
+
+    // Key, md5 and event name as long as on a device, all past the small string buffer
+    const std::string eventName = "__cocos_assets_manager_ex_event__0x7b2c41a9d0";
+    const std::string storage = "/data/user/0/com.example.game/files/hotupdate/storage_temp/";
+    std::unordered_map<std::string, Asset> assets;
+    std::vector<std::string> keys;
+    keys.reserve(fileCount);
+    for (int i = 0; i < fileCount; ++i)
+    {
+        char key[64], md5[40];
+        snprintf(key, sizeof(key), "res/dir%02d/asset%06d.png", i % 64, i);
+        snprintf(md5, sizeof(md5), "%08x%08x%08x%08x", i, i * 7, i * 13, i * 31);
+        keys.push_back(key);
+        assets.emplace(key, Asset{ md5, key, false, 4096, 0 });
+    }
+
+    Result copying = runCopying(assets, keys, eventName, storage);
+    Result pooled = runPooled(assets, keys, eventName, storage);
+    if (s_checksum == 0)
+        return 2;
+
+    printf("%d files, verify callback and two events per file\n", fileCount);
+    printf("copied asset, new events : %5.2f allocations/file, %6.1f ns/file\n", copying.allocations, copying.ns);
+    printf("const ref, pooled event  : %5.2f allocations/file, %6.1f ns/file\n", pooled.allocations, pooled.ns);
+    return 0;
+}
@@ -0,0 +1,161 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+/**
+ * thread_pool_driver: checks that ThreadPoolRunner runs its works on its own
+ * threads, delivers every done to the driving thread and stops cleanly.
+ *
+ * The dones go through a ManualAssetsScheduler updated by the main thread, as
+ * with a headless AssetsManagerEx. Checks that works run concurrently on at
+ * most the requested number of threads, that each done runs once on the main
+ * thread after its work, and that destroying the pool waits for the running
+ * works, drops the queued ones and skips the dones delivered but not run yet.
+ * Build it with -fsanitize=thread to report races between works and dones.
+ *
+ * Build: g++ -std=c++11 -O1 -g -fsanitize=thread -pthread -I<cocos2d-x> -I<cocos2d-x>/cocos
+ *            thread_pool_driver.cpp ../client/AssetsManagerExEnv.cpp
+ *            -lcocos2d -o thread_pool_driver
+ *
+ * Usage: thread_pool_driver [--threads count] [--works count]
+ */
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../client/AssetsManagerExEnv.h"
+
+USING_NS_CC_EXT;
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); s_failures++; } } while (0)
+
+int main(int argc, char *argv[])
+{
+    int threadCount = 4;
+    int workCount = 200;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--threads") == 0)
+            threadCount = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--works") == 0)
+            workCount = atoi(argv[i + 1]);
+    }
+    if (threadCount < 1)
+        threadCount = 1;
+    if (workCount < threadCount)
+        workCount = threadCount;
+
+    const std::thread::id mainThread = std::this_thread::get_id();
+    ManualAssetsScheduler scheduler;
+    auto deliver = [&scheduler](const std::function<void()> &done) {
+        scheduler.performInDriverThread(done);
+    };
+
+    // Every work runs once on a pool thread, every done once on the main thread after its work
+    std::atomic<int> running(0);
+    std::atomic<int> maxRunning(0);
+    std::atomic<int> onMainThread(0);
+    std::vector<int> worked(workCount, 0);
+    std::vector<int> completed(workCount, 0);
+    int doneCount = 0;
+    {
+        ThreadPoolRunner pool(threadCount, deliver);
+        for (int i = 0; i < workCount; ++i)
+        {
+            pool.runAsync([&, i]() {
+                if (std::this_thread::get_id() == mainThread)
+                    onMainThread++;
+                int now = ++running;
+                int seen = maxRunning.load();
+                while (now > seen && !maxRunning.compare_exchange_weak(seen, now))
+                {
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                worked[i]++;
+                running--;
+            }, [&, i]() {
+                CHECK(std::this_thread::get_id() == mainThread);
+                CHECK(worked[i] == 1);
+                completed[i]++;
+                doneCount++;
+            });
+        }
+        CHECK(pool.getQueuedCount() > 0);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (doneCount < workCount && std::chrono::steady_clock::now() < deadline)
+        {
+            scheduler.update(1.0f / 60);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        CHECK(pool.getQueuedCount() == 0);
+    }
+    CHECK(doneCount == workCount);
+    CHECK(onMainThread == 0);
+    CHECK(maxRunning <= threadCount);
+    CHECK(threadCount == 1 || maxRunning > 1);
+    for (int i = 0; i < workCount; ++i)
+    {
+        CHECK(worked[i] == 1 && completed[i] == 1);
+    }
+    printf("%d works on %d threads, at most %d at once\n", workCount, threadCount, maxRunning.load());
+
+    // Destroyed with works queued: the running ones finish, the queued ones and all dones are dropped
+    std::atomic<int> started(0);
+    std::atomic<int> finished(0);
+    int lateDones = 0;
+    {
+        ThreadPoolRunner pool(threadCount, deliver);
+        for (int i = 0; i < workCount; ++i)
+        {
+            pool.runAsync([&]() {
+                started++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                finished++;
+            }, [&]() {
+                lateDones++;
+            });
+        }
+        while (started < threadCount)
+        {
+            std::this_thread::yield();
+        }
+    }
+    CHECK(started == finished);
+    CHECK(started < workCount);
+    CHECK(scheduler.hasPendingFunctions());
+    scheduler.update(1.0f / 60);
+    CHECK(lateDones == 0);
+    printf("Destroyed after %d of %d works\n", started.load(), workCount);
+
+    printf("%s\n", s_failures == 0 ? "OK" : "FAILED");
+    return s_failures == 0 ? 0 : 2;
+}
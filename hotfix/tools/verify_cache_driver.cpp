@@ -0,0 +1,154 @@
+/****************************************************************************
+ Copyright (c) 2014 cocos2d-x.org
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * verify_cache_driver: checks that AssetsVerifyCache survives a save and load
+ * and only trusts files that didn't change.
+ *
+ * Marks a few files verified, saves the cache and loads it into another one,
+ * then checks what a resumed update relies on: unchanged files are trusted
+ * for the same md5 only, a file moved by a rename keeps its entry, a file
+ * replaced by another one or rewritten with another size isn't trusted, and a
+ * missing or broken cache file loads empty.
+ *
+ * Build: g++ -std=c++11 -O2 -I<cocos2d-x> -I<cocos2d-x>/cocos
+ *            verify_cache_driver.cpp ../client/AssetsVerifyCache.cpp -o verify_cache_driver
+ *
+ * Usage: verify_cache_driver [--dir path]
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "../client/AssetsVerifyCache.h"
+
+USING_NS_CC_EXT;
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); s_failures++; } } while (0)
+
+static bool writeFile(const std::string &path, const std::string &content)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool written = fwrite(content.data(), 1, content.size(), fp) == content.size();
+    return fclose(fp) == 0 && written;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string dir = "/tmp/verify_cache_driver";
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--dir") == 0)
+            dir = argv[i + 1];
+    }
+    dir += "/";
+    if (system(("rm -rf '" + dir + "' && mkdir -p '" + dir + "'").c_str()) != 0)
+    {
+        fprintf(stderr, "Can't create %s\n", dir.c_str());
+        return 1;
+    }
+    const std::string cachePath = dir + "verify.cache";
+
+    const int fileCount = 100;
+    AssetsVerifyCache cache;
+    for (int i = 0; i < fileCount; ++i)
+    {
+        std::string name = "asset" + std::to_string(i) + ".png";
+        CHECK(writeFile(dir + name, std::string(100 + i, 'a')));
+        cache.markVerified("res/" + name, dir + name, "md5-" + std::to_string(i));
+    }
+    // Keys may hold spaces
+    CHECK(writeFile(dir + "with space.txt", "content"));
+    cache.markVerified("res/with space.txt", dir + "with space.txt", "md5-space");
+    CHECK(cache.size() == fileCount + 1);
+    CHECK(cache.isVerified("res/asset0.png", dir + "asset0.png", "md5-0"));
+    CHECK(!cache.isVerified("res/asset0.png", dir + "asset0.png", "md5-1"));
+    CHECK(!cache.isVerified("res/unknown.png", dir + "asset0.png", "md5-0"));
+    CHECK(cache.save(cachePath));
+
+    // Round trip
+    AssetsVerifyCache loaded;
+    CHECK(loaded.load(cachePath));
+    CHECK(loaded.size() == fileCount + 1);
+    for (int i = 0; i < fileCount; ++i)
+    {
+        std::string name = "asset" + std::to_string(i) + ".png";
+        CHECK(loaded.isVerified("res/" + name, dir + name, "md5-" + std::to_string(i)));
+    }
+    CHECK(loaded.isVerified("res/with space.txt", dir + "with space.txt", "md5-space"));
+    AssetsVerifyCache::FileStat recorded, current;
+    CHECK(loaded.find("res/asset1.png", "md5-1", &recorded));
+    CHECK(AssetsVerifyCache::statFile(dir + "asset1.png", &current) && AssetsVerifyCache::sameStat(recorded, current));
+    CHECK(!loaded.find("res/asset1.png", "md5-2", &recorded));
+
+    // A rename, like the move from the temporary storage, keeps the entry valid
+    CHECK(rename((dir + "asset2.png").c_str(), (dir + "moved2.png").c_str()) == 0);
+    CHECK(loaded.isVerified("res/asset2.png", dir + "moved2.png", "md5-2"));
+    CHECK(!loaded.isVerified("res/asset2.png", dir + "asset2.png", "md5-2"));
+
+    // Another file with the same content renamed over it, or the same file rewritten with another size, isn't trusted
+    CHECK(writeFile(dir + "replacement", std::string(103, 'a')));
+    CHECK(rename((dir + "replacement").c_str(), (dir + "asset3.png").c_str()) == 0);
+    CHECK(!loaded.isVerified("res/asset3.png", dir + "asset3.png", "md5-3"));
+    CHECK(writeFile(dir + "asset4.png", std::string(10, 'b')));
+    CHECK(!loaded.isVerified("res/asset4.png", dir + "asset4.png", "md5-4"));
+
+    // Removed entries are gone after the next round trip, an unchanged cache isn't written again
+    loaded.remove("res/asset5.png");
+    CHECK(!loaded.isVerified("res/asset5.png", dir + "asset5.png", "md5-5"));
+    CHECK(loaded.save(cachePath));
+    CHECK(unlink(cachePath.c_str()) == 0);
+    CHECK(loaded.save(cachePath));
+    CHECK(access(cachePath.c_str(), F_OK) != 0);
+    loaded.markVerified("res/asset6.png", dir + "asset6.png", "md5-6b");
+    CHECK(loaded.save(cachePath));
+    AssetsVerifyCache reloaded;
+    CHECK(reloaded.load(cachePath));
+    CHECK(reloaded.size() == fileCount);
+    CHECK(!reloaded.isVerified("res/asset6.png", dir + "asset6.png", "md5-6"));
+    CHECK(reloaded.isVerified("res/asset6.png", dir + "asset6.png", "md5-6b"));
+
+    // Missing or broken files load empty
+    CHECK(!reloaded.load(dir + "missing.cache"));
+    CHECK(reloaded.size() == 0);
+    CHECK(writeFile(dir + "broken.cache", "not a verify cache\nres/a.png\t1\t2\t3\tmd5\n"));
+    CHECK(!reloaded.load(dir + "broken.cache"));
+    CHECK(reloaded.size() == 0);
+
+    if (system(("rm -rf '" + dir + "'").c_str()) != 0)
+    {
+        fprintf(stderr, "Can't remove %s\n", dir.c_str());
+    }
+    printf("%s\n", s_failures == 0 ? "OK" : "FAILED");
+    return s_failures == 0 ? 0 : 2;
+}